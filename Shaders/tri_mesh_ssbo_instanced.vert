@@ -26,15 +26,22 @@ layout (set = 0, binding = 0) uniform GPUGlobalInstanceData {
 
 struct GPUObjectData {
     mat4 model;
+    vec4 sphereBounds;
 };
 
 layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
     GPUObjectData objects[];
 } objectBuffer;
 
+// Written by indirect_cull.comp: object ids of all visible instances
+layout (std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+    uint ids[];
+} instanceBuffer;
+
 void main()
 {
-    mat4 modelMatrix = objectBuffer.objects[gl_InstanceIndex].model;
+    uint objectId = instanceBuffer.ids[gl_InstanceIndex];
+    mat4 modelMatrix = objectBuffer.objects[objectId].model;
     mat4 transform = globalData.camera.viewproj * modelMatrix;
 
     gl_Position = transform * vec4(vPosition, 1.0f);
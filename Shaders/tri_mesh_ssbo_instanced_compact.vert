@@ -0,0 +1,51 @@
+#version 460
+
+// P4hN2sC4bU2s: half position, octahedral normal, unorm color and uvs
+layout (location = 0) in vec4 vPosition;
+layout (location = 1) in vec2 vNormal;
+layout (location = 2) in vec4 vColor;
+layout (location = 3) in vec2 vTexCoord;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outTexCoord;
+
+struct GPUCameraData {
+    mat4 view;
+    mat4 proj;
+    mat4 viewproj;
+};
+
+struct GPUSceneData {
+    vec4 fog_color;
+    vec4 ambient_color;
+};
+
+layout (set = 0, binding = 0) uniform GPUGlobalInstanceData {
+    GPUCameraData camera;
+    GPUSceneData  scene;
+} globalData;
+
+struct GPUObjectData {
+    mat4 model;
+    vec4 sphereBounds;
+};
+
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    GPUObjectData objects[];
+} objectBuffer;
+
+// Written by indirect_cull.comp: object ids of all visible instances
+layout (std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+    uint ids[];
+} instanceBuffer;
+
+void main()
+{
+    uint objectId = instanceBuffer.ids[gl_InstanceIndex];
+    mat4 modelMatrix = objectBuffer.objects[objectId].model;
+    mat4 transform = globalData.camera.viewproj * modelMatrix;
+
+    gl_Position = transform * vec4(vPosition.xyz, 1.0f);
+    outColor = vColor.rgb;
+    outTexCoord = vTexCoord;
+}
\ No newline at end of file
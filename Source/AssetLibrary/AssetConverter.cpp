@@ -0,0 +1,532 @@
+#include "AssetConverter.h"
+
+#include <cctype>
+#include <chrono>
+
+#include "Core/FileMapping.h"
+#include "Core/ImageProcessing.h"
+#include "FileSystem/DirectoryIterator.h"
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+#include "Hashing.h"
+#include "tracy/Tracy.hpp"
+
+/**
+ * Cache Format
+ *
+ * [4 magic, 4 version, 8 count, entries...]
+ * Where each entry is:
+ * [8 source_hash, 8 path_len, path]
+ */
+static constexpr u32 Convert_Cache_Magic   = 0x564E4356;  // "VCNV"
+static constexpr u32 Convert_Cache_Version = 1;
+
+/** The file name of path, without its directory or extension */
+static Str file_stem(Str path)
+{
+    u64 begin = 0;
+    u64 end   = path.len;
+    for (u64 i = 0; i < path.len; ++i) {
+        char c = path.data[i];
+        if ((c == '/') || (c == '\\')) {
+            begin = i + 1;
+            end   = path.len;
+        } else if (c == '.') {
+            end = i;
+        }
+    }
+
+    if (end < begin) end = path.len;
+    return Str(path.data + begin, end - begin);
+}
+
+void AssetConverter::init(
+    ImporterRegistry*      registry,
+    EAssetCompressionLevel level,
+    EVertexFormat          vertex_format,
+    bool                   compress_textures)
+{
+    this->registry          = registry;
+    this->level             = level;
+    this->vertex_format     = vertex_format;
+    this->compress_textures = compress_textures;
+    hash_seed = (Asset_Converter_Version << 16) | (compress_textures << 15) |
+                (vertex_format << 8) | level;
+
+    entries.alloc = &System_Allocator;
+    cached_hashes.init(System_Allocator);
+    outputs.init(System_Allocator);
+}
+
+void AssetConverter::deinit()
+{
+    for (Entry& entry : entries) {
+        System_Allocator.release((umm)entry.input.data);
+        System_Allocator.release((umm)entry.output.data);
+        if (entry.error.len > 0) {
+            System_Allocator.release((umm)entry.error.data);
+        }
+    }
+    entries.release();
+
+    for (auto pair : cached_hashes) {
+        System_Allocator.release((umm)pair.key.data);
+    }
+    cached_hashes.release();
+    outputs.release();
+}
+
+bool AssetConverter::add(Str input, Str output)
+{
+    Entry entry;
+    entry.input  = input.clone(System_Allocator);
+    entry.output = output.clone(System_Allocator);
+
+    if (outputs.contains(output)) {
+        CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+        const Entry& other = entries[outputs[output]];
+        Str          error =
+            format(temp, LIT("{} converts to the same output"), other.input);
+
+        entry.failed = true;
+        entry.error  = error.clone(System_Allocator);
+        entries.add(entry);
+        return false;
+    }
+
+    // The key is the output of the entry, which lives as long as the map
+    outputs.add(entry.output, entries.size);
+    entries.add(entry);
+    return true;
+}
+
+bool AssetConverter::is_supported(Str path)
+{
+    Str extension = path.chop_left_last_of('.');
+
+    for (const Importer& importer : registry->importers) {
+        for (Str supported_extension : importer.file_extensions) {
+            if (extension == supported_extension) return true;
+        }
+    }
+
+    return false;
+}
+
+void AssetConverter::add_directory(Str directory, Str output_directory)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(4));
+
+    create_dir(output_directory);
+
+    DirectoryIterator it = open_dir(directory);
+    DEFER(it.close());
+
+    FileData it_data;
+    while (it.next_file(&it_data)) {
+        if (it_data.filename == LIT(".")) continue;
+        if (it_data.filename == LIT("..")) continue;
+
+        SAVE_ARENA(temp);
+
+        Str from = format(temp, LIT("{}/{}"), directory, it_data.filename);
+
+        if (it_data.attributes == FileAttributes::File) {
+            if (!is_supported(it_data.filename)) continue;
+
+            Str to = format(
+                temp,
+                LIT("{}/{}.asset"),
+                output_directory,
+                file_stem(it_data.filename));
+
+            add(from, to);
+        } else {
+            Str to =
+                format(temp, LIT("{}/{}"), output_directory, it_data.filename);
+            add_directory(from, to);
+        }
+    }
+}
+
+bool AssetConverter::add_from_directory(
+    Str path, Str directory, Str output_directory)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(4));
+
+    if ((path.len <= directory.len) || (path.data[directory.len] != '/') ||
+        (Str(path.data, directory.len) != directory))
+    {
+        return false;
+    }
+
+    if (!is_supported(path)) return false;
+
+    // Creates the subdirectories between directory and the file, like
+    // add_directory would
+    Str relative = Str(path.data + directory.len, path.len - directory.len);
+    u64 end      = 0;
+    for (u64 i = 1; i < relative.len; ++i) {
+        if (relative.data[i] != '/') continue;
+
+        SAVE_ARENA(temp);
+        create_dir(format(
+            temp,
+            LIT("{}{}"),
+            output_directory,
+            Str(relative.data, i)));
+        end = i;
+    }
+
+    Str to = format(
+        temp,
+        LIT("{}{}/{}.asset"),
+        output_directory,
+        Str(relative.data, end),
+        file_stem(path));
+
+    add(path, to);
+    return true;
+}
+
+/**
+ * Output of a manifest source: its relative path under output_directory, with
+ * the .asset extension. Sources that are absolute or go up a directory go in
+ * output_directory itself. Creates the directories on the way
+ */
+static Str manifest_output(Allocator& allocator, Str path, Str output_directory)
+{
+    while ((path.len > 2) && (path.data[0] == '.') && (path.data[1] == '/')) {
+        path = Str(path.data + 2, path.len - 2);
+    }
+
+    bool outside = (path.data[0] == '/') || (path.data[0] == '\\');
+    for (u64 i = 0; i < path.len; ++i) {
+        if (path.data[i] == ':') outside = true;
+        if ((i + 1 < path.len) && (path.data[i] == '.') &&
+            (path.data[i + 1] == '.'))
+        {
+            outside = true;
+        }
+    }
+
+    // The directory part of the path, without the trailing slash
+    u64 end = 0;
+    if (!outside) {
+        for (u64 i = 1; i < path.len; ++i) {
+            if ((path.data[i] != '/') && (path.data[i] != '\\')) continue;
+
+            CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+            create_dir(format(
+                temp,
+                LIT("{}/{}"),
+                output_directory,
+                Str(path.data, i)));
+            end = i;
+        }
+    }
+
+    if (end == 0) {
+        return format(
+            allocator,
+            LIT("{}/{}.asset"),
+            output_directory,
+            file_stem(path));
+    }
+
+    return format(
+        allocator,
+        LIT("{}/{}/{}.asset"),
+        output_directory,
+        Str(path.data, end),
+        file_stem(path));
+}
+
+bool AssetConverter::add_manifest(Str manifest_path, Str output_directory)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(4));
+
+    FileMapping manifest;
+    if (!manifest.open(manifest_path)) return false;
+    DEFER(manifest.close());
+
+    create_dir(output_directory);
+
+    Str text((char*)manifest.data.ptr, manifest.data.count);
+
+    u64 line_start = 0;
+    while (line_start < text.len) {
+        u64 line_end = line_start;
+        while ((line_end < text.len) && (text.data[line_end] != '\n')) {
+            line_end++;
+        }
+
+        u64 next_line = line_end + 1;
+
+        // Trim whitespace, including the \r of \r\n line endings
+        while ((line_start < line_end) && isspace(text.data[line_start])) {
+            line_start++;
+        }
+        while ((line_end > line_start) && isspace(text.data[line_end - 1])) {
+            line_end--;
+        }
+
+        Str line(text.data + line_start, line_end - line_start);
+        if ((line.len > 0) && (line.data[0] != '#')) {
+            SAVE_ARENA(temp);
+            add(line, manifest_output(temp, line, output_directory));
+        }
+
+        line_start = next_line;
+    }
+
+    return true;
+}
+
+bool AssetConverter::load_cache(Str path)
+{
+    FileMapping mapping;
+    if (!mapping.open(path)) return false;
+    DEFER(mapping.close());
+
+    RawReadTape input(Raw{mapping.data.ptr, mapping.data.count});
+
+    u32 magic, version;
+    u64 count;
+    if (!input.read_struct(magic) || (magic != Convert_Cache_Magic)) {
+        return false;
+    }
+    if (!input.read_struct(version) || (version != Convert_Cache_Version)) {
+        return false;
+    }
+    if (!input.read_struct(count)) return false;
+
+    for (u64 i = 0; i < count; ++i) {
+        u64 source_hash, path_len;
+        if (!input.read_struct(source_hash)) return false;
+        if (!input.read_struct(path_len)) return false;
+        if (path_len > mapping.data.count) return false;
+
+        char* data = (char*)System_Allocator.reserve(path_len);
+        if (input.read(data, path_len) != path_len) {
+            System_Allocator.release((umm)data);
+            return false;
+        }
+
+        Str source_path(data, path_len);
+        if (cached_hashes.contains(source_path)) {
+            System_Allocator.release((umm)data);
+            continue;
+        }
+
+        cached_hashes.add(source_path, source_hash);
+    }
+
+    return true;
+}
+
+bool AssetConverter::save_cache(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    // The sources of this run replace their cached hashes, and the ones of
+    // previous runs with other sources (e.g. another manifest) stay
+    TMap<Str, u64> merged;
+    merged.init(temp);
+
+    for (auto pair : cached_hashes) {
+        merged.add(pair.key, pair.val);
+    }
+
+    // Failed sources lose their hash, to be converted again next time
+    for (const Entry& entry : entries) {
+        const u64 hash = entry.failed ? 0 : entry.source_hash;
+        if (merged.contains(entry.input)) {
+            merged[entry.input] = hash;
+        } else {
+            merged.add(entry.input, hash);
+        }
+    }
+
+    u64 count = 0;
+    for (auto pair : merged) {
+        if (pair.val != 0) count++;
+    }
+
+    auto output = BufferedWriteTape<true>(open_file_write(path));
+
+    u32 magic   = Convert_Cache_Magic;
+    u32 version = Convert_Cache_Version;
+    if (!output.write(&magic, sizeof(magic))) return false;
+    if (!output.write(&version, sizeof(version))) return false;
+    if (!output.write(&count, sizeof(count))) return false;
+
+    for (auto pair : merged) {
+        if (pair.val == 0) continue;
+
+        u64 path_len = pair.key.len;
+        if (!output.write(&pair.val, sizeof(u64))) return false;
+        if (!output.write(&path_len, sizeof(path_len))) return false;
+        if (!output.write(pair.key.data, path_len)) return false;
+    }
+
+    return true;
+}
+
+void AssetConverter::run(JobSystem& jobs)
+{
+    ZoneScoped;
+    jobs.parallel_for(u32(entries.size), [this](u32 index) {
+        // Failed from the start, e.g. because of a duplicate output
+        if (entries[index].failed) return;
+        convert(entries[index]);
+    });
+}
+
+void AssetConverter::convert(Entry& entry)
+{
+    ZoneScoped;
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    DEFER(
+        entry.microseconds =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - start)
+                .count());
+
+    auto fail = [&entry](Str error) {
+        entry.failed = true;
+        entry.error  = error.clone(System_Allocator);
+    };
+
+    {
+        FileMapping source;
+        if (!source.open(entry.input)) {
+            fail(LIT("Could not read the source file"));
+            return;
+        }
+
+        entry.source_hash =
+            murmur_hash2(source.data.ptr, source.data.count, hash_seed);
+        source.close();
+    }
+
+    // The hash covers the settings through hash_seed, and the importer too,
+    // so that bumping its version converts its sources again
+    const Importer* importer = registry->find_importer(entry.input);
+    if (importer != nullptr) {
+        entry.source_hash =
+            DerivedDataCache::make_key(entry.source_hash, *importer);
+    }
+
+    // The map is only read while jobs run
+    bool unchanged = cached_hashes.contains(entry.input) &&
+                     (cached_hashes[entry.input] == entry.source_hash);
+    if (unchanged) {
+        FileMapping output;
+        if (output.open(entry.output)) {
+            output.close();
+            entry.skipped = true;
+            return;
+        }
+    }
+
+    u64 key = 0;
+    if ((derived_data != nullptr) && (importer != nullptr)) {
+        key = entry.source_hash;
+        if (derived_data->fetch(key, entry.output)) {
+            entry.cached = true;
+            return;
+        }
+    }
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(5));
+
+    auto import_result = registry->import_asset_from_file(entry.input, temp);
+    if (!import_result.ok()) {
+        fail(import_result.err());
+        return;
+    }
+
+    Asset asset = import_result.value();
+
+    // LODs and meshlets are built from the full precision vertices
+    if (asset.info.kind == AssetKind::Mesh) {
+        auto lods_result = build_mesh_lods(temp, asset);
+        if (!lods_result.ok()) {
+            fail(lods_result.err());
+            return;
+        }
+
+        asset = lods_result.value();
+
+        auto meshlets_result = build_mesh_meshlets(temp, asset);
+        if (!meshlets_result.ok()) {
+            fail(meshlets_result.err());
+            return;
+        }
+
+        asset = meshlets_result.value();
+    }
+
+    // Mips are filtered from the RGBA8 pixels, before they're encoded
+    if (asset.info.kind == AssetKind::Texture) {
+        auto mips_result = build_texture_mips(temp, asset);
+        if (!mips_result.ok()) {
+            fail(mips_result.err());
+            return;
+        }
+
+        asset = mips_result.value();
+    }
+
+    if ((asset.info.kind == AssetKind::Texture) && compress_textures) {
+        const TextureAsset& texture     = asset.info.texture;
+        const u64           pixel_count = u64(texture.width) * texture.height;
+
+        ETextureFormat format = TextureFormat::BC3;
+        if (is_opaque_rgba8(asset.blob.ptr, pixel_count)) {
+            format = TextureFormat::BC1;
+        }
+
+        auto compress_result = compress_texture(temp, asset, format);
+        if (!compress_result.ok()) {
+            fail(compress_result.err());
+            return;
+        }
+
+        asset = compress_result.value();
+    }
+
+    if ((asset.info.kind == AssetKind::Mesh) &&
+        (asset.info.mesh.format != vertex_format))
+    {
+        auto repack_result = repack_mesh(temp, asset, vertex_format);
+        if (!repack_result.ok()) {
+            fail(repack_result.err());
+            return;
+        }
+
+        asset = repack_result.value();
+        if (asset.info.mesh.format != vertex_format) {
+            print(
+                LIT("[convert] {}: does not fit {}, kept {}\n"),
+                entry.input,
+                vertex_format,
+                asset.info.mesh.format);
+        }
+    }
+
+    {
+        auto out_tape = BufferedWriteTape<true>(open_file_write(entry.output));
+        if (!asset.write(temp, &out_tape, true, false, level)) {
+            fail(LIT("Could not write the asset"));
+            return;
+        }
+    }
+
+    // Once the output is closed
+    if (key != 0) derived_data->store(key, entry.output);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "AssetLibrary.h"
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+#include "Core/JobSystem.h"
+#include "DerivedDataCache.h"
+
+/** Bump to reconvert every source, whatever the cache says */
+static constexpr u32 Asset_Converter_Version = 5;
+
+/**
+ * Converts source files (OBJ, PNG, ...) to assets in bulk. Each file is
+ * imported and written by a job of its own, with its own arena.
+ *
+ * A build cache keeps the hash of every source converted by the previous run,
+ * and sources whose hash didn't change are skipped, as long as their output
+ * is still there. Sources that did change may still be found in the derived
+ * data cache, if there is one, which is shared between runs and outputs.
+ */
+struct AssetConverter {
+    struct Entry {
+        Str input;
+        Str output;
+        /**
+         * Hash of the source file, the settings and its importer, zero if it
+         * couldn't be read
+         */
+        u64 source_hash = 0;
+
+        bool skipped = false;
+        /** The output was copied from the derived data cache */
+        bool cached  = false;
+        bool failed  = false;
+        /** Why the conversion failed */
+        Str  error;
+        /** Time spent hashing, importing and writing */
+        u64  microseconds = 0;
+    };
+
+    /**
+     * @param vertex_format Format meshes are repacked to, see repack_mesh.
+     * Meshes that don't fit it keep the format they were imported with
+     * @param compress_textures Encode textures to BC1, or BC3 if they have
+     * any transparency, see compress_texture
+     */
+    void init(
+        ImporterRegistry*      registry,
+        EAssetCompressionLevel level,
+        EVertexFormat          vertex_format     = VertexFormat::P3fN3fC3fU2f,
+        bool                   compress_textures = false);
+    void deinit();
+
+    /**
+     * Adds a source, unless another one already converts to output, since
+     * both would write it at the same time. The source is then added as
+     * failed instead
+     * @return false if output was taken
+     */
+    bool add(Str input, Str output);
+
+    /**
+     * Adds every file under directory that an importer supports. Outputs are
+     * placed under output_directory, in the same structure
+     */
+    void add_directory(Str directory, Str output_directory);
+
+    /**
+     * Adds a single file from under directory, if an importer supports it.
+     * Its output goes where add_directory would put it
+     * @return false if the file isn't supported, or isn't under directory
+     */
+    bool add_from_directory(Str path, Str directory, Str output_directory);
+
+    /**
+     * Adds every line of a manifest file as a source. Blank lines and lines
+     * starting with # are ignored. Outputs are placed under output_directory
+     * at the relative path of their source, or in it directly for sources
+     * outside of the working directory
+     * @return false if the manifest couldn't be read
+     */
+    bool add_manifest(Str manifest_path, Str output_directory);
+
+    /**
+     * Reads the cache of a previous run
+     * @return false if there's no valid cache, in which case every source
+     * will be converted
+     */
+    bool load_cache(Str path);
+
+    /**
+     * Writes the hashes of the sources that converted (or were skipped),
+     * along with the ones loaded by load_cache for sources this run didn't
+     * have
+     */
+    bool save_cache(Str path);
+
+    /** Converts every entry that isn't up to date */
+    void run(JobSystem& jobs);
+
+    TArray<Entry> entries;
+
+    /** Optional. Converted assets are fetched from and stored to it */
+    DerivedDataCache* derived_data = nullptr;
+
+private:
+    void convert(Entry& entry);
+    bool is_supported(Str path);
+
+    ImporterRegistry*      registry;
+    EAssetCompressionLevel level;
+    EVertexFormat          vertex_format;
+    bool                   compress_textures;
+    u32                    hash_seed;
+
+    /** Source path to source hash, as of the previous run */
+    TMap<Str, u64> cached_hashes;
+    /** Output path to the entry that converts to it */
+    TMap<Str, u64> outputs;
+};
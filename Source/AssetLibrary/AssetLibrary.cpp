@@ -1,51 +1,359 @@
 #include "AssetLibrary.h"
 
+#include <algorithm>
+
 #include "Containers/Extras.h"
+#include "Core/ImageProcessing.h"
+#include "Core/JobSystem.h"
+#include "Core/MeshOptimizer.h"
+#include "Hashing.h"
 #include "Importers/DefaultImporters.h"
 #include "Memory/AllocTape.h"
 #include "Serialization/JSON.h"
 #include "lz4.h"
 #include "tracy/Tracy.hpp"
 
-bool Asset::write(Allocator& allocator, WriteTape* output, bool compress)
+#if ASSET_LZ4_HC
+#include "lz4hc.h"
+#endif
+
+static constexpr u32 Asset_Checksum_Seed = 0;
+
+#ifndef ASSET_VERIFY_CHECKSUMS
+#ifdef NDEBUG
+#define ASSET_VERIFY_CHECKSUMS 0
+#else
+#define ASSET_VERIFY_CHECKSUMS 1
+#endif
+#endif
+
+static u64 block_table_size(u32 block_count)
+{
+    return sizeof(AssetBlockTableHeader) + (u64(block_count) + 1) * sizeof(u64);
+}
+
+/** The block table of an LZ4Chunked blob. See Asset_Block_Size */
+struct BlockTable {
+    u32       block_size;
+    u32       block_count;
+    u64       actual_size;
+    Slice<u8> stored_blob;
+
+    /** Offsets may be unaligned, since the blob follows the header */
+    u64 offset(u32 index) const
+    {
+        u64 result;
+        memcpy(
+            &result,
+            stored_blob.ptr + sizeof(AssetBlockTableHeader) +
+                u64(index) * sizeof(u64),
+            sizeof(result));
+        return result;
+    }
+
+    Slice<u8> stored_block(u32 index) const
+    {
+        u64 begin = offset(index);
+        return slice(stored_blob.ptr + begin, offset(index + 1) - begin);
+    }
+
+    u64 block_begin(u32 index) const { return u64(index) * block_size; }
+
+    u32 block_actual_size(u32 index) const
+    {
+        return (u32)std::min<u64>(block_size, actual_size - block_begin(index));
+    }
+};
+
+static bool read_block_table(
+    const AssetInfo& info, Slice<u8> stored_blob, BlockTable& table)
+{
+    AssetBlockTableHeader header;
+    if (stored_blob.size() < sizeof(header)) return false;
+    memcpy(&header, stored_blob.ptr, sizeof(header));
+
+    if ((header.block_size == 0) ||
+        (header.block_size > LZ4_MAX_INPUT_SIZE))
+        return false;
+
+    u64 block_count =
+        (info.actual_size + header.block_size - 1) / header.block_size;
+    if (block_count != header.block_count) return false;
+    if (stored_blob.size() < block_table_size(header.block_count))
+        return false;
+
+    table = {
+        .block_size  = header.block_size,
+        .block_count = header.block_count,
+        .actual_size = info.actual_size,
+        .stored_blob = stored_blob,
+    };
+
+    // Validate the offsets up front, so blocks can be read unchecked
+    u64 max_stored_size = (u64)LZ4_compressBound((int)header.block_size);
+    u64 previous        = block_table_size(header.block_count);
+    if (table.offset(0) != previous) return false;
+
+    for (u32 i = 0; i < table.block_count; ++i) {
+        u64 next = table.offset(i + 1);
+        if ((next < previous) || ((next - previous) > max_stored_size))
+            return false;
+        previous = next;
+    }
+
+    return previous <= stored_blob.size();
+}
+
+static int compress_block(
+    const u8*              src,
+    int                    size,
+    u8*                    dst,
+    int                    capacity,
+    EAssetCompressionLevel level)
+{
+#if ASSET_LZ4_HC
+    if (level == AssetCompressionLevel::High) {
+        return LZ4_compress_HC(
+            (const char*)src,
+            (char*)dst,
+            size,
+            capacity,
+            LZ4HC_CLEVEL_DEFAULT);
+    }
+#endif
+
+    return LZ4_compress_default((const char*)src, (char*)dst, size, capacity);
+}
+
+/** Compresses blob into an LZ4Chunked blob, allocated from allocator */
+static Slice<u8> compress_chunked(
+    Allocator& allocator, Slice<u8> blob, EAssetCompressionLevel level)
+{
+    ZoneScoped;
+
+    u64 block_count64 = (blob.size() + Asset_Block_Size - 1) / Asset_Block_Size;
+    ASSERT(block_count64 < NumProps<u32>::max);
+
+    const u32 block_count = (u32)block_count64;
+    const u64 table_size  = block_table_size(block_count);
+    const u64 block_bound = (u64)LZ4_compressBound(Asset_Block_Size);
+
+    // Every block gets room for its worst case, and the blocks are packed
+    // together after they are all compressed
+    u64 capacity = table_size + block_count * block_bound;
+    u8* ptr      = (u8*)allocator.reserve(capacity);
+    u8* offsets  = ptr + sizeof(AssetBlockTableHeader);
+
+    AssetBlockTableHeader header = {
+        .block_size  = Asset_Block_Size,
+        .block_count = block_count,
+    };
+    memcpy(ptr, &header, sizeof(header));
+
+    JobSystem::shared().parallel_for(block_count, [&](u32 index) {
+        u64       begin = u64(index) * Asset_Block_Size;
+        u64       left  = blob.size() - begin;
+        int       size  = (int)std::min<u64>(Asset_Block_Size, left);
+        const u8* src   = blob.ptr + begin;
+        u8*       dst   = ptr + table_size + index * block_bound;
+
+        int compressed_size =
+            compress_block(src, size, dst, (int)block_bound, level);
+
+        // Keep blocks that don't shrink as they are
+        if ((compressed_size <= 0) || (compressed_size >= size)) {
+            memcpy(dst, src, size);
+            compressed_size = size;
+        }
+
+        // Until the blocks are packed, offsets[i + 1] holds the size of block i
+        u64 stored_size = (u64)compressed_size;
+        memcpy(offsets + (index + 1) * sizeof(u64), &stored_size, sizeof(u64));
+    });
+
+    // Pack the blocks, replacing the sizes with offsets on the way
+    u64 offset = table_size;
+    for (u32 i = 0; i < block_count; ++i) {
+        u64 stored_size;
+        memcpy(&stored_size, offsets + (i + 1) * sizeof(u64), sizeof(u64));
+
+        memmove(ptr + offset, ptr + table_size + i * block_bound, stored_size);
+        memcpy(offsets + i * sizeof(u64), &offset, sizeof(u64));
+        offset += stored_size;
+    }
+    memcpy(offsets + block_count * sizeof(u64), &offset, sizeof(u64));
+
+    return slice(ptr, offset);
+}
+
+static bool unpack_block(const BlockTable& table, u32 index, u8* dst)
 {
-    AssetHeader    header;
-    AllocWriteTape info_tape(allocator);
+    Slice<u8> stored = table.stored_block(index);
+    u32       size   = table.block_actual_size(index);
+
+    if (stored.size() == size) {
+        memcpy(dst, stored.ptr, size);
+        return true;
+    }
+
+    int result = LZ4_decompress_safe(
+        (const char*)stored.ptr,
+        (char*)dst,
+        (int)stored.size(),
+        (int)size);
+
+    return result == (int)size;
+}
+
+static BinaryAssetHeader make_binary_header(
+    const AssetInfo& info, u64 blob_size, u64 blob_checksum)
+{
+    BinaryAssetHeader header = {};
+
+    header.magic              = Binary_Asset_Magic;
+    header.header_version     = Binary_Asset_Header_Version;
+    header.header_size        = sizeof(BinaryAssetHeader);
+    header.version            = (u32)info.version;
+    header.kind               = info.kind;
+    header.compression        = info.compression;
+    header.actual_size        = info.actual_size;
+    header.blob_size          = blob_size;
+    header.blob_checksum      = blob_checksum;
+
+    switch (info.kind) {
+        case AssetKind::Texture: {
+            header.texture = {
+                .width     = info.texture.width,
+                .height    = info.texture.height,
+                .depth     = info.texture.depth,
+                .format    = info.texture.format,
+                .mip_count = info.texture.mip_count,
+            };
+        } break;
+
+        case AssetKind::Mesh: {
+            const MeshBounds& bounds = info.mesh.bounds;
+            BinaryMeshInfo&   mesh   = header.mesh;
+
+            mesh.vertex_buffer_size = info.mesh.vertex_buffer_size;
+            mesh.index_buffer_size  = info.mesh.index_buffer_size;
+            mesh.bounds_radius      = bounds.radius;
+            mesh.format             = info.mesh.format;
+            mesh.index_format       = info.mesh.index_format;
+            mesh.lod_count          = info.mesh.lod_count;
+            mesh.meshlet_count      = info.mesh.meshlet_count;
+            for (int i = 0; i < 3; ++i) {
+                mesh.bounds_origin[i]  = bounds.origin[i];
+                mesh.bounds_extents[i] = bounds.extents[i];
+            }
+        } break;
+
+        default:
+            break;
+    }
 
+    return header;
+}
+
+static AssetInfo read_binary_header(const BinaryAssetHeader& header)
+{
+    AssetInfo info = {};
+
+    info.version     = (int)header.version;
+    info.kind        = (EAssetKind)header.kind;
+    info.compression = (EAssetCompression)header.compression;
+    info.actual_size = header.actual_size;
+
+    switch (info.kind) {
+        case AssetKind::Texture: {
+            info.texture = {
+                .width     = header.texture.width,
+                .height    = header.texture.height,
+                .depth     = header.texture.depth,
+                .format    = (ETextureFormat)header.texture.format,
+                .mip_count = header.texture.mip_count,
+            };
+        } break;
+
+        case AssetKind::Mesh: {
+            const BinaryMeshInfo& mesh = header.mesh;
+
+            info.mesh = {
+                .vertex_buffer_size = mesh.vertex_buffer_size,
+                .index_buffer_size  = mesh.index_buffer_size,
+                .bounds =
+                    {
+                        .origin = glm::vec3(
+                            mesh.bounds_origin[0],
+                            mesh.bounds_origin[1],
+                            mesh.bounds_origin[2]),
+                        .radius  = mesh.bounds_radius,
+                        .extents = glm::vec3(
+                            mesh.bounds_extents[0],
+                            mesh.bounds_extents[1],
+                            mesh.bounds_extents[2]),
+                    },
+                .format        = (EVertexFormat)mesh.format,
+                .index_format  = (EIndexFormat)mesh.index_format,
+                .lod_count     = mesh.lod_count,
+                .meshlet_count = mesh.meshlet_count,
+            };
+        } break;
+
+        default:
+            break;
+    }
+
+    info.blob_size   = header.blob_size;
+    info.blob_offset = header.header_size;
+    info.checksum    = header.blob_checksum;
+    return info;
+}
+
+bool Asset::write(
+    Allocator&             allocator,
+    WriteTape*             output,
+    bool                   compress,
+    bool                   json_info,
+    EAssetCompressionLevel level)
+{
     Slice<u8> compressed_blob = blob;
 
     bool did_compress = false;
 
     // Compress if needed
     if (!info.is_compressed() && compress) {
-        ASSERT(blob.size() < NumProps<int>::max);
-
-        int max_size = LZ4_compressBound((int)blob.size());
-        umm ptr      = (umm)allocator.reserve(max_size);
+        compressed_blob = compress_chunked(allocator, blob, level);
 
-        int compressed_size = LZ4_compress_default(
-            (const char*)blob.ptr,
-            (char*)ptr,
-            (int)blob.size(),
-            (int)max_size);
-
-        if (compressed_size == 0) return false;
-        compressed_blob = slice(ptr, compressed_size);
-
-        info.compression = AssetCompression::LZ4;
+        info.compression = AssetCompression::LZ4Chunked;
         did_compress     = true;
     }
 
     DEFER(if (did_compress) allocator.release(compressed_blob.ptr));
 
-    json_serialize_pretty(&info_tape, &info);
-    DEFER(info_tape.release());
+    if (json_info) {
+        AssetHeader    header;
+        AllocWriteTape info_tape(allocator);
 
-    header.info_len  = (u32)info_tape.offset;
-    header.blob_size = did_compress ? compressed_blob.size() : blob.size();
+        json_serialize_pretty(&info_tape, &info);
+        DEFER(info_tape.release());
 
-    if (!output->write(&header, sizeof(header))) return false;
-    if (!output->write(info_tape.ptr, header.info_len)) return false;
+        header.info_len  = (u32)info_tape.offset;
+        header.blob_size = compressed_blob.size();
+
+        if (!output->write(&header, sizeof(header))) return false;
+        if (!output->write(info_tape.ptr, header.info_len)) return false;
+    } else {
+        u64 checksum = murmur_hash2(
+            compressed_blob.ptr,
+            compressed_blob.size(),
+            Asset_Checksum_Seed);
+
+        BinaryAssetHeader header =
+            make_binary_header(info, compressed_blob.size(), checksum);
+
+        if (!output->write(&header, sizeof(header))) return false;
+    }
 
     if (!output->write(compressed_blob.ptr, compressed_blob.size()))
         return false;
@@ -56,18 +364,40 @@ bool Asset::write(Allocator& allocator, WriteTape* output, bool compress)
 Result<AssetInfo, EAssetLoadError> Asset::probe(
     Allocator& allocator, ReadTape* input)
 {
-    AssetHeader   header;
-    AssetInfo     asset_info;
     ParseReadTape pt(*input);
     DEFER(pt.restore());
 
-    if (!pt.read_struct(header)) return Err(AssetLoadError::InvalidFormat);
+    u32 magic;
+    if (!pt.read_struct(magic)) return Err(AssetLoadError::InvalidFormat);
+
+    if (magic == Binary_Asset_Magic) {
+        BinaryAssetHeader header;
+        header.magic = magic;
 
+        // Read the rest of the header, and nothing else
+        u64 rest = sizeof(header) - sizeof(magic);
+        if (pt.read((u8*)&header + sizeof(magic), rest) != rest) {
+            return Err(AssetLoadError::InvalidFormat);
+        }
+
+        if (header.header_size < sizeof(BinaryAssetHeader)) {
+            return Err(AssetLoadError::InvalidFormat);
+        }
+
+        return Ok(read_binary_header(header));
+    }
+
+    // JSON info: the magic was the info length
+    u32 info_len = magic;
+    u64 blob_size;
+    if (!pt.read_struct(blob_size)) return Err(AssetLoadError::InvalidFormat);
+
+    AssetInfo asset_info;
     if (!deserialize(&pt, allocator, asset_info, json_deserialize))
         return Err(AssetLoadError::InvalidFormat);
 
-    asset_info.blob_size   = header.blob_size;
-    asset_info.blob_offset = sizeof(AssetHeader) + header.info_len;
+    asset_info.blob_size   = blob_size;
+    asset_info.blob_offset = sizeof(AssetHeader) + info_len;
     return Ok(asset_info);
 }
 
@@ -94,35 +424,259 @@ Result<void, EAssetLoadError> Asset::unpack(
         DEFER(allocator.release(compressed_blob.ptr));
         // Read in the compressed blob
 
-        if (!input->read(compressed_blob.ptr, compressed_blob.size())) {
+        if (input->read(compressed_blob.ptr, compressed_blob.size()) !=
+            compressed_blob.size())
+        {
             return Err(AssetLoadError::InvalidFormat);
         }
 
-        // @note: For now we only have LZ4 compression
+        return Asset::unpack(info, compressed_blob, buffer);
+    } else {
+        ZoneScopedN("Static Load");
+
+        if (input->read(buffer.ptr, info.actual_size) != info.actual_size) {
+            return Err(AssetLoadError::InvalidFormat);
+        }
+
+#if ASSET_VERIFY_CHECKSUMS
+        // Only covers the whole blob when nothing follows the data
+        if ((info.blob_size == info.actual_size) &&
+            !Asset::verify(info, slice(buffer.ptr, info.actual_size)))
+        {
+            return Err(AssetLoadError::ChecksumMismatch);
+        }
+#endif
+        return Ok<void>();
+    }
+}
+
+bool Asset::verify(const AssetInfo& info, Slice<u8> stored_blob)
+{
+    ZoneScoped;
+
+    if (info.checksum == 0) return true;
+
+    const u64 checksum = murmur_hash2(
+        stored_blob.ptr,
+        stored_blob.size(),
+        Asset_Checksum_Seed);
+    return checksum == info.checksum;
+}
+
+Result<void, EAssetLoadError> Asset::unpack(
+    const AssetInfo& info, Slice<u8> stored_blob, Slice<u8>& buffer)
+{
+    ZoneScoped;
+
+    if (info.actual_size > buffer.size()) {
+        return Err(AssetLoadError::Unknown);
+    }
+
+#if ASSET_VERIFY_CHECKSUMS
+    if (!Asset::verify(info, stored_blob)) {
+        return Err(AssetLoadError::ChecksumMismatch);
+    }
+#endif
+
+    if (info.compression == AssetCompression::LZ4Chunked) {
+        ZoneScopedN("Unpack Blocks");
+
+        BlockTable table;
+        if (!read_block_table(info, stored_blob, table)) {
+            return Err(AssetLoadError::InvalidFormat);
+        }
+
+        std::atomic<bool> failed = false;
+        JobSystem::shared().parallel_for(table.block_count, [&](u32 index) {
+            u8* dst = buffer.ptr + table.block_begin(index);
+            if (!unpack_block(table, index, dst)) failed.store(true);
+        });
+
+        if (failed.load()) {
+            return Err(AssetLoadError::CompressionFailed);
+        }
+    } else if (info.compression == AssetCompression::LZ4) {
+        if ((stored_blob.size() > LZ4_MAX_INPUT_SIZE) ||
+            (info.actual_size > NumProps<int>::max))
+        {
+            return Err(AssetLoadError::CompressionFailed);
+        }
+
         int result = 0;
 
         {
             ZoneScopedN("LZ4_decompress_safe");
             result = LZ4_decompress_safe(
-                (const char*)compressed_blob.ptr,
+                (const char*)stored_blob.ptr,
                 (char*)buffer.ptr,
-                compressed_blob.size(),
-                (int)buffer.size());
+                (int)stored_blob.size(),
+                (int)info.actual_size);
         }
 
         if (result <= 0) {
             return Err(AssetLoadError::CompressionFailed);
         }
-
-        return Ok<void>();
     } else {
         ZoneScopedN("Static Load");
 
-        if (input->read(buffer.ptr, info.actual_size) != info.actual_size) {
+        if (stored_blob.size() < info.actual_size) {
             return Err(AssetLoadError::InvalidFormat);
         }
-        return Ok<void>();
+
+        memcpy(buffer.ptr, stored_blob.ptr, info.actual_size);
+    }
+
+    return Ok<void>();
+}
+
+Result<void, EAssetLoadError> Asset::unpack_range(
+    Allocator&       allocator,
+    const AssetInfo& info,
+    Slice<u8>        stored_blob,
+    u64              offset,
+    Slice<u8>&       buffer)
+{
+    ZoneScoped;
+
+    const u64 end = offset + buffer.size();
+    if ((end < offset) || (end > info.actual_size)) {
+        return Err(AssetLoadError::Unknown);
+    }
+
+    if (buffer.size() == 0) return Ok<void>();
+
+    if (info.compression == AssetCompression::LZ4Chunked) {
+        BlockTable table;
+        if (!read_block_table(info, stored_blob, table)) {
+            return Err(AssetLoadError::InvalidFormat);
+        }
+
+        const u32 first = (u32)(offset / table.block_size);
+        const u32 last  = (u32)((end - 1) / table.block_size);
+
+        // Blocks that stick out of the range go through scratch space; only
+        // the first and the last block can
+        const bool first_partial =
+            (table.block_begin(first) < offset) ||
+            (table.block_begin(first) + table.block_actual_size(first) > end);
+        const bool last_partial =
+            (last != first) &&
+            (table.block_begin(last) + table.block_actual_size(last) > end);
+
+        u64 scratch_size = u64(first_partial + last_partial) * table.block_size;
+        u8* scratch = scratch_size ? (u8*)allocator.reserve(scratch_size) : 0;
+        DEFER(if (scratch) allocator.release(scratch));
+
+        std::atomic<bool> failed = false;
+        JobSystem::shared().parallel_for(last - first + 1, [&](u32 i) {
+            const u32 index = first + i;
+            const u64 begin = table.block_begin(index);
+
+            bool partial = (index == first) ? first_partial
+                           : (index == last) ? last_partial
+                                             : false;
+
+            if (!partial) {
+                if (!unpack_block(table, index, buffer.ptr + (begin - offset)))
+                    failed.store(true);
+                return;
+            }
+
+            u8* block = scratch + ((index == first) ? 0 : u64(first_partial) *
+                                                              table.block_size);
+            if (!unpack_block(table, index, block)) {
+                failed.store(true);
+                return;
+            }
+
+            u64 copy_begin = std::max(begin, offset);
+            u64 copy_end =
+                std::min(begin + table.block_actual_size(index), end);
+            memcpy(
+                buffer.ptr + (copy_begin - offset),
+                block + (copy_begin - begin),
+                copy_end - copy_begin);
+        });
+
+        if (failed.load()) {
+            return Err(AssetLoadError::CompressionFailed);
+        }
+    } else if (info.compression == AssetCompression::LZ4) {
+        if ((stored_blob.size() > LZ4_MAX_INPUT_SIZE) ||
+            (end > NumProps<int>::max))
+        {
+            return Err(AssetLoadError::CompressionFailed);
+        }
+
+        // Whole blob compression can only stop early
+        u8* prefix = (u8*)allocator.reserve(end);
+        DEFER(allocator.release(prefix));
+
+        int result = LZ4_decompress_safe_partial(
+            (const char*)stored_blob.ptr,
+            (char*)prefix,
+            (int)stored_blob.size(),
+            (int)end,
+            (int)end);
+
+        if (result < (int)end) {
+            return Err(AssetLoadError::CompressionFailed);
+        }
+
+        memcpy(buffer.ptr, prefix + offset, buffer.size());
+    } else {
+        if (stored_blob.size() < end) {
+            return Err(AssetLoadError::InvalidFormat);
+        }
+
+        memcpy(buffer.ptr, stored_blob.ptr + offset, buffer.size());
     }
+
+    return Ok<void>();
+}
+
+Result<MappedAsset, EAssetLoadError> Asset::map(Allocator& allocator, Str path)
+{
+    ZoneScoped;
+
+    FileMapping mapping;
+    if (!mapping.open(path)) {
+        return Err(AssetLoadError::FileNotFound);
+    }
+
+    auto map_result = Asset::map_memory(allocator, mapping.data);
+    if (!map_result.ok()) {
+        mapping.close();
+        return Err(map_result.err());
+    }
+
+    MappedAsset result = map_result.value();
+    result.mapping     = mapping;
+    return Ok(result);
+}
+
+Result<MappedAsset, EAssetLoadError> Asset::map_memory(
+    Allocator& allocator, Slice<u8> file)
+{
+    RawReadTape input(Raw{file.ptr, file.count});
+
+    auto probe_result = Asset::probe(allocator, &input);
+    if (!probe_result.ok()) return Err(probe_result.err());
+
+    MappedAsset result;
+    result.info = probe_result.value();
+
+    u64 blob_end = u64(result.info.blob_offset) + result.info.blob_size;
+    if ((blob_end > file.count) ||
+        (!result.info.is_compressed() &&
+         (result.info.actual_size > result.info.blob_size)))
+    {
+        return Err(AssetLoadError::InvalidFormat);
+    }
+
+    result.stored_blob =
+        slice(file.ptr + result.info.blob_offset, result.info.blob_size);
+    return Ok(result);
 }
 
 Result<Asset, EAssetLoadError> Asset::load(
@@ -161,8 +715,28 @@ Result<Asset, EAssetLoadError> Asset::load(
 
 Result<Asset, EAssetLoadError> Asset::load(Allocator& allocator, Str path)
 {
-    BufferedReadTape<true> t(open_file_read(path));
-    return Asset::load(allocator, &t);
+    auto map_result = Asset::map(allocator, path);
+    if (!map_result.ok()) return Err(map_result.err());
+
+    MappedAsset mapped = map_result.value();
+    DEFER(mapped.release());
+
+    // Unpack straight from the mapping, instead of reading into a buffer
+    Slice<u8> blob = alloc_slice<u8>(allocator, mapped.info.actual_size);
+
+    auto unpack_result = mapped.unpack(blob);
+    if (!unpack_result.ok()) {
+        allocator.release(blob.ptr);
+        return Err(unpack_result.err());
+    }
+
+    Asset result = Asset{
+        .info = mapped.info,
+        .blob = blob,
+    };
+    result.info.compression = AssetCompression::None;
+
+    return Ok(result);
 }
 
 void ImporterRegistry::register_importer(const Importer& importer)
@@ -176,21 +750,24 @@ void ImporterRegistry::register_importer(const Importer& importer)
     importers.add(importer);
 }
 
-Result<Asset, Str> ImporterRegistry::import_asset_from_file(
-    Str path, Allocator& allocator)
+const Importer* ImporterRegistry::find_importer(Str path)
 {
-    Str       extension       = path.chop_left_last_of('.');
-    Importer* chosen_importer = 0;
+    Str extension = path.chop_left_last_of('.');
 
-    for (Importer& importer : importers) {
+    for (const Importer& importer : importers) {
         for (Str supported_extension : importer.file_extensions) {
-            if (extension == supported_extension) {
-                chosen_importer = &importer;
-                break;
-            }
+            if (extension == supported_extension) return &importer;
         }
     }
 
+    return 0;
+}
+
+Result<Asset, Str> ImporterRegistry::import_asset_from_file(
+    Str path, Allocator& allocator)
+{
+    const Importer* chosen_importer = find_importer(path);
+
     if (!chosen_importer) {
         return Err(LIT("No importer found for the specified file"));
     }
@@ -203,3 +780,410 @@ void ImporterRegistry::init_default_importers()
     importers.add(Stb_Image_Importer);
     importers.add(Tiny_OBJ_Loader_Importer);
 }
+
+Result<Asset, Str> repack_mesh(
+    Allocator& allocator, const Asset& asset, EVertexFormat format)
+{
+    if (asset.info.kind != AssetKind::Mesh) {
+        return Err(LIT("Not a mesh asset"));
+    }
+
+    if (asset.info.is_compressed()) {
+        return Err(LIT("Mesh asset must be unpacked before it's repacked"));
+    }
+
+    const MeshAsset& mesh = asset.info.mesh;
+    if (mesh.format == format) return Ok(asset);
+
+    if (mesh.format != VertexFormat::P3fN3fC3fU2f) {
+        return Err(LIT("Only P3fN3fC3fU2f meshes can be repacked"));
+    }
+
+    auto vertices = slice(
+        (Vertex_P3fN3fC3fU2f*)asset.blob.ptr,
+        mesh.vertex_buffer_size);
+
+    if (!vertex_format_fits(format, vertices)) return Ok(asset);
+
+    const u64 vertices_size = mesh.vertex_buffer_size * vertex_size_of(format);
+    const u64 indices_size  = asset.blob.count - vertices.size();
+
+    auto blob = alloc_slice<u8>(allocator, vertices_size + indices_size);
+    pack_vertices(format, vertices, blob.ptr);
+    memcpy(
+        blob.ptr + vertices_size,
+        asset.blob.ptr + vertices.size(),
+        indices_size);
+
+    Asset result            = asset;
+    result.blob             = blob;
+    result.info.actual_size = blob.count;
+    result.info.mesh.format = format;
+    return Ok(result);
+}
+
+/** Widens count indices in format at data to indices */
+static void read_indices(
+    const u8* data, EIndexFormat format, u64 count, Slice<u32> indices)
+{
+    for (u64 i = 0; i < count; ++i) {
+        if (format == IndexFormat::U16) {
+            u16 index;
+            memcpy(&index, data + i * sizeof(u16), sizeof(u16));
+            indices[i] = index;
+        } else {
+            memcpy(&indices[i], data + i * sizeof(u32), sizeof(u32));
+        }
+    }
+}
+
+/** Narrows indices to format, writing them to data */
+static void write_indices(u8* data, EIndexFormat format, Slice<u32> indices)
+{
+    for (u64 i = 0; i < indices.count; ++i) {
+        if (format == IndexFormat::U16) {
+            u16 index = (u16)indices[i];
+            memcpy(data + i * sizeof(u16), &index, sizeof(u16));
+        } else {
+            memcpy(data + i * sizeof(u32), &indices[i], sizeof(u32));
+        }
+    }
+}
+
+/** Simplification error allowed for the first LOD, relative to mesh extent */
+static constexpr f32 Mesh_Lod_Error = 0.01f;
+
+Result<Asset, Str> build_mesh_lods(Allocator& allocator, const Asset& asset)
+{
+    if (asset.info.kind != AssetKind::Mesh) {
+        return Err(LIT("Not a mesh asset"));
+    }
+
+    if (asset.info.is_compressed()) {
+        return Err(LIT("Mesh asset must be unpacked before LODs are built"));
+    }
+
+    const MeshAsset& mesh = asset.info.mesh;
+    if (mesh.lod_count > 0) return Ok(asset);
+
+    if (mesh.format != VertexFormat::P3fN3fC3fU2f) {
+        return Err(LIT("Only P3fN3fC3fU2f meshes can be simplified"));
+    }
+
+    const u64 vertex_count  = mesh.vertex_buffer_size;
+    const u64 index_count   = mesh.index_buffer_size;
+    const u32 index_size    = index_size_of(mesh.index_format);
+    const u64 vertices_size = vertex_count * sizeof(Vertex_P3fN3fC3fU2f);
+    const u8* index_data    = asset.blob.ptr + vertices_size;
+
+    // Scratch memory can get large, so it's not taken from allocator
+    auto indices    = alloc_slice<u32>(System_Allocator, index_count);
+    auto simplified = alloc_slice<u32>(System_Allocator, index_count);
+    DEFER(System_Allocator.release((umm)indices.ptr));
+    DEFER(System_Allocator.release((umm)simplified.ptr));
+
+    read_indices(index_data, mesh.index_format, index_count, indices);
+
+    TArray<u32> chain(&System_Allocator);
+    DEFER(chain.release());
+    for (u32 index : indices) chain.add(index);
+
+    MeshLod lods[Max_Mesh_Lods];
+    u32     lod_count = 1;
+    lods[0]           = {.first_index = 0, .index_count = (u32)index_count};
+
+    u64 target_count = index_count;
+    f32 target_error = Mesh_Lod_Error;
+    while (lod_count < Max_Mesh_Lods) {
+        target_count /= 2;
+        target_count -= target_count % 3;
+
+        u64 lod_index_count = simplify(
+            System_Allocator,
+            simplified,
+            indices,
+            asset.blob.ptr,
+            vertex_count,
+            sizeof(Vertex_P3fN3fC3fU2f),
+            target_count,
+            target_error);
+
+        // Not worth drawing instead of the previous LOD
+        const u64 previous_count = lods[lod_count - 1].index_count;
+        if ((lod_index_count == 0) ||
+            (lod_index_count > previous_count * 3 / 4))
+        {
+            break;
+        }
+
+        auto lod_indices = slice(simplified.ptr, lod_index_count);
+        optimize_vertex_cache(System_Allocator, lod_indices, vertex_count);
+
+        lods[lod_count++] = {
+            .first_index = (u32)chain.size,
+            .index_count = (u32)lod_index_count,
+        };
+        for (u32 index : lod_indices) chain.add(index);
+
+        target_error *= 2.0f;
+    }
+
+    if (lod_count == 1) return Ok(asset);
+
+    const u64 indices_size  = chain.size * index_size;
+    const u64 lods_size     = lod_count * sizeof(MeshLod);
+    const u64 meshlets_size = mesh.meshlet_count * sizeof(Meshlet);
+
+    auto blob = alloc_slice<u8>(
+        allocator,
+        vertices_size + indices_size + lods_size + meshlets_size);
+    memcpy(blob.ptr, asset.blob.ptr, vertices_size);
+
+    u8* out_indices = blob.ptr + vertices_size;
+    write_indices(out_indices, mesh.index_format, slice(chain));
+
+    // Meshlets are ranges of the full detail LOD, which is kept as it is
+    memcpy(out_indices + indices_size, lods, lods_size);
+    memcpy(
+        out_indices + indices_size + lods_size,
+        asset.blob.ptr + mesh_meshlets_offset(mesh),
+        meshlets_size);
+
+    Asset result                       = asset;
+    result.blob                        = blob;
+    result.info.actual_size            = blob.count;
+    result.info.mesh.index_buffer_size = chain.size;
+    result.info.mesh.lod_count         = lod_count;
+    return Ok(result);
+}
+
+u32 read_mesh_lods(const Asset& asset, MeshLod* lods)
+{
+    const MeshAsset& mesh = asset.info.mesh;
+
+    if (mesh.lod_count == 0) {
+        lods[0] = {
+            .first_index = 0,
+            .index_count = (u32)mesh.index_buffer_size,
+        };
+        return 1;
+    }
+
+    ASSERT(mesh.lod_count <= Max_Mesh_Lods);
+
+    // The table isn't aligned after 16 bit indices
+    const u64 table_offset =
+        mesh.vertex_buffer_size * vertex_size_of(mesh.format) +
+        mesh.index_buffer_size * index_size_of(mesh.index_format);
+    memcpy(
+        lods,
+        asset.blob.ptr + table_offset,
+        mesh.lod_count * sizeof(MeshLod));
+
+    return mesh.lod_count;
+}
+
+Result<Asset, Str> build_mesh_meshlets(Allocator& allocator, const Asset& asset)
+{
+    if (asset.info.kind != AssetKind::Mesh) {
+        return Err(LIT("Not a mesh asset"));
+    }
+
+    if (asset.info.is_compressed()) {
+        return Err(
+            LIT("Mesh asset must be unpacked before meshlets are built"));
+    }
+
+    const MeshAsset& mesh = asset.info.mesh;
+    if (mesh.meshlet_count > 0) return Ok(asset);
+
+    if (mesh.format != VertexFormat::P3fN3fC3fU2f) {
+        return Err(LIT("Only P3fN3fC3fU2f meshes can be split into meshlets"));
+    }
+
+    MeshLod lods[Max_Mesh_Lods];
+    read_mesh_lods(asset, lods);
+
+    const u64 vertex_count  = mesh.vertex_buffer_size;
+    const u32 index_size    = index_size_of(mesh.index_format);
+    const u64 vertices_size = vertex_count * sizeof(Vertex_P3fN3fC3fU2f);
+    const u64 index_count   = lods[0].index_count;
+    if (index_count == 0) return Ok(asset);
+
+    // Scratch memory can get large, so it's not taken from allocator
+    auto indices  = alloc_slice<u32>(System_Allocator, index_count);
+    auto meshlets = alloc_slice<Meshlet>(
+        System_Allocator,
+        meshlet_bound(index_count));
+    DEFER(System_Allocator.release((umm)indices.ptr));
+    DEFER(System_Allocator.release((umm)meshlets.ptr));
+
+    const u64 lod_offset =
+        vertices_size + u64(lods[0].first_index) * index_size;
+    read_indices(
+        asset.blob.ptr + lod_offset,
+        mesh.index_format,
+        index_count,
+        indices);
+
+    meshlets.count = build_meshlets(
+        System_Allocator,
+        meshlets,
+        indices,
+        asset.blob.ptr,
+        vertex_count,
+        sizeof(Vertex_P3fN3fC3fU2f));
+    compute_meshlet_bounds(
+        meshlets,
+        indices,
+        asset.blob.ptr,
+        sizeof(Vertex_P3fN3fC3fU2f));
+
+    // The table goes last, after everything the blob already had
+    const u64 meshlets_size = meshlets.count * sizeof(Meshlet);
+    ASSERT(mesh_meshlets_offset(mesh) == asset.blob.count);
+
+    auto blob = alloc_slice<u8>(allocator, asset.blob.count + meshlets_size);
+    memcpy(blob.ptr, asset.blob.ptr, asset.blob.count);
+    write_indices(blob.ptr + lod_offset, mesh.index_format, indices);
+    memcpy(blob.ptr + asset.blob.count, meshlets.ptr, meshlets_size);
+
+    Asset result                   = asset;
+    result.blob                    = blob;
+    result.info.actual_size        = blob.count;
+    result.info.mesh.meshlet_count = (u32)meshlets.count;
+    return Ok(result);
+}
+
+u64 mesh_meshlets_offset(const MeshAsset& mesh)
+{
+    return mesh.vertex_buffer_size * vertex_size_of(mesh.format) +
+           mesh.index_buffer_size * index_size_of(mesh.index_format) +
+           mesh.lod_count * sizeof(MeshLod);
+}
+
+void read_mesh_meshlets(const Asset& asset, Meshlet* meshlets)
+{
+    const MeshAsset& mesh = asset.info.mesh;
+
+    // Like the LOD table, the meshlet table isn't necessarily aligned
+    memcpy(
+        meshlets,
+        asset.blob.ptr + mesh_meshlets_offset(mesh),
+        mesh.meshlet_count * sizeof(Meshlet));
+}
+
+u64 texture_mip_size(ETextureFormat format, u32 width, u32 height)
+{
+    switch (format) {
+        case TextureFormat::R8G8B8A8UInt:
+            return u64(width) * u64(height) * 4;
+        case TextureFormat::BC1:
+            return block_count_of(width, height) * BC1_Block_Size;
+        case TextureFormat::BC3:
+            return block_count_of(width, height) * BC3_Block_Size;
+        default:
+            return 0;
+    }
+}
+
+u64 texture_mip_offset(const TextureAsset& texture, u32 mip)
+{
+    u64 result = 0;
+    for (u32 i = 0; i < mip; ++i) {
+        result += texture_mip_size(
+            texture.format,
+            mip_extent(texture.width, i),
+            mip_extent(texture.height, i));
+    }
+    return result;
+}
+
+Result<Asset, Str> build_texture_mips(Allocator& allocator, const Asset& asset)
+{
+    if (asset.info.kind != AssetKind::Texture) {
+        return Err(LIT("Not a texture asset"));
+    }
+
+    if (asset.info.is_compressed()) {
+        return Err(LIT("Texture asset must be unpacked before mips are built"));
+    }
+
+    const TextureAsset& texture = asset.info.texture;
+    if (texture.mip_count > 1) return Ok(asset);
+
+    if (texture.format != TextureFormat::R8G8B8A8UInt) {
+        return Err(LIT("Only R8G8B8A8UInt textures can be downsampled"));
+    }
+
+    TextureAsset with_mips = texture;
+    with_mips.mip_count    = mip_count_of(texture.width, texture.height);
+
+    const u64 size = texture_mip_offset(with_mips, with_mips.mip_count);
+    auto      blob = alloc_slice<u8>(allocator, size);
+    memcpy(blob.ptr, asset.blob.ptr, texture_mip_offset(with_mips, 1));
+
+    // Each mip is filtered from the one before it
+    for (u32 mip = 1; mip < with_mips.mip_count; ++mip) {
+        downsample_rgba8(
+            blob.ptr + texture_mip_offset(with_mips, mip - 1),
+            mip_extent(texture.width, mip - 1),
+            mip_extent(texture.height, mip - 1),
+            blob.ptr + texture_mip_offset(with_mips, mip));
+    }
+
+    Asset result            = asset;
+    result.blob             = blob;
+    result.info.actual_size = blob.count;
+    result.info.texture     = with_mips;
+    return Ok(result);
+}
+
+Result<Asset, Str> compress_texture(
+    Allocator& allocator, const Asset& asset, ETextureFormat format)
+{
+    if (asset.info.kind != AssetKind::Texture) {
+        return Err(LIT("Not a texture asset"));
+    }
+
+    if (asset.info.is_compressed()) {
+        return Err(LIT("Texture asset must be unpacked before it's encoded"));
+    }
+
+    const TextureAsset& texture = asset.info.texture;
+    if (texture.format == format) return Ok(asset);
+
+    if (texture.format != TextureFormat::R8G8B8A8UInt) {
+        return Err(LIT("Only R8G8B8A8UInt textures can be encoded"));
+    }
+
+    if ((format != TextureFormat::BC1) && (format != TextureFormat::BC3)) {
+        return Err(LIT("Textures can only be encoded to BC1 or BC3"));
+    }
+
+    TextureAsset encoded = texture;
+    encoded.format       = format;
+    encoded.mip_count    = texture_mip_count(texture);
+
+    const u64 size = texture_mip_offset(encoded, encoded.mip_count);
+    auto      blob = alloc_slice<u8>(allocator, size);
+
+    for (u32 mip = 0; mip < encoded.mip_count; ++mip) {
+        const u8* src    = asset.blob.ptr + texture_mip_offset(texture, mip);
+        u8*       dst    = blob.ptr + texture_mip_offset(encoded, mip);
+        const u32 width  = mip_extent(texture.width, mip);
+        const u32 height = mip_extent(texture.height, mip);
+
+        if (format == TextureFormat::BC1) {
+            encode_bc1(JobSystem::shared(), src, width, height, dst);
+        } else {
+            encode_bc3(JobSystem::shared(), src, width, height, dst);
+        }
+    }
+
+    Asset result            = asset;
+    result.blob             = blob;
+    result.info.actual_size = blob.count;
+    result.info.texture     = encoded;
+    return Ok(result);
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "Base.h"
+#include "Core/FileMapping.h"
 #include "Core/MathTypes.h"
+#include "Core/Meshlets.h"
 #include "Core/Utility.h"
 #include "Reflection.h"
 #include "Result.h"
@@ -39,6 +41,10 @@ namespace TextureFormat {
     {
         Unknown      = 0,
         R8G8B8A8UInt = 1,
+        /** 4x4 blocks of 8 bytes, without alpha */
+        BC1          = 2,
+        /** 4x4 blocks of 16 bytes, with alpha */
+        BC3          = 3,
     };
 }
 typedef TextureFormat::Type ETextureFormat;
@@ -46,12 +52,16 @@ typedef TextureFormat::Type ETextureFormat;
 PROC_FMT_ENUM(TextureFormat, {
     FMT_ENUM_CASE(TextureFormat, Unknown);
     FMT_ENUM_CASE(TextureFormat, R8G8B8A8UInt);
+    FMT_ENUM_CASE(TextureFormat, BC1);
+    FMT_ENUM_CASE(TextureFormat, BC3);
     FMT_ENUM_DEFAULT_CASE(Unknown);
 })
 
 PROC_PARSE_ENUM(TextureFormat, {
     PARSE_ENUM_CASE(TextureFormat, Unknown);
     PARSE_ENUM_CASE(TextureFormat, R8G8B8A8UInt);
+    PARSE_ENUM_CASE(TextureFormat, BC1);
+    PARSE_ENUM_CASE(TextureFormat, BC3);
 })
 
 namespace AssetLoadError {
@@ -61,6 +71,8 @@ namespace AssetLoadError {
         InvalidFormat,
         OutOfMemory,
         CompressionFailed,
+        FileNotFound,
+        ChecksumMismatch,
     };
 }
 typedef AssetLoadError::Type EAssetLoadError;
@@ -70,13 +82,18 @@ PROC_FMT_ENUM(AssetLoadError, {
     FMT_ENUM_CASE(AssetLoadError, InvalidFormat);
     FMT_ENUM_CASE(AssetLoadError, OutOfMemory);
     FMT_ENUM_CASE(AssetLoadError, CompressionFailed);
+    FMT_ENUM_CASE(AssetLoadError, FileNotFound);
+    FMT_ENUM_CASE(AssetLoadError, ChecksumMismatch);
 })
 
 namespace AssetCompression {
     enum Type : u32
     {
         None = 0,
-        LZ4
+        /** The whole blob compressed at once. Only read */
+        LZ4,
+        /** Independent blocks, see Asset_Block_Size */
+        LZ4Chunked,
     };
 }
 typedef AssetCompression::Type EAssetCompression;
@@ -84,19 +101,68 @@ typedef AssetCompression::Type EAssetCompression;
 PROC_FMT_ENUM(AssetCompression, {
     FMT_ENUM_CASE(AssetCompression, None);
     FMT_ENUM_CASE(AssetCompression, LZ4);
+    FMT_ENUM_CASE(AssetCompression, LZ4Chunked);
     FMT_ENUM_DEFAULT_CASE(None);
 })
 
 PROC_PARSE_ENUM(AssetCompression, {
     PARSE_ENUM_CASE(AssetCompression, None);
     PARSE_ENUM_CASE(AssetCompression, LZ4);
+    PARSE_ENUM_CASE(AssetCompression, LZ4Chunked);
 })
 
+namespace AssetCompressionLevel {
+    enum Type : u32
+    {
+        Default = 0,
+        /**
+         * LZ4 HC: slower to compress, same speed to decompress. Falls back
+         * to Default unless built with ASSET_LZ4_HC
+         */
+        High,
+    };
+}
+typedef AssetCompressionLevel::Type EAssetCompressionLevel;
+
+/**
+ * Uncompressed size of the blocks of LZ4Chunked blobs. Blocks are compressed
+ * independently, so they can be compressed and decompressed in parallel, and
+ * a range of the blob can be read without decompressing all of it.
+ *
+ * The stored blob starts with a block table:
+ * [4 block_size, 4 block_count, 8 offsets[block_count + 1], blocks...]
+ * Offsets are relative to the start of the stored blob, and block i takes
+ * [offsets[i], offsets[i + 1]). A block that didn't shrink is stored as is,
+ * and can be told apart by its stored size being equal to its size
+ */
+static constexpr u32 Asset_Block_Size = KILOBYTES(256);
+
+#pragma pack(push, 1)
+struct AssetBlockTableHeader {
+    u32 block_size;
+    u32 block_count;
+};
+#pragma pack(pop)
+
 struct TextureAsset {
     u32            width;
     u32            height;
     u32            depth;
     ETextureFormat format;
+    /**
+     * Mips in the blob, finest first and packed back to back. Zero in assets
+     * written before mips, which have a single one. See texture_mip_offset
+     */
+    u32            mip_count;
+};
+
+/** Most LODs a mesh asset has, including the full detail one */
+static constexpr u32 Max_Mesh_Lods = 4;
+
+/** A level of detail of a mesh, as a range of its indices */
+struct MeshLod {
+    u32 first_index;
+    u32 index_count;
 };
 
 struct MeshAsset {
@@ -104,6 +170,18 @@ struct MeshAsset {
     u64           index_buffer_size;
     MeshBounds    bounds;
     EVertexFormat format;
+    /** Indices follow the vertices in the blob, in this format */
+    EIndexFormat  index_format;
+    /**
+     * LODs in the index buffer, finest first, whose MeshLod table follows the
+     * indices in the blob. Zero if the indices are a single LOD
+     */
+    u32           lod_count;
+    /**
+     * Meshlets of the full detail LOD, whose Meshlet table follows the LOD
+     * table in the blob
+     */
+    u32           meshlet_count;
 };
 
 struct ArchiveAsset {};
@@ -135,8 +213,17 @@ struct AssetInfo {
     u64 blob_size   = 0;
     /** Blob offset from file start. Used when the blob hasn't been loaded */
     i64 blob_offset = 0;
+    /**
+     * Hash of the blob as stored in the file. Zero for assets written with a
+     * JSON info
+     */
+    u64 checksum    = 0;
 };
 
+/**
+ * Header of the asset format that stores the info as JSON, which is still
+ * read. The JSON info follows the header, and the blob follows the info
+ */
 #pragma pack(push, 1)
 struct AssetHeader {
     /** Length of asset info data */
@@ -145,16 +232,89 @@ struct AssetHeader {
 };
 #pragma pack(pop)
 
+/** "VAST" in little endian. Can't be confused with a JSON info length */
+static constexpr u32 Binary_Asset_Magic          = 0x54534156;
+static constexpr u16 Binary_Asset_Header_Version = 1;
+
+#pragma pack(push, 1)
+struct BinaryTextureInfo {
+    u32 width;
+    u32 height;
+    u32 depth;
+    u32 format;
+    /** Zero (a single mip) in headers written before it was added */
+    u32 mip_count;
+};
+
+struct BinaryMeshInfo {
+    u64   vertex_buffer_size;
+    u64   index_buffer_size;
+    float bounds_origin[3];
+    float bounds_radius;
+    float bounds_extents[3];
+    u32   format;
+    /** Zero (u32) in headers written before it was added */
+    u32   index_format;
+    /** Zero (no LODs) in headers written before it was added */
+    u32   lod_count;
+    /** Zero (no meshlets) in headers written before it was added */
+    u32   meshlet_count;
+};
+
+/**
+ * Fixed layout header of the binary asset format, directly followed by the
+ * blob. New fields may only be appended: header_size tells readers where the
+ * blob starts, so older readers can still read newer headers
+ */
+struct BinaryAssetHeader {
+    u32 magic;
+    u16 header_version;
+    u16 header_size;
+
+    u32 version;
+    u32 kind;
+    u32 compression;
+    u64 actual_size;
+    u64 blob_size;
+    /** Hash of the blob as stored in the file */
+    u64 blob_checksum;
+
+    union {
+        BinaryTextureInfo texture;
+        BinaryMeshInfo    mesh;
+        /** Room for the metadata of future kinds */
+        u8                reserved[64];
+    };
+};
+#pragma pack(pop)
+
+struct MappedAsset;
+
 struct Asset {
     AssetInfo info;
     Slice<u8> blob;
 
-    bool write(Allocator& allocator, WriteTape* output, bool comrpess = true);
+    /**
+     * @param json_info Write the info as JSON instead of a binary header, in
+     * the format used before binary headers. Only meant for compatibility
+     * testing
+     */
+    bool write(
+        Allocator&             allocator,
+        WriteTape*             output,
+        bool                   comrpess  = true,
+        bool                   json_info = false,
+        EAssetCompressionLevel level     = AssetCompressionLevel::Default);
 
     static Result<Asset, EAssetLoadError> load(
         Allocator& allocator, ReadTape* input);
     static Result<Asset, EAssetLoadError> load(Allocator& allocator, Str path);
 
+    /**
+     * Reads the info of the asset, leaving input where it was. Only the
+     * header is read for binary assets; the allocator is only used to parse
+     * JSON infos
+     */
     static Result<AssetInfo, EAssetLoadError> probe(
         Allocator& allocator, ReadTape* input);
 
@@ -163,6 +323,103 @@ struct Asset {
         const AssetInfo& info,
         ReadTape*        input,
         Slice<u8>&       buffer);
+
+    /**
+     * Whether the blob as stored in the file matches the checksum of its
+     * header. Assets written with a JSON info have none, and always match.
+     * The unpack functions check it in debug builds, or when
+     * ASSET_VERIFY_CHECKSUMS is set
+     */
+    static bool verify(const AssetInfo& info, Slice<u8> stored_blob);
+
+    /**
+     * Unpacks a blob that's already in memory (e.g. in a file mapping) into
+     * buffer, without staging it anywhere else
+     * @param stored_blob The blob as stored in the asset file
+     */
+    static Result<void, EAssetLoadError> unpack(
+        const AssetInfo& info, Slice<u8> stored_blob, Slice<u8>& buffer);
+
+    /**
+     * Unpacks buffer.size() bytes of the blob, starting at offset, into
+     * buffer (e.g. a single mip or submesh). Only the blocks that overlap the
+     * range are decompressed
+     * @param allocator Holds the blocks that only partly overlap the range,
+     * and the whole blob for assets compressed with the whole blob LZ4
+     * @note Never verifies the checksum, which would read the whole blob
+     */
+    static Result<void, EAssetLoadError> unpack_range(
+        Allocator&       allocator,
+        const AssetInfo& info,
+        Slice<u8>        stored_blob,
+        u64              offset,
+        Slice<u8>&       buffer);
+
+    /**
+     * Maps the asset file at path and reads its info. The blob is not read
+     * until it's unpacked (or accessed, if the asset is uncompressed)
+     */
+    static Result<MappedAsset, EAssetLoadError> map(
+        Allocator& allocator, Str path);
+
+    /**
+     * Reads the info of an asset file that's already in memory (e.g. in a
+     * pak), like map. The result doesn't own file, so releasing it does
+     * nothing
+     */
+    static Result<MappedAsset, EAssetLoadError> map_memory(
+        Allocator& allocator, Slice<u8> file);
+};
+
+/**
+ * An asset file mapped into memory by Asset::map. The blob of an uncompressed
+ * asset can be used in place, straight from the mapping; compressed assets
+ * have to be unpacked. Either way, nothing points into the mapping after
+ * release
+ */
+struct MappedAsset {
+    AssetInfo   info;
+    /** The blob as stored in the file, possibly compressed */
+    Slice<u8>   stored_blob;
+    FileMapping mapping;
+
+    bool is_zero_copy() const { return !info.is_compressed(); }
+
+    /** The blob of an uncompressed asset, pointing into the mapping */
+    Slice<u8> blob() const
+    {
+        ASSERT(is_zero_copy());
+        return slice(stored_blob.ptr, info.actual_size);
+    }
+
+    /** Copies or decompresses the blob into buffer */
+    Result<void, EAssetLoadError> unpack(Slice<u8>& buffer) const
+    {
+        return Asset::unpack(info, stored_blob, buffer);
+    }
+
+    /** Copies or decompresses part of the blob, see Asset::unpack_range */
+    Result<void, EAssetLoadError> unpack_range(
+        Allocator& allocator, u64 offset, Slice<u8>& buffer) const
+    {
+        return Asset::unpack_range(
+            allocator,
+            info,
+            stored_blob,
+            offset,
+            buffer);
+    }
+
+    void release() { mapping.close(); }
+};
+
+/**
+ * Maps asset files by the path they were converted to, from wherever they
+ * actually are, e.g. a pak
+ */
+struct IAssetFileSource {
+    virtual Result<MappedAsset, EAssetLoadError> map_file(
+        Allocator& allocator, Str path) = 0;
 };
 
 struct TextureAssetDescriptor : IDescriptor {
@@ -174,12 +431,15 @@ struct TextureAssetDescriptor : IDescriptor {
         OFFSET_OF(TextureAsset, depth), LIT("depth")};
     PrimitiveDescriptor<u32> format_desc = {
         OFFSET_OF(TextureAsset, format), LIT("format")};
+    PrimitiveDescriptor<u32> mip_count_desc = {
+        OFFSET_OF(TextureAsset, mip_count), LIT("mip_count")};
 
-    IDescriptor* descs[4] = {
+    IDescriptor* descs[5] = {
         &width_desc,
         &height_desc,
         &depth_desc,
         &format_desc,
+        &mip_count_desc,
     };
 
     CUSTOM_DESC_DEFAULT(TextureAssetDescriptor)
@@ -221,12 +481,21 @@ struct MeshAssetDescriptor : IDescriptor {
         OFFSET_OF(MeshAsset, bounds), LIT("bounds")};
     EnumDescriptor<EVertexFormat> format_desc = {
         OFFSET_OF(MeshAsset, format), LIT("format")};
-
-    IDescriptor* descs[4] = {
+    EnumDescriptor<EIndexFormat> index_format_desc = {
+        OFFSET_OF(MeshAsset, index_format), LIT("index_format")};
+    PrimitiveDescriptor<u32> lod_count_desc = {
+        OFFSET_OF(MeshAsset, lod_count), LIT("lod_count")};
+    PrimitiveDescriptor<u32> meshlet_count_desc = {
+        OFFSET_OF(MeshAsset, meshlet_count), LIT("meshlet_count")};
+
+    IDescriptor* descs[7] = {
         &vertex_buffer_size_desc,
         &index_buffer_size_desc,
         &bounds_desc,
         &format_desc,
+        &index_format_desc,
+        &lod_count_desc,
+        &meshlet_count_desc,
     };
 
     CUSTOM_DESC_DEFAULT(MeshAssetDescriptor)
@@ -321,17 +590,25 @@ typedef PROC_IMPORTER_IMPORT(ProcImporterImport);
 
 struct Importer {
     Str                 name;
+    /** Bump when the output changes, so that cached imports are redone */
+    u32                 version;
     EAssetKind          kind;
     Slice<Str>          file_extensions;
     ProcImporterImport* import;
 };
 
+/**
+ * Once the importers are registered, import_asset_from_file may be called
+ * from several threads at once, as long as each passes its own allocator
+ */
 struct ImporterRegistry {
     TArray<Importer> importers;
     ImporterRegistry(Allocator& allocator) : importers(&allocator) {}
 
     void               init_default_importers();
     void               register_importer(const Importer& importer);
+    /** The importer of path, by its extension. Null if there's none */
+    const Importer*    find_importer(Str path);
     Result<Asset, Str> import_asset_from_file(Str path, Allocator& allocator);
 };
 
@@ -348,3 +625,77 @@ _inline Asset make_archive_asset(Slice<u8> blob)
         .blob = blob,
     };
 }
+
+/**
+ * Converts the vertices of an uncompressed P3fN3fC3fU2f mesh asset to format.
+ * Indices and bounds are kept. Meshes that format can't hold (e.g. UVs
+ * outside [0, 1] for the UNORM formats) are returned as they are
+ * @return The repacked asset, with its blob allocated from allocator
+ */
+Result<Asset, Str> repack_mesh(
+    Allocator& allocator, const Asset& asset, EVertexFormat format);
+
+/**
+ * Appends a chain of simplified index buffers to an uncompressed
+ * P3fN3fC3fU2f mesh asset, see simplify. Each LOD aims for half the indices
+ * of the one before it, and may deviate from the full detail mesh by twice
+ * as much, starting at 1% of its extent. The chain stops at Max_Mesh_Lods,
+ * or once a LOD doesn't get much smaller. The vertices are shared by all
+ * LODs, and kept as they are
+ * @return The asset with its LODs, with its blob allocated from allocator
+ */
+Result<Asset, Str> build_mesh_lods(Allocator& allocator, const Asset& asset);
+
+/**
+ * Copies the LOD table of an unpacked mesh asset to lods, which needs room
+ * for Max_Mesh_Lods. Meshes without LODs have a single one, with all of
+ * their indices
+ * @return The number of LODs
+ */
+u32 read_mesh_lods(const Asset& asset, MeshLod* lods);
+
+/**
+ * Splits the full detail LOD of an uncompressed P3fN3fC3fU2f mesh asset into
+ * meshlets, see build_meshlets, and appends their table to the blob. The
+ * triangles of the LOD are reordered to make each meshlet a range of its
+ * indices; the other LODs and the vertices are kept as they are
+ * @return The asset with its meshlets, with its blob allocated from allocator
+ */
+Result<Asset, Str> build_mesh_meshlets(
+    Allocator& allocator, const Asset& asset);
+
+/** Offset of the meshlet table in the blob of an unpacked mesh asset */
+u64 mesh_meshlets_offset(const MeshAsset& mesh);
+
+/**
+ * Copies the meshlet table of an unpacked mesh asset to meshlets, which
+ * needs room for its meshlet_count
+ */
+void read_mesh_meshlets(const Asset& asset, Meshlet* meshlets);
+
+/** Mips of a texture asset, at least one */
+_inline u32 texture_mip_count(const TextureAsset& texture)
+{
+    return (texture.mip_count > 0) ? texture.mip_count : 1;
+}
+
+/** Size of a width x height mip in format */
+u64 texture_mip_size(ETextureFormat format, u32 width, u32 height);
+
+/** Offset of a mip in the blob of an unpacked texture asset */
+u64 texture_mip_offset(const TextureAsset& texture, u32 mip);
+
+/**
+ * Appends the mip chain, down to 1x1, to an uncompressed R8G8B8A8UInt
+ * texture asset, see downsample_rgba8
+ * @return The asset with its mips, with its blob allocated from allocator
+ */
+Result<Asset, Str> build_texture_mips(Allocator& allocator, const Asset& asset);
+
+/**
+ * Encodes every mip of an uncompressed R8G8B8A8UInt texture asset to a block
+ * compressed format (BC1 or BC3), on the shared job system
+ * @return The encoded asset, with its blob allocated from allocator
+ */
+Result<Asset, Str> compress_texture(
+    Allocator& allocator, const Asset& asset, ETextureFormat format);
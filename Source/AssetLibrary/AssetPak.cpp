@@ -0,0 +1,440 @@
+#include "AssetPak.h"
+
+#include <string.h>
+
+#include "Containers/Extras.h"
+#include "Containers/Map.h"
+#include "Core/RadixSort.h"
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+#include "Memory/Extras.h"
+#include "tracy/Tracy.hpp"
+
+#if OS_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static constexpr u32 Pak_Magic   = 0x4B415056;  // "VPAK"
+static constexpr u32 Pak_Version = 1;
+
+struct PakHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 group_count;
+    u64 strings_size;
+    u8  reserved[40];
+};
+
+struct PakEntryRecord {
+    u64 id[2];
+    u64 offset;
+    u64 size;
+    u32 module_offset;
+    u32 module_len;
+    u32 path_offset;
+    u32 path_len;
+    u32 kind;
+    u32 group;
+    u64 reserved;
+};
+
+struct PakGroupRecord {
+    u64 offset;
+    u64 size;
+    u32 name_offset;
+    u32 name_len;
+    u32 entry_count;
+    u32 reserved;
+};
+
+static_assert(sizeof(PakHeader) == 64);
+static_assert(sizeof(PakEntryRecord) == 64);
+static_assert(sizeof(PakGroupRecord) == 32);
+
+static u64 align_pak_offset(u64 offset)
+{
+    return (offset + Asset_Pak_Alignment - 1) & ~(Asset_Pak_Alignment - 1);
+}
+
+/** Where the entry data starts, past the table of contents and strings */
+static u64 pak_data_offset(const PakHeader& header)
+{
+    return align_pak_offset(
+        sizeof(PakHeader) + u64(header.entry_count) * sizeof(PakEntryRecord) +
+        u64(header.group_count) * sizeof(PakGroupRecord) +
+        header.strings_size);
+}
+
+bool AssetPak::open(Str path)
+{
+    ZoneScopedN("AssetPak.open");
+
+    close();
+    if (!mapping.open(path)) return false;
+
+    const u8* data = mapping.data.ptr;
+    const u64 size = mapping.data.count;
+
+    if (size < sizeof(PakHeader)) {
+        close();
+        return false;
+    }
+
+    // The mapping is page aligned, and so are the records within it
+    const PakHeader* header = (const PakHeader*)data;
+
+    const u64 data_offset = pak_data_offset(*header);
+    if ((header->magic != Pak_Magic) || (header->version != Pak_Version) ||
+        (data_offset > size))
+    {
+        close();
+        return false;
+    }
+
+    const u64 groups_offset =
+        sizeof(PakHeader) + u64(header->entry_count) * sizeof(PakEntryRecord);
+    const u64 strings_offset =
+        groups_offset + u64(header->group_count) * sizeof(PakGroupRecord);
+
+    count        = header->entry_count;
+    groups_count = header->group_count;
+    records      = (const PakEntryRecord*)(data + sizeof(PakHeader));
+    groups       = (const PakGroupRecord*)(data + groups_offset);
+    strings      = slice((u8*)data + strings_offset, header->strings_size);
+
+    auto in_strings = [this](u32 offset, u32 length) {
+        return (u64(offset) + length) <= strings.count;
+    };
+
+    auto in_data = [&](u64 offset, u64 length) {
+        return (offset >= data_offset) && (offset <= size) &&
+               (length <= (size - offset));
+    };
+
+    bool valid = true;
+    for (u32 i = 0; (i < count) && valid; ++i) {
+        const PakEntryRecord& record = records[i];
+        valid = in_data(record.offset, record.size) &&
+                in_strings(record.module_offset, record.module_len) &&
+                in_strings(record.path_offset, record.path_len) &&
+                (record.group < groups_count);
+    }
+
+    for (u32 i = 0; (i < groups_count) && valid; ++i) {
+        const PakGroupRecord& record = groups[i];
+        valid = in_data(record.offset, record.size) &&
+                in_strings(record.name_offset, record.name_len);
+    }
+
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void AssetPak::close()
+{
+    mapping.close();
+    count        = 0;
+    groups_count = 0;
+    records      = nullptr;
+    groups       = nullptr;
+    strings      = {};
+}
+
+Str AssetPak::string(u32 offset, u32 length) const
+{
+    return Str((const char*)strings.ptr + offset, length);
+}
+
+AssetPakEntry AssetPak::entry(u32 index) const
+{
+    ASSERT(index < count);
+    const PakEntryRecord& record = records[index];
+
+    return AssetPakEntry{
+        .id     = {record.id[0], record.id[1]},
+        .module = string(record.module_offset, record.module_len),
+        .path   = string(record.path_offset, record.path_len),
+        .kind   = EAssetKind(record.kind),
+        .group  = record.group,
+        .data   = slice(mapping.data.ptr + record.offset, record.size),
+    };
+}
+
+i64 AssetPak::find(u64 id0, u64 id1) const
+{
+    u32 low  = 0;
+    u32 high = count;
+    while (low < high) {
+        const u32             middle = low + (high - low) / 2;
+        const PakEntryRecord& record = records[middle];
+
+        if ((record.id[0] == id0) && (record.id[1] == id1)) return middle;
+
+        if ((record.id[0] < id0) ||
+            ((record.id[0] == id0) && (record.id[1] < id1)))
+        {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return -1;
+}
+
+AssetPakGroup AssetPak::group(u32 index) const
+{
+    ASSERT(index < groups_count);
+    const PakGroupRecord& record = groups[index];
+
+    return AssetPakGroup{
+        .name        = string(record.name_offset, record.name_len),
+        .data        = slice(mapping.data.ptr + record.offset, record.size),
+        .entry_count = record.entry_count,
+    };
+}
+
+bool AssetPak::prefetch_group(Str name) const
+{
+    for (u32 i = 0; i < groups_count; ++i) {
+        AssetPakGroup found = group(i);
+        if (found.name != name) continue;
+
+#if OS_LINUX
+        // madvise takes whole pages
+        const umm page  = umm(sysconf(_SC_PAGESIZE));
+        const umm begin = umm(found.data.ptr) & ~(page - 1);
+        const umm end   = umm(found.data.ptr) + found.data.count;
+        madvise((void*)begin, end - begin, MADV_WILLNEED);
+#endif
+        return true;
+    }
+
+    return false;
+}
+
+bool AssetPak::contains(const void* ptr) const
+{
+    const u8* at = (const u8*)ptr;
+    return is_open() && (at >= mapping.data.ptr) &&
+           (at < (mapping.data.ptr + mapping.data.count));
+}
+
+void AssetPakBuilder::init(Allocator& allocator)
+{
+    this->allocator = &allocator;
+    inputs          = TArray<Input>(&allocator);
+    group_names     = TArray<Str>(&allocator);
+}
+
+void AssetPakBuilder::deinit()
+{
+    for (const Input& input : inputs) {
+        allocator->release((umm)input.module.data);
+        allocator->release((umm)input.path.data);
+        allocator->release((umm)input.file_path.data);
+    }
+    inputs.release();
+
+    for (Str name : group_names) allocator->release((umm)name.data);
+    group_names.release();
+}
+
+void AssetPakBuilder::add(
+    const u64 id[2], Str module, Str path, Str file_path, Str group)
+{
+    u32 group_index = 0;
+    while ((group_index < group_names.size) &&
+           (group_names[group_index] != group))
+    {
+        group_index++;
+    }
+
+    if (group_index == group_names.size) {
+        group_names.add(group.clone(*allocator));
+    }
+
+    inputs.add(Input{
+        .id        = {id[0], id[1]},
+        .module    = module.clone(*allocator),
+        .path      = path.clone(*allocator),
+        .file_path = file_path.clone(*allocator),
+        .group     = group_index,
+    });
+}
+
+bool AssetPakBuilder::write(Str pak_path)
+{
+    ZoneScopedN("AssetPakBuilder.write");
+
+    auto temp = Arena<ArenaMode::Dynamic>(System_Allocator, MEGABYTES(1));
+    temp.init();
+    DEFER(temp.deinit());
+
+    // Every asset file is mapped up front, to lay out the pak before it's
+    // written
+    TArray<MappedAsset> files(&temp);
+    auto                close_files = [&files]() {
+        for (MappedAsset& file : files) file.release();
+    };
+
+    for (const Input& input : inputs) {
+        auto map_result = Asset::map(temp, input.file_path);
+        if (!map_result.ok()) {
+            print(
+                LIT("[Pak]: Failed to read {}: {}\n"),
+                input.file_path,
+                map_result.err());
+            close_files();
+            return false;
+        }
+
+        files.add(map_result.value());
+    }
+    DEFER(close_files());
+
+    TArray<char>           table(&temp);
+    TArray<PakEntryRecord> entry_records(&temp);
+    TArray<PakGroupRecord> group_records(&temp);
+
+    // Module names are shared by most entries, so they're only stored once
+    TMap<Str, u32> module_offsets;
+    module_offsets.init(temp);
+
+    auto add_string = [&](Str s) -> u32 {
+        u32 offset = u32(table.size);
+        for (u64 i = 0; i < s.len; ++i) table.add(s.data[i]);
+        return offset;
+    };
+
+    auto add_module = [&](Str module) -> u32 {
+        if (!module_offsets.contains(module)) {
+            module_offsets.add(module, add_string(module));
+        }
+        return module_offsets[module];
+    };
+
+    for (u32 i = 0; i < inputs.size; ++i) {
+        const Input& input = inputs[i];
+        entry_records.add(PakEntryRecord{
+            .id            = {input.id[0], input.id[1]},
+            .offset        = 0,
+            .size          = files[i].mapping.data.count,
+            .module_offset = add_module(input.module),
+            .module_len    = u32(input.module.len),
+            .path_offset   = add_string(input.path),
+            .path_len      = u32(input.path.len),
+            .kind          = u32(files[i].info.kind),
+            .group         = input.group,
+            .reserved      = 0,
+        });
+    }
+
+    for (Str name : group_names) {
+        group_records.add(PakGroupRecord{
+            .offset      = 0,
+            .size        = 0,
+            .name_offset = add_string(name),
+            .name_len    = u32(name.len),
+            .entry_count = 0,
+            .reserved    = 0,
+        });
+    }
+
+    PakHeader header = {
+        .magic        = Pak_Magic,
+        .version      = Pak_Version,
+        .entry_count  = u32(entry_records.size),
+        .group_count  = u32(group_records.size),
+        .strings_size = table.size,
+        .reserved     = {},
+    };
+
+    // Data is laid out by group, in the order the entries were added
+    TArray<u32> data_order(&temp);
+    for (u32 i = 0; i < inputs.size; ++i) data_order.add(i);
+
+    auto scratch = alloc_slice<u32>(temp, data_order.size);
+    radix_sort(slice(data_order), scratch, [&](u32 index) {
+        return u64(inputs[index].group);
+    });
+
+    u64 offset = pak_data_offset(header);
+    for (u32 index : data_order) {
+        PakEntryRecord& record = entry_records[index];
+        PakGroupRecord& group  = group_records[record.group];
+
+        record.offset = offset;
+        if (group.entry_count == 0) group.offset = offset;
+        group.entry_count++;
+        group.size = offset + record.size - group.offset;
+
+        offset = align_pak_offset(offset + record.size);
+    }
+
+    // The table of contents is sorted by id, first by its low then its high
+    // part since the sort is stable
+    TArray<u32> toc_order(&temp);
+    for (u32 i = 0; i < entry_records.size; ++i) toc_order.add(i);
+
+    radix_sort(slice(toc_order), scratch, [&](u32 index) {
+        return entry_records[index].id[1];
+    });
+    radix_sort(slice(toc_order), scratch, [&](u32 index) {
+        return entry_records[index].id[0];
+    });
+
+    TArray<PakEntryRecord> toc(&temp);
+    for (u32 index : toc_order) {
+        const PakEntryRecord& record = entry_records[index];
+        if ((toc.size > 0) && (toc.last()->id[0] == record.id[0]) &&
+            (toc.last()->id[1] == record.id[1]))
+        {
+            print(
+                LIT("[Pak]: {} and {} have the same id\n"),
+                inputs[index].file_path,
+                inputs[toc_order[toc.size - 1]].file_path);
+            return false;
+        }
+
+        toc.add(record);
+    }
+
+    static const u8 Padding[Asset_Pak_Alignment] = {};
+
+    auto output  = BufferedWriteTape<true>(open_file_write(pak_path));
+    u64  written = 0;
+
+    auto write = [&](const void* ptr, u64 size) {
+        written += size;
+        return output.write((void*)ptr, size);
+    };
+
+    auto pad = [&](u64 to) { return write(Padding, to - written); };
+
+    if (!write(&header, sizeof(header))) return false;
+    if (!write(toc.data, toc.size * sizeof(PakEntryRecord))) return false;
+    if (!write(
+            group_records.data,
+            group_records.size * sizeof(PakGroupRecord)))
+    {
+        return false;
+    }
+    if (!write(table.data, table.size)) return false;
+
+    for (u32 index : data_order) {
+        const PakEntryRecord& record = entry_records[index];
+        const Slice<u8>       data   = files[index].mapping.data;
+
+        if (!pad(record.offset)) return false;
+        if (!write(data.ptr, data.count)) return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "AssetLibrary.h"
+#include "Containers/Array.h"
+#include "Core/FileMapping.h"
+
+/**
+ * A set of asset files packed into one, for shipping builds. The pak is
+ * mapped as a whole, so loading an asset from it is a lookup in its table of
+ * contents rather than opening a file, and uncompressed assets are used in
+ * place as with Asset::map.
+ *
+ * Every entry is the asset file as it was converted, so it keeps its own
+ * compression. Entries are sorted by their id in the table of contents.
+ * Their data is grouped instead (e.g. by level): the entries of a group are
+ * stored next to each other, so that loading a whole group reads the pak
+ * sequentially.
+ *
+ * Pak file format, meant to be mapped and used in place:
+ *
+ * [4 magic, 4 version, 4 entry_count, 4 group_count, 8 strings_size,
+ *  40 reserved]
+ * [entry_count x Entry Record (64)], sorted by id
+ * [group_count x Group Record (32)]
+ * [strings_size strings]
+ * [entry data, each entry aligned to Asset_Pak_Alignment]
+ *
+ * Strings are referenced by offset and length into the strings section, and
+ * entry data by offset from the start of the file.
+ */
+static constexpr u64 Asset_Pak_Alignment = 64;
+
+struct AssetPakEntry {
+    u64        id[2];
+    Str        module;
+    /** Relative to the root of the module, see AssetRegistryEntry */
+    Str        path;
+    EAssetKind kind;
+    u32        group;
+    /** The asset file */
+    Slice<u8>  data;
+};
+
+struct AssetPakGroup {
+    Str       name;
+    /** The data of every entry in the group */
+    Slice<u8> data;
+    u32       entry_count;
+};
+
+struct PakEntryRecord;
+struct PakGroupRecord;
+
+struct AssetPak {
+    /**
+     * Maps the pak at path. Entries point into the mapping, and stay valid
+     * until close
+     * @return false if the file is missing or isn't a valid pak
+     */
+    bool open(Str path);
+    void close();
+
+    bool is_open() const { return mapping.is_open(); }
+
+    u32           entry_count() const { return count; }
+    AssetPakEntry entry(u32 index) const;
+
+    /** @return The index of the entry with id, or -1 if there's none */
+    i64 find(u64 id0, u64 id1) const;
+
+    u32           group_count() const { return groups_count; }
+    AssetPakGroup group(u32 index) const;
+
+    /**
+     * Asks the OS to start reading the data of the named group, ahead of its
+     * assets being loaded. Only does anything on Linux
+     * @return false if there's no such group
+     */
+    bool prefetch_group(Str name) const;
+
+    /** Whether ptr points into the pak, e.g. the blob of a mapped entry */
+    bool contains(const void* ptr) const;
+
+private:
+    FileMapping           mapping;
+    u32                   count        = 0;
+    u32                   groups_count = 0;
+    const PakEntryRecord* records      = nullptr;
+    const PakGroupRecord* groups       = nullptr;
+    Slice<u8>             strings;
+
+    Str string(u32 offset, u32 length) const;
+};
+
+/**
+ * Writes paks. Asset files are added along with the id and reference they
+ * are registered with, and only read when the pak is written.
+ */
+struct AssetPakBuilder {
+    void init(Allocator& allocator);
+    void deinit();
+
+    /**
+     * @param file_path The asset file to pack
+     * @param group Entries of the same group are stored next to each other,
+     * in the order they were added
+     */
+    void add(
+        const u64 id[2],
+        Str       module,
+        Str       path,
+        Str       file_path,
+        Str       group = LIT(""));
+
+    /**
+     * @return false if an asset file couldn't be read, two entries have the
+     * same id, or the pak couldn't be written
+     */
+    bool write(Str pak_path);
+
+private:
+    struct Input {
+        u64 id[2];
+        Str module;
+        Str path;
+        Str file_path;
+        u32 group;
+    };
+
+    Allocator*    allocator;
+    TArray<Input> inputs;
+    TArray<Str>   group_names;
+};
@@ -0,0 +1,517 @@
+#include "AssetRegistry.h"
+
+#include <string.h>
+
+#include "Core/FileStat.h"
+#include "FileSystem/DirectoryIterator.h"
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+#include "Hashing.h"
+#include "Memory/Extras.h"
+#include "tracy/Tracy.hpp"
+
+static constexpr u32 Registry_Magic     = 0x47455256;  // "VREG"
+static constexpr u32 Registry_Version   = 2;
+static constexpr u32 Registry_Hash_Seed = 0x52454749;
+
+struct RegistryHeader {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 directory_count;
+    u64 strings_size;
+};
+
+struct RegistryEntryRecord {
+    u64 id[2];
+    u64 size;
+    u64 modified;
+    u64 content_hash;
+    u32 module_offset;
+    u32 module_len;
+    u32 path_offset;
+    u32 path_len;
+    u32 kind;
+    u32 reserved;
+};
+
+struct RegistryDirectoryRecord {
+    u64 modified;
+    u32 module_offset;
+    u32 module_len;
+    u32 path_offset;
+    u32 path_len;
+};
+
+static_assert(sizeof(RegistryHeader) == 24);
+static_assert(sizeof(RegistryEntryRecord) == 64);
+static_assert(sizeof(RegistryDirectoryRecord) == 24);
+
+void AssetRegistry::init(Allocator& allocator)
+{
+    this->allocator = &allocator;
+    entries         = TArray<AssetRegistryEntry>(&allocator);
+    directories     = TArray<AssetRegistryDirectory>(&allocator);
+
+    strings = Arena<ArenaMode::Dynamic>(allocator, KILOBYTES(64));
+    strings.init();
+}
+
+void AssetRegistry::deinit()
+{
+    entries.release();
+    directories.release();
+    strings.deinit();
+}
+
+bool AssetRegistry::load(Str path)
+{
+    ZoneScopedN("AssetRegistry.load");
+
+    // Nothing refers to the strings of the previous index anymore
+    entries.size     = 0;
+    directories.size = 0;
+    strings.deinit();
+    strings.init();
+
+    FileMapping mapping;
+    if (!mapping.open(path)) return false;
+    DEFER(mapping.close());
+
+    const u8* data = mapping.data.ptr;
+    const u64 size = mapping.data.count;
+
+    RegistryHeader header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+
+    const u64 entries_size =
+        u64(header.entry_count) * sizeof(RegistryEntryRecord);
+    const u64 directories_size =
+        u64(header.directory_count) * sizeof(RegistryDirectoryRecord);
+
+    const u64 entries_offset     = sizeof(header);
+    const u64 directories_offset = entries_offset + entries_size;
+    const u64 strings_offset     = directories_offset + directories_size;
+
+    if ((header.magic != Registry_Magic) ||
+        (header.version != Registry_Version) ||
+        ((strings_offset + header.strings_size) != size))
+    {
+        return false;
+    }
+
+    // The strings section is copied as a whole, and shared by the records
+    const char* strings_base =
+        Str((const char*)data + strings_offset, header.strings_size)
+            .clone(strings)
+            .data;
+
+    auto string_at = [&](u32 offset, u32 len, Str& result) {
+        if ((u64(offset) + len) > header.strings_size) return false;
+        result = Str(strings_base + offset, len);
+        return true;
+    };
+
+    bool valid = true;
+    for (u32 i = 0; (i < header.entry_count) && valid; ++i) {
+        RegistryEntryRecord record;
+        memcpy(
+            &record,
+            data + entries_offset + u64(i) * sizeof(record),
+            sizeof(record));
+
+        AssetRegistryEntry entry = {
+            .id           = {record.id[0], record.id[1]},
+            .kind         = EAssetKind(record.kind),
+            .size         = record.size,
+            .modified     = record.modified,
+            .content_hash = record.content_hash,
+        };
+        valid =
+            string_at(record.module_offset, record.module_len, entry.module) &&
+            string_at(record.path_offset, record.path_len, entry.path);
+        entries.add(entry);
+    }
+
+    for (u32 i = 0; (i < header.directory_count) && valid; ++i) {
+        RegistryDirectoryRecord record;
+        memcpy(
+            &record,
+            data + directories_offset + u64(i) * sizeof(record),
+            sizeof(record));
+
+        AssetRegistryDirectory dir = {.modified = record.modified};
+        valid =
+            string_at(record.module_offset, record.module_len, dir.module) &&
+            string_at(record.path_offset, record.path_len, dir.path);
+        directories.add(dir);
+    }
+
+    if (!valid) {
+        entries.size     = 0;
+        directories.size = 0;
+        return false;
+    }
+
+    return true;
+}
+
+bool AssetRegistry::save(Str path)
+{
+    ZoneScopedN("AssetRegistry.save");
+
+    auto temp = Arena<ArenaMode::Dynamic>(System_Allocator, MEGABYTES(1));
+    temp.init();
+    DEFER(temp.deinit());
+
+    TArray<char>                    table(&temp);
+    TArray<RegistryEntryRecord>     entry_records(&temp);
+    TArray<RegistryDirectoryRecord> directory_records(&temp);
+
+    // Module names are shared by most entries, so they're only stored once
+    TMap<Str, u32> module_offsets;
+    module_offsets.init(temp);
+
+    auto add_string = [&](Str s) -> u32 {
+        u32 offset = u32(table.size);
+        for (u64 i = 0; i < s.len; ++i) table.add(s.data[i]);
+        return offset;
+    };
+
+    auto add_module = [&](Str module) -> u32 {
+        if (!module_offsets.contains(module)) {
+            module_offsets.add(module, add_string(module));
+        }
+        return module_offsets[module];
+    };
+
+    for (const AssetRegistryEntry& entry : entries) {
+        entry_records.add(RegistryEntryRecord{
+            .id            = {entry.id[0], entry.id[1]},
+            .size          = entry.size,
+            .modified      = entry.modified,
+            .content_hash  = entry.content_hash,
+            .module_offset = add_module(entry.module),
+            .module_len    = u32(entry.module.len),
+            .path_offset   = add_string(entry.path),
+            .path_len      = u32(entry.path.len),
+            .kind          = u32(entry.kind),
+            .reserved      = 0,
+        });
+    }
+
+    for (const AssetRegistryDirectory& directory : directories) {
+        directory_records.add(RegistryDirectoryRecord{
+            .modified      = directory.modified,
+            .module_offset = add_module(directory.module),
+            .module_len    = u32(directory.module.len),
+            .path_offset   = add_string(directory.path),
+            .path_len      = u32(directory.path.len),
+        });
+    }
+
+    RegistryHeader header = {
+        .magic           = Registry_Magic,
+        .version         = Registry_Version,
+        .entry_count     = u32(entry_records.size),
+        .directory_count = u32(directory_records.size),
+        .strings_size    = table.size,
+    };
+
+    auto output = BufferedWriteTape<true>(open_file_write(path));
+    if (!output.write(&header, sizeof(header))) return false;
+    if (!output.write(
+            entry_records.data,
+            entry_records.size * sizeof(RegistryEntryRecord)))
+    {
+        return false;
+    }
+    if (!output.write(
+            directory_records.data,
+            directory_records.size * sizeof(RegistryDirectoryRecord)))
+    {
+        return false;
+    }
+    if (!output.write(table.data, table.size)) return false;
+
+    return true;
+}
+
+/** The directory of an entry path, relative to the root like the path */
+static Str parent_of(Str path)
+{
+    u64 end = 0;
+    for (u64 i = 0; i < path.len; ++i) {
+        if (path.data[i] == '/') end = i;
+    }
+    return Str(path.data, end);
+}
+
+static bool is_asset_file_name(Str name)
+{
+    static const Str extension = LIT(".asset");
+
+    if (name.len <= extension.len) return false;
+    return memcmp(
+               name.data + name.len - extension.len,
+               extension.data,
+               extension.len) == 0;
+}
+
+/** Reads the kind and content hash of an asset file */
+static bool scan_asset_file(
+    Str path, const FileStat& stat, AssetRegistryEntry& entry)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(4));
+
+    auto map_result = Asset::map(temp, path);
+    if (!map_result.ok()) return false;
+
+    MappedAsset mapped = map_result.value();
+    DEFER(mapped.release());
+
+    // The binary header holds the checksum of the blob, so hashing it covers
+    // the whole file. Assets with a JSON info have no checksum, and are
+    // hashed whole
+    const Slice<u8>& file = mapped.mapping.data;
+    const u64 hashed_size =
+        (mapped.info.checksum != 0) ? u64(mapped.info.blob_offset) : file.count;
+
+    entry.kind         = mapped.info.kind;
+    entry.size         = stat.size;
+    entry.modified     = stat.modified;
+    entry.content_hash =
+        murmur_hash2(file.ptr, hashed_size, Registry_Hash_Seed);
+    return true;
+}
+
+u32 AssetRegistry::refresh(Slice<AssetRegistryRoot> roots, bool check_files)
+{
+    ZoneScopedN("AssetRegistry.refresh");
+
+    // Grows with the number of entries, which can be large
+    auto temp = Arena<ArenaMode::Dynamic>(System_Allocator, MEGABYTES(1));
+    temp.init();
+    DEFER(temp.deinit());
+
+    auto root_of = [&](Str module) -> const AssetRegistryRoot* {
+        for (u64 i = 0; i < roots.count; ++i) {
+            if (roots[i].module == module) return &roots[i];
+        }
+        return nullptr;
+    };
+
+    auto key_of = [&](Str module, Str path) {
+        return format(temp, LIT("{}|{}"), module, path);
+    };
+
+    // Module names owned by the registry, for the entries found now. Known
+    // modules keep the name they have
+    TArray<Str> modules(&temp);
+    for (u64 i = 0; i < roots.count; ++i) {
+        const Str* known = nullptr;
+        for (const AssetRegistryDirectory& directory : directories) {
+            if (directory.module == roots[i].module) {
+                known = &directory.module;
+                break;
+            }
+        }
+
+        modules.add(known ? *known : roots[i].module.clone(strings));
+    }
+
+    // Entries of the refreshed modules, to keep the ids of the ones found
+    // again, and to tell which went missing
+    TMap<Str, u64> previous_entries;
+    u64            previous_count = 0;
+    previous_entries.init(temp);
+    for (u64 i = 0; i < entries.size; ++i) {
+        const AssetRegistryEntry& entry = entries[i];
+        if (root_of(entry.module) == nullptr) continue;
+
+        previous_entries.add(key_of(entry.module, entry.path), i);
+        previous_count++;
+    }
+
+    TArray<AssetRegistryEntry>     next_entries(&temp);
+    TArray<AssetRegistryDirectory> next_directories(&temp);
+
+    // Directories to list: the ones that changed, and the new ones
+    TArray<AssetRegistryDirectory> to_list(&temp);
+    TMap<Str, bool>                seen_directories;
+    TMap<Str, bool>                unchanged_directories;
+    seen_directories.init(temp);
+    unchanged_directories.init(temp);
+
+    for (const AssetRegistryDirectory& directory : directories) {
+        const AssetRegistryRoot* root = root_of(directory.module);
+        if (root == nullptr) {
+            next_directories.add(directory);
+            continue;
+        }
+
+        Str full_path =
+            format(temp, LIT("{}{}"), root->directory, directory.path);
+
+        // Removed, along with its entries
+        FileStat stat;
+        if (!stat_file(full_path, stat) || !stat.is_directory) continue;
+
+        Str key = key_of(directory.module, directory.path);
+        seen_directories.add(key, true);
+
+        if (stat.modified == directory.modified) {
+            unchanged_directories.add(key, true);
+            next_directories.add(directory);
+        } else {
+            AssetRegistryDirectory changed = directory;
+            changed.modified               = stat.modified;
+            to_list.add(changed);
+        }
+    }
+
+    for (u64 i = 0; i < roots.count; ++i) {
+        if (seen_directories.contains(key_of(modules[i], LIT("")))) continue;
+
+        FileStat stat;
+        if (!stat_file(roots[i].directory, stat) || !stat.is_directory) {
+            continue;
+        }
+
+        seen_directories.add(key_of(modules[i], LIT("")), true);
+        to_list.add(AssetRegistryDirectory{
+            .module   = modules[i],
+            .path     = LIT(""),
+            .modified = stat.modified,
+        });
+    }
+
+    u32 changes        = 0;
+    u64 previous_found = 0;
+
+    // Entries of unchanged directories are kept as they are
+    for (const AssetRegistryEntry& entry : entries) {
+        const AssetRegistryRoot* root = root_of(entry.module);
+        if (root == nullptr) {
+            next_entries.add(entry);
+            continue;
+        }
+
+        Str directory_key = key_of(entry.module, parent_of(entry.path));
+        if (!unchanged_directories.contains(directory_key)) continue;
+
+        previous_found++;
+
+        AssetRegistryEntry next = entry;
+        if (check_files) {
+            SAVE_ARENA(temp);
+            Str full_path =
+                format(temp, LIT("{}{}"), root->directory, entry.path);
+
+            FileStat stat;
+            if (!stat_file(full_path, stat)) {
+                previous_found--;
+                continue;
+            }
+
+            if ((stat.size != entry.size) || (stat.modified != entry.modified))
+            {
+                if (!scan_asset_file(full_path, stat, next)) {
+                    previous_found--;
+                    continue;
+                }
+                changes++;
+            }
+        }
+
+        next_entries.add(next);
+    }
+
+    // Listing a directory can add more to the list
+    for (u64 i = 0; i < to_list.size; ++i) {
+        AssetRegistryDirectory directory = to_list[i];
+        const AssetRegistryRoot* root      = root_of(directory.module);
+
+        next_directories.add(directory);
+
+        Str directory_path =
+            format(temp, LIT("{}{}"), root->directory, directory.path);
+
+        DirectoryIterator iterator = open_dir(directory_path);
+        DEFER(iterator.close());
+
+        FileData it_data;
+        while (iterator.next_file(&it_data)) {
+            if (it_data.filename.len == 0) continue;
+
+            // Also skips . and ..
+            if (it_data.filename.data[0] == '.') continue;
+
+            Str path =
+                format(temp, LIT("{}/{}"), directory.path, it_data.filename);
+            Str full_path = format(temp, LIT("{}{}"), root->directory, path);
+
+            FileStat stat;
+            if (!stat_file(full_path, stat)) continue;
+
+            if (stat.is_directory) {
+                Str key = key_of(directory.module, path);
+                if (seen_directories.contains(key)) continue;
+
+                seen_directories.add(key, true);
+                to_list.add(AssetRegistryDirectory{
+                    .module   = directory.module,
+                    .path     = path.clone(strings),
+                    .modified = stat.modified,
+                });
+                continue;
+            }
+
+            if (!is_asset_file_name(it_data.filename)) continue;
+
+            Str key = key_of(directory.module, path);
+
+            AssetRegistryEntry entry = {
+                .id     = {0, 0},
+                .module = directory.module,
+            };
+
+            const bool previous = previous_entries.contains(key);
+            if (previous) {
+                entry = entries[previous_entries[key]];
+                previous_found++;
+
+                const bool unchanged = (stat.size == entry.size) &&
+                                       (stat.modified == entry.modified);
+                if (unchanged) {
+                    next_entries.add(entry);
+                    continue;
+                }
+            } else {
+                entry.path = path.clone(strings);
+            }
+
+            if (!scan_asset_file(full_path, stat, entry)) {
+                if (previous) previous_found--;
+                continue;
+            }
+
+            changes++;
+            next_entries.add(entry);
+        }
+    }
+
+    // Entries that weren't found again
+    changes += u32(previous_count - previous_found);
+
+    entries.size = 0;
+    for (const AssetRegistryEntry& entry : next_entries) entries.add(entry);
+
+    directories.size = 0;
+    for (const AssetRegistryDirectory& directory : next_directories) {
+        directories.add(directory);
+    }
+
+    return changes;
+}
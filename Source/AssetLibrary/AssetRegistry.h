@@ -0,0 +1,88 @@
+#pragma once
+#include "AssetLibrary.h"
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+#include "Memory/Arena.h"
+
+/** A directory whose assets are registered under a module name */
+struct AssetRegistryRoot {
+    Str module;
+    Str directory;
+};
+
+struct AssetRegistryEntry {
+    /** Stable id, assigned by the owner of the registry. Zero until then */
+    u64        id[2];
+    Str        module;
+    /** Relative to the root of the module, starting with a slash */
+    Str        path;
+    EAssetKind kind;
+    u64        size;
+    /** See FileStat::modified */
+    u64        modified;
+    /** Hash of the binary header, which covers the blob by its checksum */
+    u64        content_hash;
+};
+
+struct AssetRegistryDirectory {
+    Str module;
+    /** Relative to the root of the module; empty for the root itself */
+    Str path;
+    u64 modified;
+};
+
+/**
+ * Index of the asset files (*.asset) under a set of module roots, persisted
+ * to a single file so that startup doesn't have to walk the asset tree.
+ *
+ * The index remembers the modification time of every directory. Refreshing
+ * only stats the known directories, and lists again the ones that changed
+ * (i.e. had files added, removed or renamed) along with any new
+ * subdirectories. Files are only hashed when they are new or their size or
+ * time changed, and keep their id for as long as their path is the same.
+ * Files modified in place don't change their directory, so they're only seen
+ * by refreshing with check_files.
+ *
+ * Index file format. Records are fixed size and strings are stored once, so
+ * that loading is a pass over the records and a single copy of the strings:
+ *
+ * [4 magic, 4 version, 4 entry_count, 4 directory_count, 8 strings_size]
+ * [entry_count x Entry Record (64)]
+ * [directory_count x Directory Record (24)]
+ * [strings_size strings]
+ *
+ * Strings are referenced by offset and length into the strings section.
+ */
+struct AssetRegistry {
+    TArray<AssetRegistryEntry>     entries;
+    TArray<AssetRegistryDirectory> directories;
+
+    void init(Allocator& allocator);
+    void deinit();
+
+    /**
+     * Reads an index file, replacing the entries and directories and freeing
+     * their strings
+     * @return false if the file is missing or isn't a valid index, in which
+     * case the registry is left empty
+     */
+    bool load(Str path);
+
+    bool save(Str path);
+
+    /**
+     * Brings the index up to date with the files under roots. Entries and
+     * directories of modules that aren't in roots are left untouched
+     * @param check_files Also stat the files of unchanged directories
+     * @return The number of entries added, changed or removed
+     */
+    u32 refresh(Slice<AssetRegistryRoot> roots, bool check_files = false);
+
+private:
+    Allocator*                allocator;
+    /**
+     * Strings section of the loaded index, and strings of the entries and
+     * directories added since. Reset by load
+     */
+    Arena<ArenaMode::Dynamic> strings;
+};
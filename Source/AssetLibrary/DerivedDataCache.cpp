@@ -0,0 +1,185 @@
+#include "DerivedDataCache.h"
+
+#include <stdio.h>
+
+#include "Containers/Extras.h"
+#include "Core/FileMapping.h"
+#include "Core/FileStat.h"
+#include "Core/RadixSort.h"
+#include "FileSystem/DirectoryIterator.h"
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+#include "Hashing.h"
+#include "tracy/Tracy.hpp"
+
+#if OS_MSWINDOWS
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static constexpr u32 Derived_Data_Key_Seed = 0x44444331;  // "DDC1"
+
+/** Writes the contents of the file at from to the file at to */
+static bool copy_file(Str from, Str to)
+{
+    FileMapping source;
+    if (!source.open(from)) return false;
+    DEFER(source.close());
+
+    auto output = BufferedWriteTape<true>(open_file_write(to));
+    return output.write(source.data.ptr, source.data.count);
+}
+
+bool DerivedDataCache::init(Str directory)
+{
+    create_dir(directory);
+
+    FileStat stat;
+    if (!stat_file(directory, stat) || !stat.is_directory) return false;
+
+    this->directory = directory.clone(System_Allocator);
+    return true;
+}
+
+void DerivedDataCache::deinit()
+{
+    System_Allocator.release((umm)directory.data);
+}
+
+u64 DerivedDataCache::make_key(u64 source_hash, const Importer& importer)
+{
+    struct {
+        u64 source_hash;
+        u64 importer_name;
+        u64 importer_version;
+    } parts = {
+        .source_hash   = source_hash,
+        .importer_name = murmur_hash2(
+            importer.name.data,
+            importer.name.len,
+            Derived_Data_Key_Seed),
+        .importer_version = importer.version,
+    };
+
+    return murmur_hash2(&parts, sizeof(parts), Derived_Data_Key_Seed);
+}
+
+Str DerivedDataCache::entry_path(Allocator& allocator, u64 key)
+{
+    static const char Hex_Digits[] = "0123456789abcdef";
+
+    char name[16];
+    for (u32 i = 0; i < 16; ++i) {
+        name[i] = Hex_Digits[(key >> ((15 - i) * 4)) & 0xF];
+    }
+
+    return format(allocator, LIT("{}/{}.ddc"), directory, Str(name, 16));
+}
+
+bool DerivedDataCache::fetch(u64 key, Str output_path)
+{
+    ZoneScoped;
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+    Str path = entry_path(temp, key);
+    if (!copy_file(path, output_path)) {
+        stats.misses++;
+        return false;
+    }
+
+    // Recently used entries are the last to be trimmed
+    touch_file(path);
+    stats.hits++;
+    return true;
+}
+
+bool DerivedDataCache::store(u64 key, Str asset_path)
+{
+    ZoneScoped;
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+    Str path = entry_path(temp, key);
+
+    // Written next to the entry first, so that nobody reads it half written
+    Str temp_path = format(
+        temp,
+        LIT("{}.{}.{}.tmp\0"),
+        path,
+        u32(getpid()),
+        u32(store_count++));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    if (!copy_file(asset_path, Str(temp_path.data, temp_path.len - 1))) {
+        remove(temp_path.data);
+        return false;
+    }
+
+    // Fails on Windows if someone else stored the same key first, which
+    // has the same contents anyway
+    if (rename(temp_path.data, path_cstr.data) != 0) {
+        remove(temp_path.data);
+        return false;
+    }
+
+    stats.stores++;
+    return true;
+}
+
+u64 DerivedDataCache::trim()
+{
+    ZoneScoped;
+
+    Arena<ArenaMode::Dynamic> temp(System_Allocator, KILOBYTES(64));
+    temp.init();
+    DEFER(temp.deinit());
+
+    struct CachedFile {
+        Str path;
+        u64 size;
+        u64 modified;
+    };
+
+    TArray<CachedFile> files(&temp);
+    u64                total_size = 0;
+
+    DirectoryIterator it = open_dir(directory);
+    FileData          it_data;
+    while (it.next_file(&it_data)) {
+        if (it_data.attributes != FileAttributes::File) continue;
+        if (it_data.filename.chop_left_last_of('.') != LIT(".ddc")) continue;
+
+        Str path = format(temp, LIT("{}/{}\0"), directory, it_data.filename);
+
+        FileStat stat;
+        if (!stat_file(Str(path.data, path.len - 1), stat)) continue;
+
+        files.add(CachedFile{path, stat.size, stat.modified});
+        total_size += stat.size;
+    }
+    it.close();
+
+    if (total_size <= max_size) return 0;
+
+    // Least recently used first
+    auto scratch = alloc_slice<CachedFile>(temp, files.size);
+    radix_sort(
+        slice(files),
+        scratch,
+        [](const CachedFile& file) { return file.modified; });
+
+    u64 removed = 0;
+    for (const CachedFile& file : files) {
+        if (total_size <= max_size) break;
+
+        // Possibly trimmed by someone else in the meantime
+        if (remove(file.path.data) != 0) continue;
+
+        total_size -= file.size;
+        removed++;
+    }
+
+    stats.evictions += removed;
+    return removed;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+
+#include "AssetLibrary.h"
+
+/**
+ * Local cache of imported assets, addressed by the hash of everything that
+ * goes into them: the source bytes, the importer and its version, and the
+ * import settings. Sources that were imported before with the same settings,
+ * on another branch, by another process, or before a hot reload, are copied
+ * from the cache instead of going through the importer again.
+ *
+ * Every entry is the .asset file itself, named after its key in directory.
+ * Entries are written to a temporary file and renamed into place, so the
+ * directory may be shared by several processes (or machines). Fetching an
+ * entry touches it, and trim removes the least recently used entries until
+ * the cache fits in max_size.
+ *
+ * fetch and store may be called from several threads at once.
+ */
+struct DerivedDataCache {
+    /** Size trim keeps the cache under */
+    u64 max_size = MEGABYTES(2048);
+
+    struct Stats {
+        std::atomic<u64> hits      = 0;
+        std::atomic<u64> misses    = 0;
+        std::atomic<u64> stores    = 0;
+        /** Entries removed by trim */
+        std::atomic<u64> evictions = 0;
+    } stats;
+
+    /** @return false if directory doesn't exist and can't be created */
+    bool init(Str directory);
+    void deinit();
+
+    /**
+     * @param source_hash Hash of the source file, seeded with the import
+     * settings
+     */
+    static u64 make_key(u64 source_hash, const Importer& importer);
+
+    /**
+     * Copies the entry of key to output_path
+     * @return false on a miss, in which case output_path isn't written
+     */
+    bool fetch(u64 key, Str output_path);
+
+    /** Copies the asset at asset_path into the cache, under key */
+    bool store(u64 key, Str asset_path);
+
+    /**
+     * Removes the least recently fetched or stored entries, until the cache
+     * is no bigger than max_size
+     * @return The number of entries removed
+     */
+    u64 trim();
+
+private:
+    Str              directory;
+    /** Tells apart the temporary files of concurrent stores */
+    std::atomic<u32> store_count = 0;
+
+    Str entry_path(Allocator& allocator, u64 key);
+};
@@ -4,13 +4,11 @@
 #include "Memory/Extras.h"
 #include "stb_image.h"
 
-static thread_local Allocator* Local_Allocator;
 static Str File_Extensions[] = {".png", ".jpeg", ".bmp", ".jpg"};
 
 PROC_IMPORTER_IMPORT(stb_image_import)
 {
-    Local_Allocator = &allocator;
-    CREATE_SCOPED_ARENA(*Local_Allocator, temp, 1024);
+    CREATE_SCOPED_ARENA(allocator, temp, 1024);
 
     Str   path_cstr = format(temp, LIT("{}\0"), path);
     int   width, height, channels;
@@ -46,8 +44,9 @@ PROC_IMPORTER_IMPORT(stb_image_import)
 }
 
 Importer Stb_Image_Importer = {
-    .name = LIT("stb_image"),
-    .kind = AssetKind::Texture,
+    .name    = LIT("stb_image"),
+    .version = 1,
+    .kind    = AssetKind::Texture,
     .file_extensions =
         Slice<Str>(File_Extensions, ARRAY_COUNT(File_Extensions)),
     .import = stb_image_import,
@@ -1,15 +1,15 @@
 #include "Containers/Extras.h"
+#include "Core/MeshOptimizer.h"
 #include "DefaultImporters.h"
+#include "FileSystem/Extras.h"
 #include "Memory/Extras.h"
 #include "tiny_obj_loader.h"
 
-static thread_local Allocator* Local_Allocator;
-static Str                     File_Extensions[] = {".obj"};
+static Str File_Extensions[] = {".obj"};
 
 PROC_IMPORTER_IMPORT(tinyobjloader_import)
 {
-    Local_Allocator = &allocator;
-    CREATE_SCOPED_ARENA(*Local_Allocator, temp, 1024);
+    CREATE_SCOPED_ARENA(allocator, temp, 1024);
 
     Str path_cstr = format(temp, LIT("{}\0"), path);
 
@@ -92,13 +92,57 @@ PROC_IMPORTER_IMPORT(tinyobjloader_import)
         }
     }
 
+    // Every face corner got its own vertex above; merge the shared ones and
+    // order everything for the GPU's vertex cache and fetches
+    Slice<u32> index_slice = slice(&indices[0], indices.size());
+
+    const u64 imported_vertices = vertices.size();
+    const f32 imported_acmr =
+        calculate_acmr(System_Allocator, index_slice, imported_vertices);
+
+    u64 vertex_count = deduplicate_vertices(
+        System_Allocator,
+        index_slice,
+        &vertices[0],
+        vertices.size(),
+        sizeof(Vertex_P3fN3fC3fU2f));
+
+    optimize_vertex_cache(System_Allocator, index_slice, vertex_count);
+
+    vertex_count = optimize_vertex_fetch(
+        System_Allocator,
+        index_slice,
+        &vertices[0],
+        vertex_count,
+        sizeof(Vertex_P3fN3fC3fU2f));
+    vertices.resize(vertex_count);
+
+    print(
+        LIT("[tinyobjloader] {}: {} -> {} vertices, ACMR {} -> {}\n"),
+        path,
+        imported_vertices,
+        vertex_count,
+        imported_acmr,
+        calculate_acmr(System_Allocator, index_slice, vertex_count));
+
+    // Most meshes fit in 16 bit indices, halving their size
+    const EIndexFormat index_format =
+        (vertex_count < 65536) ? IndexFormat::U16 : IndexFormat::U32;
+
     const size_t vertices_size = vertices.size() * sizeof(Vertex_P3fN3fC3fU2f);
-    const size_t indices_size  = indices.size() * sizeof(u32);
+    const size_t indices_size  = indices.size() * index_size_of(index_format);
     size_t       total_size    = vertices_size + indices_size;
     auto         blob          = alloc_slice<u8>(allocator, total_size);
 
     memcpy(blob.ptr, &vertices[0], vertices_size);
-    memcpy(blob.ptr + vertices_size, &indices[0], indices_size);
+    if (index_format == IndexFormat::U16) {
+        u16* narrow_indices = (u16*)(blob.ptr + vertices_size);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            narrow_indices[i] = (u16)indices[i];
+        }
+    } else {
+        memcpy(blob.ptr + vertices_size, &indices[0], indices_size);
+    }
 
     return Ok(Asset{
         .info =
@@ -113,7 +157,8 @@ PROC_IMPORTER_IMPORT(tinyobjloader_import)
                         .index_buffer_size  = indices.size(),
                         .bounds             = calculate_mesh_bounds(
                             slice(&vertices[0], vertices.size())),
-                        .format = VertexFormat::P3fN3fC3fU2f,
+                        .format       = VertexFormat::P3fN3fC3fU2f,
+                        .index_format = index_format,
                     },
             },
         .blob = blob,
@@ -121,8 +166,9 @@ PROC_IMPORTER_IMPORT(tinyobjloader_import)
 }
 
 Importer Tiny_OBJ_Loader_Importer = {
-    .name = LIT("tinyobjloader"),
-    .kind = AssetKind::Mesh,
+    .name    = LIT("tinyobjloader"),
+    .version = 1,
+    .kind    = AssetKind::Mesh,
     .file_extensions =
         Slice<Str>(File_Extensions, ARRAY_COUNT(File_Extensions)),
     .import = tinyobjloader_import,
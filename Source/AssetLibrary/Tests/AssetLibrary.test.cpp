@@ -1,7 +1,22 @@
+#include "AssetConverter.h"
 #include "AssetLibrary.h"
+#include "AssetPak.h"
+#include "AssetRegistry.h"
+#include "DerivedDataCache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
 
 #include "Containers/Array.h"
+#include "Containers/Extras.h"
+#include "Core/FileStat.h"
+#include "Core/ImageProcessing.h"
+#include "Core/Tests/TestGrid.h"
 #include "FileSystem/FileSystem.h"
+#include "Memory/AllocTape.h"
 #include "Test/Test.h"
 
 TEST_CASE("AssetLibrary/Main", "Write/Read asset basic")
@@ -59,4 +74,932 @@ TEST_CASE("AssetLibrary/Main", "Write/Read asset basic")
     }
 
     return MPASSED();
-}
\ No newline at end of file
+}
+
+TEST_CASE("AssetLibrary/Map", "Map uncompressed and compressed assets")
+{
+    u8 blob[4096];
+    for (u32 i = 0; i < ARRAY_COUNT(blob); ++i) {
+        blob[i] = u8(i % 7);
+    }
+
+    AssetInfo info = {
+        .version     = 1,
+        .kind        = AssetKind::Archive,
+        .compression = AssetCompression::None,
+        .actual_size = sizeof(blob),
+    };
+
+    {
+        Asset asset = {.info = info, .blob = slice(blob, sizeof(blob))};
+
+        FileHandle              fh = open_file_write("./asset.raw.asset");
+        BufferedWriteTape<true> ft(fh);
+        REQUIRE(asset.write(System_Allocator, &ft, false), "Write raw asset");
+    }
+
+    {
+        Asset asset = {.info = info, .blob = slice(blob, sizeof(blob))};
+
+        FileHandle              fh = open_file_write("./asset.lz4.asset");
+        BufferedWriteTape<true> ft(fh);
+        REQUIRE(asset.write(System_Allocator, &ft, true), "Write lz4 asset");
+    }
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(16));
+
+    {
+        MappedAsset mapped =
+            Asset::map(temp, LIT("./asset.raw.asset")).unwrap();
+
+        REQUIRE(mapped.is_zero_copy(), "");
+
+        Slice<u8> mapped_blob = mapped.blob();
+        REQUIRE(mapped_blob.size() == sizeof(blob), "");
+        REQUIRE(memcmp(mapped_blob.ptr, blob, sizeof(blob)) == 0, "");
+
+        mapped.release();
+    }
+
+    {
+        MappedAsset mapped =
+            Asset::map(temp, LIT("./asset.lz4.asset")).unwrap();
+
+        REQUIRE(!mapped.is_zero_copy(), "");
+
+        Slice<u8> unpacked = alloc_slice<u8>(temp, mapped.info.actual_size);
+        REQUIRE(mapped.unpack(unpacked).ok(), "");
+        REQUIRE(memcmp(unpacked.ptr, blob, sizeof(blob)) == 0, "");
+
+        mapped.release();
+    }
+
+    REQUIRE(
+        Asset::map(temp, LIT("./asset.missing.asset")).err() ==
+            AssetLoadError::FileNotFound,
+        "");
+
+    return MPASSED();
+}
+
+TEST_CASE("AssetLibrary/BinaryHeader", "Probe reads only the binary header")
+{
+    u8 blob[256];
+    for (u32 i = 0; i < ARRAY_COUNT(blob); ++i) {
+        blob[i] = u8(i);
+    }
+
+    AssetInfo info = {
+        .version     = 1,
+        .kind        = AssetKind::Mesh,
+        .compression = AssetCompression::None,
+        .actual_size = sizeof(blob),
+        .mesh =
+            {
+                .vertex_buffer_size = 4,
+                .index_buffer_size  = 6,
+                .bounds =
+                    {
+                        .origin  = glm::vec3(1, 2, 3),
+                        .radius  = 4,
+                        .extents = glm::vec3(5, 6, 7),
+                    },
+                .format       = VertexFormat::P3fN3fC3fU2f,
+                .index_format = IndexFormat::U16,
+                .lod_count    = 2,
+            },
+    };
+
+    Asset asset = {.info = info, .blob = slice(blob, sizeof(blob))};
+
+    AllocWriteTape out(System_Allocator);
+    DEFER(out.release());
+    REQUIRE(asset.write(System_Allocator, &out, false), "");
+
+    // A tape that ends right after the header
+    RawReadTape header_only(Raw{out.ptr, sizeof(BinaryAssetHeader)});
+
+    AssetInfo probed = Asset::probe(System_Allocator, &header_only).unwrap();
+
+    REQUIRE(probed.kind == AssetKind::Mesh, "");
+    REQUIRE(probed.actual_size == sizeof(blob), "");
+    REQUIRE(probed.blob_size == sizeof(blob), "");
+    REQUIRE(probed.blob_offset == sizeof(BinaryAssetHeader), "");
+    REQUIRE(probed.checksum != 0, "");
+    REQUIRE(probed.mesh.vertex_buffer_size == 4, "");
+    REQUIRE(probed.mesh.index_buffer_size == 6, "");
+    REQUIRE(probed.mesh.bounds.origin == glm::vec3(1, 2, 3), "");
+    REQUIRE(probed.mesh.bounds.radius == 4, "");
+    REQUIRE(probed.mesh.bounds.extents == glm::vec3(5, 6, 7), "");
+    REQUIRE(probed.mesh.format == VertexFormat::P3fN3fC3fU2f, "");
+    REQUIRE(probed.mesh.index_format == IndexFormat::U16, "");
+    REQUIRE(probed.mesh.lod_count == 2, "");
+
+    // The checksum catches a blob that changed after it was written
+    u8*         file   = (u8*)out.ptr;
+    MappedAsset mapped =
+        Asset::map_memory(System_Allocator, slice(file, out.offset)).unwrap();
+    REQUIRE(Asset::verify(mapped.info, mapped.stored_blob), "");
+
+    file[probed.blob_offset + 3] ^= 0xFF;
+    REQUIRE(!Asset::verify(mapped.info, mapped.stored_blob), "");
+
+    return MPASSED();
+}
+
+TEST_CASE("AssetLibrary/JSONInfo", "Assets with a JSON info still load")
+{
+    u8 blob[1024];
+    for (u32 i = 0; i < ARRAY_COUNT(blob); ++i) {
+        blob[i] = u8(i % 13);
+    }
+
+    AssetInfo info = {
+        .version     = 1,
+        .kind        = AssetKind::Texture,
+        .compression = AssetCompression::None,
+        .actual_size = sizeof(blob),
+        .texture =
+            {
+                .width  = 16,
+                .height = 16,
+                .depth  = 1,
+                .format = TextureFormat::R8G8B8A8UInt,
+            },
+    };
+
+    {
+        Asset asset = {.info = info, .blob = slice(blob, sizeof(blob))};
+
+        FileHandle              fh = open_file_write("./asset.json.asset");
+        BufferedWriteTape<true> ft(fh);
+        REQUIRE(asset.write(System_Allocator, &ft, true, true), "");
+    }
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(16));
+
+    Asset asset = Asset::load(temp, LIT("./asset.json.asset")).unwrap();
+
+    REQUIRE(asset.info.kind == AssetKind::Texture, "");
+    REQUIRE(asset.info.texture.width == 16, "");
+    REQUIRE(asset.info.checksum == 0, "");
+    REQUIRE(asset.blob.size() == sizeof(blob), "");
+    REQUIRE(memcmp(asset.blob.ptr, blob, sizeof(blob)) == 0, "");
+
+    return MPASSED();
+}
+TEST_CASE("AssetLibrary/Chunked", "Compress in blocks, unpack all or part")
+{
+    // Several blocks, the last one partial, with a stretch that won't shrink
+    const u64 size = Asset_Block_Size * 3 + 1000;
+    Slice<u8> blob = alloc_slice<u8>(System_Allocator, size);
+    DEFER(System_Allocator.release(blob.ptr));
+
+    u32 noise = 1;
+    for (u64 i = 0; i < size; ++i) {
+        noise       = noise * 1664525 + 1013904223;
+        blob.ptr[i] = (i < Asset_Block_Size) ? u8(noise >> 24) : u8(i % 11);
+    }
+
+    AssetInfo info = {
+        .version     = 1,
+        .kind        = AssetKind::Archive,
+        .compression = AssetCompression::None,
+        .actual_size = size,
+    };
+
+    Asset asset = {.info = info, .blob = blob};
+
+    AllocWriteTape out(System_Allocator);
+    DEFER(out.release());
+    REQUIRE(asset.write(System_Allocator, &out, true), "");
+
+    RawReadTape input(Raw{out.ptr, out.offset});
+    AssetInfo   probed = Asset::probe(System_Allocator, &input).unwrap();
+    REQUIRE(probed.compression == AssetCompression::LZ4Chunked, "");
+
+    Slice<u8> stored_blob =
+        slice(out.ptr + probed.blob_offset, probed.blob_size);
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(8));
+
+    Slice<u8> unpacked = alloc_slice<u8>(temp, size);
+    REQUIRE(Asset::unpack(probed, stored_blob, unpacked).ok(), "");
+    REQUIRE(memcmp(unpacked.ptr, blob.ptr, size) == 0, "");
+
+    // Within a block, across blocks, and up to the end
+    u64 ranges[][2] = {
+        {10, 100},
+        {Asset_Block_Size - 10, Asset_Block_Size * 2 + 20},
+        {Asset_Block_Size, Asset_Block_Size},
+        {size - 1500, 1500},
+    };
+
+    for (u32 i = 0; i < ARRAY_COUNT(ranges); ++i) {
+        Slice<u8> part = alloc_slice<u8>(temp, ranges[i][1]);
+        REQUIRE(
+            Asset::unpack_range(temp, probed, stored_blob, ranges[i][0], part)
+                .ok(),
+            "");
+        REQUIRE(
+            memcmp(part.ptr, blob.ptr + ranges[i][0], part.size()) == 0,
+            "");
+    }
+
+    Slice<u8> past_end = alloc_slice<u8>(temp, 10);
+    REQUIRE(
+        !Asset::unpack_range(temp, probed, stored_blob, size - 5, past_end)
+             .ok(),
+        "");
+
+    return MPASSED();
+}
+
+static void write_triangle_obj(Str path, float z)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+    Str obj = format(
+        temp,
+        LIT("v 0 0 {}\nv 1 0 {}\nv 0 1 {}\n"
+            "vt 0 0\nvt 1 0\nvt 0 1\n"
+            "vn 0 0 1\n"
+            "f 1/1/1 2/2/1 3/3/1\n"),
+        z,
+        z,
+        z);
+
+    BufferedWriteTape<true> ft(open_file_write(path));
+    ft.write(obj.data, obj.len);
+}
+
+TEST_CASE("AssetLibrary/Converter", "Convert in batches, skip unchanged")
+{
+    ImporterRegistry registry(System_Allocator);
+    registry.init_default_importers();
+
+    JobSystem jobs;
+    jobs.init(2);
+    DEFER(jobs.deinit());
+
+    write_triangle_obj(LIT("./converter.a.obj"), 0);
+    write_triangle_obj(LIT("./converter.b.obj"), 1);
+
+    auto convert = [&](u32& converted, u32& skipped, u32& failed) {
+        AssetConverter converter;
+        converter.init(&registry, AssetCompressionLevel::Default);
+        DEFER(converter.deinit());
+
+        converter.load_cache(LIT("./converter.cache"));
+        converter.add(LIT("./converter.a.obj"), LIT("./converter.a.asset"));
+        converter.add(LIT("./converter.b.obj"), LIT("./converter.b.asset"));
+        converter.add(LIT("./converter.none.obj"), LIT("./converter.c.asset"));
+        converter.run(jobs);
+        converter.save_cache(LIT("./converter.cache"));
+
+        converted = skipped = failed = 0;
+        for (const AssetConverter::Entry& entry : converter.entries) {
+            if (entry.failed) {
+                failed++;
+            } else if (entry.skipped) {
+                skipped++;
+            } else {
+                converted++;
+            }
+        }
+    };
+
+    u32 converted, skipped, failed;
+
+    convert(converted, skipped, failed);
+    REQUIRE(converted == 2, "");
+    REQUIRE(failed == 1, "");
+
+    {
+        CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(4));
+        Asset asset = Asset::load(temp, LIT("./converter.a.asset")).unwrap();
+        REQUIRE(asset.info.kind == AssetKind::Mesh, "");
+    }
+
+    convert(converted, skipped, failed);
+    REQUIRE(converted == 0, "");
+    REQUIRE(skipped == 2, "");
+
+    write_triangle_obj(LIT("./converter.b.obj"), 2);
+
+    convert(converted, skipped, failed);
+    REQUIRE(converted == 1, "");
+    REQUIRE(skipped == 1, "");
+
+    // A second source for the same output fails, instead of racing the first
+    {
+        AssetConverter converter;
+        converter.init(&registry, AssetCompressionLevel::Default);
+        DEFER(converter.deinit());
+
+        Str output = LIT("./converter.d.asset");
+        REQUIRE(converter.add(LIT("./converter.a.obj"), output), "");
+        REQUIRE(!converter.add(LIT("./converter.b.obj"), output), "");
+        converter.run(jobs);
+
+        REQUIRE(!converter.entries[0].failed, "");
+        REQUIRE(converter.entries[1].failed, "");
+    }
+
+    // A run with only some of the sources keeps the hashes of the others
+    {
+        AssetConverter converter;
+        converter.init(&registry, AssetCompressionLevel::Default);
+        DEFER(converter.deinit());
+
+        converter.load_cache(LIT("./converter.cache"));
+        converter.add(LIT("./converter.a.obj"), LIT("./converter.a.asset"));
+        converter.run(jobs);
+        converter.save_cache(LIT("./converter.cache"));
+    }
+
+    convert(converted, skipped, failed);
+    REQUIRE(converted == 0, "");
+    REQUIRE(skipped == 2, "");
+
+    // Unchanged sources are converted again by a newer importer
+    for (Importer& importer : registry.importers) importer.version++;
+    convert(converted, skipped, failed);
+    REQUIRE(converted == 2, "");
+    REQUIRE(skipped == 0, "");
+
+    return MPASSED();
+}
+
+TEST_CASE("AssetLibrary/DerivedData", "Fetch conversions by content, trim")
+{
+    ImporterRegistry registry(System_Allocator);
+    registry.init_default_importers();
+
+    JobSystem jobs;
+    jobs.init(2);
+    DEFER(jobs.deinit());
+
+    DerivedDataCache cache;
+    REQUIRE(cache.init(LIT("./ddc.test")), "");
+    DEFER(cache.deinit());
+
+    // Whatever a previous run left
+    cache.max_size = 0;
+    cache.trim();
+    cache.max_size = MEGABYTES(1);
+    cache.stats.evictions = 0;
+
+    write_triangle_obj(LIT("./ddc.a.obj"), 0);
+    write_triangle_obj(LIT("./ddc.b.obj"), 1);
+
+    // Without a build cache, so every source is looked up
+    auto convert = [&](u32& converted, u32& cached) {
+        AssetConverter converter;
+        converter.init(&registry, AssetCompressionLevel::Default);
+        DEFER(converter.deinit());
+        converter.derived_data = &cache;
+
+        converter.add(LIT("./ddc.a.obj"), LIT("./ddc.a.asset"));
+        converter.add(LIT("./ddc.b.obj"), LIT("./ddc.b.asset"));
+        converter.run(jobs);
+
+        converted = cached = 0;
+        for (const AssetConverter::Entry& entry : converter.entries) {
+            if (entry.cached) {
+                cached++;
+            } else if (!entry.failed) {
+                converted++;
+            }
+        }
+    };
+
+    auto file_size = [](Str path) {
+        FileStat stat = {};
+        stat_file(path, stat);
+        return stat.size;
+    };
+
+    u32 converted, cached;
+
+    convert(converted, cached);
+    REQUIRE(converted == 2, "");
+    REQUIRE(cache.stats.misses == 2, "");
+    REQUIRE(cache.stats.stores == 2, "");
+
+    convert(converted, cached);
+    REQUIRE(cached == 2, "");
+    REQUIRE(cache.stats.hits == 2, "");
+
+    {
+        CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(4));
+        Asset asset = Asset::load(temp, LIT("./ddc.a.asset")).unwrap();
+        REQUIRE(asset.info.kind == AssetKind::Mesh, "");
+    }
+
+    const u64 a_size = file_size(LIT("./ddc.a.asset"));
+    const u64 b_size = file_size(LIT("./ddc.b.asset"));
+
+    // A changed source misses, but changing it back hits again
+    write_triangle_obj(LIT("./ddc.b.obj"), 2);
+    convert(converted, cached);
+    REQUIRE(converted == 1, "");
+    REQUIRE(cached == 1, "");
+
+    const u64 changed_b_size = file_size(LIT("./ddc.b.asset"));
+
+    // Times from touching the entries differ from the store's
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    write_triangle_obj(LIT("./ddc.b.obj"), 1);
+    convert(converted, cached);
+    REQUIRE(cached == 2, "");
+
+    // So does another version of the importer
+    const Importer* importer = registry.find_importer(LIT("./ddc.a.obj"));
+    REQUIRE(importer != nullptr, "");
+
+    Importer bumped = *importer;
+    bumped.version++;
+    REQUIRE(
+        DerivedDataCache::make_key(1, *importer) !=
+            DerivedDataCache::make_key(1, bumped),
+        "");
+
+    // Only the changed b wasn't fetched since, so it goes first
+    cache.max_size = a_size + b_size + changed_b_size - 1;
+    REQUIRE(cache.trim() == 1, "");
+    REQUIRE(cache.stats.evictions == 1, "");
+
+    write_triangle_obj(LIT("./ddc.b.obj"), 2);
+    convert(converted, cached);
+    REQUIRE(converted == 1, "");
+    REQUIRE(cached == 1, "");
+
+    cache.max_size = 0;
+    cache.trim();
+
+    return MPASSED();
+}
+
+/**
+ * A flat grid mesh asset of size * size quads, with 16 bit indices. blob
+ * holds the vertices and indices
+ */
+static Asset make_grid_mesh(u32 size, TArray<u8>& blob)
+{
+    TArray<glm::vec3> positions(&System_Allocator);
+    TArray<u32>       grid_indices(&System_Allocator);
+    DEFER(positions.release());
+    DEFER(grid_indices.release());
+    make_grid(positions, grid_indices, size);
+
+    TArray<Vertex_P3fN3fC3fU2f> vertices(&System_Allocator);
+    TArray<u16>                 indices(&System_Allocator);
+    DEFER(vertices.release());
+    DEFER(indices.release());
+
+    for (const glm::vec3& position : positions) {
+        vertices.add(Vertex_P3fN3fC3fU2f{
+            .position = position,
+            .normal   = glm::vec3(0, 0, 1),
+        });
+    }
+    for (u32 index : grid_indices) indices.add(u16(index));
+
+    const u64 vertices_size = vertices.size * sizeof(Vertex_P3fN3fC3fU2f);
+    const u64 indices_size  = indices.size * sizeof(u16);
+
+    for (u64 i = 0; i < vertices_size + indices_size; ++i) blob.add(0);
+    memcpy(blob.data, vertices.data, vertices_size);
+    memcpy(blob.data + vertices_size, indices.data, indices_size);
+
+    return Asset{
+        .info =
+            {
+                .version     = 1,
+                .kind        = AssetKind::Mesh,
+                .compression = AssetCompression::None,
+                .actual_size = blob.size,
+                .mesh =
+                    {
+                        .vertex_buffer_size = vertices.size,
+                        .index_buffer_size  = indices.size,
+                        .format             = VertexFormat::P3fN3fC3fU2f,
+                        .index_format       = IndexFormat::U16,
+                    },
+            },
+        .blob = slice(blob),
+    };
+}
+
+TEST_CASE("AssetLibrary/MeshLods", "Build LODs of a grid, read them back")
+{
+    TArray<u8> blob(&System_Allocator);
+    DEFER(blob.release());
+
+    Asset asset = make_grid_mesh(16, blob);
+
+    const u64 vertices_size =
+        asset.info.mesh.vertex_buffer_size * sizeof(Vertex_P3fN3fC3fU2f);
+    const u64 index_count  = asset.info.mesh.index_buffer_size;
+    const u64 indices_size = index_count * sizeof(u16);
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    Asset lodded = build_mesh_lods(temp, asset).unwrap();
+    REQUIRE(lodded.info.mesh.lod_count > 1, "");
+
+    // Write uncompressed, so the odd sized index buffer is kept as it is
+    AllocWriteTape out(System_Allocator);
+    DEFER(out.release());
+    REQUIRE(lodded.write(System_Allocator, &out, false), "");
+
+    RawReadTape input(Raw{out.ptr, out.offset});
+    Asset       loaded = Asset::load(temp, &input).unwrap();
+    REQUIRE(loaded.info.mesh.lod_count == lodded.info.mesh.lod_count, "");
+
+    MeshLod lods[Max_Mesh_Lods];
+    u32     lod_count = read_mesh_lods(loaded, lods);
+    REQUIRE(lod_count == loaded.info.mesh.lod_count, "");
+
+    // LODs are laid out back to back, each smaller than the last
+    REQUIRE(lods[0].first_index == 0, "");
+    REQUIRE(lods[0].index_count == index_count, "");
+    for (u32 i = 1; i < lod_count; ++i) {
+        REQUIRE(
+            lods[i].first_index ==
+                lods[i - 1].first_index + lods[i - 1].index_count,
+            "");
+        REQUIRE(lods[i].index_count < lods[i - 1].index_count, "");
+    }
+
+    const u64 last_index = lods[lod_count - 1].first_index +
+                           lods[lod_count - 1].index_count;
+    REQUIRE(last_index == loaded.info.mesh.index_buffer_size, "");
+
+    // The full detail indices are untouched
+    REQUIRE(
+        memcmp(
+            loaded.blob.ptr + vertices_size,
+            blob.data + vertices_size,
+            indices_size) == 0,
+        "");
+
+    return MPASSED();
+}
+
+TEST_CASE("AssetLibrary/MeshMeshlets", "Split a grid into meshlets")
+{
+    TArray<u8> blob(&System_Allocator);
+    DEFER(blob.release());
+
+    Asset asset = make_grid_mesh(32, blob);
+
+    const u64 vertices_size =
+        asset.info.mesh.vertex_buffer_size * sizeof(Vertex_P3fN3fC3fU2f);
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(256));
+
+    Asset lodded = build_mesh_lods(temp, asset).unwrap();
+    REQUIRE(lodded.info.mesh.lod_count > 1, "");
+
+    Asset split = build_mesh_meshlets(temp, lodded).unwrap();
+    REQUIRE(split.info.mesh.meshlet_count > 1, "");
+
+    AllocWriteTape out(System_Allocator);
+    DEFER(out.release());
+    REQUIRE(split.write(System_Allocator, &out, false), "");
+
+    RawReadTape input(Raw{out.ptr, out.offset});
+    Asset       loaded = Asset::load(temp, &input).unwrap();
+    REQUIRE(
+        loaded.info.mesh.meshlet_count == split.info.mesh.meshlet_count,
+        "");
+
+    // The LOD table is still in place, and the coarser LODs are untouched
+    MeshLod lods[Max_Mesh_Lods];
+    u32     lod_count = read_mesh_lods(loaded, lods);
+    REQUIRE(lod_count == lodded.info.mesh.lod_count, "");
+
+    const u64 coarse_offset =
+        vertices_size + lods[1].first_index * sizeof(u16);
+    REQUIRE(
+        memcmp(
+            loaded.blob.ptr + coarse_offset,
+            lodded.blob.ptr + coarse_offset,
+            (loaded.info.mesh.index_buffer_size - lods[1].first_index) *
+                sizeof(u16)) == 0,
+        "");
+
+    // Meshlets cover the full detail LOD back to back
+    Slice<Meshlet> meshlets =
+        alloc_slice<Meshlet>(temp, loaded.info.mesh.meshlet_count);
+    read_mesh_meshlets(loaded, meshlets.ptr);
+
+    u32 next_index = 0;
+    for (const Meshlet& meshlet : meshlets) {
+        REQUIRE(meshlet.first_index == next_index, "");
+        REQUIRE(meshlet.index_count <= Meshlet_Max_Triangles * 3, "");
+        REQUIRE(meshlet.radius > 0.0f, "");
+        next_index += meshlet.index_count;
+    }
+    REQUIRE(next_index == lods[0].index_count, "");
+
+    return MPASSED();
+}
+
+TEST_CASE("AssetLibrary/TextureMips", "Build the mips of a texture, encode")
+{
+    // Columns alternate between black and white, so every mip past 0 is grey
+    static constexpr u32 width  = 16;
+    static constexpr u32 height = 8;
+
+    u8 pixels[width * height * 4];
+    for (u32 i = 0; i < width * height; ++i) {
+        u8 value = (i % 2) ? 255 : 0;
+        memset(pixels + i * 4, value, 3);
+        pixels[i * 4 + 3] = 255;
+    }
+
+    Asset asset = {
+        .info =
+            {
+                .version     = 1,
+                .kind        = AssetKind::Texture,
+                .compression = AssetCompression::None,
+                .actual_size = sizeof(pixels),
+                .texture =
+                    {
+                        .width  = width,
+                        .height = height,
+                        .depth  = 1,
+                        .format = TextureFormat::R8G8B8A8UInt,
+                    },
+            },
+        .blob = slice(pixels, sizeof(pixels)),
+    };
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    Asset mipped = build_texture_mips(temp, asset).unwrap();
+
+    // 16x8, 8x4, 4x2, 2x1, 1x1
+    const TextureAsset& texture = mipped.info.texture;
+    REQUIRE(texture.mip_count == 5, "");
+    REQUIRE(texture_mip_offset(texture, 1) == sizeof(pixels), "");
+    REQUIRE(texture_mip_offset(texture, 5) == mipped.blob.count, "");
+    REQUIRE(memcmp(mipped.blob.ptr, pixels, sizeof(pixels)) == 0, "");
+
+    const u8* last = mipped.blob.ptr + texture_mip_offset(texture, 4);
+    REQUIRE((last[0] == 128) && (last[3] == 255), "");
+
+    Asset encoded = compress_texture(temp, mipped, TextureFormat::BC1).unwrap();
+    REQUIRE(encoded.info.texture.format == TextureFormat::BC1, "");
+    REQUIRE(encoded.info.texture.mip_count == 5, "");
+
+    // 4x2 blocks, 2x1 blocks, then a partial block for each mip left
+    REQUIRE(encoded.blob.count == (8 + 2 + 3) * BC1_Block_Size, "");
+
+    AllocWriteTape out(System_Allocator);
+    DEFER(out.release());
+    REQUIRE(encoded.write(System_Allocator, &out, true), "");
+
+    RawReadTape input(Raw{out.ptr, out.offset});
+    Asset       loaded = Asset::load(temp, &input).unwrap();
+    REQUIRE(loaded.info.texture.format == TextureFormat::BC1, "");
+    REQUIRE(loaded.info.texture.mip_count == 5, "");
+    REQUIRE(loaded.blob.count == encoded.blob.count, "");
+    REQUIRE(
+        memcmp(loaded.blob.ptr, encoded.blob.ptr, loaded.blob.count) == 0,
+        "");
+
+    return MPASSED();
+}
+
+/** A small uncompressed asset of kind, filled with value */
+static void write_registry_asset(Str path, EAssetKind kind, u8 value)
+{
+    u8 blob[64];
+    memset(blob, value, sizeof(blob));
+
+    Asset asset = {
+        .info =
+            {
+                .version     = 1,
+                .kind        = kind,
+                .compression = AssetCompression::None,
+                .actual_size = sizeof(blob),
+            },
+        .blob = slice(blob, sizeof(blob)),
+    };
+
+    BufferedWriteTape<true> ft(open_file_write(path));
+    asset.write(System_Allocator, &ft, false);
+}
+
+static AssetRegistryEntry* find_registry_entry(
+    AssetRegistry& registry, Str path)
+{
+    for (AssetRegistryEntry& entry : registry.entries) {
+        if (entry.path == path) return &entry;
+    }
+    return nullptr;
+}
+
+TEST_CASE("AssetLibrary/Registry", "Index asset directories, refresh them")
+{
+    create_dir(LIT("./registry.test"));
+    create_dir(LIT("./registry.test/sub"));
+    remove("./registry.test/sub/registry.c.asset");
+
+    write_registry_asset(
+        LIT("./registry.test/registry.a.asset"), AssetKind::Archive, 1);
+    write_registry_asset(
+        LIT("./registry.test/sub/registry.b.asset"), AssetKind::Texture, 2);
+    {
+        BufferedWriteTape<true> ft(
+            open_file_write(LIT("./registry.test/notes.txt")));
+        ft.write("notes", 5);
+    }
+
+    auto roots = arr<AssetRegistryRoot>(AssetRegistryRoot{
+        .module    = LIT("Test"),
+        .directory = LIT("./registry.test"),
+    });
+
+    {
+        AssetRegistry registry;
+        registry.init(System_Allocator);
+        DEFER(registry.deinit());
+
+        REQUIRE(registry.refresh(slice(roots)) == 2, "");
+        REQUIRE(registry.entries.size == 2, "");
+
+        AssetRegistryEntry* b =
+            find_registry_entry(registry, LIT("/sub/registry.b.asset"));
+        REQUIRE(b != nullptr, "");
+        REQUIRE(b->kind == AssetKind::Texture, "");
+        REQUIRE(b->module == LIT("Test"), "");
+
+        for (u64 i = 0; i < registry.entries.size; ++i) {
+            registry.entries[i].id[0] = i + 1;
+            registry.entries[i].id[1] = 7;
+        }
+        REQUIRE(registry.save(LIT("./registry.test.index")), "");
+    }
+
+    // Directory times are only as fine as the clock of the file system
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    AssetRegistry registry;
+    registry.init(System_Allocator);
+    DEFER(registry.deinit());
+
+    REQUIRE(registry.load(LIT("./registry.test.index")), "");
+    REQUIRE(registry.entries.size == 2, "");
+    REQUIRE(registry.refresh(slice(roots)) == 0, "");
+
+    AssetRegistryEntry* b =
+        find_registry_entry(registry, LIT("/sub/registry.b.asset"));
+    REQUIRE(b != nullptr, "");
+
+    const u64 b_id   = b->id[0];
+    const u64 b_hash = b->content_hash;
+    REQUIRE(b_id != 0, "");
+
+    // One added, one removed
+    write_registry_asset(
+        LIT("./registry.test/sub/registry.c.asset"), AssetKind::Mesh, 3);
+    remove("./registry.test/registry.a.asset");
+
+    REQUIRE(registry.refresh(slice(roots)) == 2, "");
+    REQUIRE(registry.entries.size == 2, "");
+    REQUIRE(
+        find_registry_entry(registry, LIT("/registry.a.asset")) == nullptr,
+        "");
+
+    AssetRegistryEntry* c =
+        find_registry_entry(registry, LIT("/sub/registry.c.asset"));
+    REQUIRE(c != nullptr, "");
+    REQUIRE(c->kind == AssetKind::Mesh, "");
+    REQUIRE(c->id[0] == 0, "");
+
+    b = find_registry_entry(registry, LIT("/sub/registry.b.asset"));
+    REQUIRE(b->id[0] == b_id, "");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Modified in place, which only checking the files notices
+    write_registry_asset(
+        LIT("./registry.test/sub/registry.b.asset"), AssetKind::Texture, 4);
+
+    REQUIRE(registry.refresh(slice(roots)) == 0, "");
+    REQUIRE(registry.refresh(slice(roots), true) == 1, "");
+
+    b = find_registry_entry(registry, LIT("/sub/registry.b.asset"));
+    REQUIRE(b->id[0] == b_id, "");
+    REQUIRE(b->content_hash != b_hash, "");
+
+    return MPASSED();
+}
+
+TEST_CASE("AssetLibrary/Pak", "Pack assets, find them by id, read in place")
+{
+    u8 blobs[3][1000];
+    for (u32 i = 0; i < 3; ++i) {
+        for (u32 j = 0; j < sizeof(blobs[i]); ++j) blobs[i][j] = u8(i + j % 5);
+    }
+
+    // Packed in this order, but looked up by id
+    const u64  ids[3][2]   = {{3, 1}, {1, 2}, {1, 1}};
+    const Str  paths[3]    = {
+        LIT("./pak.a.asset"),
+        LIT("./pak.b.asset"),
+        LIT("./pak.c.asset"),
+    };
+    const Str  groups[3]   = {LIT("level"), LIT(""), LIT("level")};
+    const bool compress[3] = {false, true, false};
+
+    for (u32 i = 0; i < 3; ++i) {
+        Asset asset = {
+            .info =
+                {
+                    .version     = 1,
+                    .kind        = AssetKind::Archive,
+                    .compression = AssetCompression::None,
+                    .actual_size = sizeof(blobs[i]),
+                },
+            .blob = slice(blobs[i], sizeof(blobs[i])),
+        };
+
+        BufferedWriteTape<true> ft(open_file_write(paths[i]));
+        REQUIRE(asset.write(System_Allocator, &ft, compress[i]), "");
+    }
+
+    {
+        AssetPakBuilder builder;
+        builder.init(System_Allocator);
+        DEFER(builder.deinit());
+
+        for (u32 i = 0; i < 3; ++i) {
+            builder.add(ids[i], LIT("Engine"), paths[i], paths[i], groups[i]);
+        }
+        REQUIRE(builder.write(LIT("./pak.test.pak")), "");
+
+        // Ids have to be unique
+        builder.add(ids[0], LIT("Engine"), paths[0], paths[0]);
+        REQUIRE(!builder.write(LIT("./pak.dup.pak")), "");
+    }
+
+    AssetPak pak;
+    REQUIRE(pak.open(LIT("./pak.test.pak")), "");
+    DEFER(pak.close());
+
+    REQUIRE(pak.entry_count() == 3, "");
+    REQUIRE(pak.group_count() == 2, "");
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(16));
+
+    for (u32 i = 0; i < 3; ++i) {
+        i64 index = pak.find(ids[i][0], ids[i][1]);
+        REQUIRE(index >= 0, "");
+
+        AssetPakEntry entry = pak.entry(u32(index));
+        REQUIRE(entry.path == paths[i], "");
+        REQUIRE(entry.module == LIT("Engine"), "");
+        REQUIRE(entry.kind == AssetKind::Archive, "");
+        REQUIRE((u64(entry.data.ptr) % Asset_Pak_Alignment) == 0, "");
+
+        MappedAsset mapped = Asset::map_memory(temp, entry.data).unwrap();
+        REQUIRE(mapped.is_zero_copy() == !compress[i], "");
+
+        Slice<u8> unpacked = alloc_slice<u8>(temp, mapped.info.actual_size);
+        REQUIRE(mapped.unpack(unpacked).ok(), "");
+        REQUIRE(memcmp(unpacked.ptr, blobs[i], sizeof(blobs[i])) == 0, "");
+
+        // Used in place
+        if (mapped.is_zero_copy()) {
+            REQUIRE(pak.contains(mapped.blob().ptr), "");
+        }
+        mapped.release();
+    }
+
+    REQUIRE(pak.find(2, 0) == -1, "");
+    REQUIRE(pak.find(1, 1) == 0, "");
+
+    // The entries of a group are next to each other
+    AssetPakGroup level = pak.group(0);
+    REQUIRE(level.name == LIT("level"), "");
+    REQUIRE(level.entry_count == 2, "");
+
+    AssetPakEntry a = pak.entry(u32(pak.find(3, 1)));
+    AssetPakEntry c = pak.entry(u32(pak.find(1, 1)));
+    REQUIRE(a.data.ptr == level.data.ptr, "");
+    REQUIRE(c.data.ptr + c.data.count == level.data.ptr + level.data.count, "");
+
+    REQUIRE(pak.prefetch_group(LIT("level")), "");
+    REQUIRE(!pak.prefetch_group(LIT("missing")), "");
+
+    return MPASSED();
+}
@@ -0,0 +1,621 @@
+#define MOK_WIN32_NO_FUNCTIONS
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+
+#include "Containers/Extras.h"
+#include "Memory/Extras.h"
+#include "Thread/ThreadContext.h"
+
+#if OS_MSWINDOWS
+#include <windows.h>
+#elif OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Reads the range of read into its buffer, allocating it from allocator if
+ * it's empty, with blocking reads
+ */
+static bool read_blocking(Allocator& allocator, AsyncRead& read);
+
+#if OS_MSWINDOWS
+
+static HANDLE open_for_read(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    return CreateFileA(
+        path_cstr.data,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        0,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        0);
+}
+
+static bool read_blocking(Allocator& allocator, AsyncRead& read)
+{
+    HANDLE file = open_for_read(read.path);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    DEFER(CloseHandle(file));
+
+    u64 size = read.size;
+    if (size == 0) {
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) return false;
+        if (u64(file_size.QuadPart) < read.offset) return false;
+
+        size = u64(file_size.QuadPart) - read.offset;
+    }
+
+    const bool allocated = read.buffer.count == 0;
+    if (allocated) read.buffer = alloc_slice<u8>(allocator, size);
+    ASSERT(read.buffer.count >= size);
+
+    u64 done = 0;
+    while (done < size) {
+        const u64 offset = read.offset + done;
+
+        // The offset of a synchronous handle's read goes in the OVERLAPPED
+        OVERLAPPED overlapped = {};
+        overlapped.Offset     = DWORD(offset);
+        overlapped.OffsetHigh = DWORD(offset >> 32);
+        DWORD chunk      = DWORD(std::min<u64>(size - done, MEGABYTES(64)));
+        DWORD bytes_read = 0;
+
+        if (!ReadFile(
+                file,
+                read.buffer.ptr + done,
+                chunk,
+                &bytes_read,
+                &overlapped) ||
+            (bytes_read == 0))
+        {
+            break;
+        }
+
+        done += bytes_read;
+    }
+
+    if (done < size) {
+        if (allocated) {
+            allocator.release(read.buffer.ptr);
+            read.buffer = Slice<u8>();
+        }
+        return false;
+    }
+
+    read.buffer = slice(read.buffer.ptr, size);
+    return true;
+}
+
+#elif OS_LINUX
+
+static int open_for_read(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    return ::open(path_cstr.data, O_RDONLY | O_CLOEXEC);
+}
+
+/** The size of the range of read in the open file fd */
+static bool range_size(int fd, const AsyncRead& read, u64& size)
+{
+    size = read.size;
+    if (size != 0) return true;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    if (u64(st.st_size) < read.offset) return false;
+
+    size = u64(st.st_size) - read.offset;
+    return true;
+}
+
+static bool read_blocking(Allocator& allocator, AsyncRead& read)
+{
+    int fd = open_for_read(read.path);
+    if (fd < 0) return false;
+    DEFER(::close(fd));
+
+    u64 size;
+    if (!range_size(fd, read, size)) return false;
+
+    const bool allocated = read.buffer.count == 0;
+    if (allocated) read.buffer = alloc_slice<u8>(allocator, size);
+    ASSERT(read.buffer.count >= size);
+
+    u64 done = 0;
+    while (done < size) {
+        ssize_t result = pread(
+            fd,
+            read.buffer.ptr + done,
+            size - done,
+            off_t(read.offset + done));
+
+        if ((result < 0) && (errno == EINTR)) continue;
+        if (result <= 0) break;
+
+        done += u64(result);
+    }
+
+    if (done < size) {
+        if (allocated) {
+            allocator.release(read.buffer.ptr);
+            read.buffer = Slice<u8>();
+        }
+        return false;
+    }
+
+    read.buffer = slice(read.buffer.ptr, size);
+    return true;
+}
+
+/**
+ * The shared rings of an io_uring, set up without liburing. Reads go in the
+ * submission queue, and come back, in any order, through the completion
+ * queue, tagged with their user_data.
+ */
+struct IoUring {
+    int fd = -1;
+
+    u32*          sq_tail;
+    u32           sq_mask;
+    u32*          sq_array;
+    io_uring_sqe* sqes;
+    u32           sq_entries;
+    /** Entries added to the submission queue, and not submitted yet */
+    u32           unsubmitted = 0;
+
+    u32*          cq_head;
+    u32*          cq_tail;
+    u32           cq_mask;
+    io_uring_cqe* cqes;
+
+    void* sq_ring      = MAP_FAILED;
+    u64   sq_ring_size = 0;
+    void* cq_ring      = MAP_FAILED;
+    u64   cq_ring_size = 0;
+    void* sqes_ring    = MAP_FAILED;
+    u64   sqes_size    = 0;
+
+    /** @return false if io_uring or its read operation isn't available */
+    bool init(u32 entries)
+    {
+        io_uring_params params = {};
+
+        fd = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+
+        if (!supports_read()) return false;
+
+        sq_ring_size =
+            params.sq_off.array + params.sq_entries * sizeof(u32);
+        cq_ring_size =
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+        // Both rings share a mapping since 5.4
+        const bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mapping) {
+            sq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+
+        sq_ring = map_ring(sq_ring_size, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) return false;
+
+        if (single_mapping) {
+            cq_ring = sq_ring;
+        } else {
+            cq_ring = map_ring(cq_ring_size, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED) return false;
+        }
+
+        sqes_ring = map_ring(sqes_size, IORING_OFF_SQES);
+        if (sqes_ring == MAP_FAILED) return false;
+
+        u8* sq     = (u8*)sq_ring;
+        u8* cq     = (u8*)cq_ring;
+        sq_tail    = (u32*)(sq + params.sq_off.tail);
+        sq_mask    = *(u32*)(sq + params.sq_off.ring_mask);
+        sq_array   = (u32*)(sq + params.sq_off.array);
+        sqes       = (io_uring_sqe*)sqes_ring;
+        sq_entries = params.sq_entries;
+        cq_head    = (u32*)(cq + params.cq_off.head);
+        cq_tail    = (u32*)(cq + params.cq_off.tail);
+        cq_mask    = *(u32*)(cq + params.cq_off.ring_mask);
+        cqes       = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void deinit()
+    {
+        if (sqes_ring != MAP_FAILED) munmap(sqes_ring, sqes_size);
+        if ((cq_ring != MAP_FAILED) && (cq_ring != sq_ring)) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+        if (fd >= 0) ::close(fd);
+    }
+
+    /**
+     * Adds an entry to the submission queue, which has to have room for it,
+     * and returns it zeroed. It's submitted by the next call to submit
+     */
+    io_uring_sqe& push(u64 user_data)
+    {
+        // Only ever written by us, under the reader's lock
+        const u32 tail  = *sq_tail;
+        const u32 index = tail & sq_mask;
+
+        io_uring_sqe& sqe = sqes[index];
+        sqe               = {};
+        sqe.user_data     = user_data;
+
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted++;
+        return sqe;
+    }
+
+    /** Hands the entries pushed so far to the kernel */
+    void submit()
+    {
+        while (unsubmitted > 0) {
+            int result = enter(unsubmitted, 0, 0);
+            if (result > 0) {
+                unsubmitted -= std::min(u32(result), unsubmitted);
+                continue;
+            }
+
+            // The kernel found no entries left to take
+            if (result == 0) {
+                unsubmitted = 0;
+                break;
+            }
+
+            // Busy while the completion queue is full, which the completion
+            // thread is emptying
+            ASSERT((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY));
+            std::this_thread::yield();
+        }
+    }
+
+    /** Blocks until at least one completion is ready */
+    void wait_for_completion()
+    {
+        while ((enter(0, 1, IORING_ENTER_GETEVENTS) < 0) && (errno == EINTR))
+            ;
+    }
+
+    /**
+     * Removes every completion that's ready from the completion queue, and
+     * calls fn(user_data, result) for each
+     */
+    template <typename Fn>
+    void reap(Fn fn)
+    {
+        u32       head = *cq_head;
+        const u32 tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            const io_uring_cqe& cqe       = cqes[head & cq_mask];
+            const u64           user_data = cqe.user_data;
+            const i32           result    = cqe.res;
+
+            // Handed back before fn, which may submit more
+            head++;
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+            fn(user_data, result);
+        }
+    }
+
+private:
+    void* map_ring(u64 size, u64 offset)
+    {
+        return mmap(
+            0,
+            size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            off_t(offset));
+    }
+
+    int enter(u32 to_submit, u32 min_complete, u32 flags)
+    {
+        return int(syscall(
+            __NR_io_uring_enter,
+            fd,
+            to_submit,
+            min_complete,
+            flags,
+            nullptr,
+            0));
+    }
+
+    /** IORING_OP_READ came in 5.6, along with probing for it */
+    bool supports_read()
+    {
+        static constexpr u32 Probe_Ops = 64;
+
+        alignas(io_uring_probe) u8 storage
+            [sizeof(io_uring_probe) + Probe_Ops * sizeof(io_uring_probe_op)] =
+                {};
+        io_uring_probe* probe = (io_uring_probe*)storage;
+
+        int result = int(syscall(
+            __NR_io_uring_register,
+            fd,
+            IORING_REGISTER_PROBE,
+            probe,
+            Probe_Ops));
+        if (result < 0) return false;
+
+        return (probe->last_op >= IORING_OP_READ) &&
+               (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    }
+};
+
+#endif
+
+void AsyncFileReader::init(
+    Allocator&        allocator,
+    EAsyncReadBackend preferred,
+    u32               queue_depth,
+    u32               num_workers)
+{
+    this->allocator = &allocator;
+    in_flight.alloc  = &allocator;
+    free_slots.alloc = &allocator;
+
+#if OS_LINUX
+    if (preferred == AsyncReadBackend::IoUring) {
+        ring = new IoUring();
+        if (!ring->init(std::max(queue_depth, 1u) + 1)) {
+            ring->deinit();
+            delete ring;
+            ring = nullptr;
+        }
+    }
+#endif
+
+    active_backend =
+        ring ? AsyncReadBackend::IoUring : AsyncReadBackend::ThreadPool;
+
+    workers.init(num_workers);
+
+#if OS_LINUX
+    if (ring) {
+        // Fewer slots than submission queue entries, so that it never
+        // overflows and there's always one left to wake up the completion
+        // thread with
+        const u32 slot_count = std::max(queue_depth, 1u);
+        for (u32 i = 0; i < slot_count; ++i) {
+            in_flight.add(InFlight{});
+            free_slots.add(slot_count - 1 - i);
+        }
+
+        completion_thread = new std::thread([this]() { completion_main(); });
+    }
+#endif
+}
+
+void AsyncFileReader::deinit()
+{
+    wait();
+
+#if OS_LINUX
+    if (ring) {
+        // A no-op with user_data 0 stops the completion thread
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ring->push(0).opcode = IORING_OP_NOP;
+            ring->submit();
+        }
+
+        completion_thread->join();
+        delete completion_thread;
+        completion_thread = nullptr;
+
+        ring->deinit();
+        delete ring;
+        ring = nullptr;
+    }
+#endif
+
+    workers.deinit();
+    in_flight.release();
+    free_slots.release();
+}
+
+void AsyncFileReader::submit(Slice<AsyncRead> reads)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += reads.count;
+    }
+
+    for (AsyncRead& read : reads) {
+        read.reader = this;
+        read.ok     = false;
+    }
+
+    if (ring) {
+        submit_ring(reads);
+        return;
+    }
+
+    for (AsyncRead& read : reads) {
+        workers.queue(run_blocking_read, &read);
+    }
+}
+
+void AsyncFileReader::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return pending == 0; });
+}
+
+void AsyncFileReader::complete(AsyncRead* read)
+{
+    workers.queue(run_completion, read);
+}
+
+void AsyncFileReader::run_completion(void* user)
+{
+    AsyncRead*       read   = (AsyncRead*)user;
+    AsyncFileReader* reader = read->reader;
+
+    if (read->on_complete) read->on_complete(*read);
+
+    // The read may be gone from here on
+    std::lock_guard<std::mutex> lock(reader->mutex);
+    reader->pending--;
+    if (reader->pending == 0) reader->idle.notify_all();
+}
+
+void AsyncFileReader::run_blocking_read(void* user)
+{
+    AsyncRead* read = (AsyncRead*)user;
+    read->ok        = read_blocking(*read->reader->allocator, *read);
+    run_completion(read);
+}
+
+#if OS_LINUX
+
+void AsyncFileReader::submit_ring(Slice<AsyncRead> reads)
+{
+    for (AsyncRead& read : reads) {
+        // Opening is still blocking, but only touches the metadata
+        const int fd = open_for_read(read.path);
+
+        u64 size;
+        if ((fd < 0) || !range_size(fd, read, size)) {
+            if (fd >= 0) ::close(fd);
+            complete(&read);
+            continue;
+        }
+
+        if (size == 0) {
+            ::close(fd);
+            read.buffer = slice(read.buffer.ptr, 0);
+            read.ok     = true;
+            complete(&read);
+            continue;
+        }
+
+        const bool allocated = read.buffer.count == 0;
+        if (allocated) read.buffer = alloc_slice<u8>(*allocator, size);
+        ASSERT(read.buffer.count >= size);
+        read.buffer = slice(read.buffer.ptr, size);
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Queue depth reads are in flight. Submit the ones queued so far, so
+        // that some of them can complete
+        if (free_slots.size == 0) {
+            ring->submit();
+            slot_freed.wait(lock, [this]() { return free_slots.size > 0; });
+        }
+
+        const u32 slot = *free_slots.last();
+        free_slots.pop();
+        in_flight[slot] = InFlight{&read, fd, allocated, 0};
+        push_read(slot);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ring->submit();
+}
+
+void AsyncFileReader::push_read(u32 slot)
+{
+    const InFlight& flight = in_flight[slot];
+    AsyncRead*      read   = flight.read;
+
+    // The length of an entry is 32 bits
+    const u64 size = std::min(
+        std::min(read->buffer.count - flight.done, max_read_size),
+        u64(NumProps<u32>::max));
+
+    io_uring_sqe& sqe = ring->push(u64(slot) + 1);
+    sqe.opcode        = IORING_OP_READ;
+    sqe.fd            = flight.fd;
+    sqe.addr          = u64(read->buffer.ptr + flight.done);
+    sqe.len           = u32(size);
+    sqe.off           = read->offset + flight.done;
+}
+
+void AsyncFileReader::completion_main()
+{
+    {
+        BOOTSTRAP_THREAD(SimpleThreadContext);
+    }
+
+    bool quit = false;
+    while (!quit) {
+        ring->wait_for_completion();
+
+        ring->reap([&](u64 user_data, i32 result) {
+            if (user_data == 0) {
+                quit = true;
+                return;
+            }
+
+            const u32  slot   = u32(user_data - 1);
+            InFlight&  flight = in_flight[slot];
+            AsyncRead* read   = flight.read;
+
+            // Split reads, and reads that came up short, go on with the rest.
+            // Regular files otherwise only come up short past their end, i.e.
+            // when they were truncated since they were opened, and then the
+            // next read returns 0
+            if (result > 0) flight.done += u64(result);
+            const bool retry = (result == -EINTR) || (result == -EAGAIN);
+            if (retry ||
+                ((result > 0) && (flight.done < read->buffer.count)))
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                push_read(slot);
+                ring->submit();
+                return;
+            }
+
+            ::close(flight.fd);
+
+            read->ok = (result >= 0) && (flight.done == read->buffer.count);
+            if (!read->ok && flight.allocated) {
+                allocator->release(read->buffer.ptr);
+                read->buffer = Slice<u8>();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                free_slots.add(slot);
+            }
+            slot_freed.notify_one();
+
+            complete(read);
+        });
+    }
+}
+
+#else
+
+void AsyncFileReader::submit_ring(Slice<AsyncRead> reads) {}
+void AsyncFileReader::push_read(u32 slot) {}
+void AsyncFileReader::completion_main() {}
+
+#endif
@@ -0,0 +1,146 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Base.h"
+#include "Containers/Array.h"
+#include "TaskQueue.h"
+
+namespace AsyncReadBackend {
+    enum Type : u32
+    {
+        /**
+         * Reads are submitted to the kernel in batches, through an io_uring,
+         * and completed from a single thread. Linux only
+         */
+        IoUring = 0,
+        /** Every read is a blocking pread, on one of the workers */
+        ThreadPool,
+    };
+}
+typedef AsyncReadBackend::Type EAsyncReadBackend;
+
+PROC_FMT_ENUM(AsyncReadBackend, {
+    FMT_ENUM_CASE(AsyncReadBackend, IoUring);
+    FMT_ENUM_CASE(AsyncReadBackend, ThreadPool);
+    FMT_ENUM_DEFAULT_CASE(ThreadPool);
+})
+
+struct AsyncFileReader;
+
+/**
+ * A read of a whole file, or of a range of it (e.g. an entry of a pak), done
+ * by an AsyncFileReader. It has to stay alive until it completes.
+ */
+struct AsyncRead {
+    Str       path;
+    u64       offset = 0;
+    /** Bytes to read, or 0 to read from offset to the end of the file */
+    u64       size   = 0;
+    /**
+     * Where to read to, with room for size bytes. If empty, it's allocated
+     * from the allocator of the reader and left for the caller to release.
+     * Set to the bytes that were read once the read completes
+     */
+    Slice<u8> buffer;
+
+    /**
+     * Called on a worker once the read completes, whether it succeeded or
+     * not, e.g. to unpack the buffer. May be null
+     */
+    void (*on_complete)(AsyncRead& read) = nullptr;
+    void* user                           = nullptr;
+
+    /** Whether the whole range was read. Set once the read completes */
+    bool ok = false;
+
+    /** Set by AsyncFileReader::submit */
+    AsyncFileReader* reader = nullptr;
+};
+
+/**
+ * Reads files in the background, many at a time. Reads are submitted in
+ * batches and report back through their on_complete, which runs on one of
+ * the reader's workers so that decompressing one read overlaps the others.
+ *
+ * The io_uring backend keeps up to queue_depth reads in flight with a single
+ * system call per batch, and falls back to the thread pool backend if
+ * io_uring isn't available (other platforms, older kernels, or sandboxes
+ * that forbid it). The thread pool backend reads on the workers instead, one
+ * blocking read at a time each.
+ *
+ * The allocator has to be thread safe (e.g. System_Allocator): buffers are
+ * allocated on whichever thread starts the read, and released on whichever
+ * completes it if it fails.
+ */
+struct AsyncFileReader {
+    /**
+     * Largest read handed to the kernel at once, larger ones are split. Linux
+     * reads at most 0x7ffff000 bytes per call anyway. Set before submitting
+     */
+    u64 max_read_size = MEGABYTES(1024);
+
+    void init(
+        Allocator&        allocator,
+        EAsyncReadBackend preferred   = AsyncReadBackend::IoUring,
+        u32               queue_depth = 64,
+        u32               num_workers = 2);
+
+    /** Waits for the submitted reads to complete, then stops the workers */
+    void deinit();
+
+    /** The backend in use, which may not be the preferred one */
+    EAsyncReadBackend backend() const { return active_backend; }
+
+    /**
+     * Starts the reads. With io_uring, blocks while queue_depth reads are
+     * already in flight, until enough of them complete
+     */
+    void submit(Slice<AsyncRead> reads);
+
+    /**
+     * Blocks until every read submitted so far has completed, and its
+     * on_complete has run
+     */
+    void wait();
+
+private:
+    /** A read submitted to the io_uring, by its user_data */
+    struct InFlight {
+        AsyncRead* read;
+        int        fd;
+        /** Whether the reader allocated the buffer */
+        bool       allocated;
+        /** Bytes read so far, of reads that take more than one */
+        u64        done;
+    };
+
+    Allocator*        allocator;
+    EAsyncReadBackend active_backend;
+    TaskQueue         workers;
+
+    std::mutex              mutex;
+    /** Signaled when the last pending read completes */
+    std::condition_variable idle;
+    /** Reads whose on_complete hasn't run yet */
+    u64                     pending = 0;
+
+    // io_uring
+    struct IoUring*         ring = nullptr;
+    TArray<InFlight>        in_flight;
+    /** Indices of the unused in_flight slots */
+    TArray<u32>             free_slots;
+    std::condition_variable slot_freed;
+    std::thread*            completion_thread = nullptr;
+
+    void submit_ring(Slice<AsyncRead> reads);
+    /** Queues what's left of the read in slot. Called with the lock held */
+    void push_read(u32 slot);
+    void completion_main();
+
+    /** Queues on_complete of read to run on a worker */
+    void complete(AsyncRead* read);
+    static void run_completion(void* user);
+    static void run_blocking_read(void* user);
+};
@@ -0,0 +1,109 @@
+#define MOK_WIN32_NO_FUNCTIONS
+#include "FileMapping.h"
+
+#include "Containers/Extras.h"
+#include "Memory/Extras.h"
+
+#if OS_MSWINDOWS
+#include <windows.h>
+#elif OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if OS_MSWINDOWS
+
+bool FileMapping::open(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    HANDLE file = CreateFileA(
+        path_cstr.data,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        0,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        0);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (size.QuadPart == 0)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (mapping == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (ptr == 0) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle    = file;
+    mapping_handle = mapping;
+    data           = Slice<u8>((u8*)ptr, (u64)size.QuadPart);
+    return true;
+}
+
+void FileMapping::close()
+{
+    if (!is_open()) return;
+
+    UnmapViewOfFile(data.ptr);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+
+    data           = Slice<u8>();
+    file_handle    = nullptr;
+    mapping_handle = nullptr;
+}
+
+#elif OS_LINUX
+
+bool FileMapping::open(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    int fd = ::open(path_cstr.data, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    ::close(fd);
+
+    if (ptr == MAP_FAILED) return false;
+
+    // Assets are mostly read front to back, once
+    madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+    data = Slice<u8>((u8*)ptr, (u64)st.st_size);
+    return true;
+}
+
+void FileMapping::close()
+{
+    if (!is_open()) return;
+
+    munmap(data.ptr, data.count);
+    data = Slice<u8>();
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+#include "Containers/Slice.h"
+#include "Host.h"
+#include "Str.h"
+#include "Types.h"
+
+/**
+ * A read-only mapping of a whole file. Pages are read in by the OS as they
+ * are touched, so opening a mapping doesn't read the file, and reading from it
+ * doesn't go through an intermediate buffer.
+ *
+ * The data stays valid until close, even if the file is modified or removed
+ * (though modifications may be visible through it).
+ */
+struct FileMapping {
+    Slice<u8> data;
+
+    /** @return false if the file couldn't be opened, or is empty */
+    bool open(Str path);
+    void close();
+
+    bool is_open() const { return data.ptr != nullptr; }
+
+#if OS_MSWINDOWS
+private:
+    void* file_handle    = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,86 @@
+#define MOK_WIN32_NO_FUNCTIONS
+#include "FileStat.h"
+
+#include "Memory/Extras.h"
+
+#if OS_MSWINDOWS
+#include <windows.h>
+#elif OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#if OS_MSWINDOWS
+
+bool stat_file(Str path, FileStat& result)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path_cstr.data, GetFileExInfoStandard, &data)) {
+        return false;
+    }
+
+    // FILETIME is already in 100ns units
+    const FILETIME& time = data.ftLastWriteTime;
+
+    result.size         = (u64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    result.modified     = (u64(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    result.is_directory =
+        (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    return true;
+}
+
+bool touch_file(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    HANDLE file = CreateFileA(
+        path_cstr.data,
+        FILE_WRITE_ATTRIBUTES,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        0,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        0);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+
+    BOOL result = SetFileTime(file, 0, 0, &now);
+    CloseHandle(file);
+    return result != 0;
+}
+
+#elif OS_LINUX
+
+bool stat_file(Str path, FileStat& result)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    struct stat st;
+    if (stat(path_cstr.data, &st) != 0) return false;
+
+    const u64 seconds = u64(st.st_mtim.tv_sec);
+    const u64 ticks   = u64(st.st_mtim.tv_nsec) / 100;
+
+    result.size         = u64(st.st_size);
+    result.modified     = seconds * 10000000 + ticks;
+    result.is_directory = S_ISDIR(st.st_mode);
+    return true;
+}
+
+bool touch_file(Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    // Null times set both access and modification time to now
+    return utimensat(AT_FDCWD, path_cstr.data, 0, 0) == 0;
+}
+
+#endif
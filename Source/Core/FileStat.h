@@ -0,0 +1,24 @@
+#pragma once
+#include "Host.h"
+#include "Str.h"
+#include "Types.h"
+
+/** What the file system knows about a file or directory, without opening it */
+struct FileStat {
+    u64  size;
+    /**
+     * Last modification, in 100ns units since an OS defined epoch. Only
+     * meant to be compared with other times from stat_file
+     */
+    u64  modified;
+    bool is_directory;
+};
+
+/** @return false if there's nothing at path */
+bool stat_file(Str path, FileStat& result);
+
+/**
+ * Sets the modification time of the file at path to now
+ * @return false if there's nothing at path, or its time can't be set
+ */
+bool touch_file(Str path);
@@ -0,0 +1,262 @@
+#define MOK_WIN32_NO_FUNCTIONS
+#include "FileWatcher.h"
+
+#include <string.h>
+
+#include "FileSystem/DirectoryIterator.h"
+#include "Memory/Extras.h"
+
+#if OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static constexpr u32 Watch_Mask = IN_CLOSE_WRITE | IN_MOVED_TO |
+                                  IN_MOVED_FROM | IN_DELETE | IN_CREATE |
+                                  IN_ONLYDIR;
+#endif
+
+/** Appends the paths of the files under directory, recursively */
+static void list_files(Allocator& allocator, Str directory, TArray<Str>& files)
+{
+    DirectoryIterator it = open_dir(directory);
+    DEFER(it.close());
+
+    FileData it_data;
+    while (it.next_file(&it_data)) {
+        if (it_data.filename == LIT(".")) continue;
+        if (it_data.filename == LIT("..")) continue;
+
+        Str path =
+            format(allocator, LIT("{}/{}"), directory, it_data.filename);
+
+        if (it_data.attributes == FileAttributes::File) {
+            files.add(path);
+        } else {
+            list_files(allocator, path, files);
+        }
+    }
+}
+
+/** Removes the paths from first on that are already in changes */
+static void remove_duplicates(TArray<Str>& changes, u64 first)
+{
+    TMap<Str, bool> seen;
+    seen.init(System_Allocator);
+    DEFER(seen.release());
+
+    u64 count = first;
+    for (u64 i = first; i < changes.size; ++i) {
+        if (seen.contains(changes[i])) continue;
+
+        seen.add(changes[i], true);
+        changes[count++] = changes[i];
+    }
+    changes.size = count;
+}
+
+void FileWatcher::init(Allocator& allocator)
+{
+    this->allocator = &allocator;
+    directories     = TArray<Str>(&allocator);
+
+    for (u32 i = 0; i < 2; ++i) {
+        snapshot_arenas[i] =
+            Arena<ArenaMode::Dynamic>(allocator, KILOBYTES(64));
+        snapshot_arenas[i].init();
+        snapshots[i].init(snapshot_arenas[i]);
+    }
+    last_walk = std::chrono::steady_clock::now();
+
+#if OS_LINUX
+    watches.init(allocator);
+    if (!polling) {
+        // Out of inotify instances, most likely
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0) polling = true;
+    }
+#else
+    polling = true;
+#endif
+}
+
+void FileWatcher::deinit()
+{
+#if OS_LINUX
+    if (inotify_fd >= 0) close(inotify_fd);
+    inotify_fd = -1;
+
+    for (auto pair : watches) allocator->release((umm)pair.val.data);
+    watches.release();
+#endif
+
+    for (Str directory : directories) allocator->release((umm)directory.data);
+    directories.release();
+
+    for (u32 i = 0; i < 2; ++i) snapshot_arenas[i].deinit();
+}
+
+bool FileWatcher::add_directory(Str directory)
+{
+    FileStat stat;
+    if (!stat_file(directory, stat) || !stat.is_directory) return false;
+
+    directories.add(directory.clone(*allocator));
+
+#if OS_LINUX
+    if (!polling) {
+        add_watches(directory);
+        return true;
+    }
+#endif
+
+    // The files already there aren't changes
+    walk(nullptr, nullptr);
+    return true;
+}
+
+void FileWatcher::poll(Allocator& allocator, TArray<Str>& changes)
+{
+    const u64 first = changes.size;
+
+#if OS_LINUX
+    if (!polling) {
+        alignas(struct inotify_event) char buffer[4096];
+        bool overflowed = false;
+
+        while (true) {
+            // Fails with EAGAIN once there's nothing left to read
+            ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if (length <= 0) break;
+
+            const char* end = buffer + length;
+            for (const char* at = buffer; at < end;) {
+                auto event = (const inotify_event*)at;
+                at         += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflowed = true;
+                    continue;
+                }
+
+                // Events of the watched directory itself, e.g. IN_IGNORED
+                if (event->len == 0) continue;
+                if (!watches.contains(u64(event->wd))) continue;
+
+                Str name = Str(event->name, strlen(event->name));
+                Str path = format(
+                    allocator,
+                    LIT("{}/{}"),
+                    watches[u64(event->wd)],
+                    name);
+
+                // New directories are watched too, and whatever was put in
+                // them before the watch was added counts as changed
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        add_watches(path);
+                        list_files(allocator, path, changes);
+                    }
+                    continue;
+                }
+
+                // Seen once the file is closed, rather than while it's empty
+                if (event->mask & IN_CREATE) continue;
+
+                changes.add(path);
+            }
+        }
+
+        // Events were dropped, so any file may have changed, and directories
+        // created in the meantime aren't watched yet
+        if (overflowed) {
+            print(LIT("[File Watcher]: Event queue overflow, rescanning\n"));
+            for (Str directory : directories) add_watches(directory);
+            walk(&allocator, &changes, true);
+        }
+
+        remove_duplicates(changes, first);
+        return;
+    }
+#endif
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_walk < std::chrono::milliseconds(poll_interval_ms)) return;
+
+    walk(&allocator, &changes);
+}
+
+#if OS_LINUX
+void FileWatcher::add_watches(Str directory)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+    Str path_cstr = format(temp, LIT("{}\0"), directory);
+
+    int wd = inotify_add_watch(inotify_fd, path_cstr.data, Watch_Mask);
+    if (wd < 0) return;
+
+    // The same directory added twice gets the same descriptor
+    if (!watches.contains(u64(wd))) {
+        watches.add(u64(wd), directory.clone(*allocator));
+    }
+
+    DirectoryIterator it = open_dir(directory);
+    DEFER(it.close());
+
+    FileData it_data;
+    while (it.next_file(&it_data)) {
+        if (it_data.filename == LIT(".")) continue;
+        if (it_data.filename == LIT("..")) continue;
+        if (it_data.attributes == FileAttributes::File) continue;
+
+        SAVE_ARENA(temp);
+        add_watches(format(temp, LIT("{}/{}"), directory, it_data.filename));
+    }
+}
+#endif
+
+void FileWatcher::walk(
+    Allocator* changes_allocator, TArray<Str>* changes, bool report_all)
+{
+    last_walk = std::chrono::steady_clock::now();
+
+    TMap<Str, FileStat>& previous = snapshots[snapshot_index];
+
+    // Takes the place of the snapshot before the previous one
+    const u32                  next_index = snapshot_index ^ 1;
+    Arena<ArenaMode::Dynamic>& arena      = snapshot_arenas[next_index];
+    TMap<Str, FileStat>&       files      = snapshots[next_index];
+    arena.deinit();
+    arena.init();
+    files.init(arena);
+
+    TArray<Str> paths(&arena);
+    for (Str directory : directories) list_files(arena, directory, paths);
+
+    for (Str path : paths) {
+        FileStat stat;
+        if (!stat_file(path, stat)) continue;
+        files.add(path, stat);
+    }
+
+    snapshot_index = next_index;
+    if (changes == nullptr) return;
+
+    for (auto pair : files) {
+        if (!report_all && previous.contains(pair.key)) {
+            const FileStat& before = previous[pair.key];
+            if ((before.size == pair.val.size) &&
+                (before.modified == pair.val.modified))
+            {
+                continue;
+            }
+        }
+
+        changes->add(pair.key.clone(*changes_allocator));
+    }
+
+    for (auto pair : previous) {
+        if (files.contains(pair.key)) continue;
+        changes->add(pair.key.clone(*changes_allocator));
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+
+#include "Containers/Array.h"
+#include "Containers/Map.h"
+#include "FileStat.h"
+#include "Host.h"
+#include "Memory/Arena.h"
+
+/**
+ * Reports the files that change under a set of directories, subdirectories
+ * included.
+ *
+ * On Linux, changes come from inotify, so polling is cheap and they're seen
+ * once the file is closed after writing. Elsewhere, if inotify isn't
+ * available, or if polling is set before init, the directories are walked
+ * every poll_interval_ms instead and the files compared by size and time to
+ * the previous walk.
+ *
+ * A file that changes several times between two polls is reported once. If
+ * inotify drops events because its queue overflowed, every file under the
+ * directories is reported instead.
+ */
+struct FileWatcher {
+    /** Walk the directories instead of using OS notifications */
+    bool polling          = false;
+    /** Least time between two walks, when polling */
+    u32  poll_interval_ms = 500;
+
+    void init(Allocator& allocator);
+    void deinit();
+
+    /**
+     * Starts watching directory and everything under it
+     * @return false if it isn't a directory
+     */
+    bool add_directory(Str directory);
+
+    /**
+     * Appends the paths of the files that were written, created or removed
+     * since the last poll to changes. Paths are the watched directory joined
+     * with the path under it, allocated from allocator. Never blocks
+     */
+    void poll(Allocator& allocator, TArray<Str>& changes);
+
+private:
+    Allocator*  allocator;
+    TArray<Str> directories;
+
+#if OS_LINUX
+    int            inotify_fd = -1;
+    /** Watched directory of every inotify watch descriptor */
+    TMap<u64, Str> watches;
+
+    /** Adds a watch for directory and its subdirectories */
+    void add_watches(Str directory);
+#endif
+
+    /**
+     * Files of the last two walks, each in its own arena, which is cleared
+     * when the snapshot is reused. snapshot_index is the last one
+     */
+    TMap<Str, FileStat>                   snapshots[2];
+    Arena<ArenaMode::Dynamic>             snapshot_arenas[2];
+    u32                                   snapshot_index = 0;
+    std::chrono::steady_clock::time_point last_walk;
+
+    /**
+     * Lists the files under the watched directories into a new snapshot, and
+     * reports the ones that differ from the previous one, if changes is set
+     * @param report_all Report every file listed, along with the ones that
+     * were removed
+     */
+    void walk(
+        Allocator*   changes_allocator,
+        TArray<Str>* changes,
+        bool         report_all = false);
+};
@@ -0,0 +1,315 @@
+#include "ImageProcessing.h"
+
+#include <string.h>
+
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IMAGE_SSE2 1
+#include <emmintrin.h>
+#else
+#define IMAGE_SSE2 0
+#endif
+
+u32 mip_count_of(u32 width, u32 height)
+{
+    u32 extent = (width > height) ? width : height;
+    u32 result = 1;
+    while (extent > 1) {
+        extent >>= 1;
+        result++;
+    }
+    return result;
+}
+
+#if IMAGE_SSE2
+/** Averages 8 pixels of each row into 4 pixels */
+static void downsample_4_pixels(const u8* row0, const u8* row1, u8* dst)
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(2);
+
+    __m128i halves[2];
+    for (int i = 0; i < 2; ++i) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(row0 + i * 16));
+        __m128i b = _mm_loadu_si128((const __m128i*)(row1 + i * 16));
+
+        // Pixels 0, 1 (lo) and 2, 3 (hi) of both rows added, in 16 bits
+        __m128i lo = _mm_add_epi16(
+            _mm_unpacklo_epi8(a, zero),
+            _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(
+            _mm_unpackhi_epi8(a, zero),
+            _mm_unpackhi_epi8(b, zero));
+
+        // Then each pair of pixels, into the low half
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+        __m128i sum = _mm_unpacklo_epi64(lo, hi);
+        halves[i]   = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+    }
+
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(halves[0], halves[1]));
+}
+#endif
+
+void downsample_rgba8(const u8* src, u32 width, u32 height, u8* dst)
+{
+    const u32 dst_width  = mip_extent(width, 1);
+    const u32 dst_height = mip_extent(height, 1);
+    const u64 row_size   = u64(width) * 4;
+
+    // A dimension of 1 reads its only row or column twice
+    const u64 next_row    = (height > 1) ? row_size : 0;
+    const u64 next_column = (width > 1) ? 4 : 0;
+
+    for (u32 y = 0; y < dst_height; ++y) {
+        const u8* row0 = src + u64(y) * 2 * row_size;
+        const u8* row1 = row0 + next_row;
+        u8*       out  = dst + u64(y) * dst_width * 4;
+
+        u32 x = 0;
+#if IMAGE_SSE2
+        for (; x + 4 <= dst_width; x += 4) {
+            downsample_4_pixels(row0 + x * 8, row1 + x * 8, out + x * 4);
+        }
+#endif
+        for (; x < dst_width; ++x) {
+            const u8* a = row0 + x * 8;
+            const u8* b = row1 + x * 8;
+            for (u32 c = 0; c < 4; ++c) {
+                u32 sum = a[c] + a[c + next_column] + b[c] + b[c + next_column];
+                out[x * 4 + c] = u8((sum + 2) >> 2);
+            }
+        }
+    }
+}
+
+bool is_opaque_rgba8(const u8* pixels, u64 pixel_count)
+{
+    for (u64 i = 0; i < pixel_count; ++i) {
+        if (pixels[i * 4 + 3] != 255) return false;
+    }
+    return true;
+}
+
+/** Gathers the texels of a block, clamping the ones outside of the image */
+static void load_block(
+    const u8* src, u32 width, u32 height, u32 bx, u32 by, u8 block[16][4])
+{
+    for (u32 ty = 0; ty < 4; ++ty) {
+        u32 y = by * 4 + ty;
+        if (y >= height) y = height - 1;
+
+        for (u32 tx = 0; tx < 4; ++tx) {
+            u32 x = bx * 4 + tx;
+            if (x >= width) x = width - 1;
+
+            memcpy(block[ty * 4 + tx], src + (u64(y) * width + x) * 4, 4);
+        }
+    }
+}
+
+static u16 pack_565(const u8 color[4])
+{
+    u32 r = (color[0] * 31 + 127) / 255;
+    u32 g = (color[1] * 63 + 127) / 255;
+    u32 b = (color[2] * 31 + 127) / 255;
+    return u16((r << 11) | (g << 5) | b);
+}
+
+/** Expands to 8 bits per channel, the way decoders do */
+static void unpack_565(u16 color, i32 result[3])
+{
+    u32 r = (color >> 11) & 31;
+    u32 g = (color >> 5) & 63;
+    u32 b = color & 31;
+    result[0] = i32((r << 3) | (r >> 2));
+    result[1] = i32((g << 2) | (g >> 4));
+    result[2] = i32((b << 3) | (b >> 2));
+}
+
+static void encode_color_block(const u8 block[16][4], u8* dst)
+{
+    f32 mean[3] = {};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < 3; ++c) mean[c] += block[i][c];
+    }
+    for (u32 c = 0; c < 3; ++c) mean[c] /= 16.0f;
+
+    // Covariance of the colors: rr, rg, rb, gg, gb, bb
+    f32 cov[6] = {};
+    for (u32 i = 0; i < 16; ++i) {
+        f32 r = block[i][0] - mean[0];
+        f32 g = block[i][1] - mean[1];
+        f32 b = block[i][2] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    // Principal axis by power iteration. Solid blocks keep the first guess,
+    // which doesn't matter since all of their texels are the same
+    f32 axis[3] = {1.0f, 1.0f, 1.0f};
+    for (u32 iteration = 0; iteration < 4; ++iteration) {
+        f32 next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+
+        f32 largest = 0.0f;
+        for (f32 v : next) {
+            if (v > largest) largest = v;
+            if (-v > largest) largest = -v;
+        }
+        if (largest == 0.0f) break;
+
+        for (u32 c = 0; c < 3; ++c) axis[c] = next[c] / largest;
+    }
+
+    // The texels furthest apart along the axis are the endpoints
+    u32 min_texel = 0, max_texel = 0;
+    f32 min_dot = 0.0f, max_dot = 0.0f;
+    for (u32 i = 0; i < 16; ++i) {
+        f32 dot = block[i][0] * axis[0] + block[i][1] * axis[1] +
+                  block[i][2] * axis[2];
+        if ((i == 0) || (dot < min_dot)) {
+            min_dot   = dot;
+            min_texel = i;
+        }
+        if ((i == 0) || (dot > max_dot)) {
+            max_dot   = dot;
+            max_texel = i;
+        }
+    }
+
+    // color0 > color1 selects the four color mode
+    u16 color0 = pack_565(block[max_texel]);
+    u16 color1 = pack_565(block[min_texel]);
+    if (color0 < color1) {
+        u16 temp = color0;
+        color0   = color1;
+        color1   = temp;
+    }
+
+    u32 indices = 0;
+    if (color0 != color1) {
+        i32 palette[4][3];
+        unpack_565(color0, palette[0]);
+        unpack_565(color1, palette[1]);
+        for (u32 c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (u32 i = 0; i < 16; ++i) {
+            u32 best          = 0;
+            i32 best_distance = 0;
+            for (u32 p = 0; p < 4; ++p) {
+                i32 distance = 0;
+                for (u32 c = 0; c < 3; ++c) {
+                    i32 d = i32(block[i][c]) - palette[p][c];
+                    distance += d * d;
+                }
+
+                if ((p == 0) || (distance < best_distance)) {
+                    best          = p;
+                    best_distance = distance;
+                }
+            }
+
+            indices |= best << (i * 2);
+        }
+    }
+
+    memcpy(dst + 0, &color0, sizeof(u16));
+    memcpy(dst + 2, &color1, sizeof(u16));
+    memcpy(dst + 4, &indices, sizeof(u32));
+}
+
+static void encode_alpha_block(const u8 block[16][4], u8* dst)
+{
+    u8 alpha0 = 0;
+    u8 alpha1 = 255;
+    for (u32 i = 0; i < 16; ++i) {
+        if (block[i][3] > alpha0) alpha0 = block[i][3];
+        if (block[i][3] < alpha1) alpha1 = block[i][3];
+    }
+
+    // alpha0 > alpha1 selects the mode with 6 values in between
+    u64 indices = 0;
+    if (alpha0 > alpha1) {
+        i32 palette[8] = {alpha0, alpha1};
+        for (i32 k = 1; k < 7; ++k) {
+            palette[k + 1] = ((7 - k) * alpha0 + k * alpha1) / 7;
+        }
+
+        for (u32 i = 0; i < 16; ++i) {
+            u64 best          = 0;
+            i32 best_distance = 256;
+            for (u32 p = 0; p < 8; ++p) {
+                i32 distance = i32(block[i][3]) - palette[p];
+                if (distance < 0) distance = -distance;
+
+                if (distance < best_distance) {
+                    best          = p;
+                    best_distance = distance;
+                }
+            }
+
+            indices |= best << (i * 3);
+        }
+    }
+
+    dst[0] = alpha0;
+    dst[1] = alpha1;
+    for (u32 i = 0; i < 6; ++i) dst[2 + i] = u8(indices >> (i * 8));
+}
+
+static void encode_blocks(
+    JobSystem& jobs,
+    const u8*  src,
+    u32        width,
+    u32        height,
+    u8*        dst,
+    bool       alpha)
+{
+    const u32 blocks_x   = (width + 3) / 4;
+    const u32 blocks_y   = (height + 3) / 4;
+    const u32 block_size = alpha ? BC3_Block_Size : BC1_Block_Size;
+
+    jobs.parallel_for(blocks_y, [&](u32 by) {
+        u8  block[16][4];
+        u8* out = dst + u64(by) * blocks_x * block_size;
+
+        for (u32 bx = 0; bx < blocks_x; ++bx) {
+            load_block(src, width, height, bx, by, block);
+
+            if (alpha) {
+                encode_alpha_block(block, out);
+                out += BC3_Block_Size - BC1_Block_Size;
+            }
+
+            encode_color_block(block, out);
+            out += BC1_Block_Size;
+        }
+    });
+}
+
+void encode_bc1(
+    JobSystem& jobs, const u8* src, u32 width, u32 height, u8* dst)
+{
+    encode_blocks(jobs, src, width, height, dst, false);
+}
+
+void encode_bc3(
+    JobSystem& jobs, const u8* src, u32 width, u32 height, u8* dst)
+{
+    encode_blocks(jobs, src, width, height, dst, true);
+}
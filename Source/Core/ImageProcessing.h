@@ -0,0 +1,64 @@
+#pragma once
+#include "Base.h"
+
+struct JobSystem;
+
+/**
+ * Processing of RGBA8 images, meant to run at import time. Pixels are packed
+ * row by row, without padding, 4 bytes each.
+ *
+ * Block compressed images are made of 4x4 texel blocks, also packed row by
+ * row. Images whose size isn't a multiple of 4 get partial blocks at their
+ * right and bottom edges, padded with the pixels at the edge.
+ */
+
+/** Size of a BC1 block: two RGB565 endpoints and 2 bit indices */
+static constexpr u32 BC1_Block_Size = 8;
+
+/** Size of a BC3 block: a BC4 alpha block followed by a BC1 color block */
+static constexpr u32 BC3_Block_Size = 16;
+
+/** Number of mips of a full chain down to 1x1, including mip 0 */
+u32 mip_count_of(u32 width, u32 height);
+
+/** Size of mip of an image of the given size, halved and rounded down */
+_inline u32 mip_extent(u32 extent, u32 mip)
+{
+    u32 result = extent >> mip;
+    return (result > 0) ? result : 1;
+}
+
+/** Number of blocks that cover width x height texels */
+_inline u64 block_count_of(u32 width, u32 height)
+{
+    return u64((width + 3) / 4) * u64((height + 3) / 4);
+}
+
+/**
+ * Halves an RGBA8 image with a 2x2 box filter, into dst which needs room for
+ * mip_extent(width, 1) x mip_extent(height, 1) pixels. Odd rows and columns
+ * at the edge are dropped, dimensions of 1 are kept. Channels are averaged as
+ * they are, so sRGB images are filtered in gamma space
+ */
+void downsample_rgba8(const u8* src, u32 width, u32 height, u8* dst);
+
+/** Whether every pixel of an RGBA8 image has an alpha of 255 */
+bool is_opaque_rgba8(const u8* pixels, u64 pixel_count);
+
+/**
+ * Encodes an RGBA8 image to BC1, without alpha. Endpoints are the extremes of
+ * each block along the principal axis of its colors, and every texel picks
+ * the closest of the four colors in between. Rows of blocks are encoded in
+ * parallel on jobs
+ * @param dst Needs room for block_count_of(width, height) blocks
+ */
+void encode_bc1(
+    JobSystem& jobs, const u8* src, u32 width, u32 height, u8* dst);
+
+/**
+ * Encodes an RGBA8 image to BC3: the colors as in encode_bc1, and the alpha
+ * between the smallest and largest alpha of each block
+ * @param dst Needs room for block_count_of(width, height) blocks
+ */
+void encode_bc3(
+    JobSystem& jobs, const u8* src, u32 width, u32 height, u8* dst);
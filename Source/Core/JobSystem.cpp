@@ -0,0 +1,118 @@
+#include "JobSystem.h"
+
+#include "Thread/ThreadContext.h"
+
+/** The job system whose job the current thread is working on, if any */
+static thread_local JobSystem* Current_Job_System = nullptr;
+
+void JobSystem::init(u32 num_workers)
+{
+    workers.alloc = &System_Allocator;
+
+    for (u32 i = 0; i < num_workers; ++i) {
+        workers.add(new std::thread([this]() { worker_main(); }));
+    }
+}
+
+void JobSystem::deinit()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    job_available.notify_all();
+
+    for (std::thread* worker : workers) {
+        worker->join();
+        delete worker;
+    }
+    workers.release();
+}
+
+void JobSystem::run(u32 count, JobFunction fn, void* user)
+{
+    if (count == 0) return;
+
+    if ((workers.size == 0) || (count == 1) || Current_Job_System) {
+        for (u32 i = 0; i < count; ++i) {
+            fn(user, i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit_lock(submit_mutex);
+    Current_Job_System = this;
+    DEFER(Current_Job_System = nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job_fn       = fn;
+        job_user     = user;
+        job_count    = count;
+        busy_workers = u32(workers.size);
+        next_index.store(0);
+        generation++;
+    }
+    job_available.notify_all();
+
+    work();
+
+    // The job's data lives on the caller's stack, so wait for every worker
+    // to leave it, not just for the last index to complete
+    std::unique_lock<std::mutex> lock(mutex);
+    job_done.wait(lock, [this]() { return busy_workers == 0; });
+}
+
+u32 JobSystem::default_worker_count()
+{
+    u32 hardware_threads = std::thread::hardware_concurrency();
+    return (hardware_threads > 1) ? (hardware_threads - 1) : 0;
+}
+
+JobSystem& JobSystem::shared()
+{
+    // Never deinitialized; the workers are left waiting at exit
+    static JobSystem* system = []() {
+        JobSystem* result = new JobSystem();
+        result->init(default_worker_count());
+        return result;
+    }();
+    return *system;
+}
+
+void JobSystem::worker_main()
+{
+    {
+        BOOTSTRAP_THREAD(SimpleThreadContext);
+    }
+    Current_Job_System = this;
+
+    u64 last_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_available.wait(lock, [&]() {
+                return quit || (generation != last_generation);
+            });
+
+            if (quit) return;
+            last_generation = generation;
+        }
+
+        work();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        busy_workers--;
+        if (busy_workers == 0) job_done.notify_one();
+    }
+}
+
+void JobSystem::work()
+{
+    while (true) {
+        u32 index = next_index.fetch_add(1);
+        if (index >= job_count) break;
+
+        job_fn(job_user, index);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "Base.h"
+#include "Containers/Array.h"
+
+/**
+ * A fixed pool of worker threads that run data parallel jobs. A job is a
+ * function called once for every index in [0, count); indices are handed out
+ * to the workers and the calling thread as they become free, so the calling
+ * thread always contributes, and a job system with zero workers runs
+ * everything inline.
+ *
+ * Only one job runs at a time; run may be called from several threads, and
+ * they take turns. A job that starts another job, on any job system, runs it
+ * inline on its own thread, since the other threads are busy anyway.
+ */
+struct JobSystem {
+    using JobFunction = void (*)(void* user, u32 index);
+
+    void init(u32 num_workers);
+    void deinit();
+
+    /** Calls fn(user, index) for every index, and blocks until all return */
+    void run(u32 count, JobFunction fn, void* user);
+
+    /** Same as run, for any callable with the signature void(u32 index) */
+    template <typename F>
+    void parallel_for(u32 count, F&& fn)
+    {
+        using Fn = std::remove_reference_t<F>;
+        run(
+            count,
+            [](void* user, u32 index) { (*(Fn*)user)(index); },
+            (void*)&fn);
+    }
+
+    /** Number of threads that take part in a job, including the caller */
+    u32 num_threads() const { return u32(workers.size) + 1; }
+
+    /** One worker less than the hardware threads, leaving one to the caller */
+    static u32 default_worker_count();
+
+    /**
+     * Process wide job system for general purpose work (e.g. asset
+     * compression), started with default_worker_count workers on first use
+     */
+    static JobSystem& shared();
+
+private:
+    void worker_main();
+    void work();
+
+    TArray<std::thread*> workers;
+
+    /** Held by the thread running a job, for as long as it runs */
+    std::mutex              submit_mutex;
+    std::mutex              mutex;
+    std::condition_variable job_available;
+    std::condition_variable job_done;
+    bool                    quit = false;
+    /** Incremented for every job, so that workers can tell jobs apart */
+    u64                     generation = 0;
+
+    // Current job
+    JobFunction      job_fn;
+    void*            job_user;
+    u32              job_count = 0;
+    std::atomic<u32> next_index;
+    /** Workers still inside the current job */
+    u32              busy_workers = 0;
+};
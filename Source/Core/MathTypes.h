@@ -24,6 +24,14 @@
 
 #include "Debugging/Assertions.h"
 
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define MATH_SSE 1
+#include <xmmintrin.h>
+#else
+#define MATH_SSE 0
+#endif
+
 struct Vec2 : public glm::vec2 {
     Vec2() {}
     Vec2(float x, float y) : glm::vec2(x, y) {}
@@ -145,6 +153,15 @@ struct Mat4 : public glm::mat4 {
 
     _inline Mat4 inverse() const { return glm::inverse(*this); }
 
+    /**
+     * Inverse of a matrix whose last row is (0, 0, 0, 1), like any
+     * combination of translation, rotation and scale. Only the upper 3x3
+     * part needs to be inverted
+     */
+    _inline Mat4 inverse_affine() const;
+
+    _inline Vec3 translation() const { return Vec3(glm::vec3((*this)[3])); }
+
     void decompose(Vec3& position, struct Quat& rotation, Vec3& scale) const;
 
     const float* ptr() const { return glm::value_ptr(glm::mat4(*this)); }
@@ -168,7 +185,30 @@ struct Mat4 : public glm::mat4 {
 
 static _inline Mat4 operator*(const Mat4& left, const Mat4& right)
 {
+#if MATH_SSE
+    // Column j of the result is left * right[j], built out of the columns of
+    // left scaled by the components of right[j]
+    const float* l = &left[0][0];
+    const float* r = &right[0][0];
+
+    __m128 l0 = _mm_loadu_ps(l + 0);
+    __m128 l1 = _mm_loadu_ps(l + 4);
+    __m128 l2 = _mm_loadu_ps(l + 8);
+    __m128 l3 = _mm_loadu_ps(l + 12);
+
+    Mat4   result;
+    float* o = &result[0][0];
+    for (int j = 0; j < 4; ++j) {
+        __m128 c = _mm_mul_ps(l0, _mm_set1_ps(r[j * 4 + 0]));
+        c        = _mm_add_ps(c, _mm_mul_ps(l1, _mm_set1_ps(r[j * 4 + 1])));
+        c        = _mm_add_ps(c, _mm_mul_ps(l2, _mm_set1_ps(r[j * 4 + 2])));
+        c        = _mm_add_ps(c, _mm_mul_ps(l3, _mm_set1_ps(r[j * 4 + 3])));
+        _mm_storeu_ps(o + j * 4, c);
+    }
+    return result;
+#else
     return glm::mat4(left) * glm::mat4(right);
+#endif
 }
 
 static _inline Vec3 operator*(const Mat4& left, const Vec3& right)
@@ -231,8 +271,23 @@ static _inline float absolute(float v) { return glm::abs(v); }
 _inline Mat4 Mat4::make_transform(
     const Vec3& position, const Quat& rotation, const Vec3& scale)
 {
-    return glm::translate(glm::mat4(1.0f), position) *
-           glm::mat4(rotation.matrix()) * glm::scale(glm::mat4(1.0f), scale);
+    // Same as T * R * S, without the two matrix multiplications
+    glm::mat4 result = glm::toMat4(glm::quat(rotation));
+    result[0] *= scale.x;
+    result[1] *= scale.y;
+    result[2] *= scale.z;
+    result[3] = glm::vec4(glm::vec3(position), 1.0f);
+    return result;
+}
+
+_inline Mat4 Mat4::inverse_affine() const
+{
+    glm::mat3 inv = glm::inverse(glm::mat3(*this));
+    glm::vec3 t   = -(inv * glm::vec3((*this)[3]));
+
+    glm::mat4 result(inv);
+    result[3] = glm::vec4(t, 1.0f);
+    return result;
 }
 
 _inline void Mat4::decompose(Vec3& position, Quat& rotation, Vec3& scale) const
@@ -0,0 +1,638 @@
+#include "MeshOptimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "Containers/Extras.h"
+#include "Hashing.h"
+#include "MathTypes.h"
+#include "RadixSort.h"
+#include "Traits.h"
+
+static constexpr u32 Invalid_Index = 0xFFFFFFFF;
+
+u64 deduplicate_vertices(
+    Allocator& allocator,
+    Slice<u32> indices,
+    void*      vertices,
+    u64        vertex_count,
+    u64        vertex_size)
+{
+    if (vertex_count == 0) return 0;
+
+    u8* data = (u8*)vertices;
+
+    // Open addressing, at most half full
+    u64 table_size = 16;
+    while (table_size < vertex_count * 2) table_size *= 2;
+    const u64 mask = table_size - 1;
+
+    Slice<u32> table = alloc_slice<u32>(allocator, table_size);
+    Slice<u32> remap = alloc_slice<u32>(allocator, vertex_count);
+    DEFER(allocator.release((umm)table.ptr));
+    DEFER(allocator.release((umm)remap.ptr));
+
+    memset(table.ptr, 0xFF, table_size * sizeof(u32));
+
+    // Unique vertices are compacted in place as they're found. Compacted
+    // slots are never written again, so lookups can compare against them
+    u32 unique_count = 0;
+    for (u64 v = 0; v < vertex_count; ++v) {
+        const u8* vertex = data + v * vertex_size;
+
+        u64 slot = murmur_hash2(vertex, vertex_size, 0) & mask;
+        while (table[slot] != Invalid_Index) {
+            const u8* other = data + u64(table[slot]) * vertex_size;
+            if (memcmp(vertex, other, vertex_size) == 0) break;
+            slot = (slot + 1) & mask;
+        }
+
+        if (table[slot] == Invalid_Index) {
+            if (unique_count != v) {
+                u8* compacted = data + u64(unique_count) * vertex_size;
+                memcpy(compacted, vertex, vertex_size);
+            }
+            table[slot] = unique_count++;
+        }
+
+        remap[v] = table[slot];
+    }
+
+    for (u64 i = 0; i < indices.count; ++i) {
+        indices[i] = remap[indices[i]];
+    }
+
+    return unique_count;
+}
+
+/**
+ * Tuning of the Forsyth scoring, from "Linear-Speed Vertex Cache
+ * Optimisation" (Tom Forsyth, 2006)
+ */
+static constexpr u32 Cache_Size          = 32;
+static constexpr f32 Cache_Decay_Power   = 1.5f;
+static constexpr f32 Last_Triangle_Score = 0.75f;
+static constexpr f32 Valence_Boost_Scale = 2.0f;
+static constexpr f32 Valence_Boost_Power = 0.5f;
+
+static f32 vertex_score(i32 cache_position, u32 live_triangles)
+{
+    // Nothing left to draw with this vertex
+    if (live_triangles == 0) return -1.0f;
+
+    f32 score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // Used by the triangle just drawn. Scored lower on purpose, so
+            // that strips of triangles don't form
+            score = Last_Triangle_Score;
+        } else {
+            f32 scale = 1.0f / (Cache_Size - 3);
+            score     = 1.0f - (cache_position - 3) * scale;
+            score     = powf(score, Cache_Decay_Power);
+        }
+    }
+
+    // Get rid of vertices with few triangles left first, so they don't stay
+    // around as lone triangles
+    score += Valence_Boost_Scale * powf(live_triangles, -Valence_Boost_Power);
+    return score;
+}
+
+void optimize_vertex_cache(
+    Allocator& allocator, Slice<u32> indices, u64 vertex_count)
+{
+    const u64 triangle_count = indices.count / 3;
+    if (triangle_count < 2) return;
+
+    auto live_triangles  = alloc_slice<u32>(allocator, vertex_count);
+    auto first_triangle  = alloc_slice<u32>(allocator, vertex_count);
+    auto adjacency       = alloc_slice<u32>(allocator, triangle_count * 3);
+    auto cache_position  = alloc_slice<i32>(allocator, vertex_count);
+    auto vertex_scores   = alloc_slice<f32>(allocator, vertex_count);
+    auto triangle_scores = alloc_slice<f32>(allocator, triangle_count);
+    auto emitted         = alloc_slice<u8>(allocator, triangle_count);
+    auto result          = alloc_slice<u32>(allocator, indices.count);
+    DEFER({
+        allocator.release((umm)live_triangles.ptr);
+        allocator.release((umm)first_triangle.ptr);
+        allocator.release((umm)adjacency.ptr);
+        allocator.release((umm)cache_position.ptr);
+        allocator.release((umm)vertex_scores.ptr);
+        allocator.release((umm)triangle_scores.ptr);
+        allocator.release((umm)emitted.ptr);
+        allocator.release((umm)result.ptr);
+    });
+
+    // Triangles of each vertex. The live triangles of vertex v are
+    // adjacency[first_triangle[v]..first_triangle[v] + live_triangles[v]]
+    memset(live_triangles.ptr, 0, vertex_count * sizeof(u32));
+    for (u64 i = 0; i < indices.count; ++i) {
+        live_triangles[indices[i]]++;
+    }
+
+    u32 offset = 0;
+    for (u64 v = 0; v < vertex_count; ++v) {
+        first_triangle[v] = offset;
+        offset += live_triangles[v];
+        live_triangles[v] = 0;
+    }
+
+    for (u64 t = 0; t < triangle_count; ++t) {
+        for (u32 k = 0; k < 3; ++k) {
+            u32 v = indices[t * 3 + k];
+            adjacency[first_triangle[v] + live_triangles[v]++] = u32(t);
+        }
+    }
+
+    for (u64 v = 0; v < vertex_count; ++v) {
+        cache_position[v] = -1;
+        vertex_scores[v]  = vertex_score(-1, live_triangles[v]);
+    }
+
+    u32 best_triangle = 0;
+    f32 best_score    = -1.0f;
+    for (u64 t = 0; t < triangle_count; ++t) {
+        triangle_scores[t] = vertex_scores[indices[t * 3 + 0]] +
+                             vertex_scores[indices[t * 3 + 1]] +
+                             vertex_scores[indices[t * 3 + 2]];
+        if (triangle_scores[t] > best_score) {
+            best_score    = triangle_scores[t];
+            best_triangle = u32(t);
+        }
+    }
+
+    memset(emitted.ptr, 0, triangle_count);
+
+    // The three vertices of the emitted triangle, pushed in front of the
+    // cache, may push up to three vertices out of it
+    u32 cache[Cache_Size + 3];
+    u32 cache_count = 0;
+
+    u64 scan_cursor = 0;
+    for (u64 out = 0; out < triangle_count; ++out) {
+        if (best_triangle == Invalid_Index) {
+            // Nothing in the cache has triangles left, take the next one in
+            // the original order
+            while (emitted[scan_cursor]) scan_cursor++;
+            best_triangle = u32(scan_cursor);
+        }
+
+        const u32  t   = best_triangle;
+        const u32* tri = &indices[u64(t) * 3];
+
+        result[out * 3 + 0] = tri[0];
+        result[out * 3 + 1] = tri[1];
+        result[out * 3 + 2] = tri[2];
+        emitted[t]          = 1;
+
+        // Remove the triangle from its vertices
+        for (u32 k = 0; k < 3; ++k) {
+            u32  v     = tri[k];
+            u32* list  = &adjacency[first_triangle[v]];
+            u32  count = live_triangles[v];
+            for (u32 i = 0; i < count; ++i) {
+                if (list[i] == t) {
+                    list[i] = list[count - 1];
+                    break;
+                }
+            }
+            live_triangles[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the cache
+        u32 new_cache[Cache_Size + 3];
+        u32 new_count = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            // Degenerate triangles repeat vertices
+            if ((k > 0) && (tri[k] == tri[0])) continue;
+            if ((k > 1) && (tri[k] == tri[1])) continue;
+            new_cache[new_count++] = tri[k];
+        }
+        for (u32 i = 0; i < cache_count; ++i) {
+            u32 v = cache[i];
+            if ((v != tri[0]) && (v != tri[1]) && (v != tri[2])) {
+                new_cache[new_count++] = v;
+            }
+        }
+
+        for (u32 i = 0; i < new_count; ++i) {
+            u32 v             = new_cache[i];
+            cache_position[v] = (i < Cache_Size) ? i32(i) : -1;
+            vertex_scores[v] =
+                vertex_score(cache_position[v], live_triangles[v]);
+        }
+
+        // Rescore the triangles touched by the cache, including those of
+        // the vertices that just left it, but only pick from the ones in it
+        best_triangle = Invalid_Index;
+        best_score    = -1.0f;
+        for (u32 i = 0; i < new_count; ++i) {
+            u32        v    = new_cache[i];
+            const u32* list = &adjacency[first_triangle[v]];
+            for (u32 j = 0; j < live_triangles[v]; ++j) {
+                u32        other = list[j];
+                const u32* otri  = &indices[u64(other) * 3];
+
+                f32 score = vertex_scores[otri[0]] + vertex_scores[otri[1]] +
+                            vertex_scores[otri[2]];
+                triangle_scores[other] = score;
+
+                if ((i < Cache_Size) && (score > best_score)) {
+                    best_score    = score;
+                    best_triangle = other;
+                }
+            }
+        }
+
+        cache_count = (new_count < Cache_Size) ? new_count : Cache_Size;
+        memcpy(cache, new_cache, cache_count * sizeof(u32));
+    }
+
+    memcpy(indices.ptr, result.ptr, indices.count * sizeof(u32));
+}
+
+u64 optimize_vertex_fetch(
+    Allocator& allocator,
+    Slice<u32> indices,
+    void*      vertices,
+    u64        vertex_count,
+    u64        vertex_size)
+{
+    if (vertex_count == 0) return 0;
+
+    u8* data = (u8*)vertices;
+
+    Slice<u32> remap = alloc_slice<u32>(allocator, vertex_count);
+    Slice<u8>  reordered =
+        alloc_slice<u8>(allocator, vertex_count * vertex_size);
+    DEFER(allocator.release((umm)remap.ptr));
+    DEFER(allocator.release((umm)reordered.ptr));
+
+    memset(remap.ptr, 0xFF, vertex_count * sizeof(u32));
+
+    u32 next = 0;
+    for (u64 i = 0; i < indices.count; ++i) {
+        u32 v = indices[i];
+        if (remap[v] == Invalid_Index) {
+            memcpy(
+                reordered.ptr + u64(next) * vertex_size,
+                data + u64(v) * vertex_size,
+                vertex_size);
+            remap[v] = next++;
+        }
+
+        indices[i] = remap[v];
+    }
+
+    memcpy(data, reordered.ptr, u64(next) * vertex_size);
+    return next;
+}
+
+f32 calculate_acmr(
+    Allocator& allocator,
+    Slice<u32> indices,
+    u64        vertex_count,
+    u32        cache_size)
+{
+    if (indices.count < 3) return 0.0f;
+
+    // A vertex is in the cache if fewer than cache_size vertices were
+    // transformed since it was, which is how a FIFO cache behaves
+    Slice<u32> timestamps = alloc_slice<u32>(allocator, vertex_count);
+    DEFER(allocator.release((umm)timestamps.ptr));
+    memset(timestamps.ptr, 0, vertex_count * sizeof(u32));
+
+    u32 time   = cache_size + 1;
+    u64 misses = 0;
+    for (u64 i = 0; i < indices.count; ++i) {
+        u32 v = indices[i];
+        if (time - timestamps[v] > cache_size) {
+            timestamps[v] = time++;
+            misses++;
+        }
+    }
+
+    return f32(double(misses) / double(indices.count / 3));
+}
+
+/** Sum of area weighted plane quadrics, a symmetric 4x4 matrix */
+struct Quadric {
+    f32 a00, a11, a22, a01, a02, a12;
+    f32 b0, b1, b2;
+    f32 c;
+    /** Total area */
+    f32 w;
+};
+
+static void quadric_add(Quadric& q, const Quadric& other)
+{
+    q.a00 += other.a00;
+    q.a11 += other.a11;
+    q.a22 += other.a22;
+    q.a01 += other.a01;
+    q.a02 += other.a02;
+    q.a12 += other.a12;
+    q.b0 += other.b0;
+    q.b1 += other.b1;
+    q.b2 += other.b2;
+    q.c += other.c;
+    q.w += other.w;
+}
+
+static Quadric quadric_from_triangle(
+    const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+{
+    glm::vec3 n      = glm::cross(p1 - p0, p2 - p0);
+    f32       length = glm::length(n);
+    if (length == 0.0f) return Quadric{};
+
+    n /= length;
+    const f32 area = length * 0.5f;
+    const f32 d    = -glm::dot(n, p0);
+
+    return Quadric{
+        .a00 = area * n.x * n.x,
+        .a11 = area * n.y * n.y,
+        .a22 = area * n.z * n.z,
+        .a01 = area * n.x * n.y,
+        .a02 = area * n.x * n.z,
+        .a12 = area * n.y * n.z,
+        .b0  = area * n.x * d,
+        .b1  = area * n.y * d,
+        .b2  = area * n.z * d,
+        .c   = area * d * d,
+        .w   = area,
+    };
+}
+
+/** Mean squared distance of p to the planes of q */
+static f32 quadric_error(const Quadric& q, const glm::vec3& p)
+{
+    f32 r = q.a00 * p.x * p.x + q.a11 * p.y * p.y + q.a22 * p.z * p.z;
+    r += 2.0f * (q.a01 * p.x * p.y + q.a02 * p.x * p.z + q.a12 * p.y * p.z);
+    r += 2.0f * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z);
+    r += q.c;
+
+    return (q.w > 0.0f) ? fabsf(r) / q.w : 0.0f;
+}
+
+struct Collapse {
+    u32 from;
+    u32 to;
+    f32 error;
+};
+
+u64 simplify(
+    Allocator&  allocator,
+    Slice<u32>  destination,
+    Slice<u32>  indices,
+    const void* vertices,
+    u64         vertex_count,
+    u64         vertex_size,
+    u64         target_index_count,
+    f32         target_error,
+    f32*        result_error)
+{
+    ASSERT(destination.count >= indices.count);
+
+    if (result_error) *result_error = 0.0f;
+    memcpy(destination.ptr, indices.ptr, indices.count * sizeof(u32));
+
+    u64 index_count = indices.count;
+    if ((vertex_count == 0) || (index_count <= target_index_count)) {
+        return index_count;
+    }
+
+    auto positions      = alloc_slice<glm::vec3>(allocator, vertex_count);
+    auto quadrics       = alloc_slice<Quadric>(allocator, vertex_count);
+    auto locked         = alloc_slice<u8>(allocator, vertex_count);
+    auto touched        = alloc_slice<u8>(allocator, vertex_count);
+    auto remap          = alloc_slice<u32>(allocator, vertex_count);
+    auto valence        = alloc_slice<u32>(allocator, vertex_count);
+    auto first_triangle = alloc_slice<u32>(allocator, vertex_count);
+    auto adjacency      = alloc_slice<u32>(allocator, indices.count);
+    auto collapses      = alloc_slice<Collapse>(allocator, indices.count);
+    auto scratch        = alloc_slice<Collapse>(allocator, indices.count);
+    DEFER({
+        allocator.release((umm)positions.ptr);
+        allocator.release((umm)quadrics.ptr);
+        allocator.release((umm)locked.ptr);
+        allocator.release((umm)touched.ptr);
+        allocator.release((umm)remap.ptr);
+        allocator.release((umm)valence.ptr);
+        allocator.release((umm)first_triangle.ptr);
+        allocator.release((umm)adjacency.ptr);
+        allocator.release((umm)collapses.ptr);
+        allocator.release((umm)scratch.ptr);
+    });
+
+    // Positions are scaled to the unit cube, so that errors are relative to
+    // the extent of the mesh
+    const u8* data = (const u8*)vertices;
+    glm::vec3 min  = glm::vec3(NumProps<f32>::max);
+    glm::vec3 max  = glm::vec3(-NumProps<f32>::max);
+    for (u64 v = 0; v < vertex_count; ++v) {
+        memcpy(&positions[v], data + v * vertex_size, sizeof(glm::vec3));
+        min = glm::min(min, positions[v]);
+        max = glm::max(max, positions[v]);
+    }
+
+    const glm::vec3 extent = max - min;
+    f32 scale = glm::max(extent.x, glm::max(extent.y, extent.z));
+    scale     = (scale > 0.0f) ? (1.0f / scale) : 1.0f;
+    for (u64 v = 0; v < vertex_count; ++v) {
+        positions[v] = (positions[v] - min) * scale;
+    }
+
+    // The triangles of vertex v are
+    // adjacency[first_triangle[v]..first_triangle[v] + valence[v]]
+    auto build_adjacency = [&]() {
+        memset(valence.ptr, 0, vertex_count * sizeof(u32));
+        for (u64 i = 0; i < index_count; ++i) valence[destination[i]]++;
+
+        u32 offset = 0;
+        for (u64 v = 0; v < vertex_count; ++v) {
+            first_triangle[v] = offset;
+            offset += valence[v];
+            valence[v] = 0;
+        }
+
+        for (u64 i = 0; i < index_count; ++i) {
+            u32 v = destination[i];
+            adjacency[first_triangle[v] + valence[v]++] = u32(i / 3);
+        }
+    };
+
+    build_adjacency();
+    memset(locked.ptr, 0, vertex_count);
+
+    // Seams: vertices that share a position with another vertex
+    {
+        u64 table_size = 16;
+        while (table_size < vertex_count * 2) table_size *= 2;
+        const u64 mask = table_size - 1;
+
+        Slice<u32> table = alloc_slice<u32>(allocator, table_size);
+        DEFER(allocator.release((umm)table.ptr));
+        memset(table.ptr, 0xFF, table_size * sizeof(u32));
+
+        for (u64 v = 0; v < vertex_count; ++v) {
+            const glm::vec3& p = positions[v];
+
+            u64 slot = murmur_hash2(&p, sizeof(p), 0) & mask;
+            while (table[slot] != Invalid_Index) {
+                if (positions[table[slot]] == p) break;
+                slot = (slot + 1) & mask;
+            }
+
+            if (table[slot] == Invalid_Index) {
+                table[slot] = u32(v);
+            } else {
+                locked[v]           = 1;
+                locked[table[slot]] = 1;
+            }
+        }
+    }
+
+    // Borders: edges whose opposite edge isn't in any triangle
+    for (u64 i = 0; i < index_count; ++i) {
+        const u32 a = destination[i];
+        const u32 b = destination[i - (i % 3) + ((i + 1) % 3)];
+
+        bool has_opposite = false;
+        for (u32 j = 0; j < valence[b]; ++j) {
+            const u32* tri =
+                &destination[u64(adjacency[first_triangle[b] + j]) * 3];
+            for (u32 k = 0; k < 3; ++k) {
+                if ((tri[k] == b) && (tri[(k + 1) % 3] == a)) {
+                    has_opposite = true;
+                }
+            }
+        }
+
+        if (!has_opposite) {
+            locked[a] = 1;
+            locked[b] = 1;
+        }
+    }
+
+    memset(quadrics.ptr, 0, vertex_count * sizeof(Quadric));
+    for (u64 i = 0; i < index_count; i += 3) {
+        const u32* tri = &destination[i];
+        Quadric    q   = quadric_from_triangle(
+            positions[tri[0]],
+            positions[tri[1]],
+            positions[tri[2]]);
+
+        for (u32 k = 0; k < 3; ++k) quadric_add(quadrics[tri[k]], q);
+    }
+
+    // Moving from onto to must not turn any of the triangles that are left
+    // around by more than 60 degrees
+    auto flips = [&](u32 from, u32 to) {
+        for (u32 j = 0; j < valence[from]; ++j) {
+            const u32* tri =
+                &destination[u64(adjacency[first_triangle[from] + j]) * 3];
+            if ((tri[0] == to) || (tri[1] == to) || (tri[2] == to)) continue;
+
+            glm::vec3 p[3], q[3];
+            for (u32 k = 0; k < 3; ++k) {
+                p[k] = positions[tri[k]];
+                q[k] = (tri[k] == from) ? positions[to] : p[k];
+            }
+
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after  = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) <=
+                0.5f * glm::length(before) * glm::length(after))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    const f32 error_limit = target_error * target_error;
+    f32       max_error   = 0.0f;
+
+    // Each pass collapses the cheapest edges whose neighbourhoods don't
+    // overlap, then rewrites the indices
+    while (index_count > target_index_count) {
+        u64 collapse_count = 0;
+        for (u64 i = 0; i < index_count; ++i) {
+            const u32 from = destination[i];
+            const u32 to   = destination[i - (i % 3) + ((i + 1) % 3)];
+            if (locked[from]) continue;
+
+            Quadric q = quadrics[from];
+            quadric_add(q, quadrics[to]);
+            collapses[collapse_count++] = Collapse{
+                .from  = from,
+                .to    = to,
+                .error = quadric_error(q, positions[to]),
+            };
+        }
+
+        // Errors are positive, so their bits sort like they do
+        auto candidates = slice(collapses.ptr, collapse_count);
+        radix_sort(candidates, scratch, [](const Collapse& collapse) {
+            u32 bits;
+            memcpy(&bits, &collapse.error, sizeof(bits));
+            return u64(bits);
+        });
+
+        for (u64 v = 0; v < vertex_count; ++v) remap[v] = u32(v);
+        memset(touched.ptr, 0, vertex_count);
+
+        const u64 triangle_goal     = (index_count - target_index_count) / 3;
+        u64       removed_triangles = 0;
+        u64       pass_collapses    = 0;
+        for (const Collapse& collapse : candidates) {
+            if (collapse.error > error_limit) break;
+            if (removed_triangles >= triangle_goal) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+            if (flips(collapse.from, collapse.to)) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadric_add(quadrics[collapse.to], quadrics[collapse.from]);
+            max_error = glm::max(max_error, collapse.error);
+            pass_collapses++;
+
+            // Triangles around from can't change again in this pass
+            for (u32 j = 0; j < valence[collapse.from]; ++j) {
+                const u32* tri = &destination
+                    [u64(adjacency[first_triangle[collapse.from] + j]) * 3];
+                for (u32 k = 0; k < 3; ++k) touched[tri[k]] = 1;
+
+                if ((tri[0] == collapse.to) || (tri[1] == collapse.to) ||
+                    (tri[2] == collapse.to))
+                {
+                    removed_triangles++;
+                }
+            }
+        }
+
+        if (pass_collapses == 0) break;
+
+        // Drop the triangles that collapsed
+        u64 write = 0;
+        for (u64 i = 0; i < index_count; i += 3) {
+            const u32 a = remap[destination[i + 0]];
+            const u32 b = remap[destination[i + 1]];
+            const u32 c = remap[destination[i + 2]];
+            if ((a == b) || (b == c) || (c == a)) continue;
+
+            destination[write++] = a;
+            destination[write++] = b;
+            destination[write++] = c;
+        }
+        index_count = write;
+
+        build_adjacency();
+    }
+
+    if (result_error) *result_error = sqrtf(max_error);
+    return index_count;
+}
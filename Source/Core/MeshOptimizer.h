@@ -0,0 +1,87 @@
+#pragma once
+#include "Base.h"
+#include "Containers/Slice.h"
+
+/**
+ * Optimizations of indexed triangle lists, meant to run at import time.
+ * Vertices are treated as opaque blobs of vertex_size bytes, so any vertex
+ * format works. The usual order is:
+ *
+ * deduplicate_vertices -> optimize_vertex_cache -> optimize_vertex_fetch
+ *
+ * since the vertex order that's best for fetching depends on the order of the
+ * triangles.
+ */
+
+/**
+ * Merges byte-identical vertices, compacting vertices in place and remapping
+ * indices to the merged vertices
+ * @return The number of unique vertices
+ */
+u64 deduplicate_vertices(
+    Allocator& allocator,
+    Slice<u32> indices,
+    void*      vertices,
+    u64        vertex_count,
+    u64        vertex_size);
+
+/**
+ * Reorders triangles so that the vertices they share are still in the
+ * post-transform cache when they're reused (Forsyth's linear-speed vertex
+ * cache optimization). Triangles keep their winding
+ */
+void optimize_vertex_cache(
+    Allocator& allocator, Slice<u32> indices, u64 vertex_count);
+
+/**
+ * Reorders vertices in the order the indices first reference them, so that
+ * vertex fetches walk memory front to back, and remaps indices to match.
+ * Vertices that aren't referenced are dropped
+ * @return The number of vertices left
+ */
+u64 optimize_vertex_fetch(
+    Allocator& allocator,
+    Slice<u32> indices,
+    void*      vertices,
+    u64        vertex_count,
+    u64        vertex_size);
+
+/**
+ * Average cache miss ratio: transformed vertices per triangle, simulating a
+ * FIFO post-transform cache of cache_size entries. Ranges from 0.5 (ideal
+ * for large grids) to 3 (no reuse)
+ */
+f32 calculate_acmr(
+    Allocator& allocator,
+    Slice<u32> indices,
+    u64        vertex_count,
+    u32        cache_size = 16);
+
+/**
+ * Simplifies a triangle list by collapsing edges in the order of their
+ * quadric error (Garland & Heckbert, "Surface Simplification Using Quadric
+ * Error Metrics", 1997), until it's down to target_index_count indices or
+ * the next collapse would exceed target_error. Vertices are only removed,
+ * never moved, so the result indexes the same vertex buffer.
+ *
+ * Vertices on open borders and on attribute seams (vertices that share their
+ * position with another one) are never collapsed, which keeps the outline
+ * and the UV layout of the mesh.
+ *
+ * @param destination  Receives the indices, needs room for indices.count
+ * @param vertices     Each vertex starts with its position, as three f32
+ * @param target_error Relative to the extent of the mesh, e.g. 0.01 for 1%
+ * @param result_error If not null, receives the error of the result,
+ * relative to the extent of the mesh
+ * @return The number of indices written to destination
+ */
+u64 simplify(
+    Allocator&  allocator,
+    Slice<u32>  destination,
+    Slice<u32>  indices,
+    const void* vertices,
+    u64         vertex_count,
+    u64         vertex_size,
+    u64         target_index_count,
+    f32         target_error,
+    f32*        result_error = nullptr);
@@ -0,0 +1,271 @@
+#include "Meshlets.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "Containers/Extras.h"
+#include "Debugging/Assertions.h"
+#include "Traits.h"
+
+static constexpr u32 Invalid_Index = 0xFFFFFFFF;
+
+/** Cones whose normals spread further than ~84 degrees are never culled */
+static constexpr f32 Min_Cone_Dot = 0.1f;
+
+/**
+ * Each triangle adds at most 3 vertices, so a meshlet that the next triangle
+ * doesn't fit in has at least this many triangles. Smaller meshlets aren't
+ * closed for any other reason either, which bounds the meshlet count
+ */
+static constexpr u32 Min_Meshlet_Triangles = (Meshlet_Max_Vertices - 2) / 3;
+
+u64 meshlet_bound(u64 index_count)
+{
+    const u64 triangle_count = index_count / 3;
+    return (triangle_count + Min_Meshlet_Triangles - 1) /
+           Min_Meshlet_Triangles;
+}
+
+u64 build_meshlets(
+    Allocator&     allocator,
+    Slice<Meshlet> meshlets,
+    Slice<u32>     indices,
+    const void*    vertices,
+    u64            vertex_count,
+    u64            vertex_size)
+{
+    ASSERT(indices.count % 3 == 0);
+    ASSERT(meshlets.count >= meshlet_bound(indices.count));
+
+    const u64 triangle_count = indices.count / 3;
+    if (triangle_count == 0) return 0;
+
+    auto valence        = alloc_slice<u32>(allocator, vertex_count);
+    auto live           = alloc_slice<u32>(allocator, vertex_count);
+    auto first_triangle = alloc_slice<u32>(allocator, vertex_count);
+    auto owner          = alloc_slice<u32>(allocator, vertex_count);
+    auto adjacency      = alloc_slice<u32>(allocator, indices.count);
+    auto ordered        = alloc_slice<u32>(allocator, indices.count);
+    auto emitted        = alloc_slice<u8>(allocator, triangle_count);
+    DEFER({
+        allocator.release((umm)valence.ptr);
+        allocator.release((umm)live.ptr);
+        allocator.release((umm)first_triangle.ptr);
+        allocator.release((umm)owner.ptr);
+        allocator.release((umm)adjacency.ptr);
+        allocator.release((umm)ordered.ptr);
+        allocator.release((umm)emitted.ptr);
+    });
+
+    // The triangles of vertex v are
+    // adjacency[first_triangle[v]..first_triangle[v] + valence[v]]
+    memset(valence.ptr, 0, vertex_count * sizeof(u32));
+    for (u32 index : indices) valence[index]++;
+
+    u32 offset = 0;
+    for (u64 v = 0; v < vertex_count; ++v) {
+        first_triangle[v] = offset;
+        offset += valence[v];
+        live[v]    = valence[v];
+        valence[v] = 0;
+    }
+
+    for (u64 i = 0; i < indices.count; ++i) {
+        u32 v = indices[i];
+        adjacency[first_triangle[v] + valence[v]++] = u32(i / 3);
+    }
+
+    // The meshlet each vertex was last added to
+    memset(owner.ptr, 0xFF, vertex_count * sizeof(u32));
+    memset(emitted.ptr, 0, triangle_count);
+
+    const u8* data = (const u8*)vertices;
+
+    auto position = [&](u32 index) {
+        glm::vec3 result;
+        memcpy(&result, data + u64(index) * vertex_size, sizeof(result));
+        return result;
+    };
+
+    u32       meshlet_vertices[Meshlet_Max_Vertices];
+    u32       vertex_used   = 0;
+    u32       triangle_used = 0;
+    u64       meshlet_count = 0;
+    u64       written       = 0;
+    u64       cursor        = 0;
+    glm::vec3 position_sum  = glm::vec3(0.0f);
+
+    auto new_vertices = [&](u32 triangle) {
+        u32 result = 0;
+        for (u32 k = 0; k < 3; ++k) {
+            if (owner[indices[triangle * 3 + k]] != meshlet_count) result++;
+        }
+        return result;
+    };
+
+    // Squared distance of a triangle from the center of the meshlet, times 9
+    auto spread = [&](u32 triangle) {
+        glm::vec3 sum = glm::vec3(0.0f);
+        for (u32 k = 0; k < 3; ++k) sum += position(indices[triangle * 3 + k]);
+
+        const glm::vec3 offset = sum - position_sum * (3.0f / vertex_used);
+        return glm::dot(offset, offset);
+    };
+
+    meshlets[0] = {.first_index = 0, .index_count = 0};
+
+    for (u64 n = 0; n < triangle_count; ++n) {
+        // The neighbour that brings in the fewest vertices, and of those the
+        // closest one, which grows meshlets round instead of into strips
+        u32 best        = Invalid_Index;
+        u32 best_new    = 4;
+        f32 best_spread = 0.0f;
+        for (u32 i = 0; i < vertex_used; ++i) {
+            const u32 v = meshlet_vertices[i];
+            if (live[v] == 0) continue;
+
+            for (u32 j = 0; j < valence[v]; ++j) {
+                const u32 triangle = adjacency[first_triangle[v] + j];
+                if (emitted[triangle]) continue;
+
+                const u32 count = new_vertices(triangle);
+                if (count > best_new) continue;
+
+                const f32 distance = spread(triangle);
+                if ((count < best_new) || (distance < best_spread)) {
+                    best        = triangle;
+                    best_new    = count;
+                    best_spread = distance;
+                }
+            }
+        }
+
+        // Nothing connected left, continue with the next triangle in order.
+        // It may be anywhere, so it starts a meshlet of its own unless the
+        // current one is too small
+        bool disconnected = false;
+        if (best == Invalid_Index) {
+            while (emitted[cursor]) cursor++;
+            best         = (u32)cursor;
+            best_new     = new_vertices(best);
+            disconnected = triangle_used >= Min_Meshlet_Triangles;
+        }
+
+        if (disconnected || (vertex_used + best_new > Meshlet_Max_Vertices) ||
+            (triangle_used == Meshlet_Max_Triangles))
+        {
+            meshlets[meshlet_count].index_count = triangle_used * 3;
+            meshlet_count++;
+            meshlets[meshlet_count] = {
+                .first_index = (u32)written,
+                .index_count = 0,
+            };
+
+            // Every vertex is new to the next meshlet
+            vertex_used   = 0;
+            triangle_used = 0;
+            position_sum  = glm::vec3(0.0f);
+        }
+
+        for (u32 k = 0; k < 3; ++k) {
+            const u32 v = indices[best * 3 + k];
+            if (owner[v] != meshlet_count) {
+                owner[v]                        = (u32)meshlet_count;
+                meshlet_vertices[vertex_used++] = v;
+                position_sum += position(v);
+            }
+
+            live[v]--;
+            ordered[written++] = v;
+        }
+
+        emitted[best] = 1;
+        triangle_used++;
+    }
+
+    meshlets[meshlet_count].index_count = triangle_used * 3;
+    meshlet_count++;
+
+    memcpy(indices.ptr, ordered.ptr, indices.count * sizeof(u32));
+    return meshlet_count;
+}
+
+void compute_meshlet_bounds(
+    Slice<Meshlet> meshlets,
+    Slice<u32>     indices,
+    const void*    vertices,
+    u64            vertex_size)
+{
+    const u8* data = (const u8*)vertices;
+
+    auto position = [&](u32 index) {
+        glm::vec3 result;
+        memcpy(&result, data + u64(index) * vertex_size, sizeof(result));
+        return result;
+    };
+
+    // Unit normal of a triangle, or zero if it's degenerate
+    auto normal = [&](const u32* triangle) {
+        const glm::vec3 a = position(triangle[0]);
+        const glm::vec3 b = position(triangle[1]);
+        const glm::vec3 c = position(triangle[2]);
+
+        glm::vec3 result = glm::cross(b - a, c - a);
+        f32       length = glm::length(result);
+        return (length > 0.0f) ? (result / length) : glm::vec3(0.0f);
+    };
+
+    for (Meshlet& meshlet : meshlets) {
+        const u32* range = indices.ptr + meshlet.first_index;
+
+        // Sphere around the bounding box
+        glm::vec3 min = glm::vec3(NumProps<f32>::max);
+        glm::vec3 max = glm::vec3(-NumProps<f32>::max);
+        for (u32 i = 0; i < meshlet.index_count; ++i) {
+            const glm::vec3 p = position(range[i]);
+            min               = glm::min(min, p);
+            max               = glm::max(max, p);
+        }
+
+        meshlet.center = (min + max) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (u32 i = 0; i < meshlet.index_count; ++i) {
+            f32 distance = glm::distance(position(range[i]), meshlet.center);
+            if (distance > meshlet.radius) meshlet.radius = distance;
+        }
+
+        // Cone around the triangle normals
+        glm::vec3 axis = glm::vec3(0.0f);
+        for (u32 i = 0; i < meshlet.index_count; i += 3) {
+            axis += normal(range + i);
+        }
+
+        meshlet.cone_axis   = glm::vec3(0.0f);
+        meshlet.cone_cutoff = 1.0f;
+
+        const f32 axis_length = glm::length(axis);
+        if (axis_length == 0.0f) continue;
+        axis /= axis_length;
+
+        f32 min_dot = 1.0f;
+        for (u32 i = 0; i < meshlet.index_count; i += 3) {
+            const glm::vec3 n = normal(range + i);
+            if (n == glm::vec3(0.0f)) continue;
+            min_dot = glm::min(min_dot, glm::dot(n, axis));
+        }
+
+        meshlet.cone_axis = axis;
+        if (min_dot > Min_Cone_Dot) {
+            meshlet.cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+        }
+    }
+}
+
+bool is_meshlet_backfacing(
+    const Meshlet& meshlet, const glm::vec3& camera_position)
+{
+    // The whole sphere has to be behind the cone, pushed back by its radius
+    const glm::vec3 view = meshlet.center - camera_position;
+    return glm::dot(view, meshlet.cone_axis) >=
+           meshlet.cone_cutoff * glm::length(view) + meshlet.radius;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Base.h"
+#include "Containers/Slice.h"
+#include "MathTypes.h"
+
+/**
+ * Meshlets: small clusters of neighbouring triangles, with bounds tight
+ * enough to cull them on their own. The limits match what mesh shading
+ * hardware likes, and keep clusters small enough to cull well
+ */
+static constexpr u32 Meshlet_Max_Vertices  = 64;
+static constexpr u32 Meshlet_Max_Triangles = 124;
+
+/**
+ * A meshlet as a range of the index buffer it was built from, with its
+ * bounding sphere and normal cone in the space of the vertices.
+ *
+ * Stored as is in mesh assets, so fields may only be appended
+ */
+struct Meshlet {
+    glm::vec3 center;
+    f32       radius;
+    /** Average facing of the triangles */
+    glm::vec3 cone_axis;
+    /**
+     * Sine of the angle between the axis and the normal furthest from it.
+     * 1 if the triangles don't share a general facing (never backfacing)
+     */
+    f32       cone_cutoff;
+    u32       first_index;
+    u32       index_count;
+};
+
+/** The most meshlets build_meshlets may make out of index_count indices */
+u64 meshlet_bound(u64 index_count);
+
+/**
+ * Splits a triangle list into meshlets of at most Meshlet_Max_Vertices
+ * unique vertices and Meshlet_Max_Triangles triangles. Meshlets grow
+ * greedily from a seed triangle, adding the neighbour that brings in the
+ * fewest new vertices (the closest one, on ties), and start over from the
+ * neighbour that didn't fit.
+ *
+ * The triangles are reordered in place so that each meshlet is a range of
+ * indices; triangles keep their winding. Only first_index and index_count of
+ * the meshlets are written, see compute_meshlet_bounds
+ *
+ * @param meshlets Needs room for meshlet_bound(indices.count)
+ * @param vertices Each vertex starts with its position, as three f32
+ * @return The number of meshlets
+ */
+u64 build_meshlets(
+    Allocator&     allocator,
+    Slice<Meshlet> meshlets,
+    Slice<u32>     indices,
+    const void*    vertices,
+    u64            vertex_count,
+    u64            vertex_size);
+
+/**
+ * Computes the bounding sphere and normal cone of meshlets made by
+ * build_meshlets
+ * @param vertices Each vertex starts with its position, as three f32
+ */
+void compute_meshlet_bounds(
+    Slice<Meshlet> meshlets,
+    Slice<u32>     indices,
+    const void*    vertices,
+    u64            vertex_size);
+
+/**
+ * Whether every triangle of the meshlet faces away from camera_position.
+ * Both are in the same space. Matches the test of indirect_cull.comp
+ */
+bool is_meshlet_backfacing(
+    const Meshlet& meshlet, const glm::vec3& camera_position);
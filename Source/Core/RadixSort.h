@@ -0,0 +1,61 @@
+#pragma once
+#include <string.h>
+
+#include "Base.h"
+#include "Containers/Slice.h"
+#include "Debugging/Assertions.h"
+
+/**
+ * Stable LSD radix sort on a 64 bit key, 8 bits per pass. Passes where all
+ * keys fall into the same bucket are skipped, so keys that only use their
+ * lower bits are cheap to sort.
+ *
+ * @param items   The items to sort. Holds the sorted result on return
+ * @param scratch Temporary storage, at least as big as items
+ * @param key_of  Callable returning the u64 key of an item
+ */
+template <typename T, typename KeyFunc>
+_inline void radix_sort(Slice<T> items, Slice<T> scratch, KeyFunc key_of)
+{
+    ASSERT(scratch.count >= items.count);
+    if (items.count < 2) return;
+
+    constexpr u32 Num_Buckets = 256;
+    constexpr u32 Num_Passes  = sizeof(u64);
+
+    T* src = items.ptr;
+    T* dst = scratch.ptr;
+
+    for (u32 pass = 0; pass < Num_Passes; ++pass) {
+        const u32 shift = pass * 8;
+
+        u64 offsets[Num_Buckets] = {};
+        for (u64 i = 0; i < items.count; ++i) {
+            offsets[(key_of(src[i]) >> shift) & 0xFF]++;
+        }
+
+        // Every key shares this digit
+        if (offsets[(key_of(src[0]) >> shift) & 0xFF] == items.count) {
+            continue;
+        }
+
+        u64 total = 0;
+        for (u32 b = 0; b < Num_Buckets; ++b) {
+            u64 count  = offsets[b];
+            offsets[b] = total;
+            total += count;
+        }
+
+        for (u64 i = 0; i < items.count; ++i) {
+            dst[offsets[(key_of(src[i]) >> shift) & 0xFF]++] = src[i];
+        }
+
+        T* tmp = src;
+        src    = dst;
+        dst    = tmp;
+    }
+
+    if (src != items.ptr) {
+        memcpy(items.ptr, src, items.count * sizeof(T));
+    }
+}
@@ -0,0 +1,94 @@
+#include "RangeAllocator.h"
+
+#include "Debugging/Assertions.h"
+
+void RangeAllocator::init(Allocator& allocator, u64 capacity)
+{
+    free_ranges.alloc = &allocator;
+    this->capacity    = capacity;
+    reset();
+}
+
+void RangeAllocator::deinit() { free_ranges.release(); }
+
+u64 RangeAllocator::allocate(u64 size)
+{
+    if (size == 0) return Invalid_Offset;
+
+    for (u64 i = 0; i < free_ranges.size; ++i) {
+        Range& range = free_ranges[i];
+        if (range.size < size) continue;
+
+        u64 offset = range.offset;
+        range.offset += size;
+        range.size -= size;
+        if (range.size == 0) free_ranges.del(i);
+
+        free_size -= size;
+        return offset;
+    }
+
+    return Invalid_Offset;
+}
+
+void RangeAllocator::free(u64 offset, u64 size)
+{
+    if (size == 0) return;
+    ASSERT(offset + size <= capacity);
+
+    // First free range past the freed one
+    u64 next = 0;
+    while ((next < free_ranges.size) && (free_ranges[next].offset < offset)) {
+        next++;
+    }
+
+    bool merges_prev =
+        (next > 0) &&
+        (free_ranges[next - 1].offset + free_ranges[next - 1].size == offset);
+    bool merges_next = (next < free_ranges.size) &&
+                       (offset + size == free_ranges[next].offset);
+
+    if (merges_prev && merges_next) {
+        free_ranges[next - 1].size += size + free_ranges[next].size;
+        free_ranges.del(next);
+    } else if (merges_prev) {
+        free_ranges[next - 1].size += size;
+    } else if (merges_next) {
+        free_ranges[next].offset = offset;
+        free_ranges[next].size += size;
+    } else {
+        // Shift the ranges after it up by one
+        free_ranges.add(Range{});
+        for (u64 i = free_ranges.size - 1; i > next; --i) {
+            free_ranges[i] = free_ranges[i - 1];
+        }
+        free_ranges[next] = Range{.offset = offset, .size = size};
+    }
+
+    free_size += size;
+}
+
+void RangeAllocator::reset()
+{
+    free_ranges.empty();
+    free_ranges.add(Range{.offset = 0, .size = capacity});
+    free_size = capacity;
+}
+
+u64 RangeAllocator::largest_free()
+{
+    u64 result = 0;
+    for (u64 i = 0; i < free_ranges.size; ++i) {
+        if (free_ranges[i].size > result) result = free_ranges[i].size;
+    }
+    return result;
+}
+
+u64 RangeAllocator::fragmented_size()
+{
+    if (free_ranges.size == 0) return 0;
+
+    Range& last = free_ranges[free_ranges.size - 1];
+    if (last.offset + last.size == capacity) return free_size - last.size;
+    return free_size;
+}
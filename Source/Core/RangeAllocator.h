@@ -0,0 +1,37 @@
+#pragma once
+#include "Base.h"
+#include "Containers/Array.h"
+
+/**
+ * Hands out ranges of a linear space of capacity units (e.g. vertices of a
+ * vertex buffer), without touching the space itself. Free ranges are kept
+ * sorted by offset and merged with their neighbours when freed; allocation
+ * takes the first range that fits.
+ */
+struct RangeAllocator {
+    static constexpr u64 Invalid_Offset = ~u64(0);
+
+    struct Range {
+        u64 offset;
+        u64 size;
+    };
+
+    void init(Allocator& allocator, u64 capacity);
+    void deinit();
+
+    /** @return The offset of the range, or Invalid_Offset if none fits */
+    u64  allocate(u64 size);
+    void free(u64 offset, u64 size);
+
+    /** Makes the whole space free again */
+    void reset();
+
+    u64 largest_free();
+
+    /** Free units that aren't at the end of the space */
+    u64 fragmented_size();
+
+    u64           capacity  = 0;
+    u64           free_size = 0;
+    TArray<Range> free_ranges;
+};
@@ -0,0 +1,89 @@
+#include "TaskQueue.h"
+
+#include "Thread/ThreadContext.h"
+
+void TaskQueue::init(u32 num_workers)
+{
+    workers.alloc = &System_Allocator;
+    tasks.alloc   = &System_Allocator;
+
+    for (u32 i = 0; i < num_workers; ++i) {
+        workers.add(new std::thread([this]() { worker_main(); }));
+    }
+}
+
+void TaskQueue::deinit()
+{
+    wait_idle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    task_available.notify_all();
+
+    for (std::thread* worker : workers) {
+        worker->join();
+        delete worker;
+    }
+    workers.release();
+    tasks.release();
+}
+
+void TaskQueue::queue(TaskFunction fn, void* user)
+{
+    if (workers.size == 0) {
+        fn(user);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Reclaim the space of the tasks taken so far, once there are none
+        // left to take
+        if (head == tasks.size) {
+            head       = 0;
+            tasks.size = 0;
+        }
+
+        tasks.add(Task{fn, user});
+    }
+    task_available.notify_one();
+}
+
+void TaskQueue::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() {
+        return (head == tasks.size) && (busy_workers == 0);
+    });
+}
+
+void TaskQueue::worker_main()
+{
+    {
+        BOOTSTRAP_THREAD(SimpleThreadContext);
+    }
+
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_available.wait(lock, [this]() {
+                return quit || (head < tasks.size);
+            });
+
+            if (head == tasks.size) return;
+
+            task = tasks[head++];
+            busy_workers++;
+        }
+
+        task.fn(task.user);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        busy_workers--;
+        if ((head == tasks.size) && (busy_workers == 0)) idle.notify_all();
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Base.h"
+#include "Containers/Array.h"
+
+/**
+ * Worker threads that run independent tasks in the background, in the order
+ * they were queued. Unlike a JobSystem job, which every thread works on while
+ * the caller waits, queue returns right away; tasks report back through their
+ * own data (e.g. an atomic state), which has to outlive them.
+ *
+ * Meant for long, blocking work like file I/O. Tasks may still run jobs on a
+ * JobSystem, taking turns with the other threads that do.
+ */
+struct TaskQueue {
+    using TaskFunction = void (*)(void* user);
+
+    void init(u32 num_workers);
+
+    /** Waits for the queued tasks to run, then stops the workers */
+    void deinit();
+
+    /**
+     * Queues fn(user) to run on a worker. Without workers it runs inline,
+     * before queue returns
+     */
+    void queue(TaskFunction fn, void* user);
+
+    /** Blocks until every task queued so far has run */
+    void wait_idle();
+
+private:
+    struct Task {
+        TaskFunction fn;
+        void*        user;
+    };
+
+    void worker_main();
+
+    TArray<std::thread*> workers;
+
+    std::mutex              mutex;
+    std::condition_variable task_available;
+    std::condition_variable idle;
+    bool                    quit = false;
+    /** Pending tasks are the ones past head */
+    TArray<Task>            tasks;
+    u64                     head = 0;
+    /** Workers running a task */
+    u32                     busy_workers = 0;
+};
@@ -0,0 +1,144 @@
+#include "AsyncFileReader.h"
+
+#include <atomic>
+
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+#include "Test/Test.h"
+
+static constexpr u32 File_Count = 100;
+
+/** Byte at offset of the file with index */
+static u8 file_byte(u32 index, u64 offset) { return u8(index * 7 + offset); }
+
+/** Sizes vary across a few pages, and the first file is empty */
+static u64 file_size(u32 index) { return (index * 397) % 9000; }
+
+static void write_test_files()
+{
+    create_dir(LIT("./reader.test"));
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(16));
+    for (u32 i = 0; i < File_Count; ++i) {
+        SAVE_ARENA(temp);
+
+        Str path = format(temp, LIT("./reader.test/{}.bin"), i);
+
+        BufferedWriteTape<true> ft(open_file_write(path));
+        for (u64 offset = 0; offset < file_size(i); ++offset) {
+            u8 byte = file_byte(i, offset);
+            ft.write(&byte, 1);
+        }
+    }
+}
+
+struct ReadCheck {
+    u32               index;
+    std::atomic<u32>* matches;
+};
+
+/** Counts the reads whose buffer holds what was written to their file */
+static void check_read(AsyncRead& read)
+{
+    ReadCheck* check = (ReadCheck*)read.user;
+    if (!read.ok) return;
+
+    for (u64 i = 0; i < read.buffer.count; ++i) {
+        if (read.buffer.ptr[i] != file_byte(check->index, read.offset + i)) {
+            return;
+        }
+    }
+
+    check->matches->fetch_add(1);
+}
+
+/**
+ * Reads every test file with the backend, in two batches, half of them whole
+ * and half of them from an offset into a buffer of their own, plus a file
+ * that doesn't exist
+ * @return Whether every read matched, and the missing file failed
+ */
+static bool read_test_files(
+    EAsyncReadBackend backend,
+    u32               queue_depth,
+    u64               max_read_size = MEGABYTES(1024))
+{
+    AsyncFileReader reader;
+    reader.max_read_size = max_read_size;
+    reader.init(System_Allocator, backend, queue_depth, 2);
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    std::atomic<u32> matches = 0;
+    AsyncRead        reads[File_Count + 1];
+    ReadCheck        checks[File_Count];
+    u8               buffers[File_Count / 2][64];
+
+    for (u32 i = 0; i < File_Count; ++i) {
+        checks[i] = ReadCheck{i, &matches};
+
+        AsyncRead& read  = reads[i];
+        read.path        = format(temp, LIT("./reader.test/{}.bin"), i);
+        read.on_complete = check_read;
+        read.user        = &checks[i];
+
+        if ((i % 2) && (file_size(i) >= 100)) {
+            read.offset = 30;
+            read.size   = sizeof(buffers[0]);
+            read.buffer = slice(buffers[i / 2], sizeof(buffers[0]));
+        }
+    }
+
+    reads[File_Count].path = LIT("./reader.test/missing.bin");
+
+    reader.submit(slice(reads, File_Count / 2));
+    reader.submit(slice(reads + File_Count / 2, File_Count / 2 + 1));
+    reader.wait();
+
+    bool result = (matches.load() == File_Count) && !reads[File_Count].ok;
+
+    // The whole files were allocated by the reader
+    for (u32 i = 0; i < File_Count; ++i) {
+        if ((reads[i].size == 0) && reads[i].buffer.ptr) {
+            System_Allocator.release(reads[i].buffer.ptr);
+        }
+    }
+
+    reader.deinit();
+    return result;
+}
+
+TEST_CASE("Core/AsyncFileReader", "Reads whole files and ranges of them")
+{
+    write_test_files();
+
+    // A queue depth lower than the batches, which have to wait for room
+    REQUIRE(read_test_files(AsyncReadBackend::IoUring, 8), "");
+    REQUIRE(read_test_files(AsyncReadBackend::IoUring, 256), "");
+    // Files larger than a read are read in parts
+    REQUIRE(read_test_files(AsyncReadBackend::IoUring, 8, 1000), "");
+    REQUIRE(read_test_files(AsyncReadBackend::ThreadPool, 8), "");
+
+    return MPASSED();
+}
+
+TEST_CASE("Core/AsyncFileReader/Fallback", "Falls back to the thread pool")
+{
+    AsyncFileReader pool_reader;
+    pool_reader.init(System_Allocator, AsyncReadBackend::ThreadPool);
+    const EAsyncReadBackend pool_backend = pool_reader.backend();
+    pool_reader.deinit();
+
+    REQUIRE(pool_backend == AsyncReadBackend::ThreadPool, "");
+
+#if !OS_LINUX
+    AsyncFileReader uring_reader;
+    uring_reader.init(System_Allocator, AsyncReadBackend::IoUring);
+    const EAsyncReadBackend uring_backend = uring_reader.backend();
+    uring_reader.deinit();
+
+    REQUIRE(uring_backend == AsyncReadBackend::ThreadPool, "");
+#endif
+
+    return MPASSED();
+}
@@ -0,0 +1,80 @@
+#include "FileWatcher.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+#include "Test/Test.h"
+
+static void write_watched_file(Str path, Str contents)
+{
+    BufferedWriteTape<true> ft(open_file_write(path));
+    ft.write(contents.data, contents.len);
+}
+
+/** Polls until path shows up in the changes, for up to two seconds */
+static bool wait_for_change(FileWatcher& watcher, Str path)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    for (u32 attempt = 0; attempt < 200; ++attempt) {
+        SAVE_ARENA(temp);
+
+        TArray<Str> changes(&temp);
+        watcher.poll(temp, changes);
+        for (Str change : changes) {
+            if (change == path) return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+/** Creates, overwrites and removes files under a watched directory */
+static bool watch_changes(bool polling)
+{
+    create_dir(LIT("./watcher.test"));
+    create_dir(LIT("./watcher.test/sub"));
+    remove("./watcher.test/sub/new.txt");
+    write_watched_file(LIT("./watcher.test/old.txt"), LIT("old"));
+
+    FileWatcher watcher;
+    watcher.polling          = polling;
+    watcher.poll_interval_ms = 0;
+    watcher.init(System_Allocator);
+    DEFER(watcher.deinit());
+
+    if (!watcher.add_directory(LIT("./watcher.test"))) return false;
+    if (watcher.add_directory(LIT("./watcher.test/old.txt"))) return false;
+
+    write_watched_file(LIT("./watcher.test/sub/new.txt"), LIT("new"));
+    if (!wait_for_change(watcher, LIT("./watcher.test/sub/new.txt"))) {
+        return false;
+    }
+
+    // A different size, since the time may not have changed yet
+    write_watched_file(LIT("./watcher.test/old.txt"), LIT("changed"));
+    if (!wait_for_change(watcher, LIT("./watcher.test/old.txt"))) {
+        return false;
+    }
+
+    remove("./watcher.test/sub/new.txt");
+    return wait_for_change(watcher, LIT("./watcher.test/sub/new.txt"));
+}
+
+TEST_CASE("Core/FileWatcher", "Reports written and removed files")
+{
+    REQUIRE(watch_changes(false), "");
+    return MPASSED();
+}
+
+TEST_CASE("Core/FileWatcher/Polling", "Walking finds the same changes")
+{
+    REQUIRE(watch_changes(true), "");
+    return MPASSED();
+}
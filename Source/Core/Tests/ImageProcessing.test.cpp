@@ -0,0 +1,245 @@
+#include "ImageProcessing.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Containers/Array.h"
+#include "FileSystem/Extras.h"
+#include "JobSystem.h"
+#include "Test/Test.h"
+
+static void unpack_565(u16 color, i32 result[3])
+{
+    u32 r     = (color >> 11) & 31;
+    u32 g     = (color >> 5) & 63;
+    u32 b     = color & 31;
+    result[0] = i32((r << 3) | (r >> 2));
+    result[1] = i32((g << 2) | (g >> 4));
+    result[2] = i32((b << 3) | (b >> 2));
+}
+
+/** Decodes the colors of a BC1 block, or of the color half of a BC3 block */
+static void decode_color_block(const u8* block, u8 texels[16][4])
+{
+    u16 color0, color1;
+    u32 indices;
+    memcpy(&color0, block + 0, sizeof(u16));
+    memcpy(&color1, block + 2, sizeof(u16));
+    memcpy(&indices, block + 4, sizeof(u32));
+
+    i32 palette[4][3];
+    unpack_565(color0, palette[0]);
+    unpack_565(color1, palette[1]);
+    for (u32 c = 0; c < 3; ++c) {
+        if (color0 > color1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    for (u32 i = 0; i < 16; ++i) {
+        u32 index = (indices >> (i * 2)) & 3;
+        for (u32 c = 0; c < 3; ++c) texels[i][c] = u8(palette[index][c]);
+    }
+}
+
+/** Decodes the alpha half of a BC3 block */
+static void decode_alpha_block(const u8* block, u8 texels[16][4])
+{
+    i32 alpha0 = block[0], alpha1 = block[1];
+
+    i32 palette[8] = {alpha0, alpha1};
+    if (alpha0 > alpha1) {
+        for (i32 k = 1; k < 7; ++k) {
+            palette[k + 1] = ((7 - k) * alpha0 + k * alpha1) / 7;
+        }
+    } else {
+        for (i32 k = 1; k < 5; ++k) {
+            palette[k + 1] = ((5 - k) * alpha0 + k * alpha1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; ++i) indices |= u64(block[2 + i]) << (i * 8);
+
+    for (u32 i = 0; i < 16; ++i) {
+        texels[i][3] = u8(palette[(indices >> (i * 3)) & 7]);
+    }
+}
+
+TEST_CASE("Core/ImageProcessing", "Downsampling averages 2x2 pixels")
+{
+    // Widths both wide enough to take the SIMD path, and odd or 1
+    static constexpr u32 widths[]  = {1, 2, 13, 16, 17};
+    static constexpr u32 heights[] = {1, 3, 8};
+
+    TArray<u8> image(&System_Allocator);
+    TArray<u8> result(&System_Allocator);
+
+    bool matches = true;
+    for (u32 width : widths) {
+        for (u32 height : heights) {
+            image.size = 0;
+            for (u32 i = 0; i < width * height * 4; ++i) {
+                image.add(u8(rand()));
+            }
+
+            const u32 result_width  = mip_extent(width, 1);
+            const u32 result_height = mip_extent(height, 1);
+            result.size             = 0;
+            for (u32 i = 0; i < result_width * result_height * 4; ++i) {
+                result.add(0);
+            }
+
+            downsample_rgba8(image.data, width, height, result.data);
+
+            auto pixel = [&](u32 x, u32 y, u32 c) -> u32 {
+                return image[(y * width + x) * 4 + c];
+            };
+
+            for (u32 y = 0; y < result_height; ++y) {
+                for (u32 x = 0; x < result_width; ++x) {
+                    u32 x0 = x * 2, x1 = (width > 1) ? x * 2 + 1 : 0;
+                    u32 y0 = y * 2, y1 = (height > 1) ? y * 2 + 1 : 0;
+
+                    for (u32 c = 0; c < 4; ++c) {
+                        u32 sum = pixel(x0, y0, c) + pixel(x1, y0, c) +
+                                  pixel(x0, y1, c) + pixel(x1, y1, c);
+                        u8 expected = u8((sum + 2) >> 2);
+
+                        if (result[(y * result_width + x) * 4 + c] !=
+                            expected)
+                        {
+                            matches = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    REQUIRE(matches, "");
+    REQUIRE(mip_count_of(1, 1) == 1, "");
+    REQUIRE(mip_count_of(256, 16) == 9, "");
+    REQUIRE(mip_count_of(5, 3) == 3, "");
+
+    image.release();
+    result.release();
+    return MPASSED();
+}
+
+TEST_CASE("Core/ImageProcessing", "BC1 and BC3 are close to the source")
+{
+    JobSystem jobs;
+    jobs.init(2);
+
+    // A ramp along x, with partial blocks at the edges
+    static constexpr u32 width  = 30;
+    static constexpr u32 height = 18;
+
+    TArray<u8> image(&System_Allocator);
+    for (u32 y = 0; y < height; ++y) {
+        for (u32 x = 0; x < width; ++x) {
+            image.add(u8(x * 8));
+            image.add(u8(255 - x * 4));
+            image.add(u8(64 + x * 2));
+            image.add(u8(x * 7 + y));
+        }
+    }
+
+    const u32  blocks_x = (width + 3) / 4;
+    TArray<u8> blocks(&System_Allocator);
+    for (u64 i = 0; i < block_count_of(width, height) * BC3_Block_Size; ++i) {
+        blocks.add(0);
+    }
+
+    i32 color_error[2] = {};
+    i32 alpha_error    = 0;
+    for (u32 alpha = 0; alpha < 2; ++alpha) {
+        const u32 block_size = alpha ? BC3_Block_Size : BC1_Block_Size;
+        if (alpha) {
+            encode_bc3(jobs, image.data, width, height, blocks.data);
+        } else {
+            encode_bc1(jobs, image.data, width, height, blocks.data);
+        }
+
+        for (u64 b = 0; b < block_count_of(width, height); ++b) {
+            const u8* block = blocks.data + b * block_size;
+
+            u8 texels[16][4];
+            if (alpha) {
+                decode_alpha_block(block, texels);
+                block += BC3_Block_Size - BC1_Block_Size;
+            }
+            decode_color_block(block, texels);
+
+            for (u32 i = 0; i < 16; ++i) {
+                u32 x = u32(b % blocks_x) * 4 + i % 4;
+                u32 y = u32(b / blocks_x) * 4 + i / 4;
+                if ((x >= width) || (y >= height)) continue;
+
+                const u8* pixel = &image[(y * width + x) * 4];
+                for (u32 c = 0; c < 3; ++c) {
+                    i32 error = abs(i32(pixel[c]) - texels[i][c]);
+                    if (error > color_error[alpha]) color_error[alpha] = error;
+                }
+                if (alpha) {
+                    i32 error = abs(i32(pixel[3]) - texels[i][3]);
+                    if (error > alpha_error) alpha_error = error;
+                }
+            }
+        }
+    }
+
+    jobs.deinit();
+
+    // Within a couple of 565 steps, since the colors are on a line
+    REQUIRE(color_error[0] <= 12, "");
+    REQUIRE(color_error[1] <= 12, "");
+    REQUIRE(alpha_error <= 4, "");
+
+    image.release();
+    blocks.release();
+    return MPASSED();
+}
+
+TEST_CASE("Core/ImageProcessing", "Solid blocks are exact")
+{
+    JobSystem jobs;
+    jobs.init(0);
+
+    // Red and half transparent, which 565 holds exactly
+    u8 image[8 * 8 * 4];
+    for (u32 i = 0; i < 8 * 8; ++i) {
+        image[i * 4 + 0] = 255;
+        image[i * 4 + 1] = 0;
+        image[i * 4 + 2] = 0;
+        image[i * 4 + 3] = 128;
+    }
+
+    u8 blocks[4 * BC3_Block_Size];
+    encode_bc3(jobs, image, 8, 8, blocks);
+    jobs.deinit();
+
+    bool exact = true;
+    for (u32 b = 0; b < 4; ++b) {
+        u8 texels[16][4];
+        decode_alpha_block(blocks + b * BC3_Block_Size, texels);
+        decode_color_block(
+            blocks + b * BC3_Block_Size + BC3_Block_Size - BC1_Block_Size,
+            texels);
+
+        for (u32 i = 0; i < 16; ++i) {
+            if (memcmp(texels[i], image, 4) != 0) exact = false;
+        }
+    }
+
+    REQUIRE(exact, "");
+    REQUIRE(!is_opaque_rgba8(image, 8 * 8), "");
+    return MPASSED();
+}
@@ -0,0 +1,60 @@
+#include "JobSystem.h"
+
+#include "FileSystem/Extras.h"
+#include "Test/Test.h"
+
+TEST_CASE("Core/JobSystem", "Runs every index exactly once")
+{
+    JobSystem jobs;
+    jobs.init(3);
+
+    static constexpr u32 count = 1000;
+    std::atomic<u32>     hits[count];
+
+    bool all_once = true;
+    for (u32 round = 0; round < 50; ++round) {
+        for (std::atomic<u32>& hit : hits) hit.store(0);
+
+        jobs.parallel_for(count, [&](u32 index) { hits[index].fetch_add(1); });
+
+        for (std::atomic<u32>& hit : hits) {
+            if (hit.load() != 1) all_once = false;
+        }
+    }
+
+    jobs.deinit();
+
+    REQUIRE(all_once, "");
+    return MPASSED();
+}
+
+TEST_CASE("Core/JobSystem/NoWorkers", "Runs inline without workers")
+{
+    JobSystem jobs;
+    jobs.init(0);
+
+    u32 num_threads = jobs.num_threads();
+    u32 sum         = 0;
+    jobs.parallel_for(100, [&](u32 index) { sum += index; });
+
+    jobs.deinit();
+
+    REQUIRE(num_threads == 1, "");
+    REQUIRE(sum == 4950, "");
+    return MPASSED();
+}
+TEST_CASE("Core/JobSystem/Nested", "Runs jobs started by a job inline")
+{
+    JobSystem jobs;
+    jobs.init(3);
+
+    std::atomic<u32> sum = 0;
+    jobs.parallel_for(10, [&](u32) {
+        jobs.parallel_for(10, [&](u32 index) { sum.fetch_add(index); });
+    });
+
+    jobs.deinit();
+
+    REQUIRE(sum.load() == 450, "");
+    return MPASSED();
+}
@@ -0,0 +1,86 @@
+#include "MathTypes.h"
+
+#include <stdlib.h>
+
+#include "Test/Test.h"
+
+static float random_float() { return (float(rand() % 2000) / 1000.f) - 1.f; }
+
+static bool nearly_equal(const Mat4& a, const Mat4& b, float epsilon)
+{
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            if (absolute(a[c][r] - b[c][r]) > epsilon) return false;
+        }
+    }
+    return true;
+}
+
+static Mat4 random_transform()
+{
+    Vec3 axis = normalize(Vec3(random_float(), random_float(), 1.f));
+    return Mat4::make_transform(
+        Vec3(random_float(), random_float(), random_float()) * 10.f,
+        Quat::angle_axis(random_float() * 180.f, axis),
+        Vec3(
+            1.f + random_float() * 0.5f,
+            1.f + random_float() * 0.5f,
+            1.f + random_float() * 0.5f));
+}
+
+TEST_CASE("Core/MathTypes", "Mat4 multiplication matches glm")
+{
+    srand(1337);
+
+    bool matches = true;
+    for (int i = 0; i < 64; ++i) {
+        Mat4 a, b;
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                a[c][r] = random_float();
+                b[c][r] = random_float();
+            }
+        }
+
+        Mat4 expected = glm::mat4(a) * glm::mat4(b);
+        if (!nearly_equal(a * b, expected, 1e-5f)) matches = false;
+    }
+
+    REQUIRE(matches, "");
+    return MPASSED();
+}
+
+TEST_CASE("Core/MathTypes", "make_transform matches T * R * S")
+{
+    Vec3 position(1.f, -2.f, 3.f);
+    Quat rotation = Quat::angle_axis(30.f, normalize(Vec3(1.f, 1.f, 0.f)));
+    Vec3 scale(2.f, 0.5f, 1.5f);
+
+    Mat4 expected = glm::translate(glm::mat4(1.0f), glm::vec3(position)) *
+                    glm::toMat4(glm::quat(rotation)) *
+                    glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+
+    REQUIRE(
+        nearly_equal(
+            Mat4::make_transform(position, rotation, scale),
+            expected,
+            1e-5f),
+        "");
+    return MPASSED();
+}
+
+TEST_CASE("Core/MathTypes", "Affine inverse matches the full inverse")
+{
+    srand(7);
+
+    bool matches = true;
+    for (int i = 0; i < 64; ++i) {
+        Mat4 m = random_transform();
+        if (!nearly_equal(m.inverse_affine(), m.inverse(), 1e-4f)) {
+            matches = false;
+        }
+    }
+
+    REQUIRE(matches, "");
+    return MPASSED();
+}
\ No newline at end of file
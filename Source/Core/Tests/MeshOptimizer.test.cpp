@@ -0,0 +1,146 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+#include "Containers/Array.h"
+#include "FileSystem/Extras.h"
+#include "Test/Test.h"
+#include "TestGrid.h"
+
+TEST_CASE("Core/MeshOptimizer", "Dedup, cache and fetch optimize a grid")
+{
+    TArray<glm::vec3> vertices(&System_Allocator);
+    TArray<u32>       indices(&System_Allocator);
+
+    // A vertex for every triangle corner, like an OBJ import, with the
+    // triangles shuffled
+    TArray<u32> order(&System_Allocator);
+    for (u32 i = 0; i < Grid_Size * Grid_Size * 2; ++i) order.add(i);
+
+    srand(1337);
+    for (u64 i = order.size - 1; i > 0; --i) {
+        u64 j = rand() % (i + 1);
+        std::swap(order[i], order[j]);
+    }
+
+    for (u32 triangle : order) {
+        u32 x = (triangle / 2) % Grid_Size;
+        u32 y = (triangle / 2) / Grid_Size;
+
+        f32 corners[2][3][2] = {
+            {{0, 0}, {1, 0}, {1, 1}},
+            {{0, 0}, {1, 1}, {0, 1}},
+        };
+
+        for (u32 k = 0; k < 3; ++k) {
+            const f32* c = corners[triangle % 2][k];
+            indices.add(u32(vertices.size));
+            vertices.add(glm::vec3(x + c[0], y + c[1], 0));
+        }
+    }
+
+    TArray<u64> before = triangle_keys(slice(indices), slice(vertices));
+
+    u64 vertex_count = deduplicate_vertices(
+        System_Allocator,
+        slice(indices),
+        vertices.data,
+        vertices.size,
+        sizeof(glm::vec3));
+    vertices.size = vertex_count;
+
+    REQUIRE(vertex_count == (Grid_Size + 1) * (Grid_Size + 1), "");
+
+    f32 shuffled_acmr =
+        calculate_acmr(System_Allocator, slice(indices), vertex_count);
+
+    optimize_vertex_cache(System_Allocator, slice(indices), vertex_count);
+
+    f32 optimized_acmr =
+        calculate_acmr(System_Allocator, slice(indices), vertex_count);
+
+    REQUIRE(optimized_acmr < 1.0f, "");
+    REQUIRE(optimized_acmr < shuffled_acmr, "");
+
+    vertex_count = optimize_vertex_fetch(
+        System_Allocator,
+        slice(indices),
+        vertices.data,
+        vertex_count,
+        sizeof(glm::vec3));
+
+    REQUIRE(vertex_count == vertices.size, "");
+
+    // Vertices are in the order they're first used
+    u32  next_new = 0;
+    bool in_order = true;
+    for (u32 index : indices) {
+        if (index > next_new) in_order = false;
+        if (index == next_new) next_new++;
+    }
+    REQUIRE(in_order, "");
+
+    TArray<u64> after = triangle_keys(slice(indices), slice(vertices));
+    REQUIRE(before.size == after.size, "");
+    REQUIRE(
+        memcmp(before.data, after.data, before.size * sizeof(u64)) ==
+            0,
+        "");
+
+    before.release();
+    after.release();
+    order.release();
+    vertices.release();
+    indices.release();
+    return MPASSED();
+}
+
+TEST_CASE("Core/MeshOptimizer", "Simplify a flat grid")
+{
+    TArray<glm::vec3> vertices(&System_Allocator);
+    TArray<u32>       indices(&System_Allocator);
+
+    make_grid(vertices, indices);
+
+    TArray<u32> simplified(&System_Allocator);
+    for (u64 i = 0; i < indices.size; ++i) simplified.add(0);
+
+    f32 error;
+    u64 index_count = simplify(
+        System_Allocator,
+        slice(simplified),
+        slice(indices),
+        vertices.data,
+        vertices.size,
+        sizeof(glm::vec3),
+        indices.size / 4,
+        0.001f,
+        &error);
+
+    // A plane simplifies without error
+    REQUIRE(index_count <= indices.size / 4, "");
+    REQUIRE(index_count % 3 == 0, "");
+    REQUIRE(error < 0.0001f, "");
+
+    // Triangles keep facing +Z, and the borders keep the grid covered
+    f32  area        = 0.0f;
+    bool same_facing = true;
+    for (u64 i = 0; i < index_count; i += 3) {
+        const glm::vec3& a = vertices[simplified[i + 0]];
+        const glm::vec3& b = vertices[simplified[i + 1]];
+        const glm::vec3& c = vertices[simplified[i + 2]];
+
+        f32 z = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (z <= 0.0f) same_facing = false;
+        area += z * 0.5f;
+    }
+    REQUIRE(same_facing, "");
+    REQUIRE(fabsf(area - f32(Grid_Size * Grid_Size)) < 0.01f, "");
+
+    simplified.release();
+    vertices.release();
+    indices.release();
+    return MPASSED();
+}
@@ -0,0 +1,141 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "Containers/Array.h"
+#include "FileSystem/Extras.h"
+#include "Test/Test.h"
+#include "TestGrid.h"
+
+TEST_CASE("Core/Meshlets", "Meshlets of a grid respect the limits")
+{
+    TArray<glm::vec3> vertices(&System_Allocator);
+    TArray<u32>       indices(&System_Allocator);
+    make_grid(vertices, indices);
+
+    TArray<u64> before = triangle_keys(slice(indices), slice(vertices));
+
+    Slice<Meshlet> meshlets =
+        alloc_slice<Meshlet>(System_Allocator, meshlet_bound(indices.size));
+
+    u64 meshlet_count = build_meshlets(
+        System_Allocator,
+        meshlets,
+        slice(indices),
+        vertices.data,
+        vertices.size,
+        sizeof(glm::vec3));
+
+    REQUIRE(meshlet_count > 1, "");
+    REQUIRE(meshlet_count <= meshlets.count, "");
+
+    // Meshlets cover the indices back to back, within the limits
+    TArray<u32> unique(&System_Allocator);
+    u32         next_index = 0;
+    bool        in_limits  = true;
+    for (u64 i = 0; i < meshlet_count; ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        REQUIRE(meshlet.first_index == next_index, "");
+        REQUIRE(meshlet.index_count % 3 == 0, "");
+        next_index += meshlet.index_count;
+
+        unique.size = 0;
+        for (u32 j = 0; j < meshlet.index_count; ++j) {
+            unique.add(indices[meshlet.first_index + j]);
+        }
+        std::sort(unique.data, unique.data + unique.size);
+        u64 vertex_count =
+            std::unique(unique.data, unique.data + unique.size) -
+            unique.data;
+
+        if ((vertex_count > Meshlet_Max_Vertices) ||
+            (meshlet.index_count / 3 > Meshlet_Max_Triangles))
+        {
+            in_limits = false;
+        }
+    }
+    REQUIRE(in_limits, "");
+    REQUIRE(next_index == indices.size, "");
+
+    // Every triangle is still there once, with its winding
+    TArray<u64> after = triangle_keys(slice(indices), slice(vertices));
+    REQUIRE(before.size == after.size, "");
+    REQUIRE(
+        memcmp(before.data, after.data, before.size * sizeof(u64)) == 0,
+        "");
+
+    System_Allocator.release((umm)meshlets.ptr);
+    unique.release();
+    before.release();
+    after.release();
+    vertices.release();
+    indices.release();
+    return MPASSED();
+}
+
+TEST_CASE("Core/Meshlets", "Bounds of a flat grid")
+{
+    TArray<glm::vec3> vertices(&System_Allocator);
+    TArray<u32>       indices(&System_Allocator);
+    make_grid(vertices, indices);
+
+    Slice<Meshlet> meshlets =
+        alloc_slice<Meshlet>(System_Allocator, meshlet_bound(indices.size));
+
+    u64 meshlet_count = build_meshlets(
+        System_Allocator,
+        meshlets,
+        slice(indices),
+        vertices.data,
+        vertices.size,
+        sizeof(glm::vec3));
+    meshlets.count = meshlet_count;
+
+    compute_meshlet_bounds(
+        meshlets,
+        slice(indices),
+        vertices.data,
+        sizeof(glm::vec3));
+
+    // Far enough that all meshlets are on the same side of the camera
+    const glm::vec3 middle = glm::vec3(Grid_Size / 2, Grid_Size / 2, 0);
+    const glm::vec3 away   = glm::vec3(0, 0, Grid_Size * 10);
+
+    bool contained = true;
+    bool flat      = true;
+    bool culled    = true;
+    bool visible   = true;
+    for (const Meshlet& meshlet : meshlets) {
+        for (u32 i = 0; i < meshlet.index_count; ++i) {
+            const glm::vec3& p = vertices[indices[meshlet.first_index + i]];
+            if (glm::distance(p, meshlet.center) > meshlet.radius + 0.001f) {
+                contained = false;
+            }
+        }
+
+        // A plane has a single facing, and is only seen from its front
+        if ((glm::abs(meshlet.cone_axis.z - 1.0f) > 0.001f) ||
+            (meshlet.cone_cutoff > 0.001f))
+        {
+            flat = false;
+        }
+
+        if (!is_meshlet_backfacing(meshlet, middle - away)) {
+            culled = false;
+        }
+        if (is_meshlet_backfacing(meshlet, middle + away)) {
+            visible = false;
+        }
+    }
+
+    REQUIRE(contained, "");
+    REQUIRE(flat, "");
+    REQUIRE(culled, "");
+    REQUIRE(visible, "");
+
+    System_Allocator.release((umm)meshlets.ptr);
+    vertices.release();
+    indices.release();
+    return MPASSED();
+}
@@ -0,0 +1,64 @@
+#include "RadixSort.h"
+
+#include <stdlib.h>
+
+#include "Containers/Array.h"
+#include "FileSystem/Extras.h"
+#include "Test/Test.h"
+
+struct KeyedItem {
+    u64 key;
+    u32 order;
+};
+
+TEST_CASE("Core/RadixSort", "Sorts by key and is stable")
+{
+    TArray<KeyedItem> items(&System_Allocator);
+    TArray<KeyedItem> scratch(&System_Allocator);
+
+    srand(1337);
+    for (u32 i = 0; i < 4096; ++i) {
+        // Few distinct keys spread over high and low bits, to get ties
+        u64 key = (u64(rand() % 16) << 48) | u64(rand() % 8);
+        items.add(KeyedItem{.key = key, .order = i});
+    }
+    scratch.init_range(items.size);
+
+    radix_sort(
+        slice(items),
+        slice(scratch),
+        [](const KeyedItem& item) { return item.key; });
+
+    bool sorted = true;
+    bool stable = true;
+    for (u64 i = 1; i < items.size; ++i) {
+        if (items[i - 1].key > items[i].key) sorted = false;
+        if ((items[i - 1].key == items[i].key) &&
+            (items[i - 1].order > items[i].order))
+        {
+            stable = false;
+        }
+    }
+
+    items.release();
+    scratch.release();
+
+    REQUIRE(sorted, "");
+    REQUIRE(stable, "");
+    return MPASSED();
+}
+
+TEST_CASE("Core/RadixSort", "Sorts keys that differ in one digit")
+{
+    auto items   = arr<KeyedItem>(KeyedItem{3, 0}, KeyedItem{1, 1});
+    auto scratch = arr<KeyedItem>(KeyedItem{}, KeyedItem{});
+
+    radix_sort(
+        slice(items),
+        slice(scratch),
+        [](const KeyedItem& item) { return item.key; });
+
+    REQUIRE(items[0].key == 1, "");
+    REQUIRE(items[1].key == 3, "");
+    return MPASSED();
+}
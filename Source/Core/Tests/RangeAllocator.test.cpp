@@ -0,0 +1,40 @@
+#include "RangeAllocator.h"
+
+#include "Test/Test.h"
+
+TEST_CASE("Core/RangeAllocator", "Freed ranges merge and get reused")
+{
+    RangeAllocator ranges;
+    ranges.init(System_Allocator, 100);
+    DEFER(ranges.deinit());
+
+    u64 a = ranges.allocate(10);
+    u64 b = ranges.allocate(20);
+    u64 c = ranges.allocate(30);
+    REQUIRE((a == 0) && (b == 10) && (c == 30), "");
+    REQUIRE(ranges.free_size == 40, "");
+    REQUIRE(ranges.allocate(50) == RangeAllocator::Invalid_Offset, "");
+
+    // A hole in the middle
+    ranges.free(b, 20);
+    REQUIRE(ranges.fragmented_size() == 20, "");
+    REQUIRE(ranges.largest_free() == 40, "");
+
+    // First fit takes the hole
+    u64 d = ranges.allocate(5);
+    REQUIRE(d == 10, "");
+
+    // Freeing both neighbours of a range merges all three
+    ranges.free(a, 10);
+    ranges.free(d, 5);
+    REQUIRE(ranges.free_ranges.size == 2, "");
+    REQUIRE(ranges.largest_free() == 40, "");
+    REQUIRE(ranges.fragmented_size() == 30, "");
+
+    ranges.free(c, 30);
+    REQUIRE(ranges.free_ranges.size == 1, "");
+    REQUIRE(ranges.free_size == 100, "");
+    REQUIRE(ranges.fragmented_size() == 0, "");
+
+    return MPASSED();
+}
@@ -0,0 +1,52 @@
+#include "TaskQueue.h"
+
+#include <atomic>
+
+#include "FileSystem/Extras.h"
+#include "Test/Test.h"
+
+TEST_CASE("Core/TaskQueue", "Runs every task exactly once")
+{
+    TaskQueue tasks;
+    tasks.init(3);
+
+    static constexpr u32    count = 1000;
+    static std::atomic<u32> hits[count];
+    for (std::atomic<u32>& hit : hits) hit.store(0);
+
+    // Half of the rounds queue behind tasks that haven't run yet
+    for (u32 round = 0; round < 20; ++round) {
+        for (std::atomic<u32>& hit : hits) {
+            tasks.queue(
+                [](void* user) { ((std::atomic<u32>*)user)->fetch_add(1); },
+                &hit);
+        }
+
+        if (round % 2) tasks.wait_idle();
+    }
+
+    tasks.deinit();
+
+    bool all_once = true;
+    for (std::atomic<u32>& hit : hits) {
+        if (hit.load() != 20) all_once = false;
+    }
+
+    REQUIRE(all_once, "");
+    return MPASSED();
+}
+
+TEST_CASE("Core/TaskQueue/NoWorkers", "Runs inline without workers")
+{
+    TaskQueue tasks;
+    tasks.init(0);
+
+    u32 value = 0;
+    tasks.queue([](void* user) { *(u32*)user = 42; }, &value);
+    const u32 queued_value = value;
+
+    tasks.deinit();
+
+    REQUIRE(queued_value == 42, "");
+    return MPASSED();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+
+#include "Containers/Array.h"
+#include "Core/MathTypes.h"
+#include "FileSystem/Extras.h"
+
+/** Grid meshes shared by the mesh processing tests */
+
+static constexpr u32 Grid_Size = 32;
+
+/** A flat grid of size * size quads in the XY plane, facing +Z */
+inline void make_grid(
+    TArray<glm::vec3>& vertices, TArray<u32>& indices, u32 size = Grid_Size)
+{
+    for (u32 y = 0; y <= size; ++y) {
+        for (u32 x = 0; x <= size; ++x) {
+            vertices.add(glm::vec3(x, y, 0));
+        }
+    }
+
+    for (u32 y = 0; y < size; ++y) {
+        for (u32 x = 0; x < size; ++x) {
+            u32 corner  = y * (size + 1) + x;
+            u32 quad[6] = {
+                corner,
+                corner + 1,
+                corner + size + 2,
+                corner,
+                corner + size + 2,
+                corner + size + 1,
+            };
+            for (u32 index : quad) indices.add(index);
+        }
+    }
+}
+
+/**
+ * Triangles of a grid as sorted keys of their vertex positions, so they stay
+ * comparable when vertices are deduplicated or reordered. Each key starts at
+ * the smallest vertex, keeping the winding
+ */
+inline TArray<u64> triangle_keys(
+    Slice<u32> indices, Slice<glm::vec3> vertices, u32 size = Grid_Size)
+{
+    TArray<u64> keys(&System_Allocator);
+
+    for (u64 i = 0; i < indices.count; i += 3) {
+        u64 v[3];
+        for (u32 k = 0; k < 3; ++k) {
+            const glm::vec3& vertex = vertices[indices[i + k]];
+            v[k] = u64(vertex.x) * (size + 1) + u64(vertex.y);
+        }
+
+        u32 first = 0;
+        if (v[1] < v[first]) first = 1;
+        if (v[2] < v[first]) first = 2;
+
+        keys.add(
+            (v[first] << 40) | (v[(first + 1) % 3] << 20) |
+            v[(first + 2) % 3]);
+    }
+
+    std::sort(keys.data, keys.data + keys.size);
+    return keys;
+}
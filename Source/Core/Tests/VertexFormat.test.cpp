@@ -0,0 +1,71 @@
+#include "Utility.h"
+
+#include <glm/gtc/packing.hpp>
+#include <stdlib.h>
+
+#include "Test/Test.h"
+
+using namespace core;
+
+static float random_float() { return (float(rand() % 2000) / 1000.f) - 1.f; }
+
+TEST_CASE("Core/VertexFormat/Octahedral", "Normals survive snorm16 packing")
+{
+    srand(1337);
+    for (u32 i = 0; i < 1000; ++i) {
+        glm::vec3 normal = glm::normalize(
+            glm::vec3(random_float(), random_float(), random_float()) +
+            glm::vec3(0.0f, 0.0f, 0.001f));
+
+        glm::i16vec2 packed = glm::packSnorm<i16>(octahedral_encode(normal));
+        glm::vec3    decoded =
+            octahedral_decode(glm::unpackSnorm<f32>(packed));
+
+        REQUIRE(glm::dot(normal, decoded) > 0.9999f, "");
+    }
+
+    return MPASSED();
+}
+
+TEST_CASE("Core/VertexFormat/Pack", "Vertices pack into the compact formats")
+{
+    Vertex_P3fN3fC3fU2f vertices[2] = {
+        {{1.5f, -2.0f, 100.0f}, {0, 1, 0}, {1, 0.5f, 0}, {0.0f, 1.0f}},
+        {{0.0f, 0.25f, -8.0f}, {0, 0, -1}, {0, 0, 1}, {0.5f, 0.25f}},
+    };
+
+    REQUIRE(vertex_size_of(VertexFormat::P4hN2sC4bU2s) == 20, "");
+    REQUIRE(vertex_size_of(VertexFormat::P4hN2sU2s) == 16, "");
+
+    auto source = Slice<Vertex_P3fN3fC3fU2f>(vertices, 2);
+    REQUIRE(vertex_format_fits(VertexFormat::P4hN2sC4bU2s, source), "");
+
+    Vertex_P4hN2sC4bU2s packed[2];
+    pack_vertices(VertexFormat::P4hN2sC4bU2s, source, packed);
+
+    for (u32 i = 0; i < 2; ++i) {
+        glm::vec4 position = glm::unpackHalf(glm::u16vec4(
+            packed[i].position[0],
+            packed[i].position[1],
+            packed[i].position[2],
+            packed[i].position[3]));
+        REQUIRE(glm::vec3(position) == vertices[i].position, "");
+
+        glm::vec2 uv = glm::unpackUnorm<f32>(
+            glm::u16vec2(packed[i].uv[0], packed[i].uv[1]));
+        glm::vec2 uv_error = glm::abs(uv - vertices[i].uv);
+        REQUIRE(glm::all(glm::lessThan(uv_error, glm::vec2(1e-5f))), "");
+
+        REQUIRE(packed[i].color[3] == 255, "");
+    }
+
+    REQUIRE(packed[0].color[0] == 255, "");
+    REQUIRE(packed[1].color[2] == 255, "");
+
+    // UNORM UVs can't tile
+    vertices[1].uv.x = 2.0f;
+    REQUIRE(!vertex_format_fits(VertexFormat::P4hN2sU2s, source), "");
+    REQUIRE(vertex_format_fits(VertexFormat::P3fN3fC3fU2f, source), "");
+
+    return MPASSED();
+}
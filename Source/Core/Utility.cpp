@@ -1,5 +1,6 @@
 #include "Utility.h"
 
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/norm.hpp>
 
 #include "Traits.h"
@@ -39,4 +40,116 @@ namespace core {
         return result;
     }
 
+    u32 vertex_size_of(EVertexFormat format)
+    {
+        switch (format) {
+            case VertexFormat::P3fN3fC3fU2f:
+                return sizeof(Vertex_P3fN3fC3fU2f);
+            case VertexFormat::P4hN2sC4bU2s:
+                return sizeof(Vertex_P4hN2sC4bU2s);
+            case VertexFormat::P4hN2sU2s:
+                return sizeof(Vertex_P4hN2sU2s);
+            default:
+                return 0;
+        }
+    }
+
+    bool vertex_format_fits(
+        EVertexFormat format, const Slice<Vertex_P3fN3fC3fU2f>& vertices)
+    {
+        if (format == VertexFormat::P3fN3fC3fU2f) return true;
+
+        // Largest finite half
+        constexpr f32 Max_Half = 65504.0f;
+
+        for (u64 i = 0; i < vertices.count; ++i) {
+            const Vertex_P3fN3fC3fU2f& v = vertices[i];
+
+            for (int c = 0; c < 3; ++c) {
+                if (glm::abs(v.position[c]) > Max_Half) return false;
+            }
+
+            for (int c = 0; c < 2; ++c) {
+                if ((v.uv[c] < 0.0f) || (v.uv[c] > 1.0f)) return false;
+            }
+        }
+
+        return true;
+    }
+
+    glm::vec2 octahedral_encode(glm::vec3 n)
+    {
+        n /= glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+
+        glm::vec2 result(n.x, n.y);
+        if (n.z < 0.0f) {
+            // Fold the lower half over the diagonals
+            result = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+                     glm::vec2(
+                         n.x >= 0.0f ? 1.0f : -1.0f,
+                         n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        return result;
+    }
+
+    glm::vec3 octahedral_decode(glm::vec2 e)
+    {
+        glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+
+        f32 t = glm::max(-n.z, 0.0f);
+        n.x += (n.x >= 0.0f) ? -t : t;
+        n.y += (n.y >= 0.0f) ? -t : t;
+
+        return glm::normalize(n);
+    }
+
+    template <typename T>
+    static void pack_common(T& dst, const Vertex_P3fN3fC3fU2f& src)
+    {
+        glm::u16vec4 position = glm::packHalf(glm::vec4(src.position, 1.0f));
+        glm::i16vec2 normal =
+            glm::packSnorm<i16>(octahedral_encode(src.normal));
+        glm::u16vec2 uv = glm::packUnorm<u16>(src.uv);
+
+        for (int c = 0; c < 4; ++c) dst.position[c] = position[c];
+        for (int c = 0; c < 2; ++c) dst.normal[c] = normal[c];
+        for (int c = 0; c < 2; ++c) dst.uv[c] = uv[c];
+    }
+
+    void pack_vertices(
+        EVertexFormat                     format,
+        const Slice<Vertex_P3fN3fC3fU2f>& vertices,
+        void*                             dst)
+    {
+        switch (format) {
+            case VertexFormat::P3fN3fC3fU2f: {
+                memcpy(dst, vertices.ptr, vertices.size());
+            } break;
+
+            case VertexFormat::P4hN2sC4bU2s: {
+                Vertex_P4hN2sC4bU2s* out = (Vertex_P4hN2sC4bU2s*)dst;
+                for (u64 i = 0; i < vertices.count; ++i) {
+                    pack_common(out[i], vertices[i]);
+
+                    glm::vec4 color_f = glm::clamp(
+                        glm::vec4(vertices[i].color, 1.0f), 0.0f, 1.0f);
+                    glm::u8vec4 color = glm::packUnorm<u8>(color_f);
+                    for (int c = 0; c < 4; ++c) out[i].color[c] = color[c];
+                }
+            } break;
+
+            case VertexFormat::P4hN2sU2s: {
+                Vertex_P4hN2sU2s* out = (Vertex_P4hN2sU2s*)dst;
+                for (u64 i = 0; i < vertices.count; ++i) {
+                    pack_common(out[i], vertices[i]);
+                }
+            } break;
+
+            default:
+                ASSERT(false);
+                break;
+        }
+    }
+
 }  // namespace core
\ No newline at end of file
@@ -22,10 +22,37 @@ namespace core {
              * float uv[2];
              */
             P3fN3fC3fU2f = 1,
+            /**
+             * half    position[4]; (w unused)
+             * snorm16 normal[2];   (octahedral)
+             * unorm8  color[4];
+             * unorm16 uv[2];
+             */
+            P4hN2sC4bU2s = 2,
+            /** P4hN2sC4bU2s without the color */
+            P4hN2sU2s    = 3,
+            Count,
         };
     }
     typedef VertexFormat::Type EVertexFormat;
 
+    namespace IndexFormat {
+        enum Type : u32
+        {
+            /** Zero, so that meshes written before u16 indices read as u32 */
+            U32 = 0,
+            /** Only for meshes with fewer than 65536 vertices */
+            U16 = 1,
+        };
+    }
+    typedef IndexFormat::Type EIndexFormat;
+
+    /** Size of an index in format, in bytes */
+    _inline u32 index_size_of(EIndexFormat format)
+    {
+        return (format == IndexFormat::U16) ? sizeof(u16) : sizeof(u32);
+    }
+
     struct Vertex_P3fN3fC3fU2f {
         glm::vec3 position;
         glm::vec3 normal;
@@ -33,6 +60,43 @@ namespace core {
         glm::vec2 uv;
     };
 
+    struct Vertex_P4hN2sC4bU2s {
+        u16 position[4];
+        i16 normal[2];
+        u8  color[4];
+        u16 uv[2];
+    };
+
+    struct Vertex_P4hN2sU2s {
+        u16 position[4];
+        i16 normal[2];
+        u16 uv[2];
+    };
+
+    /** Size of a vertex in format, in bytes */
+    u32 vertex_size_of(EVertexFormat format);
+
+    /**
+     * Whether vertices can be packed into format without losing more than
+     * its precision. UNORM UVs have to be in [0, 1], and half positions
+     * within the range of half floats
+     */
+    bool vertex_format_fits(
+        EVertexFormat format, const Slice<Vertex_P3fN3fC3fU2f>& vertices);
+
+    /**
+     * Packs vertices into format
+     * @param dst At least vertices.count * vertex_size_of(format) bytes
+     */
+    void pack_vertices(
+        EVertexFormat                     format,
+        const Slice<Vertex_P3fN3fC3fU2f>& vertices,
+        void*                             dst);
+
+    /** Maps a unit vector onto the octahedron, unfolded into [-1, 1]^2 */
+    glm::vec2 octahedral_encode(glm::vec3 n);
+    glm::vec3 octahedral_decode(glm::vec2 e);
+
     template <typename T>
     _inline void pack_vertex(
         T&    v,
@@ -77,10 +141,25 @@ namespace core {
 PROC_FMT_ENUM(core::VertexFormat, {
     FMT_ENUM_CASE(core::VertexFormat, Unknown);
     FMT_ENUM_CASE(core::VertexFormat, P3fN3fC3fU2f);
+    FMT_ENUM_CASE(core::VertexFormat, P4hN2sC4bU2s);
+    FMT_ENUM_CASE(core::VertexFormat, P4hN2sU2s);
     FMT_ENUM_DEFAULT_CASE(Unknown);
 })
 
 PROC_PARSE_ENUM(core::VertexFormat, {
     PARSE_ENUM_CASE(core::VertexFormat, Unknown);
     PARSE_ENUM_CASE(core::VertexFormat, P3fN3fC3fU2f);
+    PARSE_ENUM_CASE(core::VertexFormat, P4hN2sC4bU2s);
+    PARSE_ENUM_CASE(core::VertexFormat, P4hN2sU2s);
+})
+
+PROC_FMT_ENUM(core::IndexFormat, {
+    FMT_ENUM_CASE(core::IndexFormat, U32);
+    FMT_ENUM_CASE(core::IndexFormat, U16);
+    FMT_ENUM_DEFAULT_CASE(U32);
+})
+
+PROC_PARSE_ENUM(core::IndexFormat, {
+    PARSE_ENUM_CASE(core::IndexFormat, U32);
+    PARSE_ENUM_CASE(core::IndexFormat, U16);
 })
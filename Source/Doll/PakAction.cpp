@@ -0,0 +1,125 @@
+/**
+ * Packs the assets of a module directory into a pak, for shipping builds
+ *
+ * Assets are packed with the ids the engine registered them with, which are
+ * kept in the registry index of the directory (Assets/.registry by default).
+ * The engine has to have run at least once since an asset was added, or the
+ * asset has no id yet and is left out.
+ *
+ * With -g 1, the assets of every top level subdirectory (e.g. a level) form a
+ * group, and are stored next to each other in the pak.
+ */
+#include "Arg.h"
+#include "AssetLibrary/AssetPak.h"
+#include "AssetLibrary/AssetRegistry.h"
+#include "Doll.h"
+
+/** The top level directory of a registry path, empty for the root */
+static Str top_directory(Str path)
+{
+    for (u64 i = 1; i < path.len; ++i) {
+        if (path.data[i] == '/') return Str(path.data + 1, i - 1);
+    }
+    return LIT("");
+}
+
+static int doll_pak(Slice<Str> args)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(16));
+
+    ArgCollection arguments;
+    arguments.register_arg<Str>(
+        LIT("d"),
+        LIT(""),
+        LIT("[REQUIRED] The asset directory of the module"));
+    arguments.register_arg<Str>(
+        LIT("m"),
+        LIT("Engine"),
+        LIT("The name of the module"));
+    arguments.register_arg<Str>(
+        LIT("r"),
+        LIT(""),
+        LIT("The registry index (defaults to .registry in the directory)"));
+    arguments.register_arg<Str>(
+        LIT("o"),
+        LIT("Assets.pak"),
+        LIT("The pak to write"));
+    arguments.register_arg<i32>(
+        LIT("g"),
+        0,
+        LIT("Group assets by top level directory (1) or not (0)"));
+
+    if (!arguments.parse_args(args)) {
+        print(LIT("Invalid argument format. Printing summary...\n"));
+        arguments.summary();
+        return -1;
+    }
+
+    Str directory     = *arguments.get_arg<Str>(LIT("d"));
+    Str module        = *arguments.get_arg<Str>(LIT("m"));
+    Str registry_path = *arguments.get_arg<Str>(LIT("r"));
+    Str out_path      = *arguments.get_arg<Str>(LIT("o"));
+    i32 group_by_dir  = *arguments.get_arg<i32>(LIT("g"));
+
+    if (directory.len == 0) {
+        print(LIT("Argument '-d' must be specified.\n"));
+        arguments.summary();
+        return -1;
+    }
+
+    if (registry_path.len == 0) {
+        registry_path = format(temp, LIT("{}/.registry"), directory);
+    }
+
+    AssetRegistry index;
+    index.init(System_Allocator);
+    DEFER(index.deinit());
+
+    if (!index.load(registry_path)) {
+        print(
+            LIT("No asset registry at {}, run the engine once to register "
+                "the assets.\n"),
+            registry_path);
+        return -1;
+    }
+
+    // Files added since the engine last ran come up without an id
+    AssetRegistryRoot root = {.module = module, .directory = directory};
+    index.refresh(slice(&root, 1), true);
+
+    AssetPakBuilder builder;
+    builder.init(System_Allocator);
+    DEFER(builder.deinit());
+
+    u32 packed = 0, skipped = 0;
+    for (const AssetRegistryEntry& entry : index.entries) {
+        if (entry.module != module) continue;
+
+        if ((entry.id[0] == 0) && (entry.id[1] == 0)) {
+            print(LIT("[skipped] {}: not registered yet\n"), entry.path);
+            skipped++;
+            continue;
+        }
+
+        SAVE_ARENA(temp);
+        Str file_path = format(temp, LIT("{}{}"), directory, entry.path);
+        Str group     = group_by_dir ? top_directory(entry.path) : LIT("");
+
+        builder.add(entry.id, entry.module, entry.path, file_path, group);
+        packed++;
+    }
+
+    if (!builder.write(out_path)) {
+        print(LIT("Failed to write {}\n"), out_path);
+        return -1;
+    }
+
+    print(
+        LIT("Packed {} assets into {}, {} skipped\n"),
+        packed,
+        out_path,
+        skipped);
+    return 0;
+}
+
+DOLL_DECLARE_ACTION("pak", doll_pak);
@@ -83,14 +83,22 @@ void InspectorEditorWindow::draw()
 
             glm::vec3 euler = glm::degrees(glm::eulerAngles(t->rotation));
 
-            ImGui::DragFloat3("Position", t->position.ptr(), 0.01f);
-            ImGui::DragFloat3("Rotation", glm::value_ptr(euler), 0.01f);
-            ImGui::DragFloat3("Scale", t->scale.ptr(), 0.01f);
-
-            t->rotation =
-                glm::angleAxis(glm::radians(euler.z), glm::vec3(0, 0, 1)) *
-                glm::angleAxis(glm::radians(euler.y), glm::vec3(0, 1, 0)) *
-                glm::angleAxis(glm::radians(euler.x), glm::vec3(1, 0, 0));
+            bool changed = false;
+            changed |= ImGui::DragFloat3("Position", t->position.ptr(), 0.01f);
+            bool rotated =
+                ImGui::DragFloat3("Rotation", glm::value_ptr(euler), 0.01f);
+            changed |= ImGui::DragFloat3("Scale", t->scale.ptr(), 0.01f);
+
+            if (rotated) {
+                t->rotation =
+                    glm::angleAxis(glm::radians(euler.z), glm::vec3(0, 0, 1)) *
+                    glm::angleAxis(glm::radians(euler.y), glm::vec3(0, 1, 0)) *
+                    glm::angleAxis(glm::radians(euler.x), glm::vec3(1, 0, 0));
+            }
+
+            if (changed || rotated) {
+                entity.modified<TransformComponent>();
+            }
 
             ImGui::Text(
                 "%f %f %f",
@@ -1,4 +1,7 @@
+#include <chrono>
+
 #include "Arg.h"
+#include "AssetLibrary/AssetConverter.h"
 #include "Builtin/Builtin.h"
 #include "ECS.h"
 #include "Editor.h"
@@ -80,6 +83,7 @@ static int run(void)
     G.engine.hooks.pre_draw.add_static(on_engine_pre_draw);
 
     // Initialize engine & editor
+    G.engine.hot_reload = true;
     G.engine.init();
     The_Editor.init(G.engine.window, G.engine.renderer, G.engine.ecs);
 
@@ -94,13 +98,51 @@ static int run(void)
     return 0;
 }
 
+/**
+ * Converts a single file (-i, -o), or every supported file in a directory
+ * (-d) or listed in a manifest (-m) into the directory -o. Batches run across
+ * -j workers, and skip the sources that didn't change since the last run,
+ * according to the cache file in the output directory. Sources that did change
+ * are looked up in the derived data cache -ddc first, which is trimmed to
+ * -ddc-mb megabytes afterwards. Meshes are repacked to the vertex format -vf,
+ * if they fit it. Textures get mip chains, and are encoded to BC1/BC3 with
+ * -bc 1.
+ */
 static int convert(Slice<Str> args)
 {
     CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(5));
 
     ArgCollection arguments;
     arguments.register_arg<Str>(LIT("i"), LIT(""), LIT("Input file "));
-    arguments.register_arg<Str>(LIT("o"), LIT(""), LIT("Output asset path"));
+    arguments.register_arg<Str>(LIT("d"), LIT(""), LIT("Input directory"));
+    arguments.register_arg<Str>(
+        LIT("m"),
+        LIT(""),
+        LIT("Manifest file, one input file per line"));
+    arguments.register_arg<Str>(
+        LIT("o"),
+        LIT(""),
+        LIT("Output asset path, or directory for batches"));
+    arguments.register_arg<i32>(
+        LIT("j"),
+        -1,
+        LIT("Worker threads for batches (-1 for one per core)"));
+    arguments.register_arg<Str>(
+        LIT("vf"),
+        LIT("P3fN3fC3fU2f"),
+        LIT("Vertex format of meshes (P3fN3fC3fU2f, P4hN2sC4bU2s, P4hN2sU2s)"));
+    arguments.register_arg<i32>(
+        LIT("bc"),
+        0,
+        LIT("Encode textures to BC1/BC3 (1) or keep them RGBA8 (0)"));
+    arguments.register_arg<Str>(
+        LIT("ddc"),
+        LIT("DerivedData"),
+        LIT("Derived data cache directory (empty to disable)"));
+    arguments.register_arg<i32>(
+        LIT("ddc-mb"),
+        2048,
+        LIT("Size the derived data cache is trimmed to, in megabytes"));
 
     if (!arguments.parse_args(args)) {
         print(LIT("Invalid arguments, exiting.\n"));
@@ -108,19 +150,128 @@ static int convert(Slice<Str> args)
         return -1;
     }
 
-    Str  in_path  = *arguments.get_arg<Str>(LIT("i"));
-    Str  out_path = *arguments.get_arg<Str>(LIT("o"));
-    auto out_tape = BufferedWriteTape<true>(open_file_write(out_path));
+    Str in_path       = *arguments.get_arg<Str>(LIT("i"));
+    Str in_directory  = *arguments.get_arg<Str>(LIT("d"));
+    Str manifest_path = *arguments.get_arg<Str>(LIT("m"));
+    Str out_path      = *arguments.get_arg<Str>(LIT("o"));
+    i32 num_workers   = *arguments.get_arg<i32>(LIT("j"));
+    Str format_name   = *arguments.get_arg<Str>(LIT("vf"));
+    i32 compress_bc   = *arguments.get_arg<i32>(LIT("bc"));
+    Str ddc_directory = *arguments.get_arg<Str>(LIT("ddc"));
+    i32 ddc_megabytes = *arguments.get_arg<i32>(LIT("ddc-mb"));
+
+    EVertexFormat vertex_format = VertexFormat::Unknown;
+    for (u32 i = 1; i < VertexFormat::Count; ++i) {
+        SAVE_ARENA(temp);
+        if (format(temp, LIT("{}"), EVertexFormat(i)) == format_name) {
+            vertex_format = EVertexFormat(i);
+        }
+    }
+
+    if (vertex_format == VertexFormat::Unknown) {
+        print(LIT("Unknown vertex format {}, exiting.\n"), format_name);
+        return -1;
+    }
+
+#if ASSET_LZ4_HC
+    EAssetCompressionLevel level = AssetCompressionLevel::High;
+#else
+    EAssetCompressionLevel level = AssetCompressionLevel::Default;
+#endif
 
     ImporterRegistry registry(temp);
     registry.init_default_importers();
-    Asset asset = registry.import_asset_from_file(in_path, temp).unwrap();
-    if (!asset.write(temp, &out_tape)) {
-        print(LIT("Failed to convert import {}\n"), in_path);
+
+    AssetConverter converter;
+    converter.init(&registry, level, vertex_format, compress_bc != 0);
+    DEFER(converter.deinit());
+
+    // A single file goes through the same steps as batches, but its output
+    // is a file, with no directory for the build cache
+    const bool single_file = in_path.len > 0;
+    if (single_file) {
+        converter.add(in_path, out_path);
+    } else if (in_directory.len > 0) {
+        converter.add_directory(in_directory, out_path);
+    } else if (manifest_path.len > 0) {
+        if (!converter.add_manifest(manifest_path, out_path)) {
+            print(LIT("Failed to read manifest {}\n"), manifest_path);
+            return -1;
+        }
+    } else {
+        print(LIT("Nothing to convert, exiting.\n"));
+        arguments.summary();
         return -1;
     }
 
-    return 0;
+    Str cache_path = format(temp, LIT("{}/.convert-cache"), out_path);
+    if (!single_file) converter.load_cache(cache_path);
+
+    DerivedDataCache derived_data;
+    derived_data.max_size = u64(ddc_megabytes) * MEGABYTES(1);
+    if (ddc_directory.len > 0) {
+        if (derived_data.init(ddc_directory)) {
+            converter.derived_data = &derived_data;
+        } else {
+            print(LIT("Failed to open cache {}, ignoring\n"), ddc_directory);
+        }
+    }
+
+    JobSystem jobs;
+    jobs.init(
+        (num_workers < 0) ? JobSystem::default_worker_count()
+                          : (u32)num_workers);
+
+    auto start = std::chrono::steady_clock::now();
+    converter.run(jobs);
+    u64 total_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    jobs.deinit();
+
+    u32 converted = 0, skipped = 0, cached = 0, failed = 0;
+    for (const AssetConverter::Entry& entry : converter.entries) {
+        if (entry.failed) {
+            failed++;
+            print(LIT("[failed] {} ({})\n"), entry.input, entry.error);
+        } else if (entry.skipped) {
+            skipped++;
+        } else if (entry.cached) {
+            cached++;
+        } else {
+            converted++;
+            print(
+                LIT("{} us\t{} -> {}\n"),
+                entry.microseconds,
+                entry.input,
+                entry.output);
+        }
+    }
+
+    print(
+        LIT("Converted {}, {} from cache, skipped {} unchanged, {} failed in "
+            "{} ms\n"),
+        converted,
+        cached,
+        skipped,
+        failed,
+        total_ms);
+
+    if (converter.derived_data) {
+        u64 trimmed = derived_data.trim();
+        print(
+            LIT("Derived data cache: {} hits, {} misses, {} stored, {} "
+                "trimmed\n"),
+            derived_data.stats.hits.load(),
+            derived_data.stats.misses.load(),
+            derived_data.stats.stores.load(),
+            trimmed);
+        derived_data.deinit();
+    }
+
+    if (!single_file) converter.save_cache(cache_path);
+    return (failed > 0) ? -1 : 0;
 }
 
 static void populate_demo_scene()
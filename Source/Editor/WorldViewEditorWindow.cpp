@@ -221,6 +221,7 @@ void WorldViewEditorWindow::init()
 
             sync->position = get_world_position(*transform);
             sync->rotation = get_world_rotation(*transform);
+            gizmo_entity.modified<TransformComponent>();
         });
 
     editor_world()
@@ -242,6 +243,7 @@ void WorldViewEditorWindow::init()
             if (data.dragging) {
                 TransformComponent* et = e.get_mut<TransformComponent>();
                 set_world_position(*et, Vec3(transform.world_position));
+                e.modified<TransformComponent>();
             } else {
                 const TransformComponent* et = e.get<TransformComponent>();
                 if (!et) return;
@@ -1,56 +1,160 @@
 #include "AssetSystem.h"
 
+#include "AssetLibrary/AssetConverter.h"
+#include "Core/FileStat.h"
+#include "Core/JobSystem.h"
+#include "Core/RadixSort.h"
 #include "Engine.h"
-#include "FileSystem/DirectoryIterator.h"
+#include "tracy/Tracy.hpp"
+
+/**
+ * A load in flight. The loader thread or the reader owns it until its state
+ * is final
+ */
+struct AssetLoad {
+    Str                          path;
+    /** The asset file in the pak, if it's in one */
+    Slice<u8>                    packed;
+    /** The read of the loose file, if it isn't in the pak */
+    AsyncRead                    read;
+    std::atomic<EAssetLoadState> state;
+    Asset                        value;
+    FileMapping                  mapping;
+};
 
 void AssetSystem::init(Allocator& allocator)
 {
+    this->allocator = &allocator;
     sfl_uuid_init(&uuid_context);
     registry.ids_to_references.init(allocator);
     registry.references_to_ids.init(allocator);
     asset_states.init(allocator);
+    pending_loads.alloc       = &allocator;
+    eviction_candidates.alloc = &allocator;
+    eviction_scratch.alloc    = &allocator;
+    roots.alloc               = &allocator;
+    source_roots.alloc        = &allocator;
+    changed_assets.alloc      = &allocator;
+    index.init(allocator);
+    loaders.init(loader_threads);
+    reader.init(
+        System_Allocator,
+        AsyncReadBackend::IoUring,
+        64,
+        loader_threads);
+
+    if (hot_reload) {
+        watcher.init(allocator);
+        reimporter.init(1);
+        importers.init_default_importers();
+
+        if (derived_data_path.len > 0) {
+            has_derived_data = derived_data.init(derived_data_path);
+        }
+    }
+
+    add_module_root(LIT("Engine"), LIT("Assets"));
+    if (pak_path.len > 0) pak.open(pak_path);
     refresh_registry();
 }
 
-void AssetSystem::refresh_registry()
+void AssetSystem::add_module_root(Str module, Str directory)
 {
-    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(2));
+    roots.add(AssetRegistryRoot{
+        .module    = module.clone(*allocator),
+        .directory = directory.clone(*allocator),
+    });
 
-    Str current_directory = get_cwd(temp);
+    if (hot_reload) watcher.add_directory(directory);
+}
 
-    Str asset_directory =
-        format(temp, LIT("{}/Assets"), FmtPath(current_directory));
+void AssetSystem::add_source_root(Str source_directory, Str asset_directory)
+{
+    if (!hot_reload) return;
 
-    print(LIT("[Asset System]: On directory: {}\n"), asset_directory);
+    source_roots.add(SourceRoot{
+        .source_directory = source_directory.clone(*allocator),
+        .asset_directory  = asset_directory.clone(*allocator),
+    });
 
-    DirectoryIterator iterator = open_dir(asset_directory);
+    watcher.add_directory(source_directory);
+}
 
-    FileData it_data;
-    while (iterator.next_file(&it_data)) {
-        if (it_data.filename == LIT(".")) continue;
-        if (it_data.filename == LIT("..")) continue;
-        if (it_data.attributes == FileAttributes::File) {
-            Str asset_ns = LIT("Engine").clone(System_Allocator);
-            Str asset_path =
-                format(System_Allocator, LIT("/{}"), it_data.filename);
+void AssetSystem::refresh_registry(bool check_files)
+{
+    ZoneScoped;
+
+    // The references point into the index, which reloading replaces
+    registry.ids_to_references.release();
+    registry.references_to_ids.release();
+    registry.ids_to_references.init(*allocator);
+    registry.references_to_ids.init(*allocator);
+
+    // The pak doesn't change, and its references point into it
+    if (pak.is_open()) {
+        for (u32 i = 0; i < pak.entry_count(); ++i) {
+            AssetPakEntry entry = pak.entry(i);
+
+            AssetID asset_id;
+            asset_id.id.qwords[0] = entry.id[0];
+            asset_id.id.qwords[1] = entry.id[1];
 
             AssetReference reference = {
-                .module = asset_ns,
-                .path   = asset_path,
+                .module = entry.module,
+                .path   = entry.path,
             };
 
-            AssetID asset_id = AssetID::create(uuid_context);
-
             registry.ids_to_references.add(asset_id, reference);
             registry.references_to_ids.add(reference, asset_id);
-
-            print(
-                LIT("[Asset System]: Discovered asset: @{} {} ({})\n"),
-                reference.module,
-                reference.path,
-                asset_id);
         }
+
+        print(
+            LIT("[Asset System]: {} assets registered from {}\n"),
+            pak.entry_count(),
+            pak_path);
+        return;
     }
+
+    if (!index.load(registry_path)) {
+        print(LIT("[Asset System]: No asset registry at {}\n"), registry_path);
+    }
+
+    u32 changes = index.refresh(slice(roots.data, roots.size), check_files);
+
+    // Ids are minted once, and kept in the index from then on
+    for (AssetRegistryEntry& entry : index.entries) {
+        if ((entry.id[0] != 0) || (entry.id[1] != 0)) continue;
+
+        AssetID asset_id = AssetID::create(uuid_context);
+        entry.id[0]      = asset_id.id.qwords[0];
+        entry.id[1]      = asset_id.id.qwords[1];
+        changes++;
+    }
+
+    if ((changes > 0) && !index.save(registry_path)) {
+        print(
+            LIT("[Asset System]: Failed to write asset registry to {}\n"),
+            registry_path);
+    }
+
+    for (const AssetRegistryEntry& entry : index.entries) {
+        AssetID asset_id;
+        asset_id.id.qwords[0] = entry.id[0];
+        asset_id.id.qwords[1] = entry.id[1];
+
+        AssetReference reference = {
+            .module = entry.module,
+            .path   = entry.path,
+        };
+
+        registry.ids_to_references.add(asset_id, reference);
+        registry.references_to_ids.add(reference, asset_id);
+    }
+
+    print(
+        LIT("[Asset System]: {} assets registered, {} changed\n"),
+        index.entries.size,
+        changes);
 }
 
 AssetID AssetSystem::resolve_reference(const AssetReference& reference)
@@ -62,44 +166,654 @@ AssetID AssetSystem::resolve_reference(const AssetReference& reference)
     return AssetID::invalid();
 }
 
+/**
+ * Maps the asset file at path, or reads it from packed if it's in the pak,
+ * and unpacks its blob unless it can be used in place. Safe to call from any
+ * thread
+ */
+static bool load_asset_file(
+    Str path, Slice<u8> packed, Asset& value, FileMapping& mapping)
+{
+    auto map_result = (packed.count > 0)
+                          ? Asset::map_memory(System_Allocator, packed)
+                          : Asset::map(System_Allocator, path);
+    if (!map_result.ok()) {
+        print(LIT("Failed to load asset '{}': {}\n"), path, map_result.err());
+        return false;
+    }
+
+    MappedAsset mapped = map_result.value();
+    value              = {.info = mapped.info};
+
+    if (mapped.is_zero_copy()) {
+        value.blob = mapped.blob();
+        mapping    = mapped.mapping;
+        return true;
+    }
+
+    Slice<u8> blob = alloc_slice<u8>(System_Allocator, mapped.info.actual_size);
+
+    auto unpack_result = mapped.unpack(blob);
+    mapped.release();
+
+    if (!unpack_result.ok()) {
+        print(
+            LIT("Failed to unpack asset '{}': {}\n"),
+            path,
+            unpack_result.err());
+        System_Allocator.release(blob.ptr);
+        return false;
+    }
+
+    value.blob             = blob;
+    value.info.compression = AssetCompression::None;
+    return true;
+}
+
+static void run_asset_load(void* user)
+{
+    AssetLoad* load = (AssetLoad*)user;
+    load->state.store(AssetLoadState::Loading);
+
+    bool loaded = load_asset_file(
+        load->path,
+        load->packed,
+        load->value,
+        load->mapping);
+
+    load->state.store(loaded ? AssetLoadState::Ready : AssetLoadState::Failed);
+    load->state.notify_all();
+}
+
+/**
+ * Unpacks the asset file read whole into file, taking ownership of it. The
+ * blob of an uncompressed asset is moved to the start of the buffer and used
+ * in place
+ */
+static bool load_read_asset_file(Str path, Slice<u8> file, Asset& value)
+{
+    auto map_result = Asset::map_memory(System_Allocator, file);
+    if (!map_result.ok()) {
+        print(LIT("Failed to load asset '{}': {}\n"), path, map_result.err());
+        System_Allocator.release(file.ptr);
+        return false;
+    }
+
+    MappedAsset mapped = map_result.value();
+    value              = {.info = mapped.info};
+
+    if (mapped.is_zero_copy()) {
+        Slice<u8> blob = mapped.blob();
+        memmove(file.ptr, blob.ptr, blob.count);
+        value.blob = slice(file.ptr, blob.count);
+        return true;
+    }
+
+    Slice<u8> blob = alloc_slice<u8>(System_Allocator, mapped.info.actual_size);
+
+    auto unpack_result = mapped.unpack(blob);
+    System_Allocator.release(file.ptr);
+
+    if (!unpack_result.ok()) {
+        print(
+            LIT("Failed to unpack asset '{}': {}\n"),
+            path,
+            unpack_result.err());
+        System_Allocator.release(blob.ptr);
+        return false;
+    }
+
+    value.blob             = blob;
+    value.info.compression = AssetCompression::None;
+    return true;
+}
+
+/** Completes the read of a loose asset file, on one of the reader's workers */
+static void finish_asset_read(AsyncRead& read)
+{
+    AssetLoad* load = (AssetLoad*)read.user;
+
+    bool loaded = false;
+    if (read.ok) {
+        loaded = load_read_asset_file(load->path, read.buffer, load->value);
+    } else {
+        print(LIT("Failed to read asset '{}'\n"), load->path);
+    }
+
+    load->state.store(loaded ? AssetLoadState::Ready : AssetLoadState::Failed);
+    load->state.notify_all();
+}
+
+AssetState& AssetSystem::get_state(const AssetID& id)
+{
+    if (!asset_states.contains(id)) {
+        AssetState state = {
+            .state = AssetLoadState::Unloaded,
+            .id    = id,
+        };
+        asset_states.add(id, state);
+    }
+
+    return asset_states[id];
+}
+
 Asset* AssetSystem::load_asset_now(const AssetID& id)
 {
     CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
 
-    if (!asset_states.contains(id)) {
+    AssetState& state = get_state(id);
+    state.last_used   = update_count;
+
+    if (state.state == AssetLoadState::Unloaded) {
+        stats.misses++;
+
         const AssetReference& reference = registry.ids_to_references[id];
 
         Str path = convert_reference_to_path(temp, reference);
 
-        auto asset_load_result = Asset::load(System_Allocator, path);
-        if (!asset_load_result.ok()) {
-            print(
-                LIT("Failed to load asset '{}': {}\n"),
+        if (!load_asset_file(
                 path,
-                asset_load_result.err());
+                packed_file_of(id),
+                state.value,
+                state.mapping))
+        {
             return nullptr;
         }
 
-        AssetState state = {
-            .is_loaded = true,
-            .id        = id,
-            .value     = asset_load_result.value(),
-        };
+        state.state = AssetLoadState::Ready;
+        stats.resident_bytes += state.value.blob.count;
+    } else {
+        stats.hits++;
+    }
 
-        asset_states.add(id, state);
+    // Waits for the loader thread, rather than loading the asset twice
+    if (state.load != nullptr) {
+        EAssetLoadState load_state = state.load->state.load();
+        while (load_state < AssetLoadState::Ready) {
+            state.load->state.wait(load_state);
+            load_state = state.load->state.load();
+        }
+
+        complete_load(state);
+    }
+
+    if (state.state != AssetLoadState::Ready) return nullptr;
+    return &state.value;
+}
+
+AssetLoadHandle AssetSystem::load_asset_async(const AssetID& id)
+{
+    AssetState& state = get_state(id);
+    state.last_used   = update_count;
+
+    if (state.state != AssetLoadState::Unloaded) {
+        stats.hits++;
+        return AssetLoadHandle{id};
+    }
+
+    stats.misses++;
+
+    if (!registry.ids_to_references.contains(id)) {
+        state.state = AssetLoadState::Failed;
+        return AssetLoadHandle{id};
+    }
+
+    const AssetReference& reference = registry.ids_to_references[id];
+
+    AssetLoad* load = new AssetLoad();
+    load->path      = convert_reference_to_path(System_Allocator, reference);
+    load->packed    = packed_file_of(id);
+    load->state.store(AssetLoadState::Queued);
+
+    state.state = AssetLoadState::Queued;
+    state.load  = load;
+    pending_loads.add(id);
+
+    // Pak entries are already in memory, loose files are read in batches
+    if (load->packed.count > 0) {
+        loaders.queue(run_asset_load, load);
+        return AssetLoadHandle{id};
     }
 
+    load->read.path        = load->path;
+    load->read.on_complete = finish_asset_read;
+    load->read.user        = load;
+    load->state.store(AssetLoadState::Loading);
+
+    reader.submit(slice(&load->read, 1));
+    return AssetLoadHandle{id};
+}
+
+EAssetLoadState AssetSystem::get_load_state(const AssetID& id)
+{
+    if (!asset_states.contains(id)) return AssetLoadState::Unloaded;
+
+    const AssetState& state = asset_states[id];
+    if (state.load == nullptr) return state.state;
+
+    // Finished loads only count once update publishes them
+    return (state.load->state.load() == AssetLoadState::Queued)
+               ? AssetLoadState::Queued
+               : AssetLoadState::Loading;
+}
+
+Asset* AssetSystem::get_loaded(const AssetID& id)
+{
+    if (get_load_state(id) != AssetLoadState::Ready) return nullptr;
+
     AssetState& state = asset_states[id];
+    state.last_used   = update_count;
     return &state.value;
 }
 
+void AssetSystem::retain(const AssetID& id) { get_state(id).ref_count++; }
+
+void AssetSystem::release(const AssetID& id)
+{
+    AssetState& state = get_state(id);
+    if (state.ref_count > 0) state.ref_count--;
+}
+
+void AssetSystem::unload(const AssetID& id)
+{
+    if (!asset_states.contains(id)) return;
+
+    AssetState& state = asset_states[id];
+    if ((state.state != AssetLoadState::Ready) || (state.ref_count > 0)) {
+        return;
+    }
+
+    drop_data(state);
+}
+
+void AssetSystem::update()
+{
+    u64 i = 0;
+    while (i < pending_loads.size) {
+        AssetState& state = asset_states[pending_loads[i]];
+
+        if (state.load != nullptr) {
+            if (state.load->state.load() < AssetLoadState::Ready) {
+                i++;
+                continue;
+            }
+
+            complete_load(state);
+        }
+
+        pending_loads[i] = *pending_loads.last();
+        pending_loads.pop();
+    }
+
+    if (hot_reload) poll_changes();
+
+    if (stats.resident_bytes > budget) evict();
+
+    TracyPlot("Asset resident bytes", i64(stats.resident_bytes));
+    TracyPlot("Asset evictions", i64(stats.evictions));
+
+    update_count++;
+}
+
+void AssetSystem::evict()
+{
+    ZoneScopedN("AssetSystem.evict");
+
+    // Assets used during this update stay, since whoever asked for them may
+    // not be done with them yet
+    eviction_candidates.size = 0;
+    for (auto pair : asset_states) {
+        AssetState& state = asset_states[pair.key];
+        if (state.state != AssetLoadState::Ready) continue;
+        if (state.ref_count > 0) continue;
+        if (state.last_used == update_count) continue;
+
+        eviction_candidates.add(&state);
+    }
+
+    while (eviction_scratch.size < eviction_candidates.size) {
+        eviction_scratch.add(nullptr);
+    }
+
+    radix_sort(
+        slice(eviction_candidates),
+        slice(eviction_scratch),
+        [](AssetState* state) { return state->last_used; });
+
+    // Least recently used first
+    for (AssetState* state : eviction_candidates) {
+        if (stats.resident_bytes <= budget) break;
+
+        drop_data(*state);
+        stats.evictions++;
+    }
+}
+
+void AssetSystem::complete_load(AssetState& state)
+{
+    AssetLoad* load = state.load;
+
+    state.state = load->state.load();
+    if (state.state == AssetLoadState::Ready) {
+        state.value     = load->value;
+        state.mapping   = load->mapping;
+        state.last_used = update_count;
+        stats.resident_bytes += state.value.blob.count;
+    }
+
+    System_Allocator.release((umm)load->path.data);
+    delete load;
+    state.load = nullptr;
+}
+
+void AssetSystem::drop_data(AssetState& state)
+{
+    // Uncompressed assets point into their mapping or the pak, the rest own
+    // their blob
+    if (state.mapping.is_open()) {
+        state.mapping.close();
+    } else if (
+        (state.value.blob.ptr != nullptr) &&
+        !pak.contains(state.value.blob.ptr))
+    {
+        System_Allocator.release(state.value.blob.ptr);
+    }
+
+    stats.resident_bytes -= state.value.blob.count;
+
+    state.value   = {};
+    state.mapping = {};
+    state.state   = AssetLoadState::Unloaded;
+}
+
+Slice<u8> AssetSystem::packed_file_of(const AssetID& id)
+{
+    if (!pak.is_open()) return {};
+
+    i64 index = pak.find(id.id.qwords[0], id.id.qwords[1]);
+    if (index < 0) return {};
+
+    return pak.entry(u32(index)).data;
+}
+
+bool AssetSystem::prefetch_group(Str group)
+{
+    return pak.is_open() && pak.prefetch_group(group);
+}
+
 Str AssetSystem::convert_reference_to_path(
     Allocator& allocator, const AssetReference& reference)
 {
-    return format(allocator, LIT("Assets{}\0"), reference.path);
+    const AssetRegistryRoot* root = root_of(reference.module);
+
+    Str directory = root ? root->directory : LIT("Assets");
+    return format(allocator, LIT("{}{}\0"), directory, reference.path);
+}
+
+const AssetRegistryRoot* AssetSystem::root_of(Str module)
+{
+    for (const AssetRegistryRoot& root : roots) {
+        if (root.module == module) return &root;
+    }
+    return nullptr;
+}
+
+/** Whether path is somewhere under directory */
+static bool is_under(Str path, Str directory)
+{
+    return (path.len > directory.len) && (path.data[directory.len] == '/') &&
+           (Str(path.data, directory.len) == directory);
+}
+
+Result<MappedAsset, EAssetLoadError> AssetSystem::map_file(
+    Allocator& allocator, Str path)
+{
+    if (pak.is_open()) {
+        for (const AssetRegistryRoot& root : roots) {
+            if (!is_under(path, root.directory)) continue;
+
+            AssetReference reference = {
+                .module = root.module,
+                .path   = Str(
+                    path.data + root.directory.len,
+                    path.len - root.directory.len),
+            };
+
+            Slice<u8> packed = packed_file_of(resolve_reference(reference));
+            if (packed.count > 0) return Asset::map_memory(allocator, packed);
+        }
+    }
+
+    return Asset::map(allocator, path);
+}
+
+/** Changed sources under one source root, see run_reimport */
+struct ReimportBatch {
+    ImporterRegistry* importers;
+    /** Null if there's none */
+    DerivedDataCache* derived_data;
+    Str               source_directory;
+    Str               asset_directory;
+    TArray<Str>       sources;
+};
+
+/**
+ * Converts the sources of a batch on the reimporter thread. The build cache
+ * of the convert command isn't used: a source may well be changed back to
+ * what it was when the cache was written. The derived data cache is, since
+ * it's keyed by contents, which makes undoing a change cheap
+ */
+static void run_reimport(void* user)
+{
+    ReimportBatch* batch = (ReimportBatch*)user;
+
+    AssetConverter converter;
+    converter.init(batch->importers, AssetCompressionLevel::Default);
+    converter.derived_data = batch->derived_data;
+
+    for (Str source : batch->sources) {
+        converter.add_from_directory(
+            source,
+            batch->source_directory,
+            batch->asset_directory);
+    }
+
+    // The batch is converted on this thread
+    JobSystem jobs;
+    jobs.init(0);
+    converter.run(jobs);
+    jobs.deinit();
+
+    for (const AssetConverter::Entry& entry : converter.entries) {
+        if (entry.failed) {
+            print(
+                LIT("[Asset System]: Failed to convert {} ({})\n"),
+                entry.input,
+                entry.error);
+        } else {
+            print(
+                LIT("[Asset System]: Converted {} -> {}\n"),
+                entry.input,
+                entry.output);
+        }
+    }
+
+    converter.deinit();
+
+    for (Str source : batch->sources) {
+        System_Allocator.release((umm)source.data);
+    }
+    batch->sources.release();
+    delete batch;
+}
+
+void AssetSystem::poll_changes()
+{
+    ZoneScoped;
+
+    // Changes that had to wait for a load to complete, or a release
+    u64 i = 0;
+    while (i < changed_assets.size) {
+        if (!reload(changed_assets[i])) {
+            i++;
+            continue;
+        }
+
+        changed_assets[i] = *changed_assets.last();
+        changed_assets.pop();
+    }
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(1));
+
+    TArray<Str> changes(&temp);
+    watcher.poll(temp, changes);
+    if (changes.size == 0) return;
+
+    TArray<ReimportBatch*> batches(&temp);
+    for (const SourceRoot& root : source_roots) {
+        batches.add(new ReimportBatch{
+            .importers        = &importers,
+            .derived_data     = has_derived_data ? &derived_data : nullptr,
+            .source_directory = root.source_directory,
+            .asset_directory  = root.asset_directory,
+            .sources          = TArray<Str>(&System_Allocator),
+        });
+    }
+
+    bool registry_changed = false;
+    for (Str path : changes) {
+        FileStat   stat;
+        const bool exists = stat_file(path, stat);
+
+        bool is_source = false;
+        for (u64 r = 0; r < source_roots.size; ++r) {
+            if (!is_under(path, source_roots[r].source_directory)) continue;
+
+            // Removing a source leaves its asset be
+            if (exists) batches[r]->sources.add(path.clone(System_Allocator));
+            is_source = true;
+            break;
+        }
+
+        if (is_source) continue;
+
+        if (path.chop_left_last_of('.') != LIT(".asset")) continue;
+
+        for (const AssetRegistryRoot& root : roots) {
+            if (!is_under(path, root.directory)) continue;
+
+            AssetReference reference = {
+                .module = root.module,
+                .path   = Str(
+                    path.data + root.directory.len,
+                    path.len - root.directory.len),
+            };
+
+            // Added and removed assets only show after a refresh
+            if (!exists || !registry.references_to_ids.contains(reference)) {
+                registry_changed = true;
+                break;
+            }
+
+            AssetID id = registry.references_to_ids[reference];
+            if (!reload(id)) {
+                bool waiting = false;
+                for (const AssetID& changed_id : changed_assets) {
+                    if (changed_id == id) waiting = true;
+                }
+
+                if (!waiting) changed_assets.add(id);
+            }
+            break;
+        }
+    }
+
+    if (registry_changed) refresh_registry();
+
+    for (ReimportBatch* batch : batches) {
+        if (batch->sources.size > 0) {
+            reimporter.queue(run_reimport, batch);
+            continue;
+        }
+
+        batch->sources.release();
+        delete batch;
+    }
+}
+
+bool AssetSystem::reload(const AssetID& id)
+{
+    if (asset_states.contains(id)) {
+        AssetState& state = asset_states[id];
+
+        // A load under way may have read the file before it changed, so it
+        // completes first
+        if ((state.load != nullptr) || (state.ref_count > 0)) return false;
+
+        if (state.state == AssetLoadState::Ready) drop_data(state);
+        state.state = AssetLoadState::Unloaded;
+    }
+
+    if (!registry.ids_to_references.contains(id)) return true;
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+    const AssetReference&    reference = registry.ids_to_references[id];
+    const AssetRegistryRoot* root      = root_of(reference.module);
+    if (root == nullptr) return true;
+
+    Str path = format(temp, LIT("{}{}"), root->directory, reference.path);
+    hooks.changed.broadcast(id, path);
+    return true;
 }
 
-void AssetSystem::deinit() {}
+void AssetSystem::deinit()
+{
+    // Loads still in flight finish first, so that their files get closed
+    reader.deinit();
+    loaders.deinit();
+    update();
+    pending_loads.release();
+    eviction_candidates.release();
+    eviction_scratch.release();
+
+    for (auto pair : asset_states) {
+        if (pair.val.state == AssetLoadState::Ready) {
+            drop_data(asset_states[pair.key]);
+        }
+    }
+
+    if (hot_reload) {
+        // Conversions under way finish first
+        reimporter.deinit();
+        watcher.deinit();
+    }
+
+    if (has_derived_data) {
+        derived_data.trim();
+        print(
+            LIT("[Asset System]: Derived data cache: {} hits, {} misses\n"),
+            derived_data.stats.hits.load(),
+            derived_data.stats.misses.load());
+        derived_data.deinit();
+        has_derived_data = false;
+    }
+
+    for (const SourceRoot& root : source_roots) {
+        allocator->release((umm)root.source_directory.data);
+        allocator->release((umm)root.asset_directory.data);
+    }
+    source_roots.release();
+    changed_assets.release();
+
+    for (const AssetRegistryRoot& root : roots) {
+        allocator->release((umm)root.module.data);
+        allocator->release((umm)root.directory.data);
+    }
+    roots.release();
+    index.deinit();
+    pak.close();
+}
 
 Asset* AssetProxy::get_now()
 {
@@ -109,6 +823,14 @@ Asset* AssetProxy::get_now()
     return sys->load_asset_now(cached_id);
 }
 
+AssetLoadHandle AssetProxy::load_async()
+{
+    AssetSystem* sys = Engine::instance()->asset_system;
+    resolve();
+
+    return sys->load_asset_async(cached_id);
+}
+
 bool AssetProxy::resolve()
 {
     AssetSystem* sys = Engine::instance()->asset_system;
@@ -134,3 +856,13 @@ AssetProxy AssetProxy::from_path(Str name)
     result.ref.path   = path;
     return result;
 }
+
+EAssetLoadState AssetLoadHandle::state() const
+{
+    return Engine::instance()->asset_system->get_load_state(id);
+}
+
+Asset* AssetLoadHandle::get() const
+{
+    return Engine::instance()->asset_system->get_loaded(id);
+}
@@ -1,7 +1,16 @@
 #pragma once
+#include <atomic>
+
 #include "AssetLibrary/AssetLibrary.h"
+#include "AssetLibrary/AssetPak.h"
+#include "AssetLibrary/AssetRegistry.h"
+#include "AssetLibrary/DerivedDataCache.h"
 #include "Containers/Map.h"
+#include "Core/AsyncFileReader.h"
+#include "Core/FileWatcher.h"
 #include "Core/Handle.h"
+#include "Core/TaskQueue.h"
+#include "MulticastDelegate.h"
 #include "sfl_uuid.h"
 
 /**
@@ -111,10 +120,46 @@ static _inline bool operator==(const AssetID& left, const AssetID& right)
            (left.id.qwords[1] == right.id.qwords[1]);
 }
 
+namespace AssetLoadState {
+    enum Type : u32
+    {
+        /** Never requested */
+        Unloaded = 0,
+        /** Waiting for a loader thread */
+        Queued,
+        /** Being read and unpacked in the background */
+        Loading,
+        /** Loaded, once AssetSystem::update has seen it */
+        Ready,
+        Failed,
+    };
+}
+typedef AssetLoadState::Type EAssetLoadState;
+
+PROC_FMT_ENUM(AssetLoadState, {
+    FMT_ENUM_CASE(AssetLoadState, Unloaded);
+    FMT_ENUM_CASE(AssetLoadState, Queued);
+    FMT_ENUM_CASE(AssetLoadState, Loading);
+    FMT_ENUM_CASE(AssetLoadState, Ready);
+    FMT_ENUM_CASE(AssetLoadState, Failed);
+    FMT_ENUM_DEFAULT_CASE(Unloaded);
+})
+
 struct AssetState {
-    bool    is_loaded;
-    AssetID id;
-    Asset   value;
+    EAssetLoadState   state;
+    AssetID           id;
+    Asset             value;
+    /**
+     * Mapping of the asset file. Uncompressed assets are used in place, so
+     * their blob points into it
+     */
+    FileMapping       mapping;
+    /** The load on a loader thread, until AssetSystem::update completes it */
+    struct AssetLoad* load;
+    /** Holders that keep the asset from being evicted */
+    u32               ref_count;
+    /** AssetSystem update the asset was last asked for in */
+    u64               last_used;
 };
 
 static _inline bool operator==(const AssetState& left, const AssetState& right)
@@ -122,27 +167,224 @@ static _inline bool operator==(const AssetState& left, const AssetState& right)
     return left.id == right.id;
 }
 
-struct AssetSystem {
+/**
+ * Handle to an asset loaded with AssetSystem::load_asset_async. Only valid on
+ * the main thread
+ */
+struct AssetLoadHandle {
+    AssetID id;
+
+    EAssetLoadState state() const;
+    bool            is_ready() const
+    {
+        return state() == AssetLoadState::Ready;
+    }
+
+    /** The asset, or null if it isn't ready */
+    Asset* get() const;
+};
+
+/**
+ * Registry of the assets in the asset directory, and their loaded state.
+ *
+ * Assets are loaded either synchronously with load_asset_now, or in the
+ * background with load_asset_async: loose files are read through an
+ * AsyncFileReader (io_uring where available) and unpacked on its workers,
+ * while pak entries are unpacked on one of the loader threads (LZ4Chunked
+ * blocks being decompressed in parallel on the shared job system). update
+ * publishes them on the main thread. Loaded assets are only ever accessed
+ * from the main thread.
+ *
+ * Loaded assets are evicted by update, least recently used first, while their
+ * data goes over budget. Assets that are retained are never evicted; the ones
+ * that aren't are only valid until the next update.
+ *
+ * With hot_reload, update also watches the asset directories for changes.
+ * Changed assets are unloaded and broadcast through hooks.changed, so that
+ * whatever was made from them can be loaded again. Sources under the
+ * directories added with add_source_root are converted again on a background
+ * thread when they change, which in turn changes their asset.
+ */
+struct AssetSystem : IAssetFileSource {
+    /** Threads that read and unpack assets loaded asynchronously */
+    u32  loader_threads    = 2;
+    /** Index of the assets of every module, kept between runs */
+    Str  registry_path     = LIT("Assets/.registry");
+    /** Bytes of loaded asset data past which assets are evicted */
+    u64  budget            = MEGABYTES(512);
+    /** Watch for changed assets and sources. Set before init */
+    bool hot_reload        = false;
+    /**
+     * Derived data cache of the sources converted on hot reload, shared with
+     * the convert command. Empty for none
+     */
+    Str  derived_data_path = LIT("DerivedData");
+    /**
+     * Pak that every asset is loaded from instead of the module directories,
+     * if there is one. Shipping builds have one, see AssetPak
+     */
+    Str  pak_path          = LIT("Assets.pak");
+
+    using ChangedHook = MulticastDelegate<AssetID, Str>;
+    struct {
+        /**
+         * An asset file changed, given its id and path. Called from update,
+         * once the data it had loaded is dropped
+         */
+        ChangedHook changed;
+    } hooks;
+
+    struct {
+        /** Bytes of the loaded blobs, whether unpacked or mapped */
+        u64 resident_bytes = 0;
+        /** Loads of assets that were already loaded or being loaded */
+        u64 hits           = 0;
+        /** Loads that had to read the asset */
+        u64 misses         = 0;
+        u64 evictions      = 0;
+    } stats;
+
     void init(Allocator& allocator);
     void deinit();
 
-    void refresh_registry();
+    /**
+     * Brings the registry up to date with the asset directories, reading the
+     * index instead of walking them where they're unchanged. With a pak, the
+     * registry is the pak's table of contents instead
+     * @param check_files Also look for assets modified in place
+     */
+    void refresh_registry(bool check_files = false);
+
+    /**
+     * Registers the assets under directory as @module. Takes effect on the
+     * next refresh_registry
+     */
+    void add_module_root(Str module, Str directory);
+
+    /**
+     * Converts the sources under source_directory to assets under
+     * asset_directory when they change, like the convert command does for a
+     * whole directory. Only with hot_reload
+     */
+    void add_source_root(Str source_directory, Str asset_directory);
 
     AssetID resolve_reference(const AssetReference& reference);
 
+    /**
+     * Maps the asset file at path, as named by convert_reference_to_path.
+     * With a pak, the entry of the asset is mapped from the pak's memory, and
+     * the loose file is only read for assets that aren't in it, as during
+     * development. For users that know assets by path, e.g. textures
+     */
+    Result<MappedAsset, EAssetLoadError> map_file(
+        Allocator& allocator, Str path) override;
+
+    /** Loads the asset, waiting for an asynchronous load already under way */
     Asset* load_asset_now(const AssetID& id);
 
+    /**
+     * Queues the asset to be loaded in the background, unless it's already
+     * loaded or being loaded
+     */
+    AssetLoadHandle load_asset_async(const AssetID& id);
+    EAssetLoadState get_load_state(const AssetID& id);
+
+    /** The asset if it's loaded, without loading it otherwise */
+    Asset* get_loaded(const AssetID& id);
+
+    /** Keeps the asset from being evicted, until it's released as often */
+    void retain(const AssetID& id);
+    void release(const AssetID& id);
+
+    /**
+     * Drops the loaded data of the asset right away, unless it's retained.
+     * Meant for assets whose data was copied elsewhere, e.g. to the GPU
+     */
+    void unload(const AssetID& id);
+
+    /**
+     * Starts reading the assets of a group of the pak (e.g. a level) in the
+     * background, ahead of loading them
+     * @return false if there's no pak, or no such group in it
+     */
+    bool prefetch_group(Str group);
+
+    /**
+     * Publishes the asynchronous loads that completed since the last call.
+     * Called once per frame, on the main thread
+     */
+    void update();
+
 private:
     Str convert_reference_to_path(
         Allocator& allocator, const AssetReference& reference);
 
+    /** The directory of module, or null if it isn't registered */
+    const AssetRegistryRoot* root_of(Str module);
+
+    /** The state of the asset, added as unloaded if it has none */
+    AssetState& get_state(const AssetID& id);
+
+    /** Moves the result of a completed load into its asset state */
+    void complete_load(AssetState& state);
+
+    /**
+     * Drops the least recently used assets that nothing retains, until the
+     * resident bytes are within the budget
+     */
+    void evict();
+
+    /** Frees the blob or closes the mapping of a loaded asset */
+    void drop_data(AssetState& state);
+
+    /** The asset file of id in the pak, empty if it isn't in one */
+    Slice<u8> packed_file_of(const AssetID& id);
+
+    /** Handles the files that changed since the last update */
+    void poll_changes();
+
+    /**
+     * Drops the data of a changed asset, and broadcasts the change
+     * @return false if it's loading or retained, and has to wait
+     */
+    bool reload(const AssetID& id);
+
     struct {
         TMap<AssetID, AssetReference> ids_to_references;
         TMap<AssetReference, AssetID> references_to_ids;
     } registry;
 
+    Allocator*                allocator;
+    AssetRegistry             index;
+    AssetPak                  pak;
+    TArray<AssetRegistryRoot> roots;
     TMap<AssetID, AssetState> asset_states;
+    /** Assets whose asynchronous load hasn't been completed yet */
+    TArray<AssetID>           pending_loads;
+    /** Assets update may evict, least recently used first */
+    TArray<AssetState*>       eviction_candidates;
+    TArray<AssetState*>       eviction_scratch;
+    TaskQueue                 loaders;
+    /** Reads the loose files of asynchronous loads */
+    AsyncFileReader           reader;
     SflUUIDContext            uuid_context;
+    u64                       update_count = 1;
+
+    // Hot reload
+    struct SourceRoot {
+        Str source_directory;
+        Str asset_directory;
+    };
+
+    FileWatcher        watcher;
+    TArray<SourceRoot> source_roots;
+    ImporterRegistry   importers{System_Allocator};
+    /** Converts changed sources, one batch at a time */
+    TaskQueue          reimporter;
+    /** Changed assets that were loading or retained at the time */
+    TArray<AssetID>    changed_assets;
+    DerivedDataCache   derived_data;
+    bool               has_derived_data = false;
 };
 
 /**
@@ -154,8 +396,10 @@ struct AssetProxy {
     AssetReference ref;
     AssetID        cached_id = AssetID::invalid();
 
-    Asset* get_now();
-    bool   is_resolved() const { return cached_id.is_valid(); }
+    Asset*          get_now();
+    /** Resolves the proxy if needed, and loads it asynchronously */
+    AssetLoadHandle load_async();
+    bool            is_resolved() const { return cached_id.is_valid(); }
 
     bool resolve();
 
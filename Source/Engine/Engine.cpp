@@ -18,32 +18,42 @@ void Engine::init()
 
     // Allocate subsystems
     input                       = alloc<Input>(allocator);
-    window                      = win::create_window(allocator);
-    window->input               = input;
+    window                      = nullptr;
     renderer                    = alloc<Renderer>(allocator);
-    renderer->window            = window;
     renderer->input             = input;
     renderer->validation_layers = true;
     renderer->allocator         = allocator;
+    renderer->headless          = headless;
+    if (render_workers >= 0) renderer->record_workers = u32(render_workers);
+
+    if (!headless) {
+        window        = win::create_window(allocator);
+        window->input = input;
+    }
+    renderer->window = window;
     ecs                         = alloc<ECS>(allocator);
     subsystems                  = alloc<SubsystemManager>(allocator);
 
-    asset_system  = alloc<AssetSystem>(allocator);
-    module_system = alloc<ModuleSystem>(allocator);
+    asset_system             = alloc<AssetSystem>(allocator);
+    asset_system->hot_reload = hot_reload;
+    module_system            = alloc<ModuleSystem>(allocator);
 
     hooks.pre_init.broadcast(this);
 
     // Initialize window
-    window->init(1600, 900).unwrap();
+    if (!headless) {
+        window->init(1600, 900).unwrap();
+    }
+
+    // Initialize asset manager, which the renderer maps its textures from
+    asset_system->init(allocator);
+    renderer->asset_files = asset_system;
 
     // Initialize renderer
     renderer->init();
 
     subsystems->init();
 
-    // Initialize asset manager
-    asset_system->init(allocator);
-
     // Initialize ECS
     ecs->init(renderer);
 
@@ -54,10 +64,13 @@ void Engine::init()
 
 void Engine::loop()
 {
-    window->poll();
-    while (window->is_open) {
+    if (!headless) window->poll();
+    while (headless || window->is_open) {
+        if ((max_frames != 0) && (renderer->frame_num >= max_frames)) break;
+
         // Update
         input->update();
+        asset_system->update();
         renderer->update();
         ecs->run();
 
@@ -68,7 +81,7 @@ void Engine::loop()
         renderer->draw();
 
         // Poll
-        window->poll();
+        if (!headless) window->poll();
     }
 }
 
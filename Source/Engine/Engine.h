@@ -16,6 +16,21 @@ struct Engine {
      */
     Allocator& allocator = System_Allocator;
 
+    /**
+     * Run without a window. The renderer only draws into its offscreen color
+     * target, which allows running on software implementations (lavapipe)
+     */
+    bool headless   = false;
+    /** Stop the main loop after this many frames. Zero means no limit */
+    u32  max_frames = 0;
+    /**
+     * Threads that record draw commands besides the main thread (see
+     * Renderer::record_workers). Negative keeps the renderer's default
+     */
+    i32  render_workers = -1;
+    /** Reload assets as they change on disk, see AssetSystem::hot_reload */
+    bool hot_reload     = false;
+
     struct win::Window*      window;
     struct Renderer*         renderer;
     struct Input*            input;
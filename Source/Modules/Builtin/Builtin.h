@@ -81,6 +81,7 @@ TransformComponent: {
     world_rotation: Quat;
     world_scale: Vec3;
     world_to_local: Mat4;
+    world_matrix: Mat4;
 }
 
 @component(nodefine)
@@ -93,16 +94,6 @@ MaterialComponent: {
     name: Str;
 }
 
-@system(phase: OnUpdate, multi_threaded: true)
-apply_transform: {
-    @access(in)
-    @source(id: this, trav: ChildOf, flags: (up, cascade))
-    @op(optional)
-    parent: TransformComponent;
-
-    transform: TransformComponent;
-}
-
 @hook(init) builtin_init;
 
 // clang-format on
@@ -0,0 +1,232 @@
+#include "TransformSubsystem.h"
+
+#include <algorithm>
+
+#include "Core/JobSystem.h"
+#include "Core/RadixSort.h"
+#include "ECS/ECS.h"
+#include "Engine/Engine.h"
+
+/** Whether the sorted ids contain id */
+static bool contains_sorted(const TArray<u64>& ids, u64 id)
+{
+    return std::binary_search(ids.data, ids.data + ids.size, id);
+}
+
+/** Sorts ids in place, using scratch as temporary storage */
+static void sort_ids(TArray<u64>& ids, TArray<u64>& scratch)
+{
+    scratch.size = 0;
+    for (u64 i = 0; i < ids.size; ++i) scratch.add(0);
+
+    radix_sort(slice(ids), slice(scratch), [](u64 id) { return id; });
+}
+
+void TransformPropagation::init(flecs::world& world)
+{
+    this->world    = &world;
+    tables         = TArray<TableWork>(&System_Allocator);
+    tables_scratch = TArray<TableWork>(&System_Allocator);
+    parent_slots   = TArray<u64>(&System_Allocator);
+    moved_parents  = TArray<u64>(&System_Allocator);
+    moved_tables   = TArray<u64>(&System_Allocator);
+    sort_scratch   = TArray<u64>(&System_Allocator);
+
+    propagate_query =
+        world
+            .query_builder<const TransformComponent, const TransformComponent>()
+            .term_at(2)
+            .cascade(flecs::ChildOf)
+            .optional()
+            .build();
+
+    mark_query = world.query_builder<TransformComponent>().build();
+}
+
+void TransformPropagation::deinit()
+{
+    propagate_query.destruct();
+    mark_query.destruct();
+    tables.release();
+    tables_scratch.release();
+    parent_slots.release();
+    moved_parents.release();
+    moved_tables.release();
+    sort_scratch.release();
+}
+
+void TransformPropagation::update()
+{
+    last_update_count = 0;
+    if (!propagate_query.changed()) return;
+
+    tables.size        = 0;
+    parent_slots.size  = 0;
+    moved_parents.size = 0;
+    moved_tables.size  = 0;
+
+    // Roots that didn't change can't move. Children are kept until their
+    // parent's level is done, which tells whether it moved
+    propagate_query.iter([&](
+                             flecs::iter&              it,
+                             const TransformComponent* transforms,
+                             const TransformComponent* parent) {
+        const bool changed = it.changed();
+        if (!parent && !changed) return;
+
+        ecs_table_t* table = it.c_ptr()->table;
+        const u32    depth =
+            parent ? u32(ecs_table_get_depth(world->c_ptr(), table, EcsChildOf))
+                   : 0;
+
+        TableWork work = {
+            .table      = table,
+            .entities   = it.c_ptr()->entities,
+            .transforms = (TransformComponent*)transforms,
+            .parent     = parent,
+            .parent_id  = parent ? it.src(2).id() : 0,
+            .count      = u32(it.count()),
+            .depth      = depth,
+            .changed    = changed,
+            .first_slot = parent_slots.size,
+        };
+        tables.add(work);
+
+        for (u32 i = 0; i < work.count; ++i) parent_slots.add(0);
+    });
+
+    // Parents come before their children
+    tables_scratch.size = 0;
+    for (u64 i = 0; i < tables.size; ++i) tables_scratch.add(TableWork{});
+    radix_sort(
+        slice(tables),
+        slice(tables_scratch),
+        [](const TableWork& work) { return u64(work.depth); });
+
+    JobSystem& jobs = JobSystem::shared();
+
+    u64 first = 0;
+    while (first < tables.size) {
+        u64 last = first + 1;
+        while ((last < tables.size) &&
+               (tables[last].depth == tables[first].depth))
+        {
+            last++;
+        }
+
+        jobs.parallel_for(u32(last - first), [&](u32 index) {
+            propagate(tables[first + index]);
+        });
+
+        // The parents that moved are only looked up by the next level
+        moved_parents.size = 0;
+        for (u64 i = first; i < last; ++i) {
+            const TableWork& work = tables[i];
+            last_update_count += work.recomputed;
+
+            if (!work.moved) continue;
+            moved_tables.add(u64(work.table));
+
+            for (u32 j = 0; j < work.moved_parent_count; ++j) {
+                moved_parents.add(parent_slots[work.first_slot + j]);
+            }
+        }
+        sort_ids(moved_parents, sort_scratch);
+
+        first = last;
+    }
+
+    if (moved_tables.size > 0) {
+        sort_ids(moved_tables, sort_scratch);
+
+        // Flag the tables that moved as changed for other queries
+        mark_query.iter([this](flecs::iter& it, TransformComponent*) {
+            if (!contains_sorted(moved_tables, u64(it.c_ptr()->table))) {
+                it.skip();
+            }
+        });
+    }
+
+    // Sync the monitors of propagate_query past the changes it consumed (and
+    // the marking above), otherwise the next update would see them again
+    propagate_query.iter(
+        [](flecs::iter&, const TransformComponent*, const TransformComponent*) {
+        });
+}
+
+void TransformPropagation::propagate(TableWork& work)
+{
+    work.moved              = false;
+    work.recomputed         = 0;
+    work.moved_parent_count = 0;
+
+    const TransformComponent* parent = work.parent;
+    const bool                parent_moved =
+        parent && contains_sorted(moved_parents, work.parent_id);
+
+    if (!parent_moved && !work.changed) return;
+
+    work.recomputed = work.count;
+
+    // All entities of a table share the same parent
+    Mat4 parent_matrix  = Mat4::identity();
+    Mat4 world_to_local = Mat4::identity();
+    if (parent) {
+        parent_matrix  = parent->world_matrix;
+        world_to_local = parent_matrix.inverse_affine();
+    }
+
+    for (u32 i = 0; i < work.count; ++i) {
+        TransformComponent& transform = work.transforms[i];
+
+        Mat4 world_matrix = parent_matrix * Mat4::make_transform(
+                                                transform.position,
+                                                transform.rotation,
+                                                transform.scale);
+
+        // Unless the parent moved, the table may have changed because of a
+        // sibling
+        bool moved = parent_moved || (memcmp(
+                                          &world_matrix,
+                                          &transform.world_matrix,
+                                          sizeof(Mat4)) != 0);
+        if (!moved) continue;
+
+        transform.world_matrix   = world_matrix;
+        transform.world_to_local = world_to_local;
+
+        if (parent) {
+            transform.world_position = world_matrix.translation();
+            transform.world_rotation = Quat(
+                glm::quat(parent->world_rotation) *
+                glm::quat(transform.rotation));
+            transform.world_scale = Vec3(
+                glm::vec3(parent->world_scale) * glm::vec3(transform.scale));
+        } else {
+            transform.world_position = transform.position;
+            transform.world_rotation = transform.rotation;
+            transform.world_scale    = transform.scale;
+        }
+
+        work.moved = true;
+
+        // Only read from the entity index, which nothing changes meanwhile
+        const ecs_entity_t  entity = work.entities[i];
+        const ecs_record_t* r      = ecs_record_find(world->c_ptr(), entity);
+        if (r && (ECS_RECORD_TO_ROW_FLAGS(r->row) & EcsEntityIsTarget)) {
+            parent_slots[work.first_slot + work.moved_parent_count++] = entity;
+        }
+    }
+}
+
+void TransformSubsystem::init()
+{
+    Engine* engine = Engine::instance();
+    propagation.init(engine->ecs->world);
+
+    engine->hooks.post_update.add_raw(this, &TransformSubsystem::update);
+}
+
+void TransformSubsystem::deinit() { propagation.deinit(); }
+
+void TransformSubsystem::update(Engine* engine) { propagation.update(); }
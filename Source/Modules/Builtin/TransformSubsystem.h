@@ -0,0 +1,89 @@
+#pragma once
+#include "Builtin.h"
+#include "Containers/Array.h"
+#include "ECS.h"
+#include "Engine/SubsystemManager.h"
+
+/**
+ * Computes the world transforms of the TransformComponent hierarchy.
+ *
+ * Tables are visited in cascade (depth) order, and a table is only recomputed
+ * if its transforms changed since the last update, or if the world transform
+ * of its parent changed in this one. Since flecs tracks changes per table,
+ * recomputed entities are compared against their previous world matrix, and
+ * only the parents that actually moved are propagated further.
+ *
+ * Tables are gathered once per update, then propagated one depth level at a
+ * time: the tables of a level only read the world transforms of the level
+ * above, so each level is split across the shared job system.
+ *
+ * Propagation writes the world transform through read-only queries, so that
+ * flecs doesn't count it as a change of its own; afterwards the tables that
+ * moved are flagged as changed once, so that later readers (e.g.
+ * WorldRenderSubsystem) pick them up.
+ *
+ * Anything that writes a TransformComponent through get_mut has to call
+ * modified for the change to be seen.
+ */
+struct TransformPropagation {
+    void init(flecs::world& world);
+    void deinit();
+
+    void update();
+
+    /** Number of entities recomputed by the last update */
+    u64 last_update_count = 0;
+
+private:
+    /** A table of the hierarchy, to propagate along with its depth level */
+    struct TableWork {
+        ecs_table_t*              table;
+        const ecs_entity_t*       entities;
+        TransformComponent*       transforms;
+        /** Shared by every entity of the table, null for roots */
+        const TransformComponent* parent;
+        u64                       parent_id;
+        u32                       count;
+        u32                       depth;
+        /** Whether flecs saw the table change since the last update */
+        bool                      changed;
+
+        // Results
+        bool moved;
+        u32  recomputed;
+        /**
+         * Where the ids of moved entities that are parents go in
+         * parent_slots, and how many there are
+         */
+        u64  first_slot;
+        u32  moved_parent_count;
+    };
+
+    /** Recomputes the table if it or its parent changed */
+    void propagate(TableWork& work);
+
+    flecs::world* world;
+    flecs::query<const TransformComponent, const TransformComponent>
+                                   propagate_query;
+    flecs::query<TransformComponent> mark_query;
+
+    // Reset on every update
+    TArray<TableWork> tables;
+    TArray<TableWork> tables_scratch;
+    /** Room for every entity of tables, see TableWork::first_slot */
+    TArray<u64>       parent_slots;
+    /** Parents of the last level propagated that moved, sorted */
+    TArray<u64>       moved_parents;
+    /** Tables that moved, sorted */
+    TArray<u64>       moved_tables;
+    TArray<u64>       sort_scratch;
+};
+
+struct TransformSubsystem : ISubsystem {
+    void init() override;
+    void deinit() override;
+
+    void update(struct Engine* engine);
+
+    TransformPropagation propagation;
+};
@@ -8,31 +8,62 @@ void WorldRenderSubsystem::init()
 {
     Allocator& allocator = System_Allocator;
     meshes.init(allocator);
-    render_objects.alloc = (&allocator);
+    render_entities.init(allocator);
+    waiting_entities.alloc = &allocator;
+    reloading_meshes.alloc = &allocator;
 
     Engine* eng = Engine::instance();
 
     collection_query =
         eng->ecs->world
             .query_builder<
-                TransformComponent,
-                StaticMeshComponent,
-                MaterialComponent>()
+                const TransformComponent,
+                const StaticMeshComponent,
+                const MaterialComponent>()
             .build();
 
+    removal_observer =
+        eng->ecs->world
+            .observer<
+                const TransformComponent,
+                const StaticMeshComponent,
+                const MaterialComponent>()
+            .event(flecs::OnRemove)
+            .each([this](
+                      flecs::entity e,
+                      const TransformComponent&,
+                      const StaticMeshComponent&,
+                      const MaterialComponent&) { remove_render_object(e); });
+
     eng->hooks.pre_draw.add_raw(this, &WorldRenderSubsystem::update);
+    eng->asset_system->hooks.changed.add_raw(
+        this,
+        &WorldRenderSubsystem::on_asset_changed);
 }
 
-void WorldRenderSubsystem::deinit() {}
+void WorldRenderSubsystem::deinit()
+{
+    removal_observer.destruct();
+    render_entities.release();
+    waiting_entities.release();
+    reloading_meshes.release();
+}
 
 THandle<Mesh> WorldRenderSubsystem::resolve(const AssetID& id)
 {
     THandle<Mesh> result = meshes.get_handle(id);
+    if (result.is_valid()) return result;
 
-    if (!result.is_valid()) {
-        result = submit_mesh(id);
-    }
+    AssetSystem*    assets = Engine::instance()->asset_system;
+    AssetLoadHandle load   = assets->load_asset_async(id);
+
+    Asset* asset = load.get();
+    if (asset == nullptr) return THandle<Mesh>::invalid();
 
+    result = submit_mesh(id, *asset);
+
+    // The mesh data is staged for upload by now, so the blob can go
+    assets->unload(id);
     return result;
 }
 
@@ -41,64 +72,233 @@ Mesh* WorldRenderSubsystem::get(THandle<Mesh> handle)
     return &meshes.resolve(handle);
 }
 
-THandle<Mesh> WorldRenderSubsystem::submit_mesh(const AssetID& id)
+THandle<Mesh> WorldRenderSubsystem::submit_mesh(
+    const AssetID& id, Asset& asset)
 {
-    Engine* eng   = Engine::instance();
-    Asset*  asset = eng->asset_system->load_asset_now(id);
+    u32 hid = meshes.create_resource(id, upload_mesh(asset));
+    return THandle<Mesh>{hid};
+}
 
-    ASSERT(asset != nullptr);
+Mesh WorldRenderSubsystem::upload_mesh(Asset& asset)
+{
+    Mesh new_mesh = Mesh::from_asset(asset);
+    Engine::instance()->renderer->upload_mesh(new_mesh);
 
-    Mesh new_mesh = Mesh::from_asset(*asset);
-    eng->renderer->upload_mesh(new_mesh);
+    // They point into the asset blob, which isn't kept
+    new_mesh.vertices = {};
+    new_mesh.indices  = {};
+    new_mesh.meshlets = {};
+    return new_mesh;
+}
 
-    u32 hid = meshes.create_resource(id, new_mesh);
-    return THandle<Mesh>{hid};
+void WorldRenderSubsystem::on_asset_changed(AssetID id, Str path)
+{
+    Engine* eng = Engine::instance();
+
+    // Textures are owned by the renderer, which knows them by path
+    eng->renderer->texture_system.reload(path);
+
+    if (!meshes.get_handle(id).is_valid()) return;
+
+    eng->asset_system->load_asset_async(id);
+
+    for (const AssetID& reloading_id : reloading_meshes) {
+        if (reloading_id == id) return;
+    }
+    reloading_meshes.add(id);
+}
+
+void WorldRenderSubsystem::update_reloading_meshes()
+{
+    Engine*      eng    = Engine::instance();
+    AssetSystem* assets = eng->asset_system;
+
+    u64 i = 0;
+    while (i < reloading_meshes.size) {
+        const AssetID id = reloading_meshes[i];
+
+        // Loads again if the asset changed once more and was dropped
+        AssetLoadHandle load  = assets->load_asset_async(id);
+        EAssetLoadState state = load.state();
+        if ((state != AssetLoadState::Ready) &&
+            (state != AssetLoadState::Failed))
+        {
+            i++;
+            continue;
+        }
+
+        if (Asset* asset = load.get()) {
+            Mesh& mesh = meshes.resolve(meshes.get_handle(id));
+            eng->renderer->replace_mesh(mesh, upload_mesh(*asset));
+            assets->unload(id);
+        } else {
+            print(LIT("[World Render]: Failed to reload a mesh\n"));
+        }
+
+        reloading_meshes[i] = reloading_meshes[reloading_meshes.size - 1];
+        reloading_meshes.size--;
+    }
 }
 
 void WorldRenderSubsystem::update(Engine* engine)
 {
-    render_objects.empty();
-
-    collection_query.each([this](
-                              flecs::entity        e,
-                              TransformComponent&  transform,
-                              StaticMeshComponent& mesh,
-                              MaterialComponent&   material) {
-        update_render_object(transform, mesh, material);
+    update_reloading_meshes();
+    update_waiting_entities();
+
+    // The query only reads its components, so iterating it doesn't mark
+    // tables as changed; only tables written since the last update are
+    // visited again
+    if (!collection_query.changed()) return;
+
+    collection_query.iter([this](
+                              flecs::iter&               it,
+                              const TransformComponent*  transforms,
+                              const StaticMeshComponent* meshes,
+                              const MaterialComponent*   materials) {
+        if (!it.changed()) return;
+
+        for (auto i : it) {
+            update_render_object(
+                it.entity(i),
+                transforms[i],
+                meshes[i],
+                materials[i]);
+        }
     });
+}
+
+void WorldRenderSubsystem::update_waiting_entities()
+{
+    const u64 count = waiting_entities.size;
+    if (count == 0) return;
+
+    // Entities still waiting are added back at the end
+    for (u64 i = 0; i < count; ++i) {
+        flecs::entity entity = waiting_entities[i];
+
+        const u64 id = entity.id();
+        if (render_entities.contains(id)) render_entities[id].waiting = false;
+
+        // Destroyed while it waited
+        if (!entity.is_alive()) {
+            remove_render_object(entity);
+            continue;
+        }
+
+        auto transform = entity.get<TransformComponent>();
+        auto mesh      = entity.get<StaticMeshComponent>();
+        auto material  = entity.get<MaterialComponent>();
+        if (!transform || !mesh || !material) {
+            remove_render_object(entity);
+            continue;
+        }
 
-    engine->renderer->render_objects = slice(render_objects);
+        update_render_object(entity, *transform, *mesh, *material);
+    }
+
+    u64 remaining = waiting_entities.size - count;
+    for (u64 i = 0; i < remaining; ++i) {
+        waiting_entities[i] = waiting_entities[count + i];
+    }
+    waiting_entities.size = remaining;
 }
 
-void WorldRenderSubsystem::update_render_object(
-    TransformComponent&  transform,
-    StaticMeshComponent& mesh,
-    MaterialComponent&   material)
+void WorldRenderSubsystem::remove_render_object(flecs::entity entity)
 {
-    Mat4 object_transform = Mat4::make_translate(transform.world_position) *
-                            transform.world_rotation.matrix() *
-                            Mat4::make_scale(transform.world_scale);
+    const u64 id = entity.id();
+    if (!render_entities.contains(id)) return;
 
+    RenderEntity& render_entity = render_entities[id];
+    if (render_entity.registered) {
+        Engine::instance()->renderer->unregister_object(render_entity.handle);
+        render_entity.registered = false;
+    }
+
+    // Entities in waiting_entities keep theirs until they're visited, so
+    // that they aren't added there twice
+    if (!render_entity.waiting) render_entities.remove(id);
+}
+
+void WorldRenderSubsystem::update_render_object(
+    flecs::entity              entity,
+    const TransformComponent&  transform,
+    const StaticMeshComponent& mesh,
+    const MaterialComponent&   material)
+{
     Engine* engine = Engine::instance();
 
-    if (!mesh.mesh.is_valid()) {
-        mesh.asset.resolve();
-        mesh.mesh = resolve(mesh.asset.cached_id);
+    const u64 id = entity.id();
+
+    // Resolved handles are cached through get_mut, which (unlike writing
+    // through the query) doesn't flag the table as changed
+    THandle<Mesh> mesh_handle = mesh.mesh;
+    if (!mesh_handle.is_valid()) {
+        StaticMeshComponent* cached = entity.get_mut<StaticMeshComponent>();
+        cached->asset.resolve();
+        cached->mesh = resolve(cached->asset.cached_id);
+        mesh_handle  = cached->mesh;
+
+        const AssetID asset_id = cached->asset.cached_id;
+        if (engine->asset_system->get_load_state(asset_id) ==
+            AssetLoadState::Failed)
+        {
+            return;
+        }
+    }
+
+    // Skipped until the mesh is loaded
+    if (!mesh_handle.is_valid()) {
+        if (!render_entities.contains(id)) {
+            render_entities.add(id, RenderEntity{.registered = false});
+        }
+
+        RenderEntity& render_entity = render_entities[id];
+        if (!render_entity.waiting) {
+            render_entity.waiting = true;
+            waiting_entities.add(entity);
+        }
+        return;
     }
 
-    Mesh* mesh_ptr = get(mesh.mesh);
+    Mesh* mesh_ptr = get(mesh_handle);
     ASSERT(mesh_ptr);
 
-    if (material.instance == nullptr) {
-        material.instance =
+    MaterialInstance* material_instance = material.instance;
+    if (material_instance == nullptr) {
+        material_instance =
             engine->renderer->material_system.find_material(material.name);
+        entity.get_mut<MaterialComponent>()->instance = material_instance;
     }
 
-    ASSERT(material.instance);
+    ASSERT(material_instance);
 
-    render_objects.add(RenderObject{
+    RenderObject object = {
         .mesh      = mesh_ptr,
-        .material  = material.instance,
-        .transform = object_transform,
-    });
+        .material  = material_instance,
+        .transform = transform.world_matrix,
+        .bounds =
+            {
+                .origin  = mesh_ptr->bounds.origin,
+                .radius  = mesh_ptr->bounds.radius,
+                .extents = mesh_ptr->bounds.extents,
+                .valid   = mesh_ptr->bounds.radius > 0.f,
+            },
+    };
+
+    if (render_entities.contains(id) && render_entities[id].registered) {
+        engine->renderer->update_object(render_entities[id].handle, object);
+        return;
+    }
+
+    RenderEntity render_entity = {
+        .handle     = engine->renderer->register_object(object),
+        .registered = true,
+        .waiting    = false,
+    };
+
+    if (render_entities.contains(id)) {
+        render_entities[id] = render_entity;
+    } else {
+        render_entities.add(id, render_entity);
+    }
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 #include "Builtin.h"
 #include "Containers/Array.h"
+#include "Containers/Map.h"
 #include "Core/Handle.h"
 #include "ECS.h"
 #include "Engine/AssetSystem.h"
 #include "Engine/SubsystemManager.h"
+#include "Renderer/BatchSystem.h"
 #include "Renderer/Mesh.h"
 #include "Renderer/RenderObject.h"
 
@@ -12,25 +14,72 @@ struct WorldRenderSubsystem : ISubsystem {
     void init() override;
     void deinit() override;
 
+    /**
+     * The mesh of the asset, if it's loaded. Otherwise, starts loading the
+     * asset in the background and returns an invalid handle
+     */
     THandle<Mesh> resolve(const AssetID& id);
     Mesh*         get(THandle<Mesh> handle);
 
     void update(struct Engine* engine);
 
 private:
-    flecs::query<TransformComponent, StaticMeshComponent, MaterialComponent>
+    flecs::query<
+        const TransformComponent,
+        const StaticMeshComponent,
+        const MaterialComponent>
         collection_query;
 
+    /** Unregisters the render object of entities that stop matching */
+    flecs::observer removal_observer;
+
+    /**
+     * Registers or updates the render object of the entity. Entities whose
+     * mesh is still loading are drawn once it's loaded
+     */
     void update_render_object(
-        TransformComponent&  transform,
-        StaticMeshComponent& mesh,
-        MaterialComponent&   material);
+        flecs::entity              entity,
+        const TransformComponent&  transform,
+        const StaticMeshComponent& mesh,
+        const MaterialComponent&   material);
+
+    /** Updates the waiting entities whose mesh finished loading */
+    void update_waiting_entities();
+
+    /**
+     * Reloads the mesh or texture of a changed asset. The previous data is
+     * drawn until the new one is loaded
+     */
+    void on_asset_changed(AssetID id, Str path);
+
+    /** Swaps in the reloaded meshes that finished loading */
+    void update_reloading_meshes();
+
+    void remove_render_object(flecs::entity entity);
 
     /**
-     * Loads mesh to GPU
+     * Loads mesh to GPU. The mesh doesn't keep pointers to the asset data,
+     * which can be unloaded once this returns
      */
-    THandle<Mesh>                submit_mesh(const AssetID& id);
+    THandle<Mesh>                submit_mesh(const AssetID& id, Asset& asset);
+    /** Uploads the mesh of the asset, see submit_mesh */
+    Mesh                         upload_mesh(Asset& asset);
     THandleSystem<AssetID, Mesh> meshes;
+    /** Meshes whose asset changed, loading in the background */
+    TArray<AssetID>              reloading_meshes;
 
-    TArray<RenderObject> render_objects;
+    struct RenderEntity {
+        NamedIndex<RenderObject> handle;
+        bool                     registered;
+        /** In waiting_entities */
+        bool                     waiting;
+    };
+
+    /** Render objects registered with the renderer, by entity id */
+    TMap<u64, RenderEntity> render_entities;
+    /**
+     * Entities skipped while their mesh loads. Since the query only visits
+     * changed tables, they are retried separately
+     */
+    TArray<flecs::entity>   waiting_entities;
 };
\ No newline at end of file
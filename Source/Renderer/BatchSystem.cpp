@@ -0,0 +1,977 @@
+#include "BatchSystem.h"
+
+#include "Containers/Extras.h"
+#include "Core/RadixSort.h"
+#include "Renderer.h"
+#include "tracy/Tracy.hpp"
+
+static constexpr u32 Cull_Group_Size   = 256;
+static constexpr u32 Initial_Instances = 1024;
+static constexpr u32 Initial_Batches   = 64;
+static constexpr u32 Initial_Meshlets  = 256;
+static constexpr u32 Sort_Key_Seed     = 0x5EED;
+
+/**
+ * Extracts the (normalized) frustum planes out of a view projection matrix.
+ * The projection is expected to map depth to [0, 1]
+ */
+static void extract_frustum_planes(const glm::mat4& m, glm::vec4 planes[6])
+{
+    glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;  // Left
+    planes[1] = row3 - row0;  // Right
+    planes[2] = row3 + row1;  // Bottom
+    planes[3] = row3 - row1;  // Top
+    planes[4] = row2;         // Near
+    planes[5] = row3 - row2;  // Far
+
+    for (int i = 0; i < 6; ++i) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+void BatchSystem::init(Renderer* renderer)
+{
+    ZoneScopedN("BatchSystem.init");
+    owner = renderer;
+
+    ShaderEffect* cull_effect = owner->material_system.build_compute_effect(
+        LIT("Shaders/indirect_cull.comp.spv"));
+    cull_shader = owner->material_system.build_compute_shader(cull_effect);
+
+    init_pass(forward_pass, MeshPassType::Forward);
+}
+
+void BatchSystem::deinit()
+{
+    deinit_pass(forward_pass);
+    vkDestroyPipeline(owner->device, cull_shader->pipeline, nullptr);
+}
+
+void BatchSystem::init_pass(MeshPass& pass, MeshPassType type)
+{
+    VMA& vma = owner->vma;
+
+    pass.type                    = type;
+    pass.multibatches.alloc      = &owner->allocator;
+    pass.indirect_batches.alloc  = &owner->allocator;
+    pass.unbatched_objects.alloc = &owner->allocator;
+    pass.flat_batches.alloc      = &owner->allocator;
+    pass.objects.alloc           = &owner->allocator;
+    pass.resuable_objects.alloc  = &owner->allocator;
+    pass.objects_to_delete.alloc = &owner->allocator;
+    pass.instances.alloc         = &owner->allocator;
+    pass.meshlets.alloc          = &owner->allocator;
+
+    pass.pass_objects_buffer =
+        VMA_CREATE_BUFFER(
+            vma,
+            sizeof(GPUInstance) * Initial_Instances,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+
+    pass.compacted_instance_buffer =
+        VMA_CREATE_BUFFER(
+            vma,
+            sizeof(u32) * Initial_Instances,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+
+    pass.clear_indirect_buffer =
+        VMA_CREATE_BUFFER(
+            vma,
+            sizeof(GPUIndirectObject) * Initial_Batches,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+
+    pass.draw_indirect_buffer =
+        VMA_CREATE_BUFFER(
+            vma,
+            sizeof(GPUIndirectObject) * Initial_Batches,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+
+    pass.meshlet_buffer =
+        VMA_CREATE_BUFFER(
+            vma,
+            sizeof(GPUMeshlet) * Initial_Meshlets,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+
+    pass.cluster_object_buffer =
+        VMA_CREATE_BUFFER(
+            vma,
+            Cluster_Objects_Offset + sizeof(u32) * Initial_Instances,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+}
+
+void BatchSystem::deinit_pass(MeshPass& pass)
+{
+    VMA& vma = owner->vma;
+    VMA_DESTROY_BUFFER(vma, pass.pass_objects_buffer);
+    VMA_DESTROY_BUFFER(vma, pass.compacted_instance_buffer);
+    VMA_DESTROY_BUFFER(vma, pass.clear_indirect_buffer);
+    VMA_DESTROY_BUFFER(vma, pass.draw_indirect_buffer);
+    VMA_DESTROY_BUFFER(vma, pass.meshlet_buffer);
+    VMA_DESTROY_BUFFER(vma, pass.cluster_object_buffer);
+
+    pass.multibatches.release();
+    pass.indirect_batches.release();
+    pass.unbatched_objects.release();
+    pass.flat_batches.release();
+    pass.objects.release();
+    pass.resuable_objects.release();
+    pass.objects_to_delete.release();
+    pass.instances.release();
+    pass.meshlets.release();
+}
+
+BatchSystem::PassObject* BatchSystem::MeshPass::get(
+    NamedIndex<PassObject> index)
+{
+    return &objects[index.index];
+}
+
+void BatchSystem::add_object(NamedIndex<RenderObject> handle)
+{
+    forward_pass.unbatched_objects.add(handle);
+}
+
+void BatchSystem::remove_object(NamedIndex<RenderObject> handle)
+{
+    RenderObject& object = owner->render_objects[handle.index];
+
+    if (object.pass_index >= 0) {
+        forward_pass.objects_to_delete.add(
+            NamedIndex<PassObject>{(u32)object.pass_index});
+        object.pass_index = -1;
+        return;
+    }
+
+    // Registered and removed before the pass was refreshed
+    for (u64 i = 0; i < forward_pass.unbatched_objects.size; ++i) {
+        if (forward_pass.unbatched_objects[i] == handle) {
+            forward_pass.unbatched_objects.del(i);
+            break;
+        }
+    }
+}
+
+u64 BatchSystem::calculate_sort_key(const PassObject& object)
+{
+    // [pipeline: 16 | material set: 24 | mesh: 24]
+    // Collisions only cost batching efficiency, batches still compare the
+    // actual mesh & material
+    u64 pipeline =
+        hash_of((u64)object.material.shader_pass->pipeline, Sort_Key_Seed);
+    u64 material_set =
+        hash_of((u64)object.material.material_set, Sort_Key_Seed);
+    u64 mesh = hash_of((u64)object.mesh, Sort_Key_Seed);
+
+    return ((pipeline & 0xFFFF) << 48) | ((material_set & 0xFFFFFF) << 24) |
+           (mesh & 0xFFFFFF);
+}
+
+void BatchSystem::refresh_pass(MeshPass& pass)
+{
+    ZoneScopedN("BatchSystem.refresh_pass");
+
+    if ((pass.objects_to_delete.size == 0) &&
+        (pass.unbatched_objects.size == 0))
+    {
+        return;
+    }
+
+    // Remove deleted objects
+    if (pass.objects_to_delete.size > 0) {
+        for (NamedIndex<PassObject> index : pass.objects_to_delete) {
+            pass.get(index)->mesh = nullptr;
+            pass.resuable_objects.add(index);
+        }
+        pass.objects_to_delete.empty();
+
+        u64 num_alive = 0;
+        for (u64 i = 0; i < pass.flat_batches.size; ++i) {
+            const RenderBatch& batch = pass.flat_batches[i];
+            if (pass.get(batch.pass_object)->mesh != nullptr) {
+                pass.flat_batches[num_alive++] = batch;
+            }
+        }
+        pass.flat_batches.size = num_alive;
+    }
+
+    // Insert new objects
+    if (pass.unbatched_objects.size > 0) {
+        const u64 num_new = pass.unbatched_objects.size;
+
+        Slice<RenderBatch> new_batches =
+            alloc_slice<RenderBatch>(owner->frame_arena, num_new);
+        Slice<RenderBatch> scratch =
+            alloc_slice<RenderBatch>(owner->frame_arena, num_new);
+
+        for (u64 i = 0; i < num_new; ++i) {
+            NamedIndex<RenderObject> handle = pass.unbatched_objects[i];
+            RenderObject& render_object = owner->render_objects[handle.index];
+
+            PassObject object = {
+                .material =
+                    {
+                        .material_set = render_object.material->pass_sets,
+                        .shader_pass =
+                            render_object.material->base
+                                ->pass_shaders[render_object.mesh->format],
+                    },
+                .mesh        = render_object.mesh,
+                .original    = handle,
+                .built_batch = -1,
+                .custom_key  = 0,
+            };
+
+            NamedIndex<PassObject> index;
+            if (pass.resuable_objects.size > 0) {
+                index = *pass.resuable_objects.last();
+                pass.resuable_objects.pop();
+                pass.objects[index.index] = object;
+            } else {
+                index = NamedIndex<PassObject>{(u32)pass.objects.size};
+                pass.objects.add(object);
+            }
+
+            render_object.pass_index = (i32)index.index;
+
+            new_batches[i] = RenderBatch{
+                .pass_object = index,
+                .sort_key    = calculate_sort_key(object),
+            };
+        }
+        pass.unbatched_objects.empty();
+
+        radix_sort(new_batches, scratch, [](const RenderBatch& batch) {
+            return batch.sort_key;
+        });
+
+        // Merge the sorted new batches into the sorted flat batches
+        const u64          num_old = pass.flat_batches.size;
+        Slice<RenderBatch> merged =
+            alloc_slice<RenderBatch>(owner->frame_arena, num_old + num_new);
+
+        u64 o = 0, n = 0, m = 0;
+        while ((o < num_old) && (n < num_new)) {
+            if (pass.flat_batches[o].sort_key <= new_batches[n].sort_key) {
+                merged[m++] = pass.flat_batches[o++];
+            } else {
+                merged[m++] = new_batches[n++];
+            }
+        }
+        while (o < num_old) merged[m++] = pass.flat_batches[o++];
+        while (n < num_new) merged[m++] = new_batches[n++];
+
+        pass.flat_batches.empty();
+        for (const RenderBatch& batch : merged) {
+            pass.flat_batches.add(batch);
+        }
+    }
+
+    build_batches(pass);
+}
+
+void BatchSystem::build_batches(MeshPass& pass)
+{
+    ZoneScopedN("BatchSystem.build_batches");
+
+    pass.multibatches.empty();
+    pass.indirect_batches.empty();
+    pass.instances.empty();
+    pass.meshlets.empty();
+    pass.command_count          = 0;
+    pass.instance_slots         = 0;
+    pass.needs_indirect_refresh = true;
+    pass.needs_instance_refresh = true;
+
+    if (pass.flat_batches.size == 0) return;
+
+    // Each run of equal (material, mesh) becomes an indirect batch
+    for (u64 i = 0; i < pass.flat_batches.size; ++i) {
+        PassObject* object = pass.get(pass.flat_batches[i].pass_object);
+
+        IndirectBatch* batch = pass.indirect_batches.size > 0
+                                   ? pass.indirect_batches.last()
+                                   : nullptr;
+
+        if ((batch == nullptr) || (batch->mesh != object->mesh) ||
+            !(batch->material == object->material))
+        {
+            pass.indirect_batches.add(IndirectBatch{
+                .mesh     = object->mesh,
+                .material = object->material,
+                .count    = 0,
+            });
+            batch = pass.indirect_batches.last();
+        }
+
+        batch->count++;
+        object->built_batch = (i32)(pass.indirect_batches.size - 1);
+    }
+
+    // Every LOD of a batch needs room for all of its objects. The meshlets
+    // only get room for max_cluster_objects of them, the cull shader draws the
+    // rest with their whole LOD 0
+    MeshPool& mesh_pool = owner->mesh_pool;
+    for (IndirectBatch& batch : pass.indirect_batches) {
+        const DrawMesh& draw = mesh_pool.get(batch.mesh->draw_mesh);
+
+        batch.lod_count     = draw.lod_count;
+        batch.meshlet_count = (u32)draw.meshlets.count;
+        batch.first         = pass.instance_slots;
+        batch.first_command = pass.command_count;
+        batch.first_meshlet = (u32)pass.meshlets.size;
+        batch.cluster_slots = batch.meshlet_count > 0
+                                  ? std::min(batch.count, max_cluster_objects)
+                                  : 0;
+
+        pass.instance_slots += batch.count * batch.lod_count +
+                               batch.cluster_slots * batch.meshlet_count;
+        pass.command_count += batch.command_count();
+
+        for (const Meshlet& meshlet : draw.meshlets) {
+            pass.meshlets.add(GPUMeshlet{
+                .sphere = glm::vec4(meshlet.center, meshlet.radius),
+                .cone   = glm::vec4(meshlet.cone_axis, meshlet.cone_cutoff),
+            });
+        }
+    }
+
+    for (const RenderBatch& flat_batch : pass.flat_batches) {
+        PassObject*    object = pass.get(flat_batch.pass_object);
+        IndirectBatch& batch  = pass.indirect_batches[object->built_batch];
+        pass.instances.add(GPUInstance{
+            .object_id = object->original.index,
+            .batch_id  = batch.first_command,
+        });
+    }
+
+    // Consecutive batches that share buffers and material are drawn together
+    Multibatch multibatch = {
+        .batch = 0,
+        .first = 0,
+        .count = pass.indirect_batches[0].command_count(),
+    };
+    for (u64 i = 1; i < pass.indirect_batches.size; ++i) {
+        const IndirectBatch& prev  = pass.indirect_batches[i - 1];
+        const IndirectBatch& batch = pass.indirect_batches[i];
+
+        const DrawMesh& prev_draw = mesh_pool.get(prev.mesh->draw_mesh);
+        const DrawMesh& draw      = mesh_pool.get(batch.mesh->draw_mesh);
+
+        bool same_mesh_buffers = (prev_draw.vertex_page == draw.vertex_page) &&
+                                 (prev_draw.index_page == draw.index_page);
+        bool same_material = prev.material == batch.material;
+
+        if (same_mesh_buffers && same_material) {
+            multibatch.count += batch.command_count();
+        } else {
+            pass.multibatches.add(multibatch);
+            multibatch = {
+                .batch = (u32)i,
+                .first = batch.first_command,
+                .count = batch.command_count(),
+            };
+        }
+    }
+    pass.multibatches.add(multibatch);
+}
+
+void BatchSystem::cull_pass(
+    VkCommandBuffer  cmd,
+    FrameData&       frame,
+    MeshPass&        pass,
+    const glm::mat4& view,
+    const glm::mat4& proj)
+{
+    ZoneScopedN("BatchSystem.cull_pass");
+
+    const u64 instance_count = pass.instances.size;
+    const u64 batch_count    = pass.indirect_batches.size;
+    const u64 command_count  = pass.command_count;
+    if (batch_count == 0) return;
+
+    VMA&           vma      = owner->vma;
+    DeletionQueue& deletion = frame.deletion;
+
+    const VkDeviceSize instances_size = sizeof(GPUInstance) * instance_count;
+    const VkDeviceSize commands_size =
+        sizeof(GPUIndirectObject) * command_count;
+    const VkDeviceSize meshlets_size = sizeof(GPUMeshlet) * pass.meshlets.size;
+
+    // Grow pass buffers; their contents are lost so everything is reuploaded
+    bool reallocated = false;
+    reallocated |= owner->reserve_buffer(
+        pass.pass_objects_buffer,
+        instances_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        deletion);
+    reallocated |= owner->reserve_buffer(
+        pass.compacted_instance_buffer,
+        sizeof(u32) * pass.instance_slots,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        deletion);
+    reallocated |= owner->reserve_buffer(
+        pass.clear_indirect_buffer,
+        commands_size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        deletion);
+    reallocated |= owner->reserve_buffer(
+        pass.draw_indirect_buffer,
+        commands_size,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        deletion);
+    reallocated |= owner->reserve_buffer(
+        pass.meshlet_buffer,
+        meshlets_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        deletion);
+    reallocated |= owner->reserve_buffer(
+        pass.cluster_object_buffer,
+        Cluster_Objects_Offset + sizeof(u32) * instance_count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        deletion);
+
+    if (reallocated) {
+        pass.needs_instance_refresh = true;
+        pass.needs_indirect_refresh = true;
+    }
+
+    // Draw commands hold mesh offsets, which change when the pool compacts
+    if (pass.mesh_pool_generation != owner->mesh_pool.generation) {
+        pass.needs_indirect_refresh = true;
+        pass.mesh_pool_generation   = owner->mesh_pool.generation;
+    }
+
+    write_frame_descriptors(frame, pass);
+
+    // The previous frame may still be reading the pass buffers
+    {
+        VkMemoryBarrier barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = 0,
+        };
+        vkCmdPipelineBarrier(
+            cmd,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+    }
+
+    // Upload instances, meshlets & cleared draw commands
+    if (pass.needs_instance_refresh || pass.needs_indirect_refresh) {
+        // [instances | commands | meshlets]
+        const VkDeviceSize meshlets_offset = instances_size + commands_size;
+
+        owner->reserve_buffer(
+            frame.staging_buffer,
+            meshlets_offset + meshlets_size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_ONLY,
+            deletion);
+
+        u8* staging = (u8*)VMA_MAP(vma, frame.staging_buffer);
+        memcpy(staging, pass.instances.data, instances_size);
+        memcpy(staging + meshlets_offset, pass.meshlets.data, meshlets_size);
+
+        GPUIndirectObject* commands =
+            (GPUIndirectObject*)(staging + instances_size);
+        for (u64 i = 0; i < batch_count; ++i) {
+            const IndirectBatch& batch = pass.indirect_batches[i];
+            const DrawMesh& draw = owner->mesh_pool.get(batch.mesh->draw_mesh);
+
+            // LODs, then the meshlets of LOD 0
+            for (u32 c = 0; c < batch.command_count(); ++c) {
+                MeshLod range          = {};
+                u32     first_instance = batch.first;
+                if (c < batch.lod_count) {
+                    range = draw.lods[c];
+                    first_instance += c * batch.count;
+                } else {
+                    const u32      m       = c - batch.lod_count;
+                    const Meshlet& meshlet = draw.meshlets[m];
+                    range.first_index      = meshlet.first_index;
+                    range.index_count      = meshlet.index_count;
+                    first_instance += batch.lod_count * batch.count +
+                                      m * batch.cluster_slots;
+                }
+
+                VkDrawIndexedIndirectCommand command = {
+                    .indexCount    = range.index_count,
+                    .instanceCount = 0,
+                    .firstIndex    = draw.first_index + range.first_index,
+                    .vertexOffset  = (i32)draw.first_vertex,
+                    .firstInstance = first_instance,
+                };
+
+                commands[batch.first_command + c] = {
+                    .command         = command,
+                    .object_id       = 0,
+                    .batch_id        = (u32)i,
+                    .lod_count       = batch.lod_count,
+                    .meshlet_count   = batch.meshlet_count,
+                    .first_meshlet   = batch.first_meshlet,
+                    .cluster_slots   = batch.cluster_slots,
+                    .cluster_objects = 0,
+                };
+            }
+        }
+        VMA_UNMAP(vma, frame.staging_buffer);
+
+        VkBufferCopy instances_copy = {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size      = instances_size,
+        };
+        vkCmdCopyBuffer(
+            cmd,
+            frame.staging_buffer.buffer,
+            pass.pass_objects_buffer.buffer,
+            1,
+            &instances_copy);
+
+        VkBufferCopy commands_copy = {
+            .srcOffset = instances_size,
+            .dstOffset = 0,
+            .size      = commands_size,
+        };
+        vkCmdCopyBuffer(
+            cmd,
+            frame.staging_buffer.buffer,
+            pass.clear_indirect_buffer.buffer,
+            1,
+            &commands_copy);
+
+        if (pass.meshlets.size > 0) {
+            VkBufferCopy meshlets_copy = {
+                .srcOffset = meshlets_offset,
+                .dstOffset = 0,
+                .size      = meshlets_size,
+            };
+            vkCmdCopyBuffer(
+                cmd,
+                frame.staging_buffer.buffer,
+                pass.meshlet_buffer.buffer,
+                1,
+                &meshlets_copy);
+        }
+
+        VkMemoryBarrier barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+
+        pass.needs_instance_refresh = false;
+        pass.needs_indirect_refresh = false;
+    }
+
+    // Reset instance counts of the draw commands, and the cluster pass to no
+    // workgroups
+    {
+        VkBufferCopy copy = {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size      = commands_size,
+        };
+        vkCmdCopyBuffer(
+            cmd,
+            pass.clear_indirect_buffer.buffer,
+            pass.draw_indirect_buffer.buffer,
+            1,
+            &copy);
+
+        const VkDispatchIndirectCommand no_groups = {
+            .x = 0,
+            .y = 1,
+            .z = 1,
+        };
+        vkCmdUpdateBuffer(
+            cmd,
+            pass.cluster_object_buffer.buffer,
+            0,
+            sizeof(no_groups),
+            &no_groups);
+
+        VkMemoryBarrier barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+    }
+
+    // Cull
+    {
+        // The camera position is the translation of the inverse view
+        const glm::vec3 camera_position = glm::inverse(view)[3];
+
+        GPUCullData cull_data = {
+            .camera          = glm::vec4(camera_position, glm::abs(proj[1][1])),
+            .instance_count  = (u32)instance_count,
+            .cull_enabled    = cull_enabled ? 1u : 0u,
+            .lod_screen_size = lod_screen_size,
+            .cluster_pass    = 0,
+        };
+        extract_frustum_planes(proj * view, cull_data.frustum);
+
+        vkCmdBindPipeline(
+            cmd,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            cull_shader->pipeline);
+        vkCmdBindDescriptorSets(
+            cmd,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            cull_shader->layout,
+            0,
+            1,
+            &frame.cull_descriptor,
+            0,
+            nullptr);
+        vkCmdPushConstants(
+            cmd,
+            cull_shader->layout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(GPUCullData),
+            &cull_data);
+
+        u32 group_count =
+            (u32)((instance_count + Cull_Group_Size - 1) / Cull_Group_Size);
+        vkCmdDispatch(cmd, group_count, 1, 1);
+
+        // The cluster pass runs a workgroup for each object that the object
+        // pass handed to it
+        if (pass.meshlets.size > 0) {
+            VkMemoryBarrier barrier = {
+                .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                 VK_ACCESS_SHADER_READ_BIT |
+                                 VK_ACCESS_SHADER_WRITE_BIT,
+            };
+            vkCmdPipelineBarrier(
+                cmd,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &barrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            cull_data.cluster_pass = 1;
+            vkCmdPushConstants(
+                cmd,
+                cull_shader->layout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(GPUCullData),
+                &cull_data);
+
+            vkCmdDispatchIndirect(cmd, pass.cluster_object_buffer.buffer, 0);
+        }
+
+        VkMemoryBarrier barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask =
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            cmd,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+    }
+}
+
+void BatchSystem::draw_pass(
+    VkCommandBuffer cmd, FrameData& frame, MeshPass& pass, u32 global_offset)
+{
+    draw_multibatches(
+        cmd,
+        frame,
+        pass,
+        global_offset,
+        0,
+        u32(pass.multibatches.size));
+}
+
+void BatchSystem::draw_multibatches(
+    VkCommandBuffer cmd,
+    FrameData&      frame,
+    MeshPass&       pass,
+    u32             global_offset,
+    u32             first,
+    u32             count)
+{
+    ZoneScopedN("BatchSystem.draw_multibatches");
+
+    ShaderPass*     last_shader       = nullptr;
+    VkDescriptorSet last_material_set = VK_NULL_HANDLE;
+    VkBuffer        last_vertices     = VK_NULL_HANDLE;
+    VkBuffer        last_indices      = VK_NULL_HANDLE;
+
+    for (u32 i = first; i < first + count; ++i) {
+        const Multibatch& multibatch = pass.multibatches[i];
+
+        const IndirectBatch& batch  = pass.indirect_batches[multibatch.batch];
+        ShaderPass*          shader = batch.material.shader_pass;
+
+        // Bind material
+        if (shader != last_shader) {
+            vkCmdBindPipeline(
+                cmd,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                shader->pipeline);
+
+            vkCmdBindDescriptorSets(
+                cmd,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                shader->layout,
+                0,
+                1,
+                &frame.global_descriptor,
+                1,
+                &global_offset);
+
+            vkCmdBindDescriptorSets(
+                cmd,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                shader->layout,
+                1,
+                1,
+                &frame.object_descriptor,
+                0,
+                nullptr);
+
+            last_shader       = shader;
+            last_material_set = VK_NULL_HANDLE;
+        }
+
+        if ((shader->effect->num_valid_layouts() > 2) &&
+            (batch.material.material_set != last_material_set))
+        {
+            vkCmdBindDescriptorSets(
+                cmd,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                shader->layout,
+                2,
+                1,
+                &batch.material.material_set,
+                0,
+                nullptr);
+            last_material_set = batch.material.material_set;
+        }
+
+        // Bind mesh pool pages, which most batches share
+        MeshPool&       mesh_pool = owner->mesh_pool;
+        const DrawMesh& draw      = mesh_pool.get(batch.mesh->draw_mesh);
+        VkBuffer        vertices  = mesh_pool.page_buffer(draw.vertex_page);
+        VkBuffer        indices   = mesh_pool.page_buffer(draw.index_page);
+        VkDeviceSize    offset    = 0;
+
+        // Index pages hold a single index type, so the buffer decides it
+        if (indices != last_indices) {
+            vkCmdBindIndexBuffer(
+                cmd,
+                indices,
+                offset,
+                batch.mesh->index_type());
+            last_indices = indices;
+        }
+
+        if (vertices != last_vertices) {
+            vkCmdBindVertexBuffers(cmd, 0, 1, &vertices, &offset);
+            last_vertices = vertices;
+        }
+
+        vkCmdDrawIndexedIndirect(
+            cmd,
+            pass.draw_indirect_buffer.buffer,
+            multibatch.first * sizeof(GPUIndirectObject),
+            multibatch.count,
+            sizeof(GPUIndirectObject));
+    }
+}
+
+void BatchSystem::write_frame_descriptors(FrameData& frame, MeshPass& pass)
+{
+    VkDescriptorBufferInfo object_info = {
+        .buffer = frame.object_buffer.buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+    VkDescriptorBufferInfo pass_objects_info = {
+        .buffer = pass.pass_objects_buffer.buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+    VkDescriptorBufferInfo draw_info = {
+        .buffer = pass.draw_indirect_buffer.buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+    VkDescriptorBufferInfo instance_info = {
+        .buffer = pass.compacted_instance_buffer.buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+    VkDescriptorBufferInfo meshlet_info = {
+        .buffer = pass.meshlet_buffer.buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+    VkDescriptorBufferInfo cluster_info = {
+        .buffer = pass.cluster_object_buffer.buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE,
+    };
+
+    if (frame.cull_descriptor == VK_NULL_HANDLE) {
+        CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+        ASSERT(DescriptorBuilder::create(
+                   temp,
+                   &owner->desc.cache,
+                   &owner->desc.allocator)
+                   .bind_buffer(
+                       0,
+                       &object_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+                   .bind_buffer(
+                       1,
+                       &pass_objects_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+                   .bind_buffer(
+                       2,
+                       &draw_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+                   .bind_buffer(
+                       3,
+                       &instance_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+                   .bind_buffer(
+                       4,
+                       &meshlet_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+                   .bind_buffer(
+                       5,
+                       &cluster_info,
+                       VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                       VK_SHADER_STAGE_COMPUTE_BIT)
+                   .build(frame.cull_descriptor));
+    }
+
+    // This frame's sets aren't in use by the GPU anymore, so buffers that
+    // were reallocated can be rebound in place
+    VkWriteDescriptorSet writes[8];
+    auto write = [](VkDescriptorSet         set,
+                    u32                     binding,
+                    VkDescriptorBufferInfo* info) {
+        return VkWriteDescriptorSet{
+            .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext           = nullptr,
+            .dstSet          = set,
+            .dstBinding      = binding,
+            .descriptorCount = 1,
+            .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo     = info,
+        };
+    };
+
+    writes[0] = write(frame.cull_descriptor, 0, &object_info);
+    writes[1] = write(frame.cull_descriptor, 1, &pass_objects_info);
+    writes[2] = write(frame.cull_descriptor, 2, &draw_info);
+    writes[3] = write(frame.cull_descriptor, 3, &instance_info);
+    writes[4] = write(frame.cull_descriptor, 4, &meshlet_info);
+    writes[5] = write(frame.cull_descriptor, 5, &cluster_info);
+    writes[6] = write(frame.object_descriptor, 0, &object_info);
+    writes[7] = write(frame.object_descriptor, 1, &instance_info);
+
+    vkUpdateDescriptorSets(
+        owner->device,
+        ARRAY_COUNT(writes),
+        writes,
+        0,
+        nullptr);
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include "Containers/Array.h"
+#include "RenderObject.h"
+#include "RendererTypes.h"
+#include "VulkanCommon/VulkanCommon.h"
+
+struct Mesh;
+struct MaterialInstance;
+struct ShaderPass;
+
+template <typename T>
+struct NamedIndex {
+    u32 index;
+
+    bool operator==(const NamedIndex& other) const
+    {
+        return index == other.index;
+    }
+};
+
+/**
+ * Indirect draw command as consumed by vkCmdDrawIndexedIndirect, with extra
+ * data used by the culling shader. Must match DrawCommand in
+ * indirect_cull.comp
+ */
+struct GPUIndirectObject {
+    VkDrawIndexedIndirectCommand command;
+    uint32_t                     object_id;
+    uint32_t                     batch_id;
+    /** LODs of the batch, set on its first (full detail) command */
+    uint32_t                     lod_count;
+    /** Meshlets of the batch, set on its first command too */
+    uint32_t                     meshlet_count;
+    /** First of the batch's meshlets in MeshPass::meshlets */
+    uint32_t                     first_meshlet;
+    /** Objects each meshlet command of the batch has room for */
+    uint32_t                     cluster_slots;
+    /** Objects of the batch handed to the cluster pass, counted by the GPU */
+    uint32_t                     cluster_objects;
+};
+
+/** Must match GPUInstance in indirect_cull.comp */
+struct GPUInstance {
+    u32 object_id;
+    /** First draw command of the object's batch */
+    u32 batch_id;
+};
+
+/** Meshlet bounds in object space. Must match Meshlet in indirect_cull.comp */
+struct GPUMeshlet {
+    /** xyz: Center, w: radius */
+    glm::vec4 sphere;
+    /** xyz: Axis, w: cutoff, see Meshlet */
+    glm::vec4 cone;
+};
+
+/**
+ * MeshPass::cluster_object_buffer starts with the indirect dispatch of the
+ * cluster pass, followed by the pass instances that the object pass handed
+ * to it, one workgroup each. Must match ClusterObjectBuffer in
+ * indirect_cull.comp
+ */
+static constexpr VkDeviceSize Cluster_Objects_Offset = 16;
+
+/** Push constants of indirect_cull.comp, at the 128 bytes all devices take */
+struct GPUCullData {
+    glm::vec4 frustum[6];
+    /** xyz: Camera position, w: proj[1][1] */
+    glm::vec4 camera;
+    /** Instances of the object pass */
+    u32       instance_count;
+    u32       cull_enabled;
+    f32       lod_screen_size;
+    u32       cluster_pass;
+};
+
+struct BatchSystem {
+    struct PassMaterial {
+        VkDescriptorSet material_set;
+        ShaderPass*     shader_pass;
+
+        bool operator==(const PassMaterial& other) const
+        {
+            return (material_set == other.material_set) &&
+                   (shader_pass == other.shader_pass);
+        }
+    };
+
+    struct PassObject {
+        PassMaterial             material;
+        Mesh*                    mesh;
+        NamedIndex<RenderObject> original;
+        i32                      built_batch;
+        u32                      custom_key;
+    };
+
+    struct RenderBatch {
+        NamedIndex<PassObject> pass_object;
+        u64                    sort_key;
+
+        bool operator==(const RenderBatch& other) const
+        {
+            return (pass_object == other.pass_object) &&
+                   (sort_key == other.sort_key);
+        }
+    };
+
+    /**
+     * Objects of the same mesh and material. Each LOD of the mesh gets a
+     * draw command of its own, with count instance slots, and the culling
+     * shader adds every visible object to the command of its LOD.
+     *
+     * Meshes with meshlets also get a command per meshlet, after the LODs.
+     * Up to cluster_slots objects drawn at LOD 0 skip its command, and are
+     * added to the command of each of their meshlets that passes the cluster
+     * pass instead; any more are drawn whole
+     */
+    struct IndirectBatch {
+        Mesh*        mesh;
+        PassMaterial material;
+        /** First instance slot */
+        u32          first;
+        u32          count;
+        u32          first_command;
+        u32          lod_count;
+        /** First of the mesh's meshlets in MeshPass::meshlets */
+        u32          first_meshlet;
+        u32          meshlet_count;
+        /** Instance slots of each meshlet command */
+        u32          cluster_slots;
+
+        u32 command_count() const { return lod_count + meshlet_count; }
+    };
+
+    /** A range of draw commands that can be drawn with a single call */
+    struct Multibatch {
+        /** The indirect batch of the first command */
+        u32 batch;
+        u32 first;
+        u32 count;
+    };
+
+    struct MeshPass {
+        TArray<Multibatch>               multibatches;
+        TArray<IndirectBatch>            indirect_batches;
+        TArray<NamedIndex<RenderObject>> unbatched_objects;
+        /** Batches of all pass objects, sorted by sort_key */
+        TArray<RenderBatch>              flat_batches;
+        TArray<PassObject>               objects;
+        TArray<NamedIndex<PassObject>>   resuable_objects;
+        TArray<NamedIndex<PassObject>>   objects_to_delete;
+        TArray<GPUInstance>              instances;
+        TArray<GPUMeshlet>               meshlets;
+        /** Draw commands and instance slots of all indirect batches */
+        u32                              command_count  = 0;
+        u32                              instance_slots = 0;
+
+        AllocatedBuffer<u32>                compacted_instance_buffer;
+        AllocatedBuffer<GPUInstance>        pass_objects_buffer;
+        AllocatedBuffer<GPUIndirectObject>  draw_indirect_buffer;
+        AllocatedBuffer<GPUIndirectObject>  clear_indirect_buffer;
+        AllocatedBuffer<GPUMeshlet>         meshlet_buffer;
+        /** Filled by the object pass, see Cluster_Objects_Offset */
+        AllocatedBuffer<u32>                cluster_object_buffer;
+
+        PassObject*  get(NamedIndex<PassObject> index);
+        MeshPassType type;
+
+        bool needs_indirect_refresh = true;
+        bool needs_instance_refresh = true;
+        /** MeshPool::generation the draw commands were written with */
+        u64  mesh_pool_generation   = 0;
+    };
+
+    void init(struct Renderer* renderer);
+    void deinit();
+
+    /** Queues a registered render object for insertion into its passes */
+    void add_object(NamedIndex<RenderObject> handle);
+
+    /** Queues a render object for removal from the passes it's in */
+    void remove_object(NamedIndex<RenderObject> handle);
+
+    /**
+     * Applies pending insertions and removals to the pass. Only the changed
+     * objects are sorted, then merged into the sorted flat batch list; the
+     * indirect batches are rebuilt only if anything changed
+     */
+    void refresh_pass(MeshPass& pass);
+
+    /**
+     * Uploads the batches of the pass and records the culling dispatches,
+     * which fill draw_indirect_buffer and compacted_instance_buffer: one
+     * picks the LOD of every visible object, and the cluster pass culls the
+     * meshlets of the objects drawn at LOD 0. Has to be recorded outside of
+     * a render pass
+     */
+    void cull_pass(
+        VkCommandBuffer  cmd,
+        FrameData&       frame,
+        MeshPass&        pass,
+        const glm::mat4& view,
+        const glm::mat4& proj);
+
+    /** Records one indirect draw per multibatch of the pass */
+    void draw_pass(
+        VkCommandBuffer cmd,
+        FrameData&      frame,
+        MeshPass&       pass,
+        u32             global_offset);
+
+    /**
+     * Records the draws of count multibatches, starting at first. Only reads
+     * the pass, so disjoint ranges can be recorded on different threads
+     */
+    void draw_multibatches(
+        VkCommandBuffer cmd,
+        FrameData&      frame,
+        MeshPass&       pass,
+        u32             global_offset,
+        u32             first,
+        u32             count);
+
+    MeshPass    forward_pass;
+    ShaderPass* cull_shader         = nullptr;
+    bool        cull_enabled        = true;
+    /**
+     * Objects whose bounding sphere is smaller than this fraction of the
+     * viewport height are drawn with LOD 1, and every halving of their size
+     * moves them one LOD further
+     */
+    f32         lod_screen_size     = 0.25f;
+    /**
+     * Objects of a batch whose meshlets are culled on their own, per frame.
+     * Bounds the instance slots of the meshlet commands
+     */
+    u32         max_cluster_objects = 256;
+
+private:
+    void init_pass(MeshPass& pass, MeshPassType type);
+    void deinit_pass(MeshPass& pass);
+    void build_batches(MeshPass& pass);
+    void write_frame_descriptors(FrameData& frame, MeshPass& pass);
+
+    static u64 calculate_sort_key(const PassObject& object);
+
+    struct Renderer* owner;
+};
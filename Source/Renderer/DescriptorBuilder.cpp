@@ -71,6 +71,17 @@ DescriptorBuilder& DescriptorBuilder::bind_image(
 
 bool DescriptorBuilder::build(
     VkDescriptorSet& set, VkDescriptorSetLayout& layout)
+{
+    layout = build_layout();
+
+    bool success = descriptor_allocator->allocate(&set, layout);
+    if (!success) return false;
+
+    update(set);
+    return true;
+}
+
+VkDescriptorSetLayout DescriptorBuilder::build_layout()
 {
     VkDescriptorSetLayoutCreateInfo create_info = {
         .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -80,11 +91,11 @@ bool DescriptorBuilder::build(
         .pBindings    = bindings.data,
     };
 
-    layout = cache->create_layout(&create_info);
-
-    bool success = descriptor_allocator->allocate(&set, layout);
-    if (!success) return false;
+    return cache->create_layout(&create_info);
+}
 
+void DescriptorBuilder::update(VkDescriptorSet set)
+{
     for (VkWriteDescriptorSet& w : writes) {
         w.dstSet = set;
     }
@@ -95,6 +106,4 @@ bool DescriptorBuilder::build(
         writes.data,
         0,
         nullptr);
-
-    return true;
 }
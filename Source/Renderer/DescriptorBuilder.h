@@ -28,6 +28,15 @@ struct DescriptorBuilder {
         return build(set, layout);
     }
 
+    /** The layout of the bound bindings, from the layout cache */
+    VkDescriptorSetLayout build_layout();
+
+    /**
+     * Writes the bound bindings to a set that was already allocated with the
+     * layout of the builder, e.g. a recycled one
+     */
+    void update(VkDescriptorSet set);
+
     DescriptorLayoutCache*               cache;
     DescriptorAllocator*                 descriptor_allocator;
     TArray<VkWriteDescriptorSet>         writes;
@@ -17,6 +17,14 @@ bool MaterialData::operator==(const MaterialData& other) const
     return true;
 }
 
+/** Vertex shader of the forward passes, for each vertex format */
+static Str Forward_Vertex_Shaders[VertexFormat::Count] = {
+    "",
+    "Shaders/tri_mesh_ssbo_instanced.vert.spv",
+    "Shaders/tri_mesh_ssbo_instanced_compact.vert.spv",
+    "Shaders/tri_mesh_ssbo_instanced_compact_nocolor.vert.spv",
+};
+
 void MaterialSystem::init(Renderer* renderer)
 {
     ZoneScopedN("MaterialSystem.init");
@@ -24,15 +32,13 @@ void MaterialSystem::init(Renderer* renderer)
     template_cache.init(System_Allocator);
     materials.init(System_Allocator);
     material_cache.init(System_Allocator);
+    free_sets.alloc = &System_Allocator;
 
     CREATE_SCOPED_ARENA(System_Allocator, temp_alloc, KILOBYTES(1));
 
-    VertexInputInfo vertex_input_info = Vertex::get_input_info(temp_alloc);
-
-    // Build default templates
+    // Pipeline state shared by the forward passes
     {
         forward_builder = PipelineBuilder(System_Allocator);
-        forward_builder.set_vertex_input_info(vertex_input_info);
         forward_builder.set_primitive_topology(
             VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
         forward_builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
@@ -42,40 +48,38 @@ void MaterialSystem::init(Renderer* renderer)
         forward_builder.add_dynamic_state(VK_DYNAMIC_STATE_SCISSOR);
     }
 
-    // Build effects
+    EffectTemplate textured_template;
+    EffectTemplate colored_template;
 
-    ShaderEffect* textured_lit = build_effect(
-        LIT("Shaders/tri_mesh_ssbo_instanced.vert.spv"),
-        LIT("Shaders/textured_lit.frag.spv"));
+    // Build effects & passes, for each vertex format
+    for (u32 i = 1; i < VertexFormat::Count; ++i) {
+        EVertexFormat format = EVertexFormat(i);
 
-    ShaderEffect* colored_lit = build_effect(
-        LIT("Shaders/tri_mesh_ssbo_instanced.vert.spv"),
-        LIT("Shaders/colored_lit.frag.spv"));
+        forward_builder.set_vertex_input_info(
+            Vertex::get_input_info(temp_alloc, format));
 
-    ShaderPass* textured_lit_pass = build_shader(
-        renderer->color_pass.render_pass,
-        forward_builder,
-        textured_lit);
+        ShaderEffect* textured_lit = build_effect(
+            Forward_Vertex_Shaders[format],
+            LIT("Shaders/textured_lit.frag.spv"));
 
-    ShaderPass* colored_lit_pass = build_shader(
-        renderer->color_pass.render_pass,
-        forward_builder,
-        colored_lit);
+        ShaderEffect* colored_lit = build_effect(
+            Forward_Vertex_Shaders[format],
+            LIT("Shaders/colored_lit.frag.spv"));
 
-    // Build Default textured template
-    {
-        EffectTemplate effect_template;
-        effect_template.pass_shaders = textured_lit_pass;
+        textured_template.pass_shaders[format] = build_shader(
+            renderer->color_pass.render_pass,
+            forward_builder,
+            textured_lit);
 
-        template_cache.add(LIT("default-opaque-textured"), effect_template);
+        colored_template.pass_shaders[format] = build_shader(
+            renderer->color_pass.render_pass,
+            forward_builder,
+            colored_lit);
     }
 
-    {
-        EffectTemplate effect_template;
-        effect_template.pass_shaders = colored_lit_pass;
-
-        template_cache.add(LIT("default-opaque-colored"), effect_template);
-    }
+    // Build default templates
+    template_cache.add(LIT("default-opaque-textured"), textured_template);
+    template_cache.add(LIT("default-opaque-colored"), colored_template);
 }
 
 void MaterialSystem::deinit()
@@ -83,6 +87,7 @@ void MaterialSystem::deinit()
     template_cache.release();
     materials.release();
     material_cache.release();
+    free_sets.release();
 }
 
 ShaderEffect* MaterialSystem::build_effect(Str vert_path, Str frag_path)
@@ -125,6 +130,49 @@ ShaderPass* MaterialSystem::build_shader(
     return result;
 }
 
+ShaderEffect* MaterialSystem::build_compute_effect(Str comp_path)
+{
+    ShaderEffect* effect = alloc<ShaderEffect>(System_Allocator);
+
+    effect->init(System_Allocator);
+    effect->add_stage(
+        owner->shader_cache.get_shader(comp_path),
+        VK_SHADER_STAGE_COMPUTE_BIT);
+
+    effect->reflect_layout(owner->device, {});
+
+    return effect;
+}
+
+ShaderPass* MaterialSystem::build_compute_shader(ShaderEffect* effect)
+{
+    ShaderPass* result = alloc<ShaderPass>(System_Allocator);
+    result->effect     = effect;
+    result->layout     = effect->built_layout;
+
+    ASSERT(effect->stages.size == 1);
+    ShaderEffect::Stage& stage = effect->stages[0];
+
+    VkComputePipelineCreateInfo create_info = {
+        .sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext  = nullptr,
+        .flags  = 0,
+        .stage  = make_pipeline_shader_stage_create_info(
+            stage.stage,
+            stage.mod->mod),
+        .layout = effect->built_layout,
+    };
+
+    VK_CHECK(vkCreateComputePipelines(
+        owner->device,
+        VK_NULL_HANDLE,
+        1,
+        &create_info,
+        nullptr,
+        &result->pipeline));
+    return result;
+}
+
 MaterialInstance* MaterialSystem::build_material(
     Str material_name, const MaterialData& material_data)
 {
@@ -137,8 +185,36 @@ MaterialInstance* MaterialSystem::build_material(
     MaterialInstance* result = alloc<MaterialInstance>(System_Allocator);
     result->base             = &template_cache[material_data.base_template];
 
-    result->textures = material_data.textures;
+    // The cache key keeps its own copy, since the views of the material can
+    // be replaced later on
+    const u64 count = material_data.textures.count;
+
+    Slice<SampledTexture> key_textures =
+        alloc_slice<SampledTexture>(System_Allocator, count);
+    Slice<SampledTexture> textures =
+        alloc_slice<SampledTexture>(System_Allocator, count);
+    for (u64 i = 0; i < count; ++i) {
+        key_textures[i] = material_data.textures[i];
+        textures[i]     = material_data.textures[i];
+    }
+
+    MaterialData key = material_data;
+    key.textures     = key_textures;
+    result->textures = textures;
+
+    build_material_set(result);
 
+    print(LIT("Built new material {}\n"), material_name);
+
+    material_cache.add(key, result);
+    materials.add(material_name, result);
+
+    return result;
+}
+
+VkDescriptorSetLayout MaterialSystem::build_material_set(
+    MaterialInstance* material)
+{
     CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
 
     DescriptorBuilder builder = DescriptorBuilder::create(
@@ -146,10 +222,10 @@ MaterialInstance* MaterialSystem::build_material(
         &owner->desc.cache,
         &owner->desc.allocator);
 
-    for (int i = 0; i < material_data.textures.count; ++i) {
+    for (int i = 0; i < material->textures.count; ++i) {
         VkDescriptorImageInfo image_info = {};
-        image_info.sampler               = material_data.textures[i].sampler;
-        image_info.imageView             = material_data.textures[i].view;
+        image_info.sampler               = material->textures[i].sampler;
+        image_info.imageView             = material->textures[i].view;
         image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
         builder.bind_image(
@@ -159,14 +235,52 @@ MaterialInstance* MaterialSystem::build_material(
             VK_SHADER_STAGE_FRAGMENT_BIT);
     }
 
-    ASSERT(builder.build(result->pass_sets));
+    const VkDescriptorSetLayout layout = builder.build_layout();
+    for (u64 i = 0; i < free_sets.size; ++i) {
+        if (free_sets[i].layout != layout) continue;
 
-    print(LIT("Built new material {}\n"), material_name);
+        material->pass_sets = free_sets[i].set;
+        free_sets[i]        = *free_sets.last();
+        free_sets.pop();
 
-    material_cache.add(material_data, result);
-    materials.add(material_name, result);
+        builder.update(material->pass_sets);
+        return layout;
+    }
 
-    return result;
+    ASSERT(builder.build(material->pass_sets));
+    return layout;
+}
+
+void MaterialSystem::replace_view(
+    VkImageView                from_view,
+    VkImageView                to_view,
+    TArray<MaterialInstance*>& changed,
+    DeletionQueue&             deletion)
+{
+    for (auto pair : material_cache) {
+        MaterialInstance* material = pair.val;
+
+        bool uses_view = false;
+        for (SampledTexture& texture : material->textures) {
+            if (texture.view == from_view) {
+                texture.view = to_view;
+                uses_view    = true;
+            }
+        }
+
+        if (!uses_view) continue;
+
+        // The new set has the same layout as the old one, which is free
+        // again once no frame in flight uses it
+        const FreeSet old_set = {
+            .set    = material->pass_sets,
+            .layout = build_material_set(material),
+        };
+        changed.add(material);
+
+        deletion.add_lambda([this, old_set]() { free_sets.add(old_set); });
+
+    }
 }
 
 MaterialInstance* MaterialSystem::find_material(Str name)
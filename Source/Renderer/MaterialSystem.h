@@ -1,5 +1,8 @@
 #pragma once
 #include "Containers/Map.h"
+#include "Core/DeletionQueue.h"
+#include "Core/Handle.h"
+#include "Core/Utility.h"
 #include "PipelineBuilder.h"
 #include "Shader.h"
 
@@ -20,8 +23,13 @@ struct ShaderPass {
 };
 
 struct SampledTexture {
-    VkSampler   sampler;
-    VkImageView view;
+    VkSampler        sampler;
+    VkImageView      view;
+    /**
+     * Texture the view belongs to, if it comes from the texture system, so
+     * that the renderer can request its mips
+     */
+    THandle<Texture> texture;
 
     _inline bool operator==(const SampledTexture& other) const
     {
@@ -32,7 +40,8 @@ struct SampledTexture {
 struct ShaderParameters {};
 
 struct EffectTemplate {
-    ShaderPass*       pass_shaders;
+    /** A pass per vertex format, since each needs its own vertex input */
+    ShaderPass*       pass_shaders[core::VertexFormat::Count] = {};
     ShaderParameters* parameters;
 };
 
@@ -40,6 +49,7 @@ struct MaterialInstance {
     EffectTemplate* base;
     VkDescriptorSet pass_sets;
 
+    /** Owned by the material */
     Slice<SampledTexture> textures;
     ShaderParameters*     parameters;
 };
@@ -78,15 +88,45 @@ struct MaterialSystem {
           PipelineBuilder& builder,
           ShaderEffect*    effect);
 
+    ShaderEffect* build_compute_effect(Str comp_path);
+    ShaderPass*   build_compute_shader(ShaderEffect* effect);
+
     MaterialInstance* build_material(
         Str material_name, const MaterialData& material_data);
 
     MaterialInstance* find_material(Str name);
 
+    /**
+     * Points the materials that sample from_view to to_view instead, with
+     * other descriptor sets since the old ones may still be in use. The old
+     * sets are recycled once the frames that used them are done
+     * @param changed Receives the materials that changed
+     * @param deletion Retires the old sets
+     */
+    void replace_view(
+        VkImageView                from_view,
+        VkImageView                to_view,
+        TArray<MaterialInstance*>& changed,
+        DeletionQueue&             deletion);
+
 private:
+    /** A descriptor set no frame uses anymore, to be written again */
+    struct FreeSet {
+        VkDescriptorSet       set;
+        VkDescriptorSetLayout layout;
+    };
+
+    /**
+     * Writes the descriptor set of the material textures to a free set of
+     * the same layout, or to a newly allocated one
+     * @return The layout of the set
+     */
+    VkDescriptorSetLayout build_material_set(MaterialInstance* material);
+
     TMap<Str, EffectTemplate>             template_cache;
     TMap<Str, MaterialInstance*>          materials;
     TMap<MaterialData, MaterialInstance*> material_cache;
     PipelineBuilder                       forward_builder;
+    TArray<FreeSet>                       free_sets;
     struct Renderer*                      owner;
 };
\ No newline at end of file
@@ -2,47 +2,116 @@
 
 #include "Containers/Extras.h"
 
-VertexInputInfo Vertex::get_input_info(Allocator& allocator)
+VertexInputInfo Vertex::get_input_info(
+    Allocator& allocator, EVertexFormat format)
 {
+    static_assert(sizeof(Vertex_P3fN3fC3fU2f) == sizeof(Vertex));
+
+    // Formats without color leave location 2 unbound, and are drawn with
+    // shaders that don't read it
+    const bool has_color = format != VertexFormat::P4hN2sU2s;
+
     VertexInputInfo result = {
         .bindings = alloc_slice<VkVertexInputBindingDescription>(allocator, 1),
-        .attributes =
-            alloc_slice<VkVertexInputAttributeDescription>(allocator, 4),
+        .attributes = alloc_slice<VkVertexInputAttributeDescription>(
+            allocator,
+            has_color ? 4 : 3),
     };
 
     result.bindings[0] = {
         .binding   = 0,
-        .stride    = sizeof(Vertex),
+        .stride    = vertex_size_of(format),
         .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
     };
 
-    result.attributes[0] = {
-        .location = 0,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset   = (u32)OFFSET_OF(Vertex, position),
-    };
-
-    result.attributes[1] = {
-        .location = 1,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset   = (u32)OFFSET_OF(Vertex, normal),
-    };
-
-    result.attributes[2] = {
-        .location = 2,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset   = (u32)OFFSET_OF(Vertex, color),
-    };
-
-    result.attributes[3] = {
-        .location = 3,
-        .binding  = 0,
-        .format   = VK_FORMAT_R32G32_SFLOAT,
-        .offset   = (u32)OFFSET_OF(Vertex, uv),
-    };
+    switch (format) {
+        case VertexFormat::P3fN3fC3fU2f: {
+            result.attributes[0] = {
+                .location = 0,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32B32_SFLOAT,
+                .offset   = (u32)OFFSET_OF(Vertex, position),
+            };
+
+            result.attributes[1] = {
+                .location = 1,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32B32_SFLOAT,
+                .offset   = (u32)OFFSET_OF(Vertex, normal),
+            };
+
+            result.attributes[2] = {
+                .location = 2,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32B32_SFLOAT,
+                .offset   = (u32)OFFSET_OF(Vertex, color),
+            };
+
+            result.attributes[3] = {
+                .location = 3,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32_SFLOAT,
+                .offset   = (u32)OFFSET_OF(Vertex, uv),
+            };
+        } break;
+
+        case VertexFormat::P4hN2sC4bU2s: {
+            result.attributes[0] = {
+                .location = 0,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16B16A16_SFLOAT,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sC4bU2s, position),
+            };
+
+            result.attributes[1] = {
+                .location = 1,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16_SNORM,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sC4bU2s, normal),
+            };
+
+            result.attributes[2] = {
+                .location = 2,
+                .binding  = 0,
+                .format   = VK_FORMAT_R8G8B8A8_UNORM,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sC4bU2s, color),
+            };
+
+            result.attributes[3] = {
+                .location = 3,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16_UNORM,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sC4bU2s, uv),
+            };
+        } break;
+
+        case VertexFormat::P4hN2sU2s: {
+            result.attributes[0] = {
+                .location = 0,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16B16A16_SFLOAT,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sU2s, position),
+            };
+
+            result.attributes[1] = {
+                .location = 1,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16_SNORM,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sU2s, normal),
+            };
+
+            result.attributes[2] = {
+                .location = 3,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16_UNORM,
+                .offset   = (u32)OFFSET_OF(Vertex_P4hN2sU2s, uv),
+            };
+        } break;
+
+        default:
+            ASSERT(false);
+            break;
+    }
 
     return result;
 }
@@ -50,47 +119,43 @@ VertexInputInfo Vertex::get_input_info(Allocator& allocator)
 Result<Mesh, EAssetLoadError> Mesh::load_from_asset(
     Allocator& allocator, Str path)
 {
-    static_assert(sizeof(Vertex_P3fN3fC3fU2f) == sizeof(Vertex));
     auto load_result = Asset::load(allocator, path);
 
     if (!load_result.ok()) {
         return Err(load_result.err());
     }
 
-    Asset asset = load_result.value();
-
-    ASSERT(asset.info.kind == AssetKind::Mesh);
-    ASSERT(asset.info.mesh.format == VertexFormat::P3fN3fC3fU2f);
-
-    Slice<Vertex> vertices = slice<Vertex>(
-        (Vertex*)asset.blob.ptr,
-        asset.info.mesh.vertex_buffer_size);
-
-    Slice<u32> indices = slice<u32>(
-        (u32*)(asset.blob.ptr + asset.info.mesh.vertex_buffer_size * sizeof(Vertex)),
-        asset.info.mesh.index_buffer_size);
-
-    return Ok(Mesh{
-        .vertices = vertices,
-        .indices  = indices,
-    });
+    return Ok(from_asset(load_result.value()));
 }
 
 Mesh Mesh::from_asset(const Asset& asset)
 {
     ASSERT(asset.info.kind == AssetKind::Mesh);
-    ASSERT(asset.info.mesh.format == VertexFormat::P3fN3fC3fU2f);
 
-    Slice<Vertex> vertices = slice<Vertex>(
-        (Vertex*)asset.blob.ptr,
-        asset.info.mesh.vertex_buffer_size);
+    const EVertexFormat format = asset.info.mesh.format;
+    const u32           stride = vertex_size_of(format);
+    ASSERT(stride != 0);
+
+    Slice<u8> vertices = slice<u8>(
+        asset.blob.ptr,
+        asset.info.mesh.vertex_buffer_size * stride);
 
-    Slice<u32> indices = slice<u32>(
-        (u32*)(asset.blob.ptr + asset.info.mesh.vertex_buffer_size * sizeof(Vertex)),
-        asset.info.mesh.index_buffer_size);
+    const EIndexFormat index_format = asset.info.mesh.index_format;
 
-    return Mesh{
-        .vertices = vertices,
-        .indices  = indices,
+    Slice<u8> indices = slice<u8>(
+        asset.blob.ptr + vertices.count,
+        asset.info.mesh.index_buffer_size * index_size_of(index_format));
+
+    Mesh result = {
+        .vertices     = vertices,
+        .format       = format,
+        .indices      = indices,
+        .index_format = index_format,
+        .bounds       = asset.info.mesh.bounds,
     };
+    result.lod_count = read_mesh_lods(asset, result.lods);
+    result.meshlets  = slice<u8>(
+        asset.blob.ptr + mesh_meshlets_offset(asset.info.mesh),
+        asset.info.mesh.meshlet_count * sizeof(Meshlet));
+    return result;
 }
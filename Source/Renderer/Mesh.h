@@ -1,7 +1,9 @@
 #pragma once
 #include "AssetLibrary/AssetLibrary.h"
 #include "Core/MathTypes.h"
+#include "MeshPool.h"
 #include "Result.h"
+#include "UploadQueue.h"
 #include "VMA.h"
 #include "VulkanCommon/VulkanCommon.h"
 #include "vk_mem_alloc.h"
@@ -11,22 +13,54 @@ struct Vertex {
     glm::vec3              normal;
     glm::vec3              color;
     glm::vec2              uv;
-    static VertexInputInfo get_input_info(Allocator& allocator);
+
+    /**
+     * Vertex input of meshes in format. Vertex itself is P3fN3fC3fU2f; the
+     * compact formats are packed at conversion time, see pack_vertices
+     */
+    static VertexInputInfo get_input_info(
+        Allocator&    allocator,
+        EVertexFormat format = VertexFormat::P3fN3fC3fU2f);
 };
 
 struct Mesh {
-    Slice<Vertex>     vertices;
-    Slice<u32>        indices;
-    AllocatedBuffer<> gpu_buffer;
-    AllocatedBuffer<> gpu_index_buffer;
+    /** Vertices in format, vertex_size_of(format) bytes each */
+    Slice<u8>         vertices;
+    EVertexFormat     format = VertexFormat::P3fN3fC3fU2f;
+    /** Indices in index_format, index_size_of(index_format) bytes each */
+    Slice<u8>         indices;
+    EIndexFormat      index_format        = IndexFormat::U32;
+    /** LODs as ranges of indices, none if indices are a single LOD */
+    MeshLod           lods[Max_Mesh_Lods] = {};
+    u32               lod_count           = 0;
+    /** Meshlet table of the full detail LOD, may not be aligned */
+    Slice<u8>         meshlets;
+    MeshBounds        bounds;
+    /** Where the mesh is in the mesh pool, see Renderer::upload_mesh */
+    THandle<DrawMesh> draw_mesh;
+    /** Ready once the vertices & indices are uploaded */
+    UploadTicket      upload;
 
     static Result<Mesh, EAssetLoadError> load_from_asset(
         Allocator& allocator, Str path);
 
     static Mesh from_asset(const Asset& asset);
+
+    u64 index_count() const
+    {
+        return indices.count / index_size_of(index_format);
+    }
+
+    u64 meshlet_count() const { return meshlets.count / sizeof(Meshlet); }
+
+    VkIndexType index_type() const
+    {
+        return (index_format == IndexFormat::U16) ? VK_INDEX_TYPE_UINT16
+                                                  : VK_INDEX_TYPE_UINT32;
+    }
 };
 
 static _inline bool operator==(Mesh& left, Mesh& right)
 {
-    return left.gpu_buffer.buffer == right.gpu_buffer.buffer;
+    return left.draw_mesh.id == right.draw_mesh.id;
 }
\ No newline at end of file
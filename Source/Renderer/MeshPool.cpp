@@ -0,0 +1,232 @@
+#include "MeshPool.h"
+
+#include "Containers/Extras.h"
+#include "Mesh.h"
+#include "Renderer.h"
+#include "tracy/Tracy.hpp"
+
+/** Page sizes in bytes. Meshes larger than a page get a page of their own */
+static constexpr u64 Vertex_Page_Size = MEGABYTES(32);
+static constexpr u64 Index_Page_Size  = MEGABYTES(8);
+
+static VkBufferUsageFlags page_usage(bool is_index)
+{
+    // Pages are copied from when they're compacted
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    usage |= is_index ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+                      : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    return usage;
+}
+
+void MeshPool::init(Renderer* renderer)
+{
+    owner                  = renderer;
+    pages.alloc            = &owner->allocator;
+    draw_meshes.alloc      = &owner->allocator;
+    free_draw_meshes.alloc = &owner->allocator;
+}
+
+void MeshPool::deinit()
+{
+    for (u64 i = 0; i < pages.size; ++i) {
+        VMA_DESTROY_BUFFER(owner->vma, pages[i].buffer);
+        pages[i].ranges.deinit();
+    }
+
+    for (DrawMesh& draw : draw_meshes) {
+        if (draw.in_use && (draw.meshlets.count > 0)) {
+            owner->allocator.release((umm)draw.meshlets.ptr);
+        }
+    }
+
+    pages.release();
+    draw_meshes.release();
+    free_draw_meshes.release();
+}
+
+THandle<DrawMesh> MeshPool::add(Mesh& mesh)
+{
+    ZoneScoped;
+
+    const u32 vertex_stride = vertex_size_of(mesh.format);
+    const u32 index_stride  = index_size_of(mesh.index_format);
+    ASSERT(vertex_stride != 0);
+
+    DrawMesh draw = {
+        .index_count  = (u32)mesh.index_count(),
+        .vertex_count = (u32)(mesh.vertices.count / vertex_stride),
+        .in_use       = true,
+    };
+    ASSERT((draw.index_count > 0) && (draw.vertex_count > 0));
+
+    if (mesh.lod_count > 0) {
+        draw.lod_count = mesh.lod_count;
+        memcpy(draw.lods, mesh.lods, sizeof(draw.lods));
+    } else {
+        draw.lod_count = 1;
+        draw.lods[0]   = {.first_index = 0, .index_count = draw.index_count};
+    }
+
+    if (mesh.meshlets.count > 0) {
+        draw.meshlets =
+            alloc_slice<Meshlet>(owner->allocator, mesh.meshlet_count());
+        memcpy(draw.meshlets.ptr, mesh.meshlets.ptr, mesh.meshlets.count);
+    }
+
+    u64 first_vertex, first_index;
+    draw.vertex_page = allocate(
+        false,
+        mesh.format,
+        vertex_stride,
+        draw.vertex_count,
+        first_vertex);
+    draw.index_page = allocate(
+        true,
+        mesh.index_format,
+        index_stride,
+        draw.index_count,
+        first_index);
+    draw.first_vertex = (u32)first_vertex;
+    draw.first_index  = (u32)first_index;
+
+    UploadQueue& upload_queue = owner->upload_queue;
+    upload_queue.upload_buffer(
+        page_buffer(draw.vertex_page),
+        mesh.vertices.ptr,
+        mesh.vertices.size(),
+        first_vertex * vertex_stride);
+    mesh.upload = upload_queue.upload_buffer(
+        page_buffer(draw.index_page),
+        mesh.indices.ptr,
+        mesh.indices.size(),
+        first_index * index_stride);
+
+    THandle<DrawMesh> result;
+    if (free_draw_meshes.size > 0) {
+        result = *free_draw_meshes.last();
+        free_draw_meshes.pop();
+        get(result) = draw;
+    } else {
+        draw_meshes.add(draw);
+        result = THandle<DrawMesh>((u32)draw_meshes.size);
+    }
+
+    return result;
+}
+
+void MeshPool::remove(THandle<DrawMesh> handle)
+{
+    DrawMesh& draw = get(handle);
+    ASSERT(draw.in_use);
+
+    pages[draw.vertex_page].ranges.free(draw.first_vertex, draw.vertex_count);
+    pages[draw.index_page].ranges.free(draw.first_index, draw.index_count);
+    if (draw.meshlets.count > 0) {
+        owner->allocator.release((umm)draw.meshlets.ptr);
+    }
+
+    draw.in_use = false;
+    free_draw_meshes.add(handle);
+}
+
+u32 MeshPool::allocate(
+    bool is_index, u32 format, u32 stride, u64 count, u64& offset)
+{
+    for (u64 i = 0; i < pages.size; ++i) {
+        Page& page = pages[i];
+        if ((page.is_index != is_index) || (page.format != format)) continue;
+
+        offset = page.ranges.allocate(count);
+        if (offset != RangeAllocator::Invalid_Offset) return (u32)i;
+    }
+
+    const u64 page_size = is_index ? Index_Page_Size : Vertex_Page_Size;
+    const u64 capacity  = glm::max(page_size / stride, count);
+
+    Page page = {
+        .buffer   = VMA_CREATE_BUFFER(
+                      owner->vma,
+                      capacity * stride,
+                      page_usage(is_index),
+                      VMA_MEMORY_USAGE_GPU_ONLY)
+                      .unwrap(),
+        .stride   = stride,
+        .format   = format,
+        .is_index = is_index,
+    };
+    page.ranges.init(owner->allocator, capacity);
+    pages.add(page);
+
+    offset = pages.last()->ranges.allocate(count);
+    return (u32)(pages.size - 1);
+}
+
+void MeshPool::defragment(f32 max_fragmentation)
+{
+    for (u64 i = 0; i < pages.size; ++i) {
+        RangeAllocator& ranges = pages[i].ranges;
+        if (ranges.fragmented_size() > ranges.capacity * max_fragmentation) {
+            compact((u32)i);
+        }
+    }
+}
+
+void MeshPool::compact(u32 page_index)
+{
+    ZoneScoped;
+    Page& page = pages[page_index];
+
+    AllocatedBufferBase old_buffer = page.buffer;
+    page.buffer = VMA_CREATE_BUFFER(
+                      owner->vma,
+                      old_buffer.size,
+                      page_usage(page.is_index),
+                      VMA_MEMORY_USAGE_GPU_ONLY)
+                      .unwrap();
+
+    // Reallocating every range of the page in order packs them together
+    TArray<VkBufferCopy> regions(&owner->allocator);
+    DEFER(regions.release());
+
+    page.ranges.reset();
+    for (u64 i = 0; i < draw_meshes.size; ++i) {
+        DrawMesh& draw = draw_meshes[i];
+        if (!draw.in_use) continue;
+
+        u32* first;
+        u32  count;
+        if (page.is_index && (draw.index_page == page_index)) {
+            first = &draw.first_index;
+            count = draw.index_count;
+        } else if (!page.is_index && (draw.vertex_page == page_index)) {
+            first = &draw.first_vertex;
+            count = draw.vertex_count;
+        } else {
+            continue;
+        }
+
+        u64 offset = page.ranges.allocate(count);
+        regions.add(VkBufferCopy{
+            .srcOffset = u64(*first) * page.stride,
+            .dstOffset = offset * page.stride,
+            .size      = u64(count) * page.stride,
+        });
+        *first = (u32)offset;
+    }
+
+    UploadQueue& upload_queue = owner->upload_queue;
+    if (regions.size > 0) {
+        upload_queue.copy_buffer(
+            old_buffer.buffer,
+            page.buffer.buffer,
+            slice(regions));
+    }
+
+    // Frames submitted before the copy may still read the old buffer, and
+    // they're done by the time it is
+    upload_queue.on_complete_lambda(
+        [this, old_buffer]() { VMA_DESTROY_BUFFER(owner->vma, old_buffer); });
+
+    generation++;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "AssetLibrary/AssetLibrary.h"
+#include "Containers/Array.h"
+#include "Core/Handle.h"
+#include "Core/RangeAllocator.h"
+#include "Core/Utility.h"
+#include "VMA.h"
+#include "VulkanCommon/VulkanCommon.h"
+
+struct Mesh;
+
+/** Where the vertices and indices of a mesh are in the mesh pool */
+struct DrawMesh {
+    u32            first_vertex;
+    u32            first_index;
+    u32            index_count;
+    u32            vertex_count;
+    /** Pages holding the vertices and indices, see MeshPool::pages */
+    u32            vertex_page;
+    u32            index_page;
+    /** LODs, finest first. Their indices start at first_index */
+    MeshLod        lods[Max_Mesh_Lods];
+    u32            lod_count;
+    /** Meshlets of LOD 0, if any. Their indices start at first_index too */
+    Slice<Meshlet> meshlets;
+    /** False once removed, until the slot is reused */
+    bool           in_use;
+};
+
+/**
+ * Sub-allocates the vertex and index buffers of all meshes out of a few large
+ * buffers (pages), so that batches of different meshes share binds and can
+ * be drawn by a single indirect call. A page only holds one vertex or index
+ * format, and is allocated in units of its elements, which makes allocation
+ * offsets the vertexOffset and firstIndex of draws. Pages are added when none
+ * of the right format has room.
+ *
+ * Removing meshes leaves holes in their pages. defragment compacts the pages
+ * that have too many, by copying their meshes to a new buffer on the upload
+ * queue; meshes move when it does, which bumps generation.
+ */
+struct MeshPool {
+    struct Page {
+        AllocatedBuffer<> buffer;
+        RangeAllocator    ranges;
+        /** Element size in bytes */
+        u32               stride;
+        /** EVertexFormat of vertex pages, EIndexFormat of index pages */
+        u32               format;
+        bool              is_index;
+    };
+
+    void init(struct Renderer* renderer);
+    void deinit();
+
+    /**
+     * Allocates the vertices and indices of mesh, and queues their upload.
+     * mesh.upload tells when they're ready. Meshlets are copied, since the
+     * batch system reads them every time it builds draw commands
+     */
+    THandle<DrawMesh> add(Mesh& mesh);
+
+    /** Frees the ranges of a mesh; the mesh must not be drawn anymore */
+    void remove(THandle<DrawMesh> handle);
+
+    DrawMesh& get(THandle<DrawMesh> handle)
+    {
+        return draw_meshes[handle.id - 1];
+    }
+
+    VkBuffer page_buffer(u32 page) { return pages[page].buffer.buffer; }
+
+    /**
+     * Compacts the pages where holes take more than max_fragmentation of
+     * their capacity
+     */
+    void defragment(f32 max_fragmentation = 0.25f);
+
+    /** Changes every time meshes move, i.e. when a page is compacted */
+    u64 generation = 0;
+
+    TArray<Page>     pages;
+    TArray<DrawMesh> draw_meshes;
+
+private:
+    /** @return The page the range was allocated in */
+    u32 allocate(
+        bool is_index, u32 format, u32 stride, u64 count, u64& offset);
+    void compact(u32 page_index);
+
+    TArray<THandle<DrawMesh>> free_draw_meshes;
+    struct Renderer*          owner;
+};
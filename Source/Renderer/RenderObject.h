@@ -14,8 +14,18 @@ static _inline bool operator==(Material& left, Material& right)
     return left.pipeline == right.pipeline;
 }
 
+struct RenderBounds {
+    glm::vec3 origin;
+    float     radius;
+    glm::vec3 extents;
+    bool      valid;
+};
+
 struct RenderObject {
     Mesh*                    mesh;
     struct MaterialInstance* material;
     glm::mat4                transform;
+    RenderBounds             bounds;
+    /** Index of the pass object in the forward pass, -1 if not batched */
+    i32                      pass_index = -1;
 };
\ No newline at end of file
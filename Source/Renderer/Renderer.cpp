@@ -27,6 +27,9 @@ void Renderer::init()
     present_pass.images.alloc       = &allocator;
     present_pass.image_views.alloc  = &allocator;
     present_pass.framebuffers.alloc = &allocator;
+    render_objects.alloc            = &allocator;
+    free_render_objects.alloc       = &allocator;
+    mesh_replacements.alloc         = &allocator;
     main_deletion_queue             = DeletionQueue(allocator);
     swap_chain_deletion_queue       = DeletionQueue(allocator);
 
@@ -35,8 +38,15 @@ void Renderer::init()
 
     CREATE_SCOPED_ARENA(allocator, temp_alloc, MEGABYTES(1));
 
-    Slice<const char*> required_window_ext = window->get_required_extensions();
-    window->on_resized.bind_raw(this, &Renderer::on_resize_presentation);
+    Slice<const char*> required_window_ext;
+    if (!headless) {
+        required_window_ext = window->get_required_extensions();
+        window->on_resized.bind_raw(this, &Renderer::on_resize_presentation);
+    }
+
+    // Headless rendering doesn't present, so no swap chain is needed
+    Slice<const char*> device_extensions = slice(Device_Extensions);
+    if (headless) device_extensions.count = 0;
 
     // Instance
     {
@@ -84,7 +94,10 @@ void Renderer::init()
     }
 
     // Create surface
-    surface = window->create_surface(instance).unwrap();
+    surface = VK_NULL_HANDLE;
+    if (!headless) {
+        surface = window->create_surface(instance).unwrap();
+    }
 
     // Pick physical device
     {
@@ -93,7 +106,7 @@ void Renderer::init()
         SAVE_ARENA(temp_alloc);
 
         PickPhysicalDeviceInfo pick_info = {
-            .device_extentions    = slice(Device_Extensions),
+            .device_extentions    = device_extensions,
             .prefered_device_type = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
             .surface              = surface,
         };
@@ -118,20 +131,31 @@ void Renderer::init()
                 .presentation = true,
             });
 
+        // Used by the upload queue to track completed batches
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore = {
+            .sType =
+                VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+            .pNext             = 0,
+            .timelineSemaphore = VK_TRUE,
+        };
+
         VkPhysicalDeviceShaderDrawParametersFeatures shader_draw_params = {
             .sType =
                 VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES,
-            .pNext                = 0,
+            .pNext                = &timeline_semaphore,
             .shaderDrawParameters = VK_TRUE,
         };
 
         CreateDeviceWithQueuesInfo info = {
             .surface             = surface,
-            .extensions          = slice(Device_Extensions),
+            .extensions          = device_extensions,
             .family_requirements = slice(requirements),
             .next                = (void*)&shader_draw_params,
         };
 
+        // Only the graphics queue is required when headless
+        if (headless) info.family_requirements.count = 1;
+
         if (validation_layers) {
             info.validation_layers = slice(Validation_Layers);
         }
@@ -139,7 +163,7 @@ void Renderer::init()
                      .unwrap();
 
         graphics.family     = info.families[0];
-        presentation.family = info.families[1];
+        presentation.family = headless ? graphics.family : info.families[1];
 
         vkGetDeviceQueue(device, graphics.family, 0, &graphics.queue);
         vkGetDeviceQueue(device, presentation.family, 0, &presentation.queue);
@@ -158,19 +182,23 @@ void Renderer::init()
 
     init_color_render_pass();
     recreate_swapchain();
-    init_present_render_pass();
+    if (!headless) init_present_render_pass();
 
+    record_jobs.init(record_workers);
     init_commands();
     init_input();
 
-    init_framebuffers();
+    if (!headless) init_framebuffers();
     init_sync_objects();
-    init_descriptors();
 
+    upload_queue.init(this, MEGABYTES(64));
+    mesh_pool.init(this);
     texture_system.init(allocator, this);
     shader_cache.init(allocator, device);
     material_system.init(this);
+    batch_system.init(this);
 
+    init_descriptors();
     init_default_images();
     init_pipelines();
 
@@ -214,21 +242,61 @@ void Renderer::init_commands()
                 vkAllocateCommandBuffers(device, &create_info, &cmd_buffer));
         }
 
-        // Create indirect cmd buffer
+        // Create secondary cmd buffer for the main thread's color pass draws
         {
-            frames[i].indirect_buffer =
-                VMA_CREATE_BUFFER(
-                    vma,
-                    sizeof(VkDrawIndexedIndirectCommand) *
-                        num_indirect_commands,
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
-                    VMA_MEMORY_USAGE_CPU_TO_GPU)
-                    .unwrap();
+            VkCommandBufferAllocateInfo create_info = {
+                .sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = pool,
+                .level       = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = 1,
+            };
+            VK_CHECK(vkAllocateCommandBuffers(
+                device,
+                &create_info,
+                &frames[i].color_cmd_buffer));
         }
 
+        // Create a pool & secondary cmd buffer per recording job
+        frames[i].record_pools.alloc       = &allocator;
+        frames[i].record_cmd_buffers.alloc = &allocator;
+        for (u32 j = 0; j < record_jobs.num_threads(); ++j) {
+            VkCommandPool   record_pool;
+            VkCommandBuffer record_cmd_buffer;
+
+            VkCommandPoolCreateInfo pool_info = {
+                .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                .queueFamilyIndex = graphics.family,
+            };
+            VK_CHECK(vkCreateCommandPool(device, &pool_info, 0, &record_pool));
+
+            VkCommandBufferAllocateInfo alloc_info = {
+                .sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = record_pool,
+                .level       = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = 1,
+            };
+            VK_CHECK(vkAllocateCommandBuffers(
+                device,
+                &alloc_info,
+                &record_cmd_buffer));
+
+            frames[i].record_pools.add(record_pool);
+            frames[i].record_cmd_buffers.add(record_cmd_buffer);
+        }
+
+        main_deletion_queue.add(
+            DeletionQueue::DeletionDelegate::create_lambda([this, i]() {
+                for (VkCommandPool record_pool : frames[i].record_pools) {
+                    vkDestroyCommandPool(device, record_pool, 0);
+                }
+                frames[i].record_pools.release();
+                frames[i].record_cmd_buffers.release();
+            }));
+
         frames[i].pool            = pool;
+        frames[i].deletion        = DeletionQueue(allocator);
+        frames[i].dirty_objects.alloc = &allocator;
         frames[i].main_cmd_buffer = cmd_buffer;
     }
 
@@ -301,14 +369,15 @@ void Renderer::init_descriptors()
     }
 
     // Object data buffer
+    // Grows on demand, see draw_color_pass
     {
         for (int i = 0; i < num_overlap_frames; ++i) {
             SAVE_ARENA(temp);
-            const int max_objects = 10000;
+            const int initial_objects = 1024;
             frames[i].object_buffer =
                 VMA_CREATE_BUFFER(
                     vma,
-                    sizeof(GPUObjectData) * max_objects,
+                    sizeof(GPUObjectData) * initial_objects,
                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                     VMA_MEMORY_USAGE_CPU_TO_GPU)
                     .unwrap();
@@ -316,12 +385,23 @@ void Renderer::init_descriptors()
             main_deletion_queue.add(
                 DeletionQueue::DeletionDelegate::create_lambda([this, i]() {
                     VMA_DESTROY_BUFFER(vma, frames[i].object_buffer);
+                    if (frames[i].staging_buffer.buffer != VK_NULL_HANDLE) {
+                        VMA_DESTROY_BUFFER(vma, frames[i].staging_buffer);
+                    }
                 }));
 
             VkDescriptorBufferInfo buffer_info = {
                 .buffer = frames[i].object_buffer.buffer,
                 .offset = 0,
-                .range  = sizeof(GPUObjectData) * max_objects};
+                .range  = VK_WHOLE_SIZE,
+            };
+
+            VkDescriptorBufferInfo instance_buffer_info = {
+                .buffer =
+                    batch_system.forward_pass.compacted_instance_buffer.buffer,
+                .offset = 0,
+                .range  = VK_WHOLE_SIZE,
+            };
 
             ASSERT(DescriptorBuilder::create(temp, &desc.cache, &desc.allocator)
                        .bind_buffer(
@@ -329,6 +409,11 @@ void Renderer::init_descriptors()
                            &buffer_info,
                            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                            VK_SHADER_STAGE_VERTEX_BIT)
+                       .bind_buffer(
+                           1,
+                           &instance_buffer_info,
+                           VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                           VK_SHADER_STAGE_VERTEX_BIT)
                        .build(frames[i].object_descriptor, object_set_layout));
         }
     }
@@ -350,6 +435,7 @@ void Renderer::init_pipelines()
         auto sampled_textures = arr<SampledTexture>(SampledTexture{
             .sampler = texture_system.samplers.pixel,
             .view    = t->view,
+            .texture = texture_handle,
         });
 
         MaterialData material_data = {
@@ -975,6 +1061,193 @@ void Renderer::immediate_submit(ImmediateSubmitDelegate&& submit_delegate)
     vkResetCommandPool(device, upload.pool, 0);
 }
 
+NamedIndex<RenderObject> Renderer::register_object(const RenderObject& object)
+{
+    NamedIndex<RenderObject> handle;
+
+    if (free_render_objects.size > 0) {
+        handle = *free_render_objects.last();
+        free_render_objects.pop();
+        render_objects[handle.index] = object;
+    } else {
+        handle = NamedIndex<RenderObject>{(u32)render_objects.size};
+        render_objects.add(object);
+    }
+
+    render_objects[handle.index].pass_index = -1;
+    batch_system.add_object(handle);
+    mark_object_dirty(handle);
+    return handle;
+}
+
+void Renderer::unregister_object(NamedIndex<RenderObject> handle)
+{
+    batch_system.remove_object(handle);
+
+    RenderObject& object = render_objects[handle.index];
+    object.mesh          = nullptr;
+    object.material      = nullptr;
+    free_render_objects.add(handle);
+}
+
+void Renderer::update_object(
+    NamedIndex<RenderObject> handle, const RenderObject& object)
+{
+    RenderObject& current = render_objects[handle.index];
+
+    bool needs_rebatch =
+        (current.mesh != object.mesh) || (current.material != object.material);
+
+    if (needs_rebatch) {
+        batch_system.remove_object(handle);
+        current            = object;
+        current.pass_index = -1;
+        batch_system.add_object(handle);
+    } else {
+        bool unchanged = (current.transform == object.transform) &&
+                         (current.bounds.origin == object.bounds.origin) &&
+                         (current.bounds.radius == object.bounds.radius) &&
+                         (current.bounds.extents == object.bounds.extents) &&
+                         (current.bounds.valid == object.bounds.valid);
+
+        if (unchanged) return;
+
+        i32 pass_index     = current.pass_index;
+        current            = object;
+        current.pass_index = pass_index;
+    }
+
+    mark_object_dirty(handle);
+}
+
+void Renderer::replace_texture_view(
+    VkImageView from_view, VkImageView to_view, DeletionQueue& deletion)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+
+    TArray<MaterialInstance*> changed(&temp);
+    material_system.replace_view(from_view, to_view, changed, deletion);
+    if (changed.size == 0) return;
+
+    for (u32 i = 0; i < render_objects.size; ++i) {
+        RenderObject& object = render_objects[i];
+        if (object.mesh == nullptr) continue;
+
+        bool uses_material = false;
+        for (MaterialInstance* material : changed) {
+            if (object.material == material) uses_material = true;
+        }
+
+        if (!uses_material) continue;
+
+        NamedIndex<RenderObject> handle{i};
+        batch_system.remove_object(handle);
+        object.pass_index = -1;
+        batch_system.add_object(handle);
+    }
+}
+
+void Renderer::update_texture_streaming(FrameData& frame)
+{
+    ZoneScoped;
+
+    // What's on screen changes slowly next to the frame rate, and walking
+    // every object takes a while
+    const u32 interval = glm::max(texture_system.request_interval, 1u);
+    if ((frame_num % interval) == 0) request_texture_mips();
+
+    texture_system.update(frame.deletion);
+}
+
+void Renderer::request_texture_mips()
+{
+    ZoneScoped;
+
+    texture_system.begin_requests();
+
+    // Pixels per world unit at a distance of 1, along the screen height
+    const f32 pixels_per_unit =
+        glm::abs(debug_camera.proj[1][1]) * f32(color_pass.extent.height) *
+        0.5f;
+
+    for (const RenderObject& object : render_objects) {
+        if ((object.mesh == nullptr) || (object.material == nullptr)) continue;
+        if (!object.bounds.valid) continue;
+
+        const glm::vec3 center =
+            object.transform * glm::vec4(object.bounds.origin, 1.0f);
+
+        const f32 scale = glm::max(
+            glm::length(glm::vec3(object.transform[0])),
+            glm::max(
+                glm::length(glm::vec3(object.transform[1])),
+                glm::length(glm::vec3(object.transform[2]))));
+
+        const f32 radius = object.bounds.radius * scale;
+
+        // Objects around the camera are as large as the screen gets
+        f32 distance = glm::length(center - debug_camera.position) - radius;
+        distance     = glm::max(distance, 0.1f);
+
+        const f32 screen_size = 2.0f * radius * pixels_per_unit / distance;
+
+        for (const SampledTexture& texture : object.material->textures) {
+            if (!texture.texture.is_valid()) continue;
+            texture_system.request(texture.texture, screen_size);
+        }
+    }
+}
+
+void Renderer::mark_object_dirty(NamedIndex<RenderObject> handle)
+{
+    for (int i = 0; i < num_overlap_frames; ++i) {
+        FrameData& frame = frames[i];
+        if (frame.objects_invalidated) continue;
+
+        // Past this point rewriting everything is cheaper than the list
+        if (frame.dirty_objects.size >= render_objects.size) {
+            frame.objects_invalidated = true;
+            frame.dirty_objects.size  = 0;
+            continue;
+        }
+
+        frame.dirty_objects.add(handle.index);
+    }
+}
+
+void Renderer::write_object_data(GPUObjectData* object_ssbo, u32 index)
+{
+    RenderObject& ro                 = render_objects[index];
+    object_ssbo[index].model         = ro.transform;
+    object_ssbo[index].sphere_bounds = ro.bounds.valid
+                                           ? glm::vec4(ro.bounds.origin,
+                                                       ro.bounds.radius)
+                                           : glm::vec4(0.f, 0.f, 0.f, -1.f);
+}
+
+bool Renderer::reserve_buffer(
+    AllocatedBufferBase& buffer,
+    VkDeviceSize         size,
+    VkBufferUsageFlags   usage,
+    VmaMemoryUsage       memory_usage,
+    DeletionQueue&       deletion)
+{
+    if ((buffer.buffer != VK_NULL_HANDLE) && (buffer.size >= size)) {
+        return false;
+    }
+
+    VkDeviceSize new_size = glm::max(size, buffer.size * 2);
+
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        AllocatedBufferBase old_buffer = buffer;
+        deletion.add_lambda(
+            [this, old_buffer]() { VMA_DESTROY_BUFFER(vma, old_buffer); });
+    }
+
+    buffer = VMA_CREATE_BUFFER(vma, new_size, usage, memory_usage).unwrap();
+    return true;
+}
+
 // Debug Camera
 void Renderer::on_debug_camera_forward()
 {
@@ -1049,43 +1322,6 @@ void Renderer::on_debug_camera_toggle_control()
     window->set_lock_cursor(debug_camera.has_focus);
 }
 
-bool Renderer::compact_render_objects(
-    const Slice<RenderObject>& objects, TArray<IndirectBatch>& result)
-{
-    if (objects.count < 1) return false;
-
-    IndirectBatch first_draw = {
-        .mesh     = objects[0].mesh,
-        .material = objects[0].material,
-        .first    = 0,
-        .count    = 1,
-    };
-
-    result.add(first_draw);
-
-    u64 objects_count = glm::min(objects.count, 10000ull);
-
-    for (u64 i = 1; i < objects_count; ++i) {
-        bool same_mesh     = objects[i].mesh == result.last()->mesh;
-        bool same_material = objects[i].material == result.last()->material;
-
-        if (same_mesh && same_material) {
-            result.last()->count++;
-
-        } else {
-            IndirectBatch new_draw = {
-                .mesh     = objects[i].mesh,
-                .material = objects[i].material,
-                .first    = (u32)i,
-                .count    = 1,
-            };
-            result.add(new_draw);
-        }
-    }
-
-    return true;
-}
-
 void Renderer::on_resize_presentation()
 {
     VK_CHECK(vkDeviceWaitIdle(device));
@@ -1109,129 +1345,96 @@ VkShaderModule Renderer::load_shader(Str path)
 
 void Renderer::upload_mesh(Mesh& mesh)
 {
-    const size_t staging_buffer_size =
-        mesh.vertices.size() + mesh.indices.size();
-
-    AllocatedBuffer<> staging_buffer =
-        VMA_CREATE_BUFFER(
-            vma,
-            staging_buffer_size,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_ONLY)
-            .unwrap();
+    ZoneScoped;
+    mesh.draw_mesh = mesh_pool.add(mesh);
+}
 
-    // Copy data into staging buffer
-    u8* data = (u8*)VMA_MAP(vma, staging_buffer);
-    memcpy(data, mesh.vertices.ptr, mesh.vertices.size());
-    memcpy(data + mesh.vertices.size(), mesh.indices.ptr, mesh.indices.size());
-    VMA_UNMAP(vma, staging_buffer);
+void Renderer::release_mesh(Mesh& mesh)
+{
+    mesh_pool.remove(mesh.draw_mesh);
+    mesh.draw_mesh = THandle<DrawMesh>::invalid();
+}
 
-    // Vertex Buffer
-    {
-        mesh.gpu_buffer =
-            VMA_CREATE_BUFFER(
-                vma,
-                mesh.vertices.size(),
-                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VMA_MEMORY_USAGE_GPU_ONLY)
-                .unwrap();
+void Renderer::replace_mesh(Mesh& mesh, const Mesh& replacement)
+{
+    mesh_replacements.add(MeshReplacement{&mesh, replacement});
+}
 
-        immediate_submit_lambda([=](VkCommandBuffer cmd) {
-            VkBufferCopy copy = {
-                .srcOffset = 0,
-                .dstOffset = 0,
-                .size      = mesh.vertices.size(),
-            };
-            vkCmdCopyBuffer(
-                cmd,
-                staging_buffer.buffer,
-                mesh.gpu_buffer.buffer,
-                1,
-                &copy);
-        });
+void Renderer::apply_mesh_replacements(FrameData& frame)
+{
+    ZoneScoped;
 
-        main_deletion_queue.add(DeletionQueue::DeletionDelegate::create_lambda(
-            [this, mesh]() { VMA_DESTROY_BUFFER(vma, mesh.gpu_buffer); }));
-    }
+    for (const MeshReplacement& replacement : mesh_replacements) {
+        Mesh& mesh = *replacement.mesh;
 
-    // Index Buffer
-    {
-        mesh.gpu_index_buffer =
-            VMA_CREATE_BUFFER(
-                vma,
-                mesh.indices.size(),
-                VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VMA_MEMORY_USAGE_GPU_ONLY)
-                .unwrap();
+        // Batches are keyed by the mesh data, so the objects leave them first
+        for (u32 i = 0; i < render_objects.size; ++i) {
+            if (render_objects[i].mesh != &mesh) continue;
+            batch_system.remove_object(NamedIndex<RenderObject>{i});
+        }
+
+        const THandle<DrawMesh> previous = mesh.draw_mesh;
+        mesh                             = replacement.replacement;
 
-        immediate_submit_lambda([=](VkCommandBuffer cmd) {
-            VkBufferCopy copy = {
-                .srcOffset = mesh.vertices.size(),
-                .dstOffset = 0,
-                .size      = mesh.indices.size(),
+        for (u32 i = 0; i < render_objects.size; ++i) {
+            RenderObject& object = render_objects[i];
+            if (object.mesh != &mesh) continue;
+
+            object.bounds = {
+                .origin  = mesh.bounds.origin,
+                .radius  = mesh.bounds.radius,
+                .extents = mesh.bounds.extents,
+                .valid   = mesh.bounds.radius > 0.f,
             };
-            vkCmdCopyBuffer(
-                cmd,
-                staging_buffer.buffer,
-                mesh.gpu_index_buffer.buffer,
-                1,
-                &copy);
-        });
+            object.pass_index = -1;
 
-        main_deletion_queue.add(
-            DeletionQueue::DeletionDelegate::create_lambda([this, mesh]() {
-                VMA_DESTROY_BUFFER(vma, mesh.gpu_index_buffer);
-            }));
+            NamedIndex<RenderObject> handle{i};
+            batch_system.add_object(handle);
+            mark_object_dirty(handle);
+        }
+
+        frame.deletion.add_lambda(
+            [this, previous]() { mesh_pool.remove(previous); });
     }
 
-    VMA_DESTROY_BUFFER(vma, staging_buffer);
+    mesh_replacements.size = 0;
+}
+
+Result<MappedAsset, EAssetLoadError> Renderer::map_asset(
+    Allocator& allocator, Str path)
+{
+    if (asset_files) return asset_files->map_file(allocator, path);
+    return Asset::map(allocator, path);
 }
 
 Result<AllocatedImage, VkResult> Renderer::upload_image_from_file(Str path)
 {
-    CREATE_SCOPED_ARENA(allocator, temp, MEGABYTES(5));
+    CREATE_SCOPED_ARENA(allocator, temp, KILOBYTES(64));
 
-    BufferedReadTape<true> read_tape(open_file_read(path));
-    AssetInfo              info = Asset::probe(temp, &read_tape).unwrap();
-    ASSERT(info.kind == AssetKind::Texture);
-    ASSERT(info.texture.format == TextureFormat::R8G8B8A8UInt);
+    auto map_result = map_asset(temp, path);
+    if (!map_result.ok()) {
+        print(LIT("[Renderer]: Failed to map {}\n"), path);
+        return Err(VK_ERROR_INITIALIZATION_FAILED);
+    }
 
-    VkFormat     image_format = VK_FORMAT_R8G8B8A8_SRGB;
-    VkDeviceSize image_size   = info.actual_size;
+    MappedAsset mapped = map_result.value();
+    DEFER(mapped.release());
 
-    AllocatedBuffer<> staging_buffer =
-        VMA_CREATE_BUFFER(
-            vma,
-            image_size,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_ONLY)
-            .unwrap();
+    const AssetInfo& info = mapped.info;
+    ASSERT(info.kind == AssetKind::Texture);
+    ASSERT(texture_image_format(info.texture.format) != VK_FORMAT_UNDEFINED);
 
-    void*     data = VMA_MAP(vma, staging_buffer);
-    Slice<u8> buffer_ptr((u8*)data, image_size);
-    Asset::unpack(temp, info, &read_tape, buffer_ptr).unwrap();
-    VMA_UNMAP(vma, staging_buffer);
+    VkDeviceSize image_size = info.actual_size;
 
-    VkExtent3D image_extent = {
-        .width  = (u32)info.texture.width,
-        .height = (u32)info.texture.height,
-        .depth  = 1,
-    };
+    UploadAllocation staging = upload_queue.allocate(image_size);
+    Slice<u8>        buffer_ptr((u8*)staging.ptr, image_size);
+    if (!mapped.unpack(buffer_ptr).ok()) {
+        print(LIT("[Renderer]: Failed to unpack {}\n"), path);
+        return Err(VK_ERROR_INITIALIZATION_FAILED);
+    }
 
-    VkImageCreateInfo image_create_info = {
-        .sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .pNext       = 0,
-        .imageType   = VK_IMAGE_TYPE_2D,
-        .format      = image_format,
-        .extent      = image_extent,
-        .mipLevels   = 1,
-        .arrayLayers = 1,
-        .samples     = VK_SAMPLE_COUNT_1_BIT,
-        .tiling      = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-    };
+    VkImageCreateInfo image_create_info =
+        make_texture_image_create_info(info.texture);
 
     VmaAllocationCreateInfo image_allocation_info = {
         .usage = VMA_MEMORY_USAGE_GPU_ONLY,
@@ -1247,89 +1450,17 @@ Result<AllocatedImage, VkResult> Renderer::upload_image_from_file(Str path)
         result = create_result.value();
     }
 
-    immediate_submit_lambda([&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range = {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = 1,
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        };
-
-        VkImageMemoryBarrier transfer_barrier = {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = 0,
-            .srcAccessMask    = 0,
-            .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .image            = result.image,
-            .subresourceRange = range,
-        };
-
-        vkCmdPipelineBarrier(
-            cmd,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &transfer_barrier);
-
-        VkBufferImageCopy copy_region = {
-            .bufferOffset      = 0,
-            .bufferRowLength   = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource =
-                {
-                    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .mipLevel       = 0,
-                    .baseArrayLayer = 0,
-                    .layerCount     = 1,
-                },
-            .imageExtent = image_extent,
-        };
-
-        vkCmdCopyBufferToImage(
-            cmd,
-            staging_buffer.buffer,
-            result.image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &copy_region);
-
-        VkImageMemoryBarrier layout_change_barrier = {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = 0,
-            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .image            = result.image,
-            .subresourceRange = range,
-        };
-
-        vkCmdPipelineBarrier(
-            cmd,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &layout_change_barrier);
-    });
+    VkBufferImageCopy regions[Max_Texture_Mips];
+    u32               region_count =
+        make_texture_copy_regions(info.texture, staging.offset, regions);
+    upload_queue.copy_to_image(
+        staging,
+        result.image,
+        slice(regions, region_count));
 
     main_deletion_queue.add(DeletionQueue::DeletionDelegate::create_lambda(
         [this, result]() { VMA_DESTROY_IMAGE(vma, result); }));
 
-    VMA_DESTROY_BUFFER(vma, staging_buffer);
-
     return Ok(result);
 }
 
@@ -1339,43 +1470,12 @@ Result<AllocatedImage, VkResult> Renderer::upload_image(const Asset& asset)
 
     AssetInfo info = asset.info;
     ASSERT(info.kind == AssetKind::Texture);
-    ASSERT(info.texture.format == TextureFormat::R8G8B8A8UInt);
-
-    VkFormat     image_format = VK_FORMAT_R8G8B8A8_SRGB;
-    VkDeviceSize image_size   = info.actual_size;
+    ASSERT(texture_image_format(info.texture.format) != VK_FORMAT_UNDEFINED);
 
-    AllocatedBuffer<> staging_buffer =
-        VMA_CREATE_BUFFER(
-            vma,
-            image_size,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_ONLY)
-            .unwrap();
-
-    DEFER(VMA_DESTROY_BUFFER(vma, staging_buffer));
-
-    void* data = VMA_MAP(vma, staging_buffer);
-    memcpy(data, asset.blob.ptr, image_size);
-    VMA_UNMAP(vma, staging_buffer);
+    VkDeviceSize image_size = info.actual_size;
 
-    VkExtent3D image_extent = {
-        .width  = (u32)info.texture.width,
-        .height = (u32)info.texture.height,
-        .depth  = 1,
-    };
-
-    VkImageCreateInfo image_create_info = {
-        .sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .pNext       = 0,
-        .imageType   = VK_IMAGE_TYPE_2D,
-        .format      = image_format,
-        .extent      = image_extent,
-        .mipLevels   = 1,
-        .arrayLayers = 1,
-        .samples     = VK_SAMPLE_COUNT_1_BIT,
-        .tiling      = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-    };
+    VkImageCreateInfo image_create_info =
+        make_texture_image_create_info(info.texture);
 
     VmaAllocationCreateInfo image_allocation_info = {
         .usage = VMA_MEMORY_USAGE_GPU_ONLY,
@@ -1391,83 +1491,16 @@ Result<AllocatedImage, VkResult> Renderer::upload_image(const Asset& asset)
         result = create_result.value();
     }
 
-    immediate_submit_lambda([&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range = {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = 1,
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        };
+    UploadAllocation staging = upload_queue.allocate(image_size);
+    memcpy(staging.ptr, asset.blob.ptr, image_size);
 
-        VkImageMemoryBarrier transfer_barrier = {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = 0,
-            .srcAccessMask    = 0,
-            .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .image            = result.image,
-            .subresourceRange = range,
-        };
-
-        vkCmdPipelineBarrier(
-            cmd,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &transfer_barrier);
-
-        VkBufferImageCopy copy_region = {
-            .bufferOffset      = 0,
-            .bufferRowLength   = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource =
-                {
-                    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .mipLevel       = 0,
-                    .baseArrayLayer = 0,
-                    .layerCount     = 1,
-                },
-            .imageExtent = image_extent,
-        };
-
-        vkCmdCopyBufferToImage(
-            cmd,
-            staging_buffer.buffer,
-            result.image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &copy_region);
-
-        VkImageMemoryBarrier layout_change_barrier = {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = 0,
-            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .image            = result.image,
-            .subresourceRange = range,
-        };
-
-        vkCmdPipelineBarrier(
-            cmd,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &layout_change_barrier);
-    });
+    VkBufferImageCopy regions[Max_Texture_Mips];
+    u32               region_count =
+        make_texture_copy_regions(info.texture, staging.offset, regions);
+    upload_queue.copy_to_image(
+        staging,
+        result.image,
+        slice(regions, region_count));
 
     main_deletion_queue.add(DeletionQueue::DeletionDelegate::create_lambda(
         [this, result]() { VMA_DESTROY_IMAGE(vma, result); }));
@@ -1478,6 +1511,80 @@ Result<AllocatedImage, VkResult> Renderer::upload_image(const Asset& asset)
 void Renderer::draw_color_pass(
     VkCommandBuffer cmd, FrameData& frame, u32 frame_idx)
 {
+    int frame_idx2 = frame_num % num_overlap_frames;
+
+    glm::mat4 viewproj = debug_camera.proj * debug_camera.view;
+
+    // Write global data
+    {
+        GPUGlobalInstanceData global_instance_data;
+        global_instance_data.camera = {
+            .view     = debug_camera.view,
+            .proj     = debug_camera.proj,
+            .viewproj = viewproj,
+        };
+
+        float framed               = (frame_num / 120.f);
+        global_instance_data.scene = {
+            .ambient_color = {glm::sin(framed), 0, cos(framed), 1},
+        };
+
+        u8* global_instance_data_ptr = (u8*)VMA_MAP(vma, global.buffer);
+
+        global_instance_data_ptr +=
+            pad_uniform_buffer_size(sizeof(GPUGlobalInstanceData)) * frame_idx2;
+        memcpy(
+            global_instance_data_ptr,
+            &global_instance_data,
+            sizeof(GPUGlobalInstanceData));
+
+        VMA_UNMAP(vma, global.buffer);
+    }
+
+    // Write object data
+    {
+        ZoneScopedN("Write Object Data");
+        bool reallocated = reserve_buffer(
+            frame.object_buffer,
+            sizeof(GPUObjectData) * glm::max(render_objects.size, (u64)1),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU,
+            frame.deletion);
+
+        if (reallocated) {
+            frame.objects_invalidated = true;
+        }
+
+        if (frame.objects_invalidated || (frame.dirty_objects.size > 0)) {
+            GPUObjectData* object_ssbo =
+                (GPUObjectData*)VMA_MAP(vma, frame.object_buffer);
+
+            if (frame.objects_invalidated) {
+                for (u32 i = 0; i < render_objects.size; ++i) {
+                    write_object_data(object_ssbo, i);
+                }
+            } else {
+                for (u32 index : frame.dirty_objects) {
+                    write_object_data(object_ssbo, index);
+                }
+            }
+
+            VMA_UNMAP(vma, frame.object_buffer);
+        }
+
+        frame.objects_invalidated = false;
+        frame.dirty_objects.size  = 0;
+    }
+
+    // Apply pending batch changes & cull on the GPU
+    batch_system.refresh_pass(batch_system.forward_pass);
+    batch_system.cull_pass(
+        cmd,
+        frame,
+        batch_system.forward_pass,
+        debug_camera.view,
+        debug_camera.proj);
+
     // Flash clear color
     float        flash       = abs(sinf(float(frame_num) / 120.0f));
     VkClearValue clear_value = {
@@ -1508,159 +1615,117 @@ void Renderer::draw_color_pass(
         .clearValueCount = ARRAY_COUNT(clear_values),
         .pClearValues    = clear_values,
     };
-    vkCmdBeginRenderPass(cmd, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    u32 global_offset =
+        u32(pad_uniform_buffer_size(sizeof(GPUGlobalInstanceData))) *
+        frame_idx2;
 
-    VkViewport viewport = {
-        .x        = 0,
-        .y        = 0,
-        .width    = (float)color_pass.extent.width,
-        .height   = (float)color_pass.extent.height,
-        .minDepth = 0.f,
-        .maxDepth = 1.f,
-    };
-
-    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    u32 num_multibatches = u32(batch_system.forward_pass.multibatches.size);
+    u32 num_jobs         = glm::min(
+        record_jobs.num_threads(),
+        num_multibatches / glm::max(record_min_batches, 1u));
 
-    VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
-    vkCmdSetScissor(cmd, 0, 1, &scissor);
-    int frame_idx2 = frame_num % num_overlap_frames;
-
-    // Write global data
-    {
-        GPUGlobalInstanceData global_instance_data;
-        global_instance_data.camera = {
-            .view     = debug_camera.view,
-            .proj     = debug_camera.proj,
-            .viewproj = debug_camera.proj * debug_camera.view,
-        };
-
-        float framed               = (frame_num / 120.f);
-        global_instance_data.scene = {
-            .ambient_color = {glm::sin(framed), 0, cos(framed), 1},
-        };
-
-        u8* global_instance_data_ptr = (u8*)VMA_MAP(vma, global.buffer);
+    if ((record_workers > 0) && (num_jobs > 1)) {
+        vkCmdBeginRenderPass(
+            cmd,
+            &rp_begin_info,
+            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        record_color_pass_parallel(cmd, frame, global_offset, num_jobs);
+    } else {
+        vkCmdBeginRenderPass(cmd, &rp_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        set_color_pass_viewport(cmd);
 
-        global_instance_data_ptr +=
-            pad_uniform_buffer_size(sizeof(GPUGlobalInstanceData)) * frame_idx2;
-        memcpy(
-            global_instance_data_ptr,
-            &global_instance_data,
-            sizeof(GPUGlobalInstanceData));
+        batch_system.draw_pass(
+            cmd,
+            frame,
+            batch_system.forward_pass,
+            global_offset);
 
-        VMA_UNMAP(vma, global.buffer);
+        imm.draw(cmd, debug_camera.view, debug_camera.proj);
     }
 
-    // Write object data
-    {
-        GPUObjectData* object_ssbo =
-            (GPUObjectData*)VMA_MAP(vma, frame.object_buffer);
-
-        u64 render_objects_count = glm::min(render_objects.count, 10000ull);
+    vkCmdEndRenderPass(cmd);
+}
 
-        for (u64 i = 0; i < render_objects_count; ++i) {
-            RenderObject& ro     = render_objects[i];
-            object_ssbo[i].model = ro.transform;
-        }
-        VMA_UNMAP(vma, frame.object_buffer);
-    }
+void Renderer::record_color_pass_parallel(
+    VkCommandBuffer cmd, FrameData& frame, u32 global_offset, u32 num_jobs)
+{
+    ZoneScopedN("Renderer.record_color_pass_parallel");
+
+    BatchSystem::MeshPass& pass             = batch_system.forward_pass;
+    u32                    num_multibatches = u32(pass.multibatches.size);
+
+    // Each job owns the pool of its index, whichever thread it runs on
+    record_jobs.parallel_for(num_jobs, [&](u32 job) {
+        ZoneScopedN("Record Color Pass Job");
+
+        u32 first = u32(u64(num_multibatches) * job / num_jobs);
+        u32 end   = u32(u64(num_multibatches) * (job + 1) / num_jobs);
+
+        VkCommandBuffer job_cmd = frame.record_cmd_buffers[job];
+        VK_CHECK(vkResetCommandPool(device, frame.record_pools[job], 0));
+
+        begin_color_pass_secondary(job_cmd);
+        batch_system.draw_multibatches(
+            job_cmd,
+            frame,
+            pass,
+            global_offset,
+            first,
+            end - first);
+        VK_CHECK(vkEndCommandBuffer(job_cmd));
+    });
 
-    TArray<IndirectBatch> batches(&frame_arena);
-    if (compact_render_objects(render_objects, batches)) {
-        VkDrawIndexedIndirectCommand* icmd =
-            (VkDrawIndexedIndirectCommand*)VMA_MAP(vma, frame.indirect_buffer);
-
-        u64 batch_count = glm::min(batches.size, (u64)num_indirect_commands);
-        for (int i = 0; i < batch_count; ++i) {
-            icmd[i].indexCount    = batches[i].mesh->indices.count;
-            icmd[i].instanceCount = batches[i].count;
-            icmd[i].firstIndex    = 0;
-            icmd[i].vertexOffset  = 0;
-            icmd[i].firstInstance = batches[i].first;
-        }
+    // The immediate draw queue isn't thread safe, record it here
+    begin_color_pass_secondary(frame.color_cmd_buffer);
+    imm.draw(frame.color_cmd_buffer, debug_camera.view, debug_camera.proj);
+    VK_CHECK(vkEndCommandBuffer(frame.color_cmd_buffer));
 
-        VMA_UNMAP(vma, frame.indirect_buffer);
+    Slice<VkCommandBuffer> secondaries =
+        alloc_slice<VkCommandBuffer>(frame_arena, num_jobs + 1);
+    for (u32 i = 0; i < num_jobs; ++i) {
+        secondaries[i] = frame.record_cmd_buffers[i];
+    }
+    secondaries[num_jobs] = frame.color_cmd_buffer;
 
-        for (u64 i = 0; i < batch_count; ++i) {
-            const IndirectBatch& batch = batches[i];
-            // Bind material
-            vkCmdBindPipeline(
-                cmd,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                batch.material->base->pass_shaders->pipeline);
+    vkCmdExecuteCommands(cmd, u32(secondaries.count), secondaries.ptr);
+}
 
-            u32 uniform_offsets[] = {
-                // Global
-                u32(pad_uniform_buffer_size(sizeof(GPUGlobalInstanceData))) *
-                    frame_idx2,
-            };
+void Renderer::begin_color_pass_secondary(VkCommandBuffer cmd)
+{
+    VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass  = color_pass.render_pass,
+        .subpass     = 0,
+        .framebuffer = color_pass.framebuffer,
+    };
 
-            vkCmdBindDescriptorSets(
-                cmd,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                batch.material->base->pass_shaders->layout,
-                0,
-                1,
-                &frame.global_descriptor,
-                ARRAY_COUNT(uniform_offsets),
-                uniform_offsets);
-
-            vkCmdBindDescriptorSets(
-                cmd,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                batch.material->base->pass_shaders->layout,
-                1,
-                1,
-                &frame.object_descriptor,
-                0,
-                nullptr);
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance_info,
+    };
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
 
-            if (batch.material->base->pass_shaders->effect
-                    ->num_valid_layouts() > 2)
-            {
-                // @todo: we have the benefit of knowing that the
-                // descriptorSetCount is 1 But I don't think we'll have that
-                // once we start adding more shaders.
-                vkCmdBindDescriptorSets(
-                    cmd,
-                    VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    batch.material->base->pass_shaders->layout,
-                    2,
-                    1,
-                    &batch.material->pass_sets,
-                    0,
-                    nullptr);
-            }
+    // Dynamic state isn't inherited from the primary
+    set_color_pass_viewport(cmd);
+}
 
-            // Bind mesh
-            VkDeviceSize offset = 0;
-            vkCmdBindIndexBuffer(
-                cmd,
-                batch.mesh->gpu_index_buffer.buffer,
-                offset,
-                VK_INDEX_TYPE_UINT32);
-            vkCmdBindVertexBuffers(
-                cmd,
-                0,
-                1,
-                &batch.mesh->gpu_buffer.buffer,
-                &offset);
-
-            VkDeviceSize indirect_offset =
-                batch.first * sizeof(VkDrawIndexedIndirectCommand);
-            u32 draw_stride = sizeof(VkDrawIndexedIndirectCommand);
-            vkCmdDrawIndexedIndirect(
-                cmd,
-                frame.indirect_buffer.buffer,
-                indirect_offset,
-                1,
-                draw_stride);
-        }
-    }
+void Renderer::set_color_pass_viewport(VkCommandBuffer cmd)
+{
+    VkViewport viewport = {
+        .x        = 0,
+        .y        = 0,
+        .width    = (float)color_pass.extent.width,
+        .height   = (float)color_pass.extent.height,
+        .minDepth = 0.f,
+        .maxDepth = 1.f,
+    };
 
-    imm.draw(cmd, debug_camera.view, debug_camera.proj);
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
 
-    vkCmdEndRenderPass(cmd);
+    VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
 }
 
 void Renderer::draw_present_pass(
@@ -1727,24 +1792,39 @@ void Renderer::draw()
         VK_TRUE,
         (u64)1.6 + 7));
 
+    // Resources retired the last time this frame was in flight
+    frame.deletion.flush();
+
+    // Meshes are swapped between frames, so that none draws a mix
+    apply_mesh_replacements(frame);
+
+    // Uploads recorded since the last frame go ahead of it in the queue,
+    // along with the copies of compacted mesh pages
+    upload_queue.update();
+    mesh_pool.defragment();
+    update_texture_streaming(frame);
+    upload_queue.submit();
+
     // Get next image
-    u32      next_image_index;
-    VkResult next_image_result = vkAcquireNextImageKHR(
-        device,
-        swap_chain,
-        1000000000,
-        frame.sem_present,
-        0,
-        &next_image_index);
+    u32 next_image_index = 0;
+    if (!headless) {
+        VkResult next_image_result = vkAcquireNextImageKHR(
+            device,
+            swap_chain,
+            1000000000,
+            frame.sem_present,
+            0,
+            &next_image_index);
 
-    // VK_SUBOPTIMAL_KHR considered non-error
-    if (!(next_image_result == VK_SUCCESS ||
-          next_image_result == VK_SUBOPTIMAL_KHR))
-    {
-        if (next_image_result == VK_ERROR_OUT_OF_DATE_KHR) {
-            recreate_swapchain();
-            init_framebuffers();
-            return;
+        // VK_SUBOPTIMAL_KHR considered non-error
+        if (!(next_image_result == VK_SUCCESS ||
+              next_image_result == VK_SUBOPTIMAL_KHR))
+        {
+            if (next_image_result == VK_ERROR_OUT_OF_DATE_KHR) {
+                recreate_swapchain();
+                init_framebuffers();
+                return;
+            }
         }
     }
 
@@ -1765,7 +1845,9 @@ void Renderer::draw()
 
     draw_color_pass(cmd, frame, next_image_index);
 
-    draw_present_pass(cmd, frame, next_image_index);
+    if (!headless) {
+        draw_present_pass(cmd, frame, next_image_index);
+    }
 
     vkEndCommandBuffer(cmd);
 
@@ -1776,27 +1858,29 @@ void Renderer::draw()
         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     VkSubmitInfo submit_info = {
         .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount   = 1,
+        .waitSemaphoreCount   = headless ? 0u : 1u,
         .pWaitSemaphores      = &frame.sem_present,
         .pWaitDstStageMask    = &wait_stage,
         .commandBufferCount   = 1,
         .pCommandBuffers      = &cmd,
-        .signalSemaphoreCount = 1,
+        .signalSemaphoreCount = headless ? 0u : 1u,
         .pSignalSemaphores    = &frame.sem_render,
     };
     VK_CHECK(vkQueueSubmit(graphics.queue, 1, &submit_info, frame.fnc_render));
 
     // Display image
-    VkPresentInfoKHR present_info = {
-        .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores    = &frame.sem_render,
-        .swapchainCount     = 1,
-        .pSwapchains        = &swap_chain,
-        .pImageIndices      = &next_image_index,
-    };
+    if (!headless) {
+        VkPresentInfoKHR present_info = {
+            .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores    = &frame.sem_render,
+            .swapchainCount     = 1,
+            .pSwapchains        = &swap_chain,
+            .pImageIndices      = &next_image_index,
+        };
 
-    VK_CHECK(vkQueuePresentKHR(presentation.queue, &present_info));
+        VK_CHECK(vkQueuePresentKHR(presentation.queue, &present_info));
+    }
 
     frame_num += 1;
 
@@ -1857,6 +1941,13 @@ void Renderer::recreate_swapchain()
     vkDeviceWaitIdle(device);
 
     swap_chain_deletion_queue.flush();
+
+    if (headless) {
+        extent = headless_extent;
+        resize_offscreen_buffer(extent.width, extent.height);
+        return;
+    }
+
     glm::ivec2 new_size;
     window->get_extents(new_size.x, new_size.y);
     extent = {.width = (u32)new_size.x, .height = (u32)new_size.y};
@@ -1941,11 +2032,26 @@ void Renderer::deinit()
             wait_for_fences_indefinitely(device, 1, &frames[i].fnc_render));
     }
 
+    // Deferred deletions still use the subsystems, e.g. the mesh pool for
+    // replaced meshes
+    for (int i = 0; i < num_overlap_frames; ++i) {
+        frames[i].deletion.flush();
+        frames[i].dirty_objects.release();
+    }
+
+    record_jobs.deinit();
+    upload_queue.deinit();
+    mesh_pool.deinit();
     imm.deinit();
+    batch_system.deinit();
     shader_cache.deinit();
     material_system.deinit();
     texture_system.deinit();
 
+    render_objects.release();
+    free_render_objects.release();
+    mesh_replacements.release();
+
     desc.cache.deinit();
     desc.allocator.deinit();
 
@@ -1953,7 +2059,7 @@ void Renderer::deinit()
     main_deletion_queue.flush();
     vma.deinit();
     vkDestroyDevice(device, 0);
-    vkDestroySurfaceKHR(instance, surface, 0);
+    if (!headless) vkDestroySurfaceKHR(instance, surface, 0);
     vkDestroyInstance(instance, 0);
 }
 
@@ -1,7 +1,9 @@
 #pragma once
 #include "AssetLibrary/AssetLibrary.h"
+#include "BatchSystem.h"
 #include "Containers/Map.h"
 #include "Core/DeletionQueue.h"
+#include "Core/JobSystem.h"
 #include "Core/MathTypes.h"
 #include "DescriptorBuilder.h"
 #include "ImmediateDrawQueue.h"
@@ -13,6 +15,7 @@
 #include "RendererTypes.h"
 #include "Shader.h"
 #include "TextureSystem.h"
+#include "UploadQueue.h"
 #include "VulkanCommon/VulkanCommon.h"
 #include "Window/Window.h"
 #include "vk_mem_alloc.h"
@@ -26,11 +29,39 @@ struct Renderer {
     bool       validation_layers = false;
     Allocator& allocator         = System_Allocator;
 
-    static constexpr int      num_overlap_frames    = 2;
-    static constexpr int      num_indirect_commands = 100;
-    bool                      is_initialized        = false;
-    VkExtent2D                extent                = {0, 0};
-    bool                      do_blit_pass          = true;
+    /**
+     * Render without a window: no surface, swap chain or present pass. Only
+     * the offscreen color pass is drawn, at headless_extent
+     */
+    bool       headless        = false;
+    VkExtent2D headless_extent = {1280, 720};
+
+    /**
+     * Worker threads that record the color pass into secondary command
+     * buffers, alongside the main thread. Zero records it into the primary
+     * command buffer, on the main thread only
+     */
+    u32 record_workers     = JobSystem::default_worker_count();
+    /**
+     * Minimum multibatches per recording job; passes with fewer than twice as
+     * many are recorded on the main thread only
+     */
+    u32 record_min_batches = 64;
+
+    /**
+     * Where asset files are mapped from by path, e.g. the pak of the asset
+     * system. Loose files are mapped without one. Set before init
+     */
+    IAssetFileSource* asset_files = nullptr;
+
+    /** Maps the asset file at path, see asset_files */
+    Result<MappedAsset, EAssetLoadError> map_asset(
+        Allocator& allocator, Str path);
+
+    static constexpr int      num_overlap_frames = 2;
+    bool                      is_initialized     = false;
+    VkExtent2D                extent             = {0, 0};
+    bool                      do_blit_pass       = true;
     Arena<ArenaMode::Dynamic> frame_arena;
     VMA                       vma;
 
@@ -48,6 +79,10 @@ struct Renderer {
     MaterialSystem material_system;
     TextureSystem  texture_system;
     ShaderCache    shader_cache;
+    BatchSystem    batch_system;
+    UploadQueue    upload_queue;
+    MeshPool       mesh_pool;
+    JobSystem      record_jobs;
 
     using Hook = MulticastDelegate<Renderer*>;
     struct {
@@ -97,7 +132,12 @@ struct Renderer {
     DeletionQueue swap_chain_deletion_queue;
 
     // Scene Management
-    Slice<RenderObject> render_objects;
+    /**
+     * Persistent render objects. The index of an object is also its slot in
+     * the object buffer; unregistered slots have a null mesh and get reused
+     */
+    TArray<RenderObject>             render_objects;
+    TArray<NamedIndex<RenderObject>> free_render_objects;
 
     // Immediate
     ImmediateDrawQueue imm;
@@ -152,7 +192,21 @@ struct Renderer {
      */
     void                             update();
     VkShaderModule                   load_shader(Str path);
+    /**
+     * Allocates the mesh in the mesh pool and queues its upload. The mesh
+     * can be drawn right away, mesh.upload tells when the copy is complete
+     */
     void                             upload_mesh(Mesh& mesh);
+    /** Frees the mesh from the mesh pool, once nothing draws it anymore */
+    void                             release_mesh(Mesh& mesh);
+    /**
+     * Swaps the data of mesh for replacement, uploaded with upload_mesh, at
+     * the start of the next frame. The objects that draw mesh are rebatched
+     * and take its new bounds. The previous data is freed once the frames
+     * that may still draw it are done
+     */
+    void                             replace_mesh(
+                                    Mesh& mesh, const Mesh& replacement);
     Result<AllocatedImage, VkResult> upload_image_from_file(Str path);
     Result<AllocatedImage, VkResult> upload_image(const Asset& asset);
 
@@ -169,6 +223,40 @@ struct Renderer {
 
     void immediate_submit(ImmediateSubmitDelegate&& submit_delegate);
 
+    NamedIndex<RenderObject> register_object(const RenderObject& object);
+    void                     unregister_object(NamedIndex<RenderObject> handle);
+
+    /**
+     * Replaces the data of a registered object. It is only rebatched if its
+     * mesh or material changed, and only reuploaded if anything changed at
+     * all
+     */
+    void update_object(
+        NamedIndex<RenderObject> handle, const RenderObject& object);
+
+    /**
+     * Points the materials that sample from_view to to_view, and rebatches
+     * the objects that use them, since material sets are part of the batch
+     * keys. Called by the texture system when a texture is streamed
+     * @param deletion Retires the replaced material sets
+     */
+    void replace_texture_view(
+        VkImageView from_view, VkImageView to_view, DeletionQueue& deletion);
+
+    /**
+     * Makes sure that buffer can hold at least size bytes, reallocating it
+     * (with geometric growth) if needed. The previous buffer is destroyed via
+     * deletion, so that it can outlive the frames that still reference it.
+     * Contents are not preserved.
+     * @return true if the buffer was reallocated
+     */
+    bool reserve_buffer(
+        AllocatedBufferBase& buffer,
+        VkDeviceSize         size,
+        VkBufferUsageFlags   usage,
+        VmaMemoryUsage       memory_usage,
+        DeletionQueue&       deletion);
+
 private:
     void init_present_render_pass();
     void init_color_render_pass();
@@ -187,6 +275,42 @@ private:
 
     size_t pad_uniform_buffer_size(size_t original_size);
 
+    /** Queues the object for upload in the object buffer of every frame */
+    void mark_object_dirty(NamedIndex<RenderObject> handle);
+    void write_object_data(GPUObjectData* object_ssbo, u32 index);
+
+    /**
+     * Requests texture mips every TextureSystem::request_interval frames,
+     * and streams them in
+     */
+    void update_texture_streaming(FrameData& frame);
+
+    /**
+     * Requests the mips of the textures of every object, from the size of its
+     * bounds on screen
+     */
+    void request_texture_mips();
+
+    struct MeshReplacement {
+        Mesh* mesh;
+        Mesh  replacement;
+    };
+
+    /** Replacements since the last frame, see replace_mesh */
+    TArray<MeshReplacement> mesh_replacements;
+
+    void apply_mesh_replacements(FrameData& frame);
+
+    /**
+     * Records the color pass draws into secondary command buffers, spread
+     * among the recording jobs, and executes them from cmd. Has to be called
+     * inside the color render pass, begun with secondary buffer contents
+     */
+    void record_color_pass_parallel(
+        VkCommandBuffer cmd, FrameData& frame, u32 global_offset, u32 num_jobs);
+    void begin_color_pass_secondary(VkCommandBuffer cmd);
+    void set_color_pass_viewport(VkCommandBuffer cmd);
+
     // Debug Camera
     void on_debug_camera_forward();
     void on_debug_camera_back();
@@ -198,7 +322,4 @@ private:
     void on_debug_camera_mousex(float value);
     void on_debug_camera_mousey(float value);
     void debug_camera_update_rotation();
-
-    bool compact_render_objects(
-        const Slice<RenderObject>& objects, TArray<IndirectBatch>& result);
 };
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
+#include "AssetLibrary/AssetLibrary.h"
+#include "Containers/Array.h"
+#include "Core/DeletionQueue.h"
 #include "Core/MathTypes.h"
+#include "UploadQueue.h"
 #include "VMA.h"
 #include "VulkanCommon/VulkanCommon.h"
 
@@ -11,6 +15,25 @@ struct MeshPushConstants {
 struct Texture {
     AllocatedImage image;
     VkImageView    view;
+    /** Ready once the image data is on the GPU */
+    UploadTicket   upload;
+
+    // Streaming, see TextureSystem
+    /** Asset file the mips are read from */
+    Str          path;
+    TextureAsset asset;
+    /** Finest mip in the image. Mip 0 of the image is this mip */
+    u32          resident_mip;
+    /** Coarsest resident_mip; the mips from it on are always resident */
+    u32          tail_mip;
+    /** Finest mip requested during the last update */
+    u32          requested_mip;
+    /** Round of requests the texture was last requested in */
+    u64          last_requested;
+    /** The asset changed, and is read again at the next update */
+    bool         stale;
+    /** Mips are being streamed in or out, see TextureSystem */
+    bool         streaming;
 };
 
 struct GPUCameraData {
@@ -26,6 +49,8 @@ struct GPUSceneData {
 
 struct GPUObjectData {
     glm::mat4 model;
+    /** xyz: local bounds origin, w: radius (negative if not cullable) */
+    glm::vec4 sphere_bounds;
 };
 
 struct GPUGlobalInstanceData {
@@ -41,7 +66,26 @@ struct FrameData {
     VkDescriptorSet   global_descriptor;
     AllocatedBuffer<> object_buffer;
     VkDescriptorSet   object_descriptor;
-    AllocatedBuffer<> indirect_buffer;
+    VkDescriptorSet   cull_descriptor = VK_NULL_HANDLE;
+    /** Staging memory for per-frame uploads of mesh pass data */
+    AllocatedBuffer<> staging_buffer;
+    /** Flushed once the frame's fence is signaled again */
+    DeletionQueue     deletion;
+    /**
+     * Render objects whose data changed since this frame's object buffer was
+     * last written. Ignored when objects_invalidated is set
+     */
+    TArray<u32>       dirty_objects;
+    /** Set when the whole object buffer has to be rewritten */
+    bool              objects_invalidated = true;
+    /**
+     * One command pool and secondary buffer per color pass recording job, so
+     * that jobs can record on any thread without synchronization
+     */
+    TArray<VkCommandPool>   record_pools;
+    TArray<VkCommandBuffer> record_cmd_buffers;
+    /** Secondary buffer for the main thread's part of the color pass */
+    VkCommandBuffer         color_cmd_buffer;
 };
 
 struct UploadContext {
@@ -50,13 +94,6 @@ struct UploadContext {
     VkCommandBuffer buffer;
 };
 
-struct IndirectBatch {
-    struct Mesh*             mesh;
-    struct MaterialInstance* material;
-    u32                      first;
-    u32                      count;
-};
-
 enum class MeshPassType : u8
 {
     None              = 0,
@@ -161,8 +161,10 @@ void ShaderEffect::reflect_layout(
 
         TArray<SpvReflectBlockVariable*> constants(&temp);
         constants.init_range(count);
-        result =
-            spvReflectEnumeratePushConstantBlocks(&spv_mod, &count, nullptr);
+        result = spvReflectEnumeratePushConstantBlocks(
+            &spv_mod,
+            &count,
+            constants.data);
         ASSERT(result == SPV_REFLECT_RESULT_SUCCESS);
 
         if (count > 0) {
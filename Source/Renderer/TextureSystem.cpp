@@ -1,6 +1,7 @@
 #include "TextureSystem.h"
 
 #include "AssetLibrary/AssetLibrary.h"
+#include "Core/ImageProcessing.h"
 #include "FileSystem/FileSystem.h"
 #include "Renderer.h"
 #include "tracy/Tracy.hpp"
@@ -9,12 +10,18 @@ void TextureSystem::init(Allocator& allocator, Renderer* renderer)
 {
     owner = renderer;
     textures.init(allocator);
+    streams.alloc = &allocator;
+    loaders.init(loader_threads);
 
     // Samplers
     {
         VkSamplerCreateInfo sampler_create_info =
             make_sampler_create_info(VK_FILTER_NEAREST);
 
+        // Minified textures read from the mip closest in size
+        sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        sampler_create_info.maxLod     = VK_LOD_CLAMP_NONE;
+
         VK_CHECK(vkCreateSampler(
             owner->device,
             &sampler_create_info,
@@ -23,184 +30,228 @@ void TextureSystem::init(Allocator& allocator, Renderer* renderer)
     }
 }
 
-AllocatedImage TextureSystem::load_texture_from_file(Str path)
+VkFormat texture_image_format(ETextureFormat format)
 {
-    ZoneScoped;
-
-    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(5));
-    BufferedReadTape<true> read_tape(open_file_read(path));
-
-    AssetInfo info;
-    {
-        ZoneScopedN("Probe texture asset");
-        info = Asset::probe(temp, &read_tape).unwrap();
-        ASSERT(info.kind == AssetKind::Texture);
-        ASSERT(info.texture.format == TextureFormat::R8G8B8A8UInt);
-    }
-
-    VkFormat     image_format = VK_FORMAT_R8G8B8A8_SRGB;
-    VkDeviceSize image_size   = info.actual_size;
-
-    AllocatedBuffer<> staging_buffer =
-        VMA_CREATE_BUFFER(
-            owner->vma,
-            image_size,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_ONLY)
-            .unwrap();
-
-    {
-        ZoneScopedN("Unpack texture");
-        void*     data = VMA_MAP(owner->vma, staging_buffer);
-        Slice<u8> buffer_ptr((u8*)data, image_size);
-        Asset::unpack(temp, info, &read_tape, buffer_ptr).unwrap();
-        VMA_UNMAP(owner->vma, staging_buffer);
+    switch (format) {
+        case TextureFormat::R8G8B8A8UInt:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        case TextureFormat::BC1:
+            return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case TextureFormat::BC3:
+            return VK_FORMAT_BC3_SRGB_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
     }
+}
 
-    VkExtent3D image_extent = {
-        .width  = (u32)info.texture.width,
-        .height = (u32)info.texture.height,
-        .depth  = 1,
-    };
-
-    VkImageCreateInfo image_create_info = {
-        .sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .pNext       = 0,
-        .imageType   = VK_IMAGE_TYPE_2D,
-        .format      = image_format,
-        .extent      = image_extent,
-        .mipLevels   = 1,
+VkImageCreateInfo make_texture_image_create_info(
+    const TextureAsset& texture, u32 first_mip)
+{
+    return VkImageCreateInfo{
+        .sType     = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext     = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format    = texture_image_format(texture.format),
+        .extent =
+            {
+                .width  = mip_extent(texture.width, first_mip),
+                .height = mip_extent(texture.height, first_mip),
+                .depth  = 1,
+            },
+        .mipLevels   = texture_mip_count(texture) - first_mip,
         .arrayLayers = 1,
         .samples     = VK_SAMPLE_COUNT_1_BIT,
         .tiling      = VK_IMAGE_TILING_OPTIMAL,
         .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
     };
+}
 
-    VmaAllocationCreateInfo image_allocation_info = {
-        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
-    };
-
-    AllocatedImage result =
-        VMA_CREATE_IMAGE(
-            owner->vma,
-            image_create_info,
-            VMA_MEMORY_USAGE_GPU_ONLY)
-            .unwrap();
-    owner->immediate_submit_lambda([&](VkCommandBuffer cmd) {
-        VkImageSubresourceRange range = {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = 1,
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        };
-
-        VkImageMemoryBarrier transfer_barrier = {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = 0,
-            .srcAccessMask    = 0,
-            .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .image            = result.image,
-            .subresourceRange = range,
-        };
+u32 make_texture_copy_regions(
+    const TextureAsset& texture,
+    VkDeviceSize        blob_offset,
+    VkBufferImageCopy*  regions,
+    u32                 first_mip)
+{
+    const u32 mip_count = texture_mip_count(texture);
+    ASSERT(mip_count <= Max_Texture_Mips);
+    ASSERT(first_mip < mip_count);
 
-        vkCmdPipelineBarrier(
-            cmd,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &transfer_barrier);
+    const u64 first_offset = texture_mip_offset(texture, first_mip);
+    for (u32 mip = first_mip; mip < mip_count; ++mip) {
+        const u64 offset = texture_mip_offset(texture, mip) - first_offset;
 
-        VkBufferImageCopy copy_region = {
-            .bufferOffset      = 0,
+        regions[mip - first_mip] = {
+            .bufferOffset      = blob_offset + offset,
             .bufferRowLength   = 0,
             .bufferImageHeight = 0,
             .imageSubresource =
                 {
                     .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .mipLevel       = 0,
+                    .mipLevel       = mip - first_mip,
                     .baseArrayLayer = 0,
                     .layerCount     = 1,
                 },
-            .imageExtent = image_extent,
+            .imageExtent =
+                {
+                    .width  = mip_extent(texture.width, mip),
+                    .height = mip_extent(texture.height, mip),
+                    .depth  = 1,
+                },
         };
+    }
 
-        vkCmdCopyBufferToImage(
-            cmd,
-            staging_buffer.buffer,
-            result.image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &copy_region);
-
-        VkImageMemoryBarrier layout_change_barrier = {
-            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .pNext            = 0,
-            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
-            .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            .image            = result.image,
-            .subresourceRange = range,
-        };
+    return mip_count - first_mip;
+}
 
-        vkCmdPipelineBarrier(
-            cmd,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-            0,
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &layout_change_barrier);
-    });
+/** VRAM taken by the mips of a texture from first_mip on */
+static VkDeviceSize resident_size_of(const TextureAsset& texture, u32 first_mip)
+{
+    return texture_mip_offset(texture, texture_mip_count(texture)) -
+           texture_mip_offset(texture, first_mip);
+}
+
+bool TextureSystem::load_mips(
+    const MappedAsset& mapped,
+    u32                first_mip,
+    AllocatedImage&    image,
+    UploadTicket&      ticket)
+{
+    ZoneScoped;
 
-    VMA_DESTROY_BUFFER(owner->vma, staging_buffer);
+    const TextureAsset& texture = mapped.info.texture;
+    const VkDeviceSize  size    = resident_size_of(texture, first_mip);
 
-    return result;
+    UploadAllocation staging = owner->upload_queue.allocate(size);
+
+    {
+        ZoneScopedN("Unpack texture mips");
+        CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(1));
+
+        // The staging memory is reclaimed with its batch either way
+        Slice<u8> buffer_ptr((u8*)staging.ptr, size);
+        auto      unpack_result = mapped.unpack_range(
+            temp,
+            texture_mip_offset(texture, first_mip),
+            buffer_ptr);
+        if (!unpack_result.ok()) return false;
+    }
+
+    image = upload_mips(texture, first_mip, staging, ticket);
+    return true;
 }
 
-THandle<Texture> TextureSystem::create_texture(Str path)
+AllocatedImage TextureSystem::upload_mips(
+    const TextureAsset&     texture,
+    u32                     first_mip,
+    const UploadAllocation& staging,
+    UploadTicket&           ticket)
 {
-    AllocatedImage image = load_texture_from_file(path);
+    VkImageCreateInfo image_create_info =
+        make_texture_image_create_info(texture, first_mip);
+
+    AllocatedImage result =
+        VMA_CREATE_IMAGE(
+            owner->vma,
+            image_create_info,
+            VMA_MEMORY_USAGE_GPU_ONLY)
+            .unwrap();
+
+    // Every mip in one copy
+    VkBufferImageCopy regions[Max_Texture_Mips];
+    u32               region_count =
+        make_texture_copy_regions(texture, staging.offset, regions, first_mip);
+    ticket = owner->upload_queue.copy_to_image(
+        staging,
+        result.image,
+        slice(regions, region_count));
+
+    return result;
+}
 
+VkImageView TextureSystem::create_view(const Texture& texture)
+{
     VkImageView           view;
     VkImageViewCreateInfo create_info = {
         .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .pNext    = 0,
         .flags    = 0,
-        .image    = image.image,
+        .image    = texture.image.image,
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format   = VK_FORMAT_R8G8B8A8_SRGB,
+        .format   = texture_image_format(texture.asset.format),
         .subresourceRange =
             {
-                .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                .baseMipLevel   = 0,
-                .levelCount     = 1,
+                .aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount =
+                    texture_mip_count(texture.asset) - texture.resident_mip,
                 .baseArrayLayer = 0,
                 .layerCount     = 1,
             },
     };
     VK_CHECK(vkCreateImageView(owner->device, &create_info, 0, &view));
+    return view;
+}
+
+THandle<Texture> TextureSystem::create_texture(Str path)
+{
+    ZoneScoped;
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    MappedAsset mapped;
+    {
+        ZoneScopedN("Probe texture asset");
+        auto map_result = owner->map_asset(temp, path);
+        if (!map_result.ok()) {
+            print(LIT("[Textures]: Failed to map {}\n"), path);
+            return THandle<Texture>::invalid();
+        }
+        mapped = map_result.value();
+    }
+    DEFER(mapped.release());
+
+    const AssetInfo& info = mapped.info;
+    ASSERT(info.kind == AssetKind::Texture);
+    ASSERT(texture_image_format(info.texture.format) != VK_FORMAT_UNDEFINED);
+
+    const u32 tail_mip = tail_mip_of(info.texture);
 
     Texture texture = {
-        .image = image,
-        .view  = view,
+        .asset          = info.texture,
+        .resident_mip   = tail_mip,
+        .tail_mip       = tail_mip,
+        .requested_mip  = tail_mip,
+        .last_requested = 0,
+        .stale          = false,
+        .streaming      = false,
     };
+    if (!load_mips(mapped, tail_mip, texture.image, texture.upload)) {
+        print(LIT("[Textures]: Failed to unpack {}\n"), path);
+        return THandle<Texture>::invalid();
+    }
+
+    texture.path = path.clone(System_Allocator);
+    texture.view = create_view(texture);
+
+    resident_size += resident_size_of(texture.asset, tail_mip);
 
-    u32 id = textures.create_resource(path, texture);
+    u32 id = textures.create_resource(texture.path, texture);
     return THandle<Texture>(id);
 }
 
+u32 TextureSystem::tail_mip_of(const TextureAsset& texture)
+{
+    const u32 mip_count = texture_mip_count(texture);
+    u32       tail_mip  = 0;
+    while ((tail_mip + 1 < mip_count) &&
+           ((mip_extent(texture.width, tail_mip) > mip_tail_extent) ||
+            (mip_extent(texture.height, tail_mip) > mip_tail_extent)))
+    {
+        tail_mip++;
+    }
+    return tail_mip;
+}
+
 THandle<Texture> TextureSystem::get_handle(Str path)
 {
     return textures.get_handle(path);
@@ -216,9 +267,308 @@ Texture* TextureSystem::resolve_handle(THandle<Texture> handle)
     return &textures.resolve(handle);
 }
 
+void TextureSystem::request(THandle<Texture> handle, f32 screen_size)
+{
+    Texture& texture = textures.resources[handle.id].data;
+
+    if (texture.last_requested != request_round) {
+        texture.last_requested = request_round;
+        texture.requested_mip  = texture.tail_mip;
+    }
+
+    // The finest mip that isn't smaller than the texture on screen
+    u32 mip = texture.tail_mip;
+    while ((mip > 0) &&
+           (f32(mip_extent(texture.asset.width, mip)) < screen_size) &&
+           (f32(mip_extent(texture.asset.height, mip)) < screen_size))
+    {
+        mip--;
+    }
+
+    if (mip < texture.requested_mip) texture.requested_mip = mip;
+}
+
+void TextureSystem::reload(Str path)
+{
+    THandle<Texture> handle = textures.get_handle(path);
+    if (!handle.is_valid()) return;
+
+    textures.resources[handle.id].data.stale = true;
+}
+
+void TextureSystem::update(DeletionQueue& deletion)
+{
+    ZoneScopedN("TextureSystem.update");
+
+    for (u64 i = 0; i < streams.size;) {
+        if (!advance_stream(*streams[i], deletion)) {
+            i++;
+            continue;
+        }
+
+        delete streams[i];
+        streams[i] = *streams.last();
+        streams.pop();
+    }
+
+    // Stale textures that are streaming wait for the stream to be over
+    for (auto pair : textures.resources) {
+        Texture& texture = textures.resources[pair.key].data;
+        if (texture.stale && !texture.streaming) {
+            reload_texture(texture, deletion);
+        }
+    }
+
+    for (u32 i = 0; i < max_streams_per_update; ++i) {
+        // The requested texture missing the most mips
+        u32 wanted_id      = 0;
+        u32 wanted_missing = 0;
+        for (auto pair : textures.resources) {
+            const Texture& texture = pair.val.data;
+            if (texture.last_requested != request_round) continue;
+            if (texture.requested_mip >= texture.resident_mip) continue;
+            if (texture.streaming) continue;
+
+            u32 missing = texture.resident_mip - texture.requested_mip;
+            if (missing > wanted_missing) {
+                wanted_id      = pair.key;
+                wanted_missing = missing;
+            }
+        }
+
+        if (wanted_id == 0) break;
+
+        Texture& texture = textures.resources[wanted_id].data;
+
+        const VkDeviceSize growth =
+            resident_size_of(texture.asset, texture.requested_mip) -
+            resident_size_of(texture.asset, texture.resident_mip);
+
+        while ((resident_size + growth) > budget) {
+            if (!evict_one()) break;
+        }
+
+        // Not evictable right now, so it makes do until the next round
+        if ((resident_size + growth) > budget) {
+            texture.requested_mip = texture.resident_mip;
+            continue;
+        }
+
+        if (!start_stream(wanted_id, texture.requested_mip)) {
+            texture.requested_mip = texture.resident_mip;
+        }
+    }
+}
+
+bool TextureSystem::evict_one()
+{
+    u32 evicted_id    = 0;
+    u64 evicted_round = 0;
+    for (auto pair : textures.resources) {
+        const Texture& texture = pair.val.data;
+
+        // Textures in use this round, or that someone holds, stay
+        if (texture.resident_mip == texture.tail_mip) continue;
+        if (texture.last_requested == request_round) continue;
+        if (texture.streaming) continue;
+        if (pair.val.ref_count > 0) continue;
+
+        if ((evicted_id == 0) || (texture.last_requested < evicted_round)) {
+            evicted_id    = pair.key;
+            evicted_round = texture.last_requested;
+        }
+    }
+
+    if (evicted_id == 0) return false;
+
+    Texture& texture = textures.resources[evicted_id].data;
+    return start_stream(evicted_id, texture.tail_mip);
+}
+
+bool TextureSystem::start_stream(u32 texture_id, u32 mip)
+{
+    ZoneScoped;
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    Texture& texture = textures.resources[texture_id].data;
+
+    // The texture keeps the mips it has if its asset went missing
+    auto map_result = owner->map_asset(temp, texture.path);
+    if (!map_result.ok()) {
+        print(LIT("[Textures]: Failed to map {}\n"), texture.path);
+        return false;
+    }
+
+    MipStream* stream  = new MipStream();
+    stream->texture_id = texture_id;
+    stream->mip        = mip;
+    stream->mapped     = map_result.value();
+    stream->data       = alloc_slice<u8>(
+        System_Allocator,
+        resident_size_of(texture.asset, mip));
+    streams.add(stream);
+
+    resident_size -= resident_size_of(texture.asset, texture.resident_mip);
+    resident_size += resident_size_of(texture.asset, mip);
+    texture.streaming = true;
+
+    loaders.queue(run_unpack, stream);
+    return true;
+}
+
+void TextureSystem::run_unpack(void* user)
+{
+    ZoneScopedN("Unpack texture mips");
+
+    MipStream* stream = (MipStream*)user;
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(1));
+
+    const TextureAsset& texture = stream->mapped.info.texture;
+
+    auto unpack_result = stream->mapped.unpack_range(
+        temp,
+        texture_mip_offset(texture, stream->mip),
+        stream->data);
+
+    stream->ok = unpack_result.ok();
+    stream->unpacked.store(true);
+}
+
+bool TextureSystem::advance_stream(MipStream& stream, DeletionQueue& deletion)
+{
+    if (!stream.unpacked.load()) return false;
+
+    Texture& texture = textures.resources[stream.texture_id].data;
+
+    if (!stream.uploaded) {
+        stream.mapped.release();
+
+        if (!stream.ok) {
+            print(LIT("[Textures]: Failed to unpack {}\n"), texture.path);
+            System_Allocator.release(stream.data.ptr);
+
+            resident_size -= resident_size_of(texture.asset, stream.mip);
+            resident_size +=
+                resident_size_of(texture.asset, texture.resident_mip);
+            texture.requested_mip = texture.resident_mip;
+            texture.streaming     = false;
+            return true;
+        }
+
+        UploadAllocation staging =
+            owner->upload_queue.allocate(stream.data.count);
+        memcpy(staging.ptr, stream.data.ptr, stream.data.count);
+        System_Allocator.release(stream.data.ptr);
+
+        stream.image =
+            upload_mips(texture.asset, stream.mip, staging, stream.upload);
+        stream.uploaded = true;
+    }
+
+    if (!owner->upload_queue.is_ready(stream.upload)) return false;
+
+    AllocatedImage old_image = texture.image;
+    VkImageView    old_view  = texture.view;
+
+    texture.resident_mip = stream.mip;
+    texture.image        = stream.image;
+    texture.upload       = stream.upload;
+    texture.view         = create_view(texture);
+    texture.streaming    = false;
+
+    owner->replace_texture_view(old_view, texture.view, deletion);
+
+    deletion.add_lambda([this, old_image, old_view]() {
+        vkDestroyImageView(owner->device, old_view, 0);
+        VMA_DESTROY_IMAGE(owner->vma, old_image);
+    });
+    return true;
+}
+
+void TextureSystem::reload_texture(Texture& texture, DeletionQueue& deletion)
+{
+    ZoneScoped;
+
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+    texture.stale = false;
+
+    // The previous data stays if the new asset can't be used
+    auto map_result = owner->map_asset(temp, texture.path);
+    if (!map_result.ok()) {
+        print(LIT("[Textures]: Failed to reload {}\n"), texture.path);
+        return;
+    }
+
+    MappedAsset mapped = map_result.value();
+    DEFER(mapped.release());
+
+    const AssetInfo& info = mapped.info;
+    if ((info.kind != AssetKind::Texture) ||
+        (texture_image_format(info.texture.format) == VK_FORMAT_UNDEFINED))
+    {
+        print(LIT("[Textures]: {} is not a texture\n"), texture.path);
+        return;
+    }
+
+    const u32      tail_mip = tail_mip_of(info.texture);
+    AllocatedImage image;
+    UploadTicket   upload;
+    if (!load_mips(mapped, tail_mip, image, upload)) {
+        print(LIT("[Textures]: Failed to unpack {}\n"), texture.path);
+        return;
+    }
+
+    AllocatedImage old_image = texture.image;
+    VkImageView    old_view  = texture.view;
+
+    resident_size -= resident_size_of(texture.asset, texture.resident_mip);
+
+    texture.asset         = info.texture;
+    texture.resident_mip  = tail_mip;
+    texture.tail_mip      = tail_mip;
+    texture.requested_mip = tail_mip;
+    texture.image         = image;
+    texture.upload        = upload;
+    texture.view          = create_view(texture);
+
+    resident_size += resident_size_of(texture.asset, tail_mip);
+
+    owner->replace_texture_view(old_view, texture.view, deletion);
+
+    deletion.add_lambda([this, old_image, old_view]() {
+        vkDestroyImageView(owner->device, old_view, 0);
+        VMA_DESTROY_IMAGE(owner->vma, old_image);
+    });
+}
+
 void TextureSystem::deinit()
 {
+    // Streams still unpacking finish first
+    loaders.deinit();
+
+    for (MipStream* stream : streams) {
+        if (stream->uploaded) {
+            VMA_DESTROY_IMAGE(owner->vma, stream->image);
+        } else {
+            stream->mapped.release();
+            System_Allocator.release(stream->data.ptr);
+        }
+        delete stream;
+    }
+    streams.release();
+
     vkDestroySampler(owner->device, samplers.pixel, nullptr);
 
+    for (auto pair : textures.resources) {
+        Texture& texture = pair.val.data;
+        vkDestroyImageView(owner->device, texture.view, 0);
+        VMA_DESTROY_IMAGE(owner->vma, texture.image);
+        System_Allocator.release((umm)texture.path.data);
+    }
+
+    resident_size = 0;
     textures.deinit();
-}
\ No newline at end of file
+}
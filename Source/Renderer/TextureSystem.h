@@ -1,8 +1,57 @@
 #pragma once
+#include <atomic>
+
+#include "AssetLibrary/AssetLibrary.h"
 #include "Containers/Map.h"
 #include "Core/Handle.h"
+#include "Core/TaskQueue.h"
 #include "RendererTypes.h"
 
+/** Most mips a texture has, enough for 65536x65536 */
+static constexpr u32 Max_Texture_Mips = 17;
+
+/** Image format of a texture asset format, sampled as sRGB */
+VkFormat texture_image_format(ETextureFormat format);
+
+/**
+ * Create info of a sampled 2D image that holds the mips of a texture from
+ * first_mip on, which becomes mip 0 of the image
+ */
+VkImageCreateInfo make_texture_image_create_info(
+    const TextureAsset& texture, u32 first_mip = 0);
+
+/**
+ * Fills a copy region for each mip of an unpacked texture asset from
+ * first_mip on, whose data starts at blob_offset in the staging buffer. See
+ * UploadQueue::copy_to_image
+ * @param regions Needs room for Max_Texture_Mips
+ * @return The number of regions
+ */
+u32 make_texture_copy_regions(
+    const TextureAsset& texture,
+    VkDeviceSize        blob_offset,
+    VkBufferImageCopy*  regions,
+    u32                 first_mip = 0);
+
+/**
+ * Streams texture mips in and out of VRAM.
+ *
+ * Textures are created with their mip tail only: the mips no larger than
+ * mip_tail_extent, which stay resident for as long as the texture exists.
+ * Every few frames, the renderer requests finer mips for the textures it
+ * draws, based on their size on screen, and update streams them in by
+ * recreating the image with the extra mips. When that would go over budget,
+ * the least recently requested textures that nothing holds a reference to
+ * are shrunk back to their tail first.
+ *
+ * Streams unpack their mips on a loader thread, with Asset::unpack_range so
+ * that only the LZ4Chunked blocks of the streamed mips are decompressed.
+ * Later updates upload them, and swap the image of the texture once the
+ * upload is done, so that a frame never waits on a stream.
+ *
+ * Streaming replaces the image and view of a texture, so Texture pointers
+ * stay valid but their view doesn't outlive the frame it was read in.
+ */
 struct TextureSystem {
     void init(Allocator& allocator, struct Renderer* renderer);
     void deinit();
@@ -13,15 +62,127 @@ struct TextureSystem {
     Texture*         resolve_handle(THandle<Texture> handle);
     void             release_handle(THandle<Texture> handle);
 
+    /**
+     * Starts a new round of requests, which replaces the previous one. The
+     * textures that aren't requested again become evictable
+     */
+    void begin_requests() { request_round++; }
+
+    /**
+     * Records that the texture is drawn about screen_size pixels across, to
+     * pick the mips it needs during the following updates
+     */
+    void request(THandle<Texture> handle, f32 screen_size);
+
+    /**
+     * Reads the texture at path again at the next update, if there is one.
+     * It starts over from its mip tail, since the new asset may differ in
+     * size and mip count
+     */
+    void reload(Str path);
+
+    /**
+     * Moves the streams in flight along, and starts streaming the mips of
+     * the current round of requests, the textures missing the most mips
+     * first, evicting to stay within budget. Called every frame, before the
+     * uploads of the frame are submitted
+     * @param deletion Destroys the replaced images, once the frames that may
+     * still sample them are done
+     */
+    void update(DeletionQueue& deletion);
+
     struct {
         VkSampler pixel;
     } samplers;
 
+    /** VRAM the textures may take before the least recently used are evicted */
+    VkDeviceSize budget                 = MEGABYTES(256);
+    /** Largest extent of the mips that are loaded with the texture */
+    u32          mip_tail_extent        = 64;
+    /** Most textures streamed in per update, to bound its time */
+    u32          max_streams_per_update = 4;
+    /** Frames between two rounds of requests by the renderer */
+    u32          request_interval       = 8;
+    /** Threads that unpack streamed mips. Set before init */
+    u32          loader_threads         = 1;
+    /** VRAM taken by the resident mips of every texture */
+    VkDeviceSize resident_size          = 0;
+
 private:
+    /** The mips of a texture from mip on, on their way to replace its image */
+    struct MipStream {
+        u32               texture_id;
+        u32               mip;
+        MappedAsset       mapped;
+        /** The unpacked mips, until they're uploaded */
+        Slice<u8>         data;
+        /** Set by the loader thread once data is unpacked, or failed to */
+        std::atomic<bool> unpacked = false;
+        bool              ok       = false;
+        bool              uploaded = false;
+        AllocatedImage    image;
+        UploadTicket      upload;
+    };
+
     struct Renderer*            owner;
     THandleSystem<Str, Texture> textures;
+    TaskQueue                   loaders;
+    TArray<MipStream*>          streams;
+    u64                         request_round = 1;
+
+    /**
+     * Creates an image with the mips of the texture from first_mip on, and
+     * queues their upload. Blocks on unpacking them, so it's meant for the
+     * small mips of the tail
+     * @return false if they couldn't be unpacked
+     */
+    bool load_mips(
+        const MappedAsset& mapped,
+        u32                first_mip,
+        AllocatedImage&    image,
+        UploadTicket&      ticket);
+
+    /**
+     * Creates an image with the mips of texture from first_mip on, and queues
+     * their copy from staging
+     */
+    AllocatedImage upload_mips(
+        const TextureAsset&     texture,
+        u32                     first_mip,
+        const UploadAllocation& staging,
+        UploadTicket&           ticket);
+
+    VkImageView create_view(const Texture& texture);
+
+    /** The first mip that fits in mip_tail_extent */
+    u32 tail_mip_of(const TextureAsset& texture);
+
+    /** Recreates a stale texture from its asset, see reload */
+    void reload_texture(Texture& texture, DeletionQueue& deletion);
+
+    /**
+     * Starts streaming the texture with the mips from mip on. It's accounted
+     * for with those from now on
+     * @return false if its asset couldn't be mapped, leaving it as it was
+     */
+    bool start_stream(u32 texture_id, u32 mip);
+
+    /**
+     * Uploads the mips of a stream once they're unpacked, and swaps them in
+     * once they're uploaded
+     * @return Whether the stream is over
+     */
+    bool advance_stream(MipStream& stream, DeletionQueue& deletion);
+
+    /** Unpacks the mips of a MipStream, on a loader thread */
+    static void run_unpack(void* user);
 
-    AllocatedImage load_texture_from_file(Str path);
+    /**
+     * Starts shrinking the least recently requested texture with streamed
+     * mips back to its tail
+     * @return false if there was nothing to evict
+     */
+    bool evict_one();
 
     static const u32 Handle_Seed = 0x26125192;
 };
\ No newline at end of file
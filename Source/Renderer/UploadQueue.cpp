@@ -0,0 +1,428 @@
+#include "UploadQueue.h"
+
+#include "Renderer.h"
+#include "tracy/Tracy.hpp"
+
+static _inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return ((value + alignment - 1) / alignment) * alignment;
+}
+
+void UploadQueue::init(Renderer* renderer, VkDeviceSize staging_size)
+{
+    owner = renderer;
+
+    VkSemaphoreTypeCreateInfo type_info = {
+        .sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext         = 0,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue  = 0,
+    };
+
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info,
+        .flags = 0,
+    };
+
+    VK_CHECK(vkCreateSemaphore(owner->device, &semaphore_info, 0, &timeline));
+
+    for (u32 i = 0; i < Num_Batches; ++i) {
+        Batch& batch = batches[i];
+
+        VkCommandPoolCreateInfo pool_info = {
+            .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = owner->graphics.family,
+        };
+        VK_CHECK(
+            vkCreateCommandPool(owner->device, &pool_info, 0, &batch.pool));
+
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = batch.pool,
+            .level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        VK_CHECK(
+            vkAllocateCommandBuffers(owner->device, &alloc_info, &batch.cmd));
+
+        batch.ring_end        = 0;
+        batch.callbacks.alloc = &owner->allocator;
+        batch.dedicated.alloc = &owner->allocator;
+    }
+
+    ring = VMA_CREATE_BUFFER(
+               owner->vma,
+               staging_size,
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VMA_MEMORY_USAGE_CPU_ONLY)
+               .unwrap();
+    ring_ptr = (u8*)VMA_MAP(owner->vma, ring);
+}
+
+void UploadQueue::deinit()
+{
+    wait(submit());
+
+    for (u32 i = 0; i < Num_Batches; ++i) {
+        vkDestroyCommandPool(owner->device, batches[i].pool, 0);
+        batches[i].callbacks.release();
+        batches[i].dedicated.release();
+    }
+
+    VMA_UNMAP(owner->vma, ring);
+    VMA_DESTROY_BUFFER(owner->vma, ring);
+    vkDestroySemaphore(owner->device, timeline, 0);
+}
+
+UploadAllocation UploadQueue::allocate(
+    VkDeviceSize size, VkDeviceSize alignment)
+{
+    ZoneScoped;
+    const VkDeviceSize capacity = ring.size;
+
+    if (size > capacity) {
+        begin_batch();
+
+        AllocatedBufferBase buffer = VMA_CREATE_BUFFER(
+                                         owner->vma,
+                                         size,
+                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                         VMA_MEMORY_USAGE_CPU_ONLY)
+                                         .unwrap();
+        batch_of(next_ticket).dedicated.add(buffer);
+
+        return UploadAllocation{
+            .ptr    = VMA_MAP(owner->vma, buffer),
+            .buffer = buffer.buffer,
+            .offset = 0,
+            .size   = size,
+        };
+    }
+
+    VkDeviceSize offset;
+    while (true) {
+        // Empty ring, start over from its beginning
+        if (ring_head == ring_tail) {
+            ring_head = ring_tail = align_up(ring_head, capacity);
+        }
+
+        offset = align_up(ring_head, alignment);
+
+        // Allocations never straddle the end of the ring
+        if ((offset % capacity) + size > capacity) {
+            offset = align_up(offset, capacity);
+        }
+
+        if ((offset + size - ring_tail) <= capacity) break;
+
+        // Out of space: flush what we have and wait for the oldest batch
+        submit();
+        wait(UploadTicket{retired_ticket + 1});
+    }
+
+    begin_batch();
+    ring_head = offset + size;
+
+    return UploadAllocation{
+        .ptr    = ring_ptr + (offset % capacity),
+        .buffer = ring.buffer,
+        .offset = offset % capacity,
+        .size   = size,
+    };
+}
+
+UploadTicket UploadQueue::copy_to_buffer(
+    const UploadAllocation& src, VkBuffer dst, VkDeviceSize dst_offset)
+{
+    begin_batch();
+
+    VkBufferCopy copy = {
+        .srcOffset = src.offset,
+        .dstOffset = dst_offset,
+        .size      = src.size,
+    };
+    vkCmdCopyBuffer(batch_of(next_ticket).cmd, src.buffer, dst, 1, &copy);
+
+    return current_ticket();
+}
+
+UploadTicket UploadQueue::copy_buffer(
+    VkBuffer src, VkBuffer dst, Slice<VkBufferCopy> regions)
+{
+    begin_batch();
+    VkCommandBuffer cmd = batch_of(next_ticket).cmd;
+
+    VkMemoryBarrier barrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext         = 0,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    vkCmdCopyBuffer(cmd, src, dst, (u32)regions.count, regions.ptr);
+
+    return current_ticket();
+}
+
+UploadTicket UploadQueue::copy_to_image(
+    const UploadAllocation& src, VkImage dst, VkExtent3D extent)
+{
+    VkBufferImageCopy region = {
+        .bufferOffset      = src.offset,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource =
+            {
+                .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel       = 0,
+                .baseArrayLayer = 0,
+                .layerCount     = 1,
+            },
+        .imageExtent = extent,
+    };
+
+    return copy_to_image(src, dst, slice(&region, 1));
+}
+
+UploadTicket UploadQueue::copy_to_image(
+    const UploadAllocation&  src,
+    VkImage                  dst,
+    Slice<VkBufferImageCopy> regions)
+{
+    begin_batch();
+    VkCommandBuffer cmd = batch_of(next_ticket).cmd;
+
+    VkImageSubresourceRange range = {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = 0,
+        .levelCount     = (u32)regions.count,
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+    };
+
+    VkImageMemoryBarrier transfer_barrier = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext            = 0,
+        .srcAccessMask    = 0,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .image            = dst,
+        .subresourceRange = range,
+    };
+
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &transfer_barrier);
+
+    vkCmdCopyBufferToImage(
+        cmd,
+        src.buffer,
+        dst,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        (u32)regions.count,
+        regions.ptr);
+
+    VkImageMemoryBarrier layout_change_barrier = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext            = 0,
+        .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .image            = dst,
+        .subresourceRange = range,
+    };
+
+    vkCmdPipelineBarrier(
+        cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &layout_change_barrier);
+
+    return current_ticket();
+}
+
+UploadTicket UploadQueue::upload_buffer(
+    VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset)
+{
+    UploadAllocation staging = allocate(size);
+    memcpy(staging.ptr, data, size);
+    return copy_to_buffer(staging, dst, dst_offset);
+}
+
+void UploadQueue::on_complete(CompletionDelegate&& delegate)
+{
+    begin_batch();
+    batch_of(next_ticket).callbacks.add(std::move(delegate));
+}
+
+UploadTicket UploadQueue::submit()
+{
+    if (!recording) return UploadTicket{next_ticket - 1};
+
+    ZoneScoped;
+    Batch& batch = batch_of(next_ticket);
+
+    // Make the uploads visible to everything submitted after this batch
+    VkMemoryBarrier barrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext         = 0,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier(
+        batch.cmd,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+
+    VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+    for (u64 i = 0; i < batch.dedicated.size; ++i) {
+        VMA_UNMAP(owner->vma, batch.dedicated[i]);
+    }
+
+    const u64 signal_value = next_ticket;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext                     = 0,
+        .waitSemaphoreValueCount   = 0,
+        .pWaitSemaphoreValues      = 0,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues    = &signal_value,
+    };
+
+    VkSubmitInfo submit_info = {
+        .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                = &timeline_info,
+        .waitSemaphoreCount   = 0,
+        .pWaitSemaphores      = 0,
+        .pWaitDstStageMask    = 0,
+        .commandBufferCount   = 1,
+        .pCommandBuffers      = &batch.cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores    = &timeline,
+    };
+    VK_CHECK(vkQueueSubmit(owner->graphics.queue, 1, &submit_info, 0));
+
+    batch.ring_end = ring_head;
+    recording      = false;
+    next_ticket++;
+
+    return UploadTicket{signal_value};
+}
+
+void UploadQueue::update() { retire(completed_value()); }
+
+void UploadQueue::wait(UploadTicket ticket)
+{
+    if (ticket.value >= next_ticket) {
+        ticket = submit();
+    }
+
+    if (ticket.value <= retired_ticket) return;
+
+    ZoneScoped;
+    VkSemaphoreWaitInfo wait_info = {
+        .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext          = 0,
+        .flags          = 0,
+        .semaphoreCount = 1,
+        .pSemaphores    = &timeline,
+        .pValues        = &ticket.value,
+    };
+    VK_CHECK(vkWaitSemaphores(owner->device, &wait_info, UINT64_MAX));
+
+    retire(completed_value());
+}
+
+bool UploadQueue::is_ready(UploadTicket ticket)
+{
+    return (ticket.value <= retired_ticket) ||
+           (ticket.value <= completed_value());
+}
+
+void UploadQueue::begin_batch()
+{
+    if (recording) return;
+
+    // The slot is reused every Num_Batches tickets
+    if (next_ticket > Num_Batches) {
+        wait(UploadTicket{next_ticket - Num_Batches});
+    }
+
+    Batch& batch = batch_of(next_ticket);
+    VK_CHECK(vkResetCommandPool(owner->device, batch.pool, 0));
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkBeginCommandBuffer(batch.cmd, &begin_info));
+
+    recording = true;
+}
+
+void UploadQueue::retire(u64 completed)
+{
+    while (retired_ticket < completed) {
+        retired_ticket++;
+        Batch& batch = batch_of(retired_ticket);
+
+        ring_tail = glm::max(ring_tail, batch.ring_end);
+
+        for (u64 i = 0; i < batch.dedicated.size; ++i) {
+            VMA_DESTROY_BUFFER(owner->vma, batch.dedicated[i]);
+        }
+        batch.dedicated.empty();
+
+        for (u64 i = 0; i < batch.callbacks.size; ++i) {
+            batch.callbacks[i].call_safe();
+        }
+        batch.callbacks.empty();
+    }
+}
+
+u64 UploadQueue::completed_value()
+{
+    u64 value = 0;
+    VK_CHECK(vkGetSemaphoreCounterValue(owner->device, timeline, &value));
+    return value;
+}
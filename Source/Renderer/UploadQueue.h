@@ -0,0 +1,141 @@
+#pragma once
+#include "Containers/Array.h"
+#include "Delegates.h"
+#include "VMA.h"
+#include "VulkanCommon/VulkanCommon.h"
+
+/**
+ * Identifies the batch an upload was recorded into. The upload (and anything
+ * else recorded in the same batch) is ready once the batch completes
+ */
+struct UploadTicket {
+    u64 value = 0;
+};
+
+/** Staging memory returned by UploadQueue::allocate */
+struct UploadAllocation {
+    void*        ptr;
+    VkBuffer     buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+};
+
+/**
+ * Records buffer and image uploads into one command buffer per batch, and
+ * submits it without waiting for the GPU. Data goes through a persistently
+ * mapped ring buffer, which is reclaimed as batches complete. Completion is
+ * tracked with a timeline semaphore whose value is the ticket of the last
+ * completed batch.
+ *
+ * Batches are submitted on the graphics queue ahead of the frame that uses
+ * them, and end with a memory barrier, so uploaded resources can be used by
+ * any command submitted afterwards, even before their ticket is ready.
+ */
+struct UploadQueue {
+    using CompletionDelegate = Delegate<void>;
+
+    void init(struct Renderer* renderer, VkDeviceSize staging_size);
+    void deinit();
+
+    /**
+     * Reserves staging memory for the current batch. Blocks if the ring is
+     * full until enough previous batches complete. Requests larger than the
+     * ring get a dedicated buffer instead.
+     *
+     * The allocation has to be copied before the next call to allocate
+     */
+    UploadAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    UploadTicket copy_to_buffer(
+        const UploadAllocation& src, VkBuffer dst, VkDeviceSize dst_offset = 0);
+
+    /**
+     * Copies regions of src to dst (e.g. to move data between buffers).
+     * Writes recorded earlier in the batch are done before src is read
+     */
+    UploadTicket copy_buffer(
+        VkBuffer src, VkBuffer dst, Slice<VkBufferCopy> regions);
+
+    /**
+     * Copies the allocation to mip 0 of a 2D color image, and transitions it
+     * to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+     */
+    UploadTicket copy_to_image(
+        const UploadAllocation& src, VkImage dst, VkExtent3D extent);
+
+    /**
+     * Copies regions of the allocation to the mips of a 2D color image in a
+     * single command, and transitions them to
+     * VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. Region i goes to mip i, and
+     * its buffer offset is in the buffer of src, past src.offset
+     */
+    UploadTicket copy_to_image(
+        const UploadAllocation&  src,
+        VkImage                  dst,
+        Slice<VkBufferImageCopy> regions);
+
+    /** Stages data and copies it to dst */
+    UploadTicket upload_buffer(
+        VkBuffer     dst,
+        const void*  data,
+        VkDeviceSize size,
+        VkDeviceSize dst_offset = 0);
+
+    /** Calls delegate once the current batch completes */
+    void on_complete(CompletionDelegate&& delegate);
+
+    FORWARD_DELEGATE_LAMBDA_TEMPLATE()
+    void on_complete_lambda(FORWARD_DELEGATE_LAMBDA_SIG(CompletionDelegate))
+    {
+        CompletionDelegate delegate =
+            FORWARD_DELEGATE_LAMBDA_CREATE(CompletionDelegate);
+        on_complete(std::move(delegate));
+    }
+
+    /**
+     * Submits the current batch, if anything was recorded
+     * @return The ticket of the last submitted batch
+     */
+    UploadTicket submit();
+
+    /** Retires completed batches, calling their completion delegates */
+    void update();
+
+    /** Submits if needed, and blocks until ticket is ready */
+    void wait(UploadTicket ticket);
+
+    bool         is_ready(UploadTicket ticket);
+    UploadTicket current_ticket() const { return UploadTicket{next_ticket}; }
+
+private:
+    static constexpr u32 Num_Batches = 3;
+
+    struct Batch {
+        VkCommandPool                pool;
+        VkCommandBuffer              cmd;
+        /** Ring offset past the last allocation of the batch */
+        VkDeviceSize                 ring_end;
+        TArray<CompletionDelegate>   callbacks;
+        /** Staging buffers of allocations that didn't fit in the ring */
+        TArray<AllocatedBufferBase>  dedicated;
+    };
+
+    void   begin_batch();
+    void   retire(u64 completed);
+    u64    completed_value();
+    Batch& batch_of(u64 ticket) { return batches[ticket % Num_Batches]; }
+
+    struct Renderer*  owner;
+    VkSemaphore       timeline = VK_NULL_HANDLE;
+    Batch             batches[Num_Batches];
+    AllocatedBuffer<> ring;
+    u8*               ring_ptr = nullptr;
+    /** Monotonic offsets, wrapped by the ring size on use */
+    VkDeviceSize      ring_head = 0;
+    VkDeviceSize      ring_tail = 0;
+    /** Ticket of the batch being recorded */
+    u64               next_ticket = 1;
+    /** Last ticket whose batch was retired */
+    u64               retired_ticket = 0;
+    bool              recording      = false;
+};
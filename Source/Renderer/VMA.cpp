@@ -48,6 +48,7 @@ Result<AllocatedBufferBase, VkResult> VMA::create_buffer(
     };
 
     AllocatedBufferBase result;
+    result.size = alloc_size;
     VK_RETURN_IF_ERR(vmaCreateBuffer(
         gpu_allocator,
         &buffer_info,
@@ -0,0 +1,121 @@
+#include "AssetLibrary/AssetLibrary.h"
+#include "Bench.h"
+#include "FileSystem/DirectoryIterator.h"
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+
+/**
+ * Loads every .asset file in directory three ways, and prints the total time
+ * of each: read through a buffered tape and unpacked (the previous
+ * Asset::load), mapped and unpacked (the current Asset::load), and mapped and
+ * used in place. In-place blobs are read in full, so that every method pays
+ * for the page faults of the whole file.
+ *
+ * Only the first load of a file hits the disk, so the directory is loaded
+ * once before timing anything.
+ */
+static void asset_bench(Str directory)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(1));
+
+    TArray<Str> paths(&System_Allocator);
+    DEFER(paths.release());
+
+    DirectoryIterator iterator = open_dir(directory);
+    FileData          it_data;
+    while (iterator.next_file(&it_data)) {
+        if (it_data.attributes != FileAttributes::File) continue;
+        if (it_data.filename.chop_left_last_of('.') != LIT(".asset")) continue;
+
+        paths.add(format(
+            temp,
+            LIT("{}/{}\0"),
+            FmtPath(directory),
+            it_data.filename));
+    }
+
+    u64 total_size = 0;
+    u64 checksum   = 0;
+
+    auto buffered_load = [&]() {
+        for (Str path : paths) {
+            BufferedReadTape<true> tape(open_file_read(path));
+
+            auto result = Asset::load(System_Allocator, &tape);
+            if (!result.ok()) continue;
+
+            Asset asset = result.value();
+            checksum += asset.blob.ptr[asset.blob.count - 1];
+            System_Allocator.release(asset.blob.ptr);
+        }
+    };
+
+    auto mapped_load = [&]() {
+        for (Str path : paths) {
+            auto result = Asset::load(System_Allocator, path);
+            if (!result.ok()) continue;
+
+            Asset asset = result.value();
+            checksum += asset.blob.ptr[asset.blob.count - 1];
+            System_Allocator.release(asset.blob.ptr);
+        }
+    };
+
+    auto in_place = [&]() {
+        for (Str path : paths) {
+            SAVE_ARENA(temp);
+
+            auto result = Asset::map(temp, path);
+            if (!result.ok()) continue;
+
+            MappedAsset mapped = result.value();
+            if (mapped.is_zero_copy()) {
+                Slice<u8> blob = mapped.blob();
+                for (u64 i = 0; i < blob.count; i += 4096) {
+                    checksum += blob.ptr[i];
+                }
+            } else {
+                Slice<u8> blob =
+                    alloc_slice<u8>(System_Allocator, mapped.info.actual_size);
+                mapped.unpack(blob).unwrap();
+                checksum += blob.ptr[blob.count - 1];
+                System_Allocator.release(blob.ptr);
+            }
+
+            total_size += mapped.mapping.data.count;
+            mapped.release();
+        }
+    };
+
+    // Warm up the page cache
+    in_place();
+
+    auto start = BenchClock::now();
+    buffered_load();
+    u64 buffered_us = elapsed_us(start);
+
+    start = BenchClock::now();
+    mapped_load();
+    u64 mapped_us = elapsed_us(start);
+
+    total_size = 0;
+    start      = BenchClock::now();
+    in_place();
+    u64 in_place_us = elapsed_us(start);
+
+    print(
+        LIT("Loaded {} assets ({} bytes) from {} (checksum {})\n"),
+        paths.size,
+        total_size,
+        directory,
+        checksum);
+    print(LIT("Buffered read + unpack: {} us\n"), buffered_us);
+    print(LIT("Mapped + unpack:        {} us\n"), mapped_us);
+    print(LIT("Mapped in place:        {} us\n"), in_place_us);
+}
+
+bool run_asset_bench(Slice<Str> args)
+{
+    asset_bench((args.count > 0) ? args[0] : LIT("Assets"));
+    return true;
+}
@@ -0,0 +1,226 @@
+#include <atomic>
+
+#include "AssetLibrary/AssetLibrary.h"
+#include "Bench.h"
+#include "Core/AsyncFileReader.h"
+#include "Core/FileStat.h"
+#include "FileSystem/Extras.h"
+#include "FileSystem/FileSystem.h"
+
+#if OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/** Evicts the file at path from the page cache. Only does anything on Linux */
+static void drop_cached_file(Str path)
+{
+#if OS_LINUX
+    CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(1));
+    Str path_cstr = format(temp, LIT("{}\0"), path);
+
+    int fd = open(path_cstr.data, O_RDONLY);
+    if (fd < 0) return;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+/** Unpacks an asset read by asset_io_bench, and adds to its checksum */
+static void unpack_read_asset(AsyncRead& read)
+{
+    std::atomic<u64>* checksum = (std::atomic<u64>*)read.user;
+    if (!read.ok) return;
+    DEFER(System_Allocator.release(read.buffer.ptr));
+
+    auto result = Asset::map_memory(System_Allocator, read.buffer);
+    if (!result.ok()) return;
+
+    MappedAsset mapped = result.value();
+
+    Slice<u8> blob = alloc_slice<u8>(System_Allocator, mapped.info.actual_size);
+    DEFER(System_Allocator.release(blob.ptr));
+
+    if (!mapped.unpack(blob).ok()) return;
+    checksum->fetch_add(blob.ptr[blob.count - 1]);
+}
+
+/**
+ * Writes count compressed assets of 4 to 64KB (once, they're kept between
+ * runs), and loads all of them three ways, with a cold and then a warm page
+ * cache: one at a time on the calling thread through a buffered tape (the
+ * blocking path), and through an AsyncFileReader with either backend, which
+ * unpacks them on workers as their reads complete.
+ *
+ * The cold runs evict every file from the page cache first, which only works
+ * on Linux; elsewhere they're as warm as the warm runs.
+ */
+static void asset_io_bench(u32 count, u32 workers)
+{
+    CREATE_SCOPED_ARENA(System_Allocator, temp, MEGABYTES(1));
+
+    create_dir(LIT("./asset-io-bench"));
+
+    TArray<Str> paths(&System_Allocator);
+    DEFER(paths.release());
+
+    u64 total_size = 0;
+    for (u32 i = 0; i < count; ++i) {
+        Str path = format(temp, LIT("./asset-io-bench/{}.asset"), i);
+        paths.add(path);
+
+        FileStat stat;
+        if (stat_file(path, stat)) {
+            total_size += stat.size;
+            continue;
+        }
+
+        // Repeats every few bytes, so that it compresses about as well as
+        // real asset data
+        Slice<u8> blob =
+            alloc_slice<u8>(System_Allocator, KILOBYTES(4 + (i * 7919) % 61));
+        DEFER(System_Allocator.release(blob.ptr));
+        for (u64 j = 0; j < blob.count; ++j) {
+            blob.ptr[j] = u8((j / 3) * (i + 1));
+        }
+
+        Asset asset = {
+            .info =
+                {
+                    .version     = 1,
+                    .kind        = AssetKind::Archive,
+                    .compression = AssetCompression::None,
+                    .actual_size = blob.count,
+                },
+            .blob = blob,
+        };
+
+        {
+            BufferedWriteTape<true> output(open_file_write(path));
+            asset.write(System_Allocator, &output, true);
+        }
+
+        if (stat_file(path, stat)) total_size += stat.size;
+    }
+
+    // Of the last run of each method, which should all be the same
+    u64 checksums[3] = {};
+
+    auto blocking_load = [&](u64& checksum) {
+        checksum = 0;
+        for (Str path : paths) {
+            BufferedReadTape<true> tape(open_file_read(path));
+
+            auto result = Asset::load(System_Allocator, &tape);
+            if (!result.ok()) continue;
+
+            Asset asset = result.value();
+            checksum += asset.blob.ptr[asset.blob.count - 1];
+            System_Allocator.release(asset.blob.ptr);
+        }
+    };
+
+    auto async_load = [&](EAsyncReadBackend backend, u64& checksum) {
+        AsyncFileReader reader;
+        reader.init(System_Allocator, backend, 64, workers);
+
+        Slice<AsyncRead> reads =
+            alloc_slice<AsyncRead>(System_Allocator, paths.size);
+        DEFER(System_Allocator.release(reads.ptr));
+
+        std::atomic<u64> sum = 0;
+        for (u64 i = 0; i < paths.size; ++i) {
+            reads[i]             = AsyncRead{};
+            reads[i].path        = paths[i];
+            reads[i].on_complete = unpack_read_asset;
+            reads[i].user        = &sum;
+        }
+
+        reader.submit(reads);
+        reader.wait();
+        reader.deinit();
+
+        checksum = sum.load();
+    };
+
+    auto time_load = [&](bool cold, auto load) -> u64 {
+        if (cold) {
+            for (Str path : paths) drop_cached_file(path);
+        } else {
+            u64 warm_up_checksum;
+            blocking_load(warm_up_checksum);
+        }
+
+        auto start = BenchClock::now();
+        load();
+        return elapsed_us(start);
+    };
+
+    auto blocking   = [&]() { blocking_load(checksums[0]); };
+    auto uring_load = [&]() {
+        async_load(AsyncReadBackend::IoUring, checksums[1]);
+    };
+    auto thread_pool = [&]() {
+        async_load(AsyncReadBackend::ThreadPool, checksums[2]);
+    };
+
+    u64 blocking_cold_us    = time_load(true, blocking);
+    u64 blocking_warm_us    = time_load(false, blocking);
+    u64 io_uring_cold_us    = time_load(true, uring_load);
+    u64 io_uring_warm_us    = time_load(false, uring_load);
+    u64 thread_pool_cold_us = time_load(true, thread_pool);
+    u64 thread_pool_warm_us = time_load(false, thread_pool);
+
+    // Falls back to the thread pool where there's no io_uring
+    AsyncFileReader probe;
+    probe.init(System_Allocator, AsyncReadBackend::IoUring, 1, 0);
+    const bool has_io_uring = probe.backend() == AsyncReadBackend::IoUring;
+    probe.deinit();
+
+    print(
+        LIT("Loaded {} assets ({} bytes) with {} workers (checksums {} {} "
+            "{})\n"),
+        paths.size,
+        total_size,
+        workers,
+        checksums[0],
+        checksums[1],
+        checksums[2]);
+    print(
+        LIT("Blocking:               cold {} us, warm {} us\n"),
+        blocking_cold_us,
+        blocking_warm_us);
+    print(
+        LIT("Async (io_uring):       cold {} us, warm {} us{}\n"),
+        io_uring_cold_us,
+        io_uring_warm_us,
+        has_io_uring ? LIT("") : LIT(" (not available, used ThreadPool)"));
+    print(
+        LIT("Async (ThreadPool):     cold {} us, warm {} us\n"),
+        thread_pool_cold_us,
+        thread_pool_warm_us);
+}
+
+bool run_asset_io_bench(Slice<Str> args)
+{
+    u32 count, workers;
+    if (!parse_bench_args(
+            args,
+            {
+                {LIT("count"),
+                 5000,
+                 LIT("Number of assets to load with each method"),
+                 &count},
+                {LIT("workers"),
+                 4,
+                 LIT("Threads that unpack the assets read asynchronously"),
+                 &workers},
+            }))
+    {
+        return false;
+    }
+
+    asset_io_bench(count, workers);
+    return true;
+}
@@ -0,0 +1,32 @@
+#include "Bench.h"
+
+#include "Arg.h"
+
+bool parse_bench_args(
+    Slice<Str> args, std::initializer_list<BenchArg> bench_args)
+{
+    ArgCollection arguments;
+    for (const BenchArg& arg : bench_args) {
+        arguments.register_arg<i32>(
+            arg.name,
+            i32(arg.default_value),
+            arg.description);
+    }
+
+    bool valid = arguments.parse_args(args);
+    for (const BenchArg& arg : bench_args) {
+        if (!valid) break;
+
+        i32 value  = *arguments.get_arg<i32>(arg.name);
+        valid      = value >= 0;
+        *arg.value = u32(value);
+    }
+
+    if (!valid) {
+        print(LIT("Invalid arguments, exiting.\n"));
+        arguments.summary();
+        return false;
+    }
+
+    return true;
+}
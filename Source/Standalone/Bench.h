@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <initializer_list>
+
+#include "Base.h"
+#include "Containers/Slice.h"
+#include "Str.h"
+
+struct Engine;
+
+/** A non-negative integer argument of a bench, e.g. -count N */
+struct BenchArg {
+    Str  name;
+    u32  default_value;
+    Str  description;
+    u32* value;
+};
+
+/**
+ * Parses the arguments of a bench into the value of each of bench_args,
+ * printing their summary if they're invalid
+ * @return false if they're invalid
+ */
+bool parse_bench_args(
+    Slice<Str> args, std::initializer_list<BenchArg> bench_args);
+
+using BenchClock = std::chrono::steady_clock;
+
+/** Microseconds since start */
+inline u64 elapsed_us(BenchClock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               BenchClock::now() - start)
+        .count();
+}
+
+// Each bench runs with the arguments that follow its command, and returns
+// false if they're invalid
+
+/** Standalone upload-bench [-count N]. Initializes the engine, headless */
+bool run_upload_bench(Engine& engine, Slice<Str> args);
+/** Standalone transform-bench [-count N] */
+bool run_transform_bench(Slice<Str> args);
+/** Standalone asset-bench [directory] */
+bool run_asset_bench(Slice<Str> args);
+/** Standalone probe-bench [-count N] */
+bool run_probe_bench(Slice<Str> args);
+/** Standalone meshlet-bench [-count N] */
+bool run_meshlet_bench(Slice<Str> args);
+/** Standalone asset-io-bench [-count N] [-workers N] */
+bool run_asset_io_bench(Slice<Str> args);
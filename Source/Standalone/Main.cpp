@@ -1,14 +1,48 @@
+#include "Arg.h"
+#include "Bench.h"
 #include "Builtin/Builtin.h"
+#include "Containers/Extras.h"
 #include "ECS/ECS.h"
 #include "Engine/Engine.h"
-#include "Renderer/Renderer.h"
 
 static struct {
     Engine engine;
 } G;
 
+static bool parse_headless(Slice<Str> args);
+
 int main(int argc, char* argv[])
 {
+    TArray<Str> args(&System_Allocator);
+    for (int i = 0; i < argc; ++i) {
+        args.add(Str(argv[i]));
+    }
+
+    // Standalone headless [-frames N] [-workers N]
+    if ((args.size > 1) && (args[1] == LIT("headless"))) {
+        if (!parse_headless(slice(args, 2))) return -1;
+    }
+
+    // Standalone <bench> [arguments], see Bench.h
+    const struct {
+        Str command;
+        bool (*run)(Slice<Str> args);
+    } benches[] = {
+        {LIT("upload-bench"),
+         [](Slice<Str> args) { return run_upload_bench(G.engine, args); }},
+        {LIT("transform-bench"), run_transform_bench},
+        {LIT("asset-bench"), run_asset_bench},
+        {LIT("probe-bench"), run_probe_bench},
+        {LIT("meshlet-bench"), run_meshlet_bench},
+        {LIT("asset-io-bench"), run_asset_io_bench},
+    };
+
+    for (const auto& bench : benches) {
+        if ((args.size > 1) && (args[1] == bench.command)) {
+            return bench.run(slice(args, 2)) ? 0 : -1;
+        }
+    }
+
     G.engine.init();
 
     {
@@ -66,4 +100,28 @@ int main(int argc, char* argv[])
     G.engine.loop();
     G.engine.deinit();
     return 0;
-}
\ No newline at end of file
+}
+
+static bool parse_headless(Slice<Str> args)
+{
+    ArgCollection arguments;
+    arguments.register_arg<i32>(
+        LIT("frames"),
+        300,
+        LIT("Number of frames to render before exiting"));
+    arguments.register_arg<i32>(
+        LIT("workers"),
+        -1,
+        LIT("Command recording worker threads (-1: one less than cores)"));
+
+    if (!arguments.parse_args(args)) {
+        print(LIT("Invalid arguments, exiting.\n"));
+        arguments.summary();
+        return false;
+    }
+
+    G.engine.headless       = true;
+    G.engine.max_frames     = (u32)*arguments.get_arg<i32>(LIT("frames"));
+    G.engine.render_workers = *arguments.get_arg<i32>(LIT("workers"));
+    return true;
+}
@@ -0,0 +1,103 @@
+#include "Bench.h"
+#include "Containers/Extras.h"
+#include "Core/Meshlets.h"
+
+/**
+ * Builds meshlets and their bounds for a square grid of about count
+ * triangles, and times each step
+ */
+static void meshlet_bench(u32 count)
+{
+    u32 size = 1;
+    while (2 * (size + 1) * (size + 1) <= count) size++;
+
+    TArray<glm::vec3> vertices(&System_Allocator);
+    TArray<u32>       indices(&System_Allocator);
+    DEFER(vertices.release());
+    DEFER(indices.release());
+
+    for (u32 y = 0; y <= size; ++y) {
+        for (u32 x = 0; x <= size; ++x) {
+            vertices.add(glm::vec3(x, y, 0));
+        }
+    }
+
+    for (u32 y = 0; y < size; ++y) {
+        for (u32 x = 0; x < size; ++x) {
+            u32 corner = y * (size + 1) + x;
+            indices.add(corner);
+            indices.add(corner + 1);
+            indices.add(corner + size + 2);
+            indices.add(corner);
+            indices.add(corner + size + 2);
+            indices.add(corner + size + 1);
+        }
+    }
+
+    Slice<Meshlet> meshlets =
+        alloc_slice<Meshlet>(System_Allocator, meshlet_bound(indices.size));
+    DEFER(System_Allocator.release((umm)meshlets.ptr));
+
+    auto start     = BenchClock::now();
+    meshlets.count = build_meshlets(
+        System_Allocator,
+        meshlets,
+        slice(indices),
+        vertices.data,
+        vertices.size,
+        sizeof(glm::vec3));
+    u64 build_us = elapsed_us(start);
+
+    start = BenchClock::now();
+    compute_meshlet_bounds(
+        meshlets,
+        slice(indices),
+        vertices.data,
+        sizeof(glm::vec3));
+    u64 bounds_us = elapsed_us(start);
+
+    // Unique vertices per meshlet, with the same marking as the builder
+    TArray<u32> owner(&System_Allocator);
+    DEFER(owner.release());
+    for (u64 i = 0; i < vertices.size; ++i) owner.add(0xFFFFFFFF);
+
+    u64 vertex_total = 0;
+    for (u64 i = 0; i < meshlets.count; ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        for (u32 j = 0; j < meshlet.index_count; ++j) {
+            u32 v = indices[meshlet.first_index + j];
+            if (owner[v] != i) {
+                owner[v] = (u32)i;
+                vertex_total++;
+            }
+        }
+    }
+
+    print(
+        LIT("Built {} meshlets from {} triangles\n"),
+        meshlets.count,
+        indices.size / 3);
+    print(
+        LIT("Average: {} vertices, {} triangles\n"),
+        vertex_total / meshlets.count,
+        indices.size / 3 / meshlets.count);
+    print(LIT("Build:  {} us\n"), build_us);
+    print(LIT("Bounds: {} us\n"), bounds_us);
+}
+
+bool run_meshlet_bench(Slice<Str> args)
+{
+    u32 count;
+    if (!parse_bench_args(
+            args,
+            {{LIT("count"),
+              1000000,
+              LIT("Number of triangles of the mesh to split into meshlets"),
+              &count}}))
+    {
+        return false;
+    }
+
+    meshlet_bench(count);
+    return true;
+}
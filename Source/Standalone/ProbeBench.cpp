@@ -0,0 +1,92 @@
+#include "AssetLibrary/AssetLibrary.h"
+#include "Bench.h"
+#include "FileSystem/Extras.h"
+#include "Memory/AllocTape.h"
+
+/**
+ * Writes count mesh assets into memory, once with JSON infos and once with
+ * binary headers, and times probing all of them. Files are left out, so that
+ * only the cost of reading the info is measured
+ */
+static void probe_bench(u32 count)
+{
+    u8 blob[64] = {};
+
+    AssetInfo info = {
+        .version     = 1,
+        .kind        = AssetKind::Mesh,
+        .compression = AssetCompression::None,
+        .actual_size = sizeof(blob),
+        .mesh =
+            {
+                .vertex_buffer_size = 2,
+                .index_buffer_size  = 3,
+                .bounds =
+                    {
+                        .origin  = glm::vec3(0.5f, 1.5f, -2.25f),
+                        .radius  = 3.75f,
+                        .extents = glm::vec3(1.f, 2.f, 3.f),
+                    },
+                .format = VertexFormat::P3fN3fC3fU2f,
+            },
+    };
+
+    auto bench = [&](bool json_info, u64& bytes) -> u64 {
+        AllocWriteTape out(System_Allocator);
+        DEFER(out.release());
+
+        TArray<u64> offsets(&System_Allocator);
+        DEFER(offsets.release());
+
+        for (u32 i = 0; i < count; ++i) {
+            Asset asset = {.info = info, .blob = slice(blob, sizeof(blob))};
+            offsets.add(out.offset);
+            asset.write(System_Allocator, &out, false, json_info);
+        }
+        offsets.add(out.offset);
+        bytes = out.offset;
+
+        CREATE_SCOPED_ARENA(System_Allocator, temp, KILOBYTES(64));
+
+        u64  checksum = 0;
+        auto start    = BenchClock::now();
+        for (u32 i = 0; i < count; ++i) {
+            SAVE_ARENA(temp);
+
+            RawReadTape input(
+                Raw{out.ptr + offsets[i], offsets[i + 1] - offsets[i]});
+
+            AssetInfo probed = Asset::probe(temp, &input).unwrap();
+            checksum += probed.blob_offset;
+        }
+        u64 us = elapsed_us(start);
+
+        ASSERT(checksum != 0);
+        return us;
+    };
+
+    u64 json_bytes, binary_bytes;
+    u64 json_us   = bench(true, json_bytes);
+    u64 binary_us = bench(false, binary_bytes);
+
+    print(LIT("Probed {} assets\n"), count);
+    print(LIT("JSON info:     {} us ({} bytes)\n"), json_us, json_bytes);
+    print(LIT("Binary header: {} us ({} bytes)\n"), binary_us, binary_bytes);
+}
+
+bool run_probe_bench(Slice<Str> args)
+{
+    u32 count;
+    if (!parse_bench_args(
+            args,
+            {{LIT("count"),
+              10000,
+              LIT("Number of assets to probe with each header format"),
+              &count}}))
+    {
+        return false;
+    }
+
+    probe_bench(count);
+    return true;
+}
@@ -0,0 +1,182 @@
+#include "Bench.h"
+#include "Builtin/Builtin.h"
+#include "Builtin/TransformSubsystem.h"
+#include "ECS/ECS.h"
+
+/**
+ * Builds a forest of count entities, with trees of up to 1000 entities that
+ * have 8 children per node, and returns the roots
+ */
+static void build_transform_forest(
+    flecs::world& world, u32 count, TArray<flecs::entity>& roots)
+{
+    const u32 tree_size = 1000;
+    const u32 fanout    = 8;
+
+    TArray<flecs::entity> tree(&System_Allocator);
+    DEFER(tree.release());
+
+    for (u32 i = 0; i < count; ++i) {
+        u32 node = i % tree_size;
+        if (node == 0) tree.size = 0;
+
+        flecs::entity e = world.entity().set<TransformComponent>(
+            make_transform_position(float(node % fanout), float(node), 0.f));
+
+        if (node == 0) {
+            roots.add(e);
+        } else {
+            e.child_of(tree[(node - 1) / fanout]);
+        }
+
+        tree.add(e);
+    }
+}
+
+/**
+ * The transform system that TransformSubsystem replaced: recomputes every
+ * entity each frame, and decomposes the world matrix
+ */
+static void legacy_apply_transform(
+    const TransformComponent* parent, TransformComponent& transform)
+{
+    if (parent) {
+        Mat4 parent_matrix = Mat4::make_transform(
+            parent->world_position,
+            parent->world_rotation,
+            parent->world_scale);
+
+        Mat4 child_matrix = Mat4::make_transform(
+            transform.position,
+            transform.rotation,
+            transform.scale);
+
+        Mat4 result              = parent_matrix * child_matrix;
+        transform.world_to_local = parent_matrix.inverse();
+        glm::vec3 world_position;
+        glm::quat world_rotation;
+        glm::vec3 world_scale;
+        glm::vec3 world_skew;
+        glm::vec4 world_perspective;
+        glm::decompose(
+            glm::mat4(result),
+            world_scale,
+            world_rotation,
+            world_position,
+            world_skew,
+            world_perspective);
+
+        transform.world_position = Vec3(world_position);
+        transform.world_rotation = Quat(world_rotation);
+        transform.world_scale    = Vec3(world_scale);
+    } else {
+        transform.world_position = Vec3(transform.position);
+        transform.world_rotation = Quat(transform.rotation);
+        transform.world_scale    = Vec3(transform.scale);
+        transform.world_to_local = Mat4::identity();
+    }
+
+    // Rebuilt by the renderer for every object
+    transform.world_matrix = Mat4::make_translate(transform.world_position) *
+                             transform.world_rotation.matrix() *
+                             Mat4::make_scale(transform.world_scale);
+}
+
+/**
+ * Times the legacy transform system against TransformPropagation on the same
+ * hierarchy: a full update, an update where nothing changed, and an update
+ * after moving a single root
+ */
+static void transform_bench(u32 count)
+{
+    const u32 frames = 100;
+
+    u64 legacy_us;
+    {
+        flecs::world          world;
+        TArray<flecs::entity> roots(&System_Allocator);
+        DEFER(roots.release());
+        build_transform_forest(world, count, roots);
+
+        auto query = world
+                         .query_builder<
+                             const TransformComponent,
+                             TransformComponent>()
+                         .term_at(1)
+                         .cascade(flecs::ChildOf)
+                         .optional()
+                         .build();
+
+        auto start = BenchClock::now();
+        for (u32 i = 0; i < frames; ++i) {
+            query.each([](const TransformComponent* parent,
+                          TransformComponent&       transform) {
+                legacy_apply_transform(parent, transform);
+            });
+        }
+        legacy_us = elapsed_us(start) / frames;
+    }
+
+    u64 full_us, steady_us, moved_us, moved_count;
+    {
+        flecs::world          world;
+        TArray<flecs::entity> roots(&System_Allocator);
+        DEFER(roots.release());
+        build_transform_forest(world, count, roots);
+
+        TransformPropagation propagation;
+        propagation.init(world);
+        DEFER(propagation.deinit());
+
+        auto start = BenchClock::now();
+        propagation.update();
+        full_us = elapsed_us(start);
+
+        start = BenchClock::now();
+        for (u32 i = 0; i < frames; ++i) {
+            propagation.update();
+        }
+        steady_us = elapsed_us(start) / frames;
+
+        moved_us    = 0;
+        moved_count = 0;
+        for (u32 i = 0; i < frames; ++i) {
+            TransformComponent* root =
+                roots[0].get_mut<TransformComponent>();
+            root->position.y += 1.f;
+            roots[0].modified<TransformComponent>();
+
+            start = BenchClock::now();
+            propagation.update();
+            moved_us += elapsed_us(start);
+            moved_count = propagation.last_update_count;
+        }
+        moved_us /= frames;
+    }
+
+    print(LIT("Transform hierarchy of {} entities\n"), count);
+    print(LIT("Legacy, every frame:       {} us\n"), legacy_us);
+    print(LIT("Propagation, full update:  {} us\n"), full_us);
+    print(LIT("Propagation, no changes:   {} us\n"), steady_us);
+    print(
+        LIT("Propagation, moved root:   {} us ({} entities)\n"),
+        moved_us,
+        moved_count);
+}
+
+bool run_transform_bench(Slice<Str> args)
+{
+    u32 count;
+    if (!parse_bench_args(
+            args,
+            {{LIT("count"),
+              100000,
+              LIT("Number of entities in the transform hierarchy"),
+              &count}}))
+    {
+        return false;
+    }
+
+    transform_bench(count);
+    return true;
+}
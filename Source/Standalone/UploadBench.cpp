@@ -0,0 +1,185 @@
+#include <chrono>
+
+#include "Bench.h"
+#include "Engine/Engine.h"
+#include "Renderer/Renderer.h"
+
+/**
+ * Uploads count copies of a generated grid mesh, once by blocking on the
+ * queue for every buffer (what Renderer::upload_mesh used to do) and once
+ * through the upload queue, and prints the wall time of each
+ */
+static void upload_bench(Engine& engine, u32 count)
+{
+    Renderer* renderer = engine.renderer;
+
+    const u32      grid         = 64;
+    TArray<Vertex> vertices(&System_Allocator);
+    TArray<u32>    indices(&System_Allocator);
+    DEFER(vertices.release());
+    DEFER(indices.release());
+
+    for (u32 y = 0; y < grid; ++y) {
+        for (u32 x = 0; x < grid; ++x) {
+            vertices.add(Vertex{
+                .position = {float(x), 0.f, float(y)},
+                .normal   = {0.f, 1.f, 0.f},
+                .color    = {1.f, 1.f, 1.f},
+                .uv       = {float(x) / grid, float(y) / grid},
+            });
+        }
+    }
+
+    for (u32 y = 0; y + 1 < grid; ++y) {
+        for (u32 x = 0; x + 1 < grid; ++x) {
+            u32 i = y * grid + x;
+            indices.add(i);
+            indices.add(i + grid);
+            indices.add(i + 1);
+            indices.add(i + 1);
+            indices.add(i + grid);
+            indices.add(i + grid + 1);
+        }
+    }
+
+    Mesh source = {
+        .vertices     = slice<u8>(
+            (u8*)vertices.data,
+            vertices.size * sizeof(Vertex)),
+        .format       = VertexFormat::P3fN3fC3fU2f,
+        .indices      = slice<u8>(
+            (u8*)indices.data,
+            indices.size * sizeof(u32)),
+        .index_format = IndexFormat::U32,
+    };
+
+    VMA& vma = renderer->vma;
+
+    // Blocking: one staging buffer and two waits per mesh
+    u64 blocking_ms;
+    {
+        TArray<AllocatedBufferBase> buffers(&System_Allocator);
+        DEFER(buffers.release());
+
+        auto start = BenchClock::now();
+        for (u32 i = 0; i < count; ++i) {
+            AllocatedBuffer<> staging_buffer =
+                VMA_CREATE_BUFFER(
+                    vma,
+                    source.vertices.size() + source.indices.size(),
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VMA_MEMORY_USAGE_CPU_ONLY)
+                    .unwrap();
+
+            u8* data = (u8*)VMA_MAP(vma, staging_buffer);
+            memcpy(data, source.vertices.ptr, source.vertices.size());
+            memcpy(
+                data + source.vertices.size(),
+                source.indices.ptr,
+                source.indices.size());
+            VMA_UNMAP(vma, staging_buffer);
+
+            AllocatedBufferBase vertex_buffer =
+                VMA_CREATE_BUFFER(
+                    vma,
+                    source.vertices.size(),
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VMA_MEMORY_USAGE_GPU_ONLY)
+                    .unwrap();
+
+            AllocatedBufferBase index_buffer =
+                VMA_CREATE_BUFFER(
+                    vma,
+                    source.indices.size(),
+                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VMA_MEMORY_USAGE_GPU_ONLY)
+                    .unwrap();
+
+            renderer->immediate_submit_lambda([&](VkCommandBuffer cmd) {
+                VkBufferCopy copy = {
+                    .srcOffset = 0,
+                    .dstOffset = 0,
+                    .size      = source.vertices.size(),
+                };
+                vkCmdCopyBuffer(
+                    cmd,
+                    staging_buffer.buffer,
+                    vertex_buffer.buffer,
+                    1,
+                    &copy);
+            });
+
+            renderer->immediate_submit_lambda([&](VkCommandBuffer cmd) {
+                VkBufferCopy copy = {
+                    .srcOffset = source.vertices.size(),
+                    .dstOffset = 0,
+                    .size      = source.indices.size(),
+                };
+                vkCmdCopyBuffer(
+                    cmd,
+                    staging_buffer.buffer,
+                    index_buffer.buffer,
+                    1,
+                    &copy);
+            });
+
+            VMA_DESTROY_BUFFER(vma, staging_buffer);
+            buffers.add(vertex_buffer);
+            buffers.add(index_buffer);
+        }
+        auto end = BenchClock::now();
+
+        blocking_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+                .count();
+
+        for (u64 i = 0; i < buffers.size; ++i) {
+            VMA_DESTROY_BUFFER(vma, buffers[i]);
+        }
+    }
+
+    // Queued: copies are batched and only waited on once, at the end
+    u64 queued_ms;
+    {
+        auto start = BenchClock::now();
+        for (u32 i = 0; i < count; ++i) {
+            Mesh mesh = source;
+            renderer->upload_mesh(mesh);
+        }
+        renderer->upload_queue.wait(renderer->upload_queue.submit());
+        auto end = BenchClock::now();
+
+        queued_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+                .count();
+    }
+
+    print(
+        LIT("Uploaded {} meshes ({} bytes each)\n"),
+        count,
+        source.vertices.size() + source.indices.size());
+    print(LIT("Blocking: {} ms\n"), blocking_ms);
+    print(LIT("Queued:   {} ms\n"), queued_ms);
+}
+
+bool run_upload_bench(Engine& engine, Slice<Str> args)
+{
+    u32 count;
+    if (!parse_bench_args(
+            args,
+            {{LIT("count"),
+              1000,
+              LIT("Number of meshes to upload with each method"),
+              &count}}))
+    {
+        return false;
+    }
+
+    engine.headless = true;
+    engine.init();
+    upload_bench(engine, count);
+    engine.deinit();
+    return true;
+}
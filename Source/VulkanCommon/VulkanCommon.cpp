@@ -97,25 +97,28 @@ Result<VkPhysicalDevice, VkResult> pick_physical_device(
             continue;
         }
 
-        // @todo: cant query willy nilly
-        auto swap_chain_support_result =
-            query_physical_device_swap_chain_support(
-                allocator,
-                device,
-                info.surface);
-
-        if (!swap_chain_support_result.ok())
-            return Err(swap_chain_support_result.err());
-
-        SwapChainSupportInfo swap_chain_support =
-            swap_chain_support_result.value();
-
-        if ((swap_chain_support.formats.size == 0) ||
-            (swap_chain_support.present_modes.size == 0))
-        {
-            // If it doesn't support swap chain with any formats or present
-            // modes, don't examine further
-            continue;
+        // Headless devices (no surface) don't need swap chain support
+        if (info.surface != VK_NULL_HANDLE) {
+            // @todo: cant query willy nilly
+            auto swap_chain_support_result =
+                query_physical_device_swap_chain_support(
+                    allocator,
+                    device,
+                    info.surface);
+
+            if (!swap_chain_support_result.ok())
+                return Err(swap_chain_support_result.err());
+
+            SwapChainSupportInfo swap_chain_support =
+                swap_chain_support_result.value();
+
+            if ((swap_chain_support.formats.size == 0) ||
+                (swap_chain_support.present_modes.size == 0))
+            {
+                // If it doesn't support swap chain with any formats or
+                // present modes, don't examine further
+                continue;
+            }
         }
 
         // Rank device type
@@ -231,11 +234,13 @@ Result<VkDevice, VkResult> create_device_with_queues(
             VkQueueFamilyProperties& family = properties[i];
 
             VkBool32 surface_supported = 0;
-            vkGetPhysicalDeviceSurfaceSupportKHR(
-                device,
-                i,
-                info.surface,
-                &surface_supported);
+            if (info.surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(
+                    device,
+                    i,
+                    info.surface,
+                    &surface_supported);
+            }
 
             if (family_requirement.flag_bits != 0) {
                 if (!(family.queueFlags & family_requirement.flag_bits))